@@ -0,0 +1,406 @@
+// Batch tessellation of the models listed in a manifest, sharded over processes or cluster nodes.
+// Each line of the manifest is
+//   model-file type[,type...] resolution[,resolution...]
+// ('#' starts a comment; relative paths are relative to the manifest). The types are named as in
+// transfinite-bench: SB, CB, GC, CR, MP, MC, C0Coons, Elastic, Polar, NSided, Harmonic and
+// Biharmonic for .lop files, GB, CornerGB and Hybrid for .gbp files, SPatch for .sp files,
+// and SuperD for .sdm files (all patches of the model).
+//
+//   transfinite-batch manifest [--shard i/N] [--output DIR] [--format cache|ply|stl|obj]
+//                              [--threads T]
+//
+// Each job (a model, a type and a resolution) belongs to one of the N shards: the jobs are
+// assigned by their estimated cost, the largest first, each to the least loaded shard.
+// Every process computes the same assignment, so the shards can be started independently,
+// e.g. one for each core or node. Without --shard, SLURM_PROCID and SLURM_NTASKS are used
+// when set (as under srun), and 0/1 otherwise.
+// With the default format, the meshes of shard i are stored in the ModelCache DIR/shard-i-of-N.tfc,
+// as entries "model/type/resolution" (with "/k" appended for the k-th patch of SuperD models)
+// tagged with the fingerprint of the model file, so on a rerun the unchanged jobs are skipped;
+// the other formats write a file for each mesh, streaming it when possible.
+// The jobs of a shard run in parallel (each evaluated serially) when there are at least T of them,
+// and one after the other (with parallel evaluation) otherwise.
+// The timing report of the shard is written to DIR/shard-i-of-N.tsv. Failed jobs are reported
+// there and on the standard error, and the exit status is 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "domain.hh"
+#include "surface-spatch.hh"
+#include "surface-superd.hh"
+
+#include "io.hh"
+#include "mesh-writer.hh"
+#include "model-cache.hh"
+#include "surface-types.hh"
+
+using namespace Transfinite;
+
+namespace {
+
+  template<typename F>
+  const F *find(const SurfaceTypes<F> &factories, const std::string &type) {
+    for (const auto &[name, factory] : factories)
+      if (name == type)
+        return &factory;
+    return nullptr;
+  }
+
+  struct Options {
+    std::string manifest, output = ".", format = "cache";
+    size_t shard = 0, shards = 1, threads = 0;
+  };
+
+  struct Job {
+    std::string model;  // as in the manifest
+    std::string path;   // of the file
+    std::string type;
+    size_t resolution;
+  };
+
+  struct Result {
+    size_t points = 0, triangles = 0;
+    double load = 0, setup = 0, eval = 0, write = 0; // ms
+    std::string status = "ok";
+  };
+
+  std::string extension(const std::string &filename) {
+    size_t dot = filename.rfind('.');
+    return dot == std::string::npos ? "" : filename.substr(dot + 1);
+  }
+
+  // The last path component without its extension
+  std::string stem(const std::string &filename) {
+    size_t slash = filename.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+    return name.substr(0, name.rfind('.'));
+  }
+
+  bool validType(const std::string &file_type, const std::string &type) {
+    if (file_type == "lop")
+      return find(curveSurfaces(), type);
+    if (file_type == "gbp")
+      return find(bezierSurfaces(), type);
+    return (file_type == "sp" && type == "SPatch") || (file_type == "sdm" && type == "SuperD");
+  }
+
+  std::vector<std::string> split(const std::string &s, char separator) {
+    std::vector<std::string> result;
+    std::istringstream stream(s);
+    std::string item;
+    while (std::getline(stream, item, separator))
+      if (!item.empty())
+        result.push_back(item);
+    return result;
+  }
+
+  // Throws ParseError for malformed lines
+  std::vector<Job> readManifest(const std::string &filename) {
+    std::ifstream f(filename);
+    if (!f.is_open())
+      throw ParseError(filename, 0, "unable to open file");
+    size_t slash = filename.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+
+    std::vector<Job> jobs;
+    std::string line;
+    for (size_t number = 1; std::getline(f, line); ++number) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream s(line);
+      std::string model, types, resolutions, rest;
+      if (!(s >> model))
+        continue;
+      if (!(s >> types >> resolutions) || (s >> rest))
+        throw ParseError(filename, number, "expected a model file, types and resolutions");
+      std::string path = model[0] == '/' ? model : directory + model;
+      for (const auto &type : split(types, ',')) {
+        if (!validType(extension(model), type))
+          throw ParseError(filename, number, "invalid type for " + model + ": " + type);
+        for (const auto &r : split(resolutions, ',')) {
+          char *end;
+          long resolution = std::strtol(r.c_str(), &end, 10);
+          if (*end != '\0' || resolution <= 0)
+            throw ParseError(filename, number, "invalid resolution: " + r);
+          jobs.push_back({ model, path, type, (size_t)resolution });
+        }
+      }
+    }
+    return jobs;
+  }
+
+  // The number of points grows with the square of the resolution
+  double cost(const Job &job) {
+    return (double)job.resolution * job.resolution;
+  }
+
+  // Longest processing time first; the result only depends on the jobs and the shard count
+  std::vector<Job> shardJobs(const std::vector<Job> &jobs, size_t shard, size_t shards) {
+    std::vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return cost(jobs[a]) > cost(jobs[b]); });
+    std::vector<double> loads(shards, 0.0);
+    std::vector<Job> result;
+    for (size_t i : order) {
+      size_t least = std::min_element(loads.begin(), loads.end()) - loads.begin();
+      loads[least] += cost(jobs[i]);
+      if (least == shard)
+        result.push_back(jobs[i]);
+    }
+    return result;
+  }
+
+  std::unique_ptr<MeshSink> writer(const std::string &format, const std::string &filename) {
+    if (format == "ply")
+      return std::make_unique<PLYWriter>(filename);
+    if (format == "stl")
+      return std::make_unique<STLWriter>(filename);
+    return std::make_unique<OBJWriter>(filename);
+  }
+
+  void writeMesh(const TriMesh &mesh, MeshSink &sink) {
+    sink.begin(mesh.points().size(), mesh.triangles().size());
+    sink.addPoints(0, mesh.points());
+    sink.addTriangles({ mesh.triangles().begin(), mesh.triangles().end() }, 0);
+    sink.end();
+  }
+
+  std::string entryName(const Job &job) {
+    return job.model + "/" + job.type + "/" + std::to_string(job.resolution);
+  }
+
+  class Shard {
+  public:
+    Shard(const Options &options)
+      : options_(options),
+        name_(options.output + "/shard-" + std::to_string(options.shard) + "-of-" +
+              std::to_string(options.shards)) {
+      if (options_.format == "cache") {
+        cache_ = std::make_unique<ModelCache>();
+        std::ifstream existing(name_ + ".tfc");
+        if (existing.is_open())
+          cache_ = std::make_unique<ModelCache>(name_ + ".tfc");
+      }
+    }
+
+    // Returns the number of failed jobs
+    size_t run(const std::vector<Job> &jobs) {
+      size_t threads = options_.threads;
+      if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+      bool parallel_jobs = threads > 1 && jobs.size() >= threads;
+      Executor job_executor = parallel_jobs ? threadExecutor(threads, 1) : serialExecutor();
+      Executor executor = parallel_jobs ? serialExecutor() : threadExecutor(threads);
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<Result> results(jobs.size());
+      job_executor(jobs.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          try {
+            run(jobs[i], executor, results[i]);
+          } catch (const std::exception &e) {
+            results[i].status = std::string("error: ") + e.what();
+          }
+        }
+      });
+      if (cache_)
+        cache_->save(name_ + ".tfc");
+      double wall = milliseconds(start);
+
+      std::ofstream f(name_ + ".tsv");
+      if (!f.is_open())
+        throw std::runtime_error("unable to open file: " + name_ + ".tsv");
+      f << "model\ttype\tresolution\tpoints\ttriangles\t"
+        << "load_ms\tsetup_ms\teval_ms\twrite_ms\tstatus\n";
+      size_t failed = 0;
+      for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto &job = jobs[i];
+        const auto &r = results[i];
+        f << job.model << '\t' << job.type << '\t' << job.resolution << '\t' << r.points << '\t'
+          << r.triangles << '\t' << r.load << '\t' << r.setup << '\t' << r.eval << '\t'
+          << r.write << '\t' << r.status << '\n';
+        if (r.status.rfind("error", 0) == 0) {
+          std::cerr << entryName(job) << ": " << r.status << std::endl;
+          ++failed;
+        }
+      }
+      f << "# shard " << options_.shard << "/" << options_.shards << ": " << jobs.size()
+        << " jobs, " << failed << " failed, " << threads << " threads"
+        << (parallel_jobs ? " (parallel jobs)" : "") << ", " << wall << " ms\n";
+      if (!f)
+        throw std::runtime_error("unable to write file: " + name_ + ".tsv");
+      std::cout << "Shard " << options_.shard << "/" << options_.shards << ": " << jobs.size()
+                << " jobs in " << wall << " ms, " << failed << " failed" << std::endl;
+      return failed;
+    }
+
+  private:
+    static double milliseconds(std::chrono::steady_clock::time_point since) {
+      auto now = std::chrono::steady_clock::now();
+      return std::chrono::duration<double, std::milli>(now - since).count();
+    }
+
+    std::string filename(const Job &job, size_t patch, size_t patches) const {
+      std::string name = options_.output + "/" + stem(job.model) + "-" + job.type + "-" +
+        std::to_string(job.resolution);
+      if (patches > 1)
+        name += "-" + std::to_string(patch);
+      return name + "." + options_.format;
+    }
+
+    void run(const Job &job, const Executor &executor, Result &result) {
+      uint64_t source = 0;
+      if (cache_) {
+        source = ModelCache::fingerprint(job.path);
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (cache_->contains(entryName(job), source) ||
+            cache_->contains(entryName(job) + "/0", source)) {
+          result.status = "cached";
+          return;
+        }
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::shared_ptr<Surface>> surfaces;
+      std::vector<SurfaceSuperD> superd;
+      if (job.type == "SuperD")
+        superd = loadSuperDModel(job.path, executor);
+      else if (job.type == "SPatch")
+        surfaces.push_back(std::make_shared<SurfaceSPatch>(loadSPatch(job.path)));
+      else if (auto factory = find(bezierSurfaces(), job.type)) {
+        auto surface = (*factory)();
+        loadBezier(job.path, surface.get());
+        surfaces.push_back(surface);
+      } else {
+        auto surface = (*find(curveSurfaces(), job.type))();
+        surface->setCurves(readLOP(job.path, executor));
+        surfaces.push_back(surface);
+      }
+      result.load = milliseconds(start);
+
+      start = std::chrono::steady_clock::now();
+      for (auto &surface : surfaces) {
+        surface->setExecutor(executor);
+        if (find(curveSurfaces(), job.type))
+          surface->setupLoop();
+        surface->update();
+      }
+      result.setup = milliseconds(start);
+
+      // Streamed directly into the files when possible
+      start = std::chrono::steady_clock::now();
+      std::vector<TriMesh> meshes;
+      if (!superd.empty())
+        meshes = SurfaceSuperD::eval(superd, job.resolution, executor);
+      else if (!cache_) {
+        auto domain = surfaces[0]->domain();
+        result.points = domain->meshLayers(job.resolution).back();
+        result.triangles = domain->meshTriangleCount(job.resolution);
+        surfaces[0]->eval(job.resolution, *writer(options_.format, filename(job, 0, 1)));
+        result.eval = milliseconds(start);
+        return;
+      } else
+        meshes.push_back(surfaces[0]->eval(job.resolution));
+      result.eval = milliseconds(start);
+      for (const auto &mesh : meshes) {
+        result.points += mesh.points().size();
+        result.triangles += mesh.triangles().size();
+      }
+
+      start = std::chrono::steady_clock::now();
+      if (cache_) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (meshes.size() == 1 && superd.empty())
+          cache_->store(entryName(job), meshes[0], {}, source);
+        else
+          for (size_t k = 0; k < meshes.size(); ++k)
+            cache_->store(entryName(job) + "/" + std::to_string(k), meshes[k], {}, source);
+      } else
+        for (size_t k = 0; k < meshes.size(); ++k)
+          writeMesh(meshes[k], *writer(options_.format, filename(job, k, meshes.size())));
+      result.write = milliseconds(start);
+    }
+
+    const Options &options_;
+    std::string name_;
+    std::unique_ptr<ModelCache> cache_;
+    std::mutex cache_mutex_;
+  };
+
+  bool parseShard(const std::string &s, size_t &shard, size_t &shards) {
+    size_t slash = s.find('/');
+    if (slash == std::string::npos)
+      return false;
+    char *end1, *end2;
+    long i = std::strtol(s.substr(0, slash).c_str(), &end1, 10);
+    long n = std::strtol(s.substr(slash + 1).c_str(), &end2, 10);
+    if (*end1 != '\0' || *end2 != '\0' || i < 0 || n <= 0 || i >= n)
+      return false;
+    shard = i;
+    shards = n;
+    return true;
+  }
+
+  bool parseOptions(int argc, char **argv, Options &options) {
+    const char *procid = std::getenv("SLURM_PROCID"), *ntasks = std::getenv("SLURM_NTASKS");
+    if (procid && ntasks &&
+        !parseShard(std::string(procid) + "/" + ntasks, options.shard, options.shards))
+      return false;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg.rfind("--", 0) != 0) {
+        if (!options.manifest.empty())
+          return false;
+        options.manifest = arg;
+      } else if (i + 1 == argc)
+        return false;
+      else if (arg == "--shard") {
+        if (!parseShard(argv[++i], options.shard, options.shards))
+          return false;
+      } else if (arg == "--output")
+        options.output = argv[++i];
+      else if (arg == "--format") {
+        options.format = argv[++i];
+        if (options.format != "cache" && options.format != "ply" && options.format != "stl" &&
+            options.format != "obj")
+          return false;
+      } else if (arg == "--threads")
+        options.threads = std::strtoul(argv[++i], nullptr, 10);
+      else
+        return false;
+    }
+    return !options.manifest.empty();
+  }
+
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage:\n"
+              << argv[0] << " manifest [--shard i/N] [--output directory]"
+              << " [--format cache|ply|stl|obj] [--threads T]" << std::endl;
+    return 1;
+  }
+
+  try {
+    auto jobs = shardJobs(readManifest(options.manifest), options.shard, options.shards);
+    Shard shard(options);
+    return shard.run(jobs) > 0 ? 1 : 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "allocations.hh"
+
+namespace Allocations {
+
+  namespace {
+
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<size_t> live{0}, peak{0};
+
+  }
+
+#ifdef TRANSFINITE_BENCH_ALLOCATIONS
+
+  namespace {
+
+    // The size is kept in a header of `align` bytes before the returned block
+    const size_t header = alignof(std::max_align_t);
+
+    void *allocate(size_t size, size_t align) {
+      align = std::max(align, header);
+      void *block = align == header ? std::malloc(size + align)
+        : std::aligned_alloc(align, (size + 2 * align - 1) / align * align);
+      if (!block)
+        return nullptr;
+      allocations.fetch_add(1, std::memory_order_relaxed);
+      size_t current = live.fetch_add(size, std::memory_order_relaxed) + size;
+      size_t max = peak.load(std::memory_order_relaxed);
+      while (current > max && !peak.compare_exchange_weak(max, current))
+        ;
+      char *result = static_cast<char *>(block) + align;
+      reinterpret_cast<size_t *>(result)[-1] = size;
+      return result;
+    }
+
+    void deallocate(void *p, size_t align) {
+      if (!p)
+        return;
+      align = std::max(align, header);
+      char *result = static_cast<char *>(p);
+      live.fetch_sub(reinterpret_cast<size_t *>(result)[-1], std::memory_order_relaxed);
+      std::free(result - align);
+    }
+
+    void *allocateOrThrow(size_t size, size_t align) {
+      while (true) {
+        if (void *p = allocate(size, align))
+          return p;
+        auto handler = std::get_new_handler();
+        if (!handler)
+          throw std::bad_alloc();
+        handler();
+      }
+    }
+
+  }
+
+  bool
+  enabled() {
+    return true;
+  }
+
+#else
+
+  bool
+  enabled() {
+    return false;
+  }
+
+#endif
+
+  uint64_t
+  count() {
+    return allocations.load();
+  }
+
+  size_t
+  liveBytes() {
+    return live.load();
+  }
+
+  size_t
+  peakBytes() {
+    return peak.load();
+  }
+
+  void
+  resetPeak() {
+    peak = live.load();
+  }
+
+  // VmHWM of /proc/self/status, reset by writing 5 to /proc/self/clear_refs (Linux 4.0+)
+  size_t
+  peakResidentBytes() {
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while (std::getline(f, line))
+      if (line.rfind("VmHWM:", 0) == 0)
+        return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    return 0;
+  }
+
+  void
+  resetPeakResident() {
+    std::ofstream f("/proc/self/clear_refs");
+    if (f.is_open())
+      f << "5";
+  }
+
+}
+
+#ifdef TRANSFINITE_BENCH_ALLOCATIONS
+
+using Allocations::allocateOrThrow;
+using Allocations::allocate;
+using Allocations::deallocate;
+
+void *operator new(size_t size) { return allocateOrThrow(size, 0); }
+void *operator new[](size_t size) { return allocateOrThrow(size, 0); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size, 0); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size, 0); }
+void *operator new(size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<size_t>(align));
+}
+void *operator new[](size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<size_t>(align));
+}
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+  return allocate(size, static_cast<size_t>(align));
+}
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+  return allocate(size, static_cast<size_t>(align));
+}
+
+void operator delete(void *p) noexcept { deallocate(p, 0); }
+void operator delete[](void *p) noexcept { deallocate(p, 0); }
+void operator delete(void *p, size_t) noexcept { deallocate(p, 0); }
+void operator delete[](void *p, size_t) noexcept { deallocate(p, 0); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { deallocate(p, 0); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { deallocate(p, 0); }
+void operator delete(void *p, std::align_val_t align) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+void operator delete[](void *p, std::align_val_t align) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+void operator delete(void *p, size_t, std::align_val_t align) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+void operator delete[](void *p, size_t, std::align_val_t align) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+void operator delete(void *p, std::align_val_t align, const std::nothrow_t &) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+void operator delete[](void *p, std::align_val_t align, const std::nothrow_t &) noexcept {
+  deallocate(p, static_cast<size_t>(align));
+}
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap statistics of the benchmarks, from a replacement of the global operator new and delete
+// compiled in by the CMake option TRANSFINITE_BENCH_ALLOCATIONS (on by default); otherwise
+// enabled() is false and all values are 0. The allocations of all threads are counted,
+// but only those through operator new (e.g. not those of malloc).
+namespace Allocations {
+
+  bool enabled();
+  // Number of calls to operator new so far
+  uint64_t count();
+  // Bytes allocated by operator new and not yet deleted, and their maximum since resetPeak()
+  size_t liveBytes();
+  size_t peakBytes();
+  void resetPeak();
+
+  // Peak resident set size of the process since resetPeakResident() (or its start),
+  // where it can be reset (on Linux); 0 where it is not available
+  size_t peakResidentBytes();
+  void resetPeakResident();
+
+}
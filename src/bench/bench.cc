@@ -0,0 +1,296 @@
+// Benchmarks of setup, update and tessellation for all surface types.
+// Curve-based surfaces are run on regular n-sided loops (n = 3 .. 12) and on the .lop models,
+// Bezier patches, S-patches and SuperD models on their model files;
+// the inner kernels are benchmarked separately (see kernels.cc).
+// Results are also written to transfinite-bench.json (in the format of google/benchmark),
+// unless --benchmark_out is given; --models=DIR sets the model directory (default: ../../models).
+// With allocation counting (see allocations.hh), the tessellations and single point evaluations
+// also report their heap allocations per point and peak memory; --point_allocation_budget=N and
+// --mesh_memory_budget=BYTES (per vertex) make the benchmarks over them fail, e.g.
+// --point_allocation_budget=0 checks that eval(uv) does not allocate.
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "domain.hh"
+#include "surface-generalized-bezier-corner.hh"
+#include "surface-generalized-bezier.hh"
+#include "surface-hybrid.hh"
+#include "surface-superd.hh"
+
+#include "io.hh"
+#include "surface-types.hh"
+
+#include "bench.hh"
+
+using namespace Transfinite;
+
+namespace {
+
+  std::string models = "../../models/";
+
+  const std::vector<size_t> side_counts = { 3, 4, 5, 6, 8, 10, 12 };
+  const std::vector<size_t> resolutions = { 15, 50, 100 };
+  const size_t point_resolution = 30;
+
+
+  struct CurveInput {
+    std::string name;
+    std::function<CurveVector()> curves;
+  };
+
+  std::vector<CurveInput> curveInputs() {
+    std::vector<CurveInput> inputs;
+    for (size_t n : side_counts)
+      inputs.push_back({ "n=" + std::to_string(n), [n]() { return polygonLoop(n); } });
+    for (std::string model : { "cagd86", "pocket3sided", "pocket4sided", "pocket6sided" })
+      inputs.push_back({ model, [model]() { return readLOP(models + model + ".lop"); } });
+    return inputs;
+  }
+
+  std::shared_ptr<Surface> setup(const SurfaceFactory &factory, const CurveVector &curves) {
+    auto surf = factory();
+    surf->setCurves(curves);
+    surf->setupLoop();
+    surf->update();
+    return surf;
+  }
+
+  void registerCurveSurfaces() {
+    for (const auto &[type, factory] : curveSurfaces())
+      for (const auto &input : curveInputs()) {
+        std::string suffix = type + "/" + input.name;
+        benchmark::RegisterBenchmark(("setup/" + suffix).c_str(), [=](benchmark::State &state) {
+          auto curves = input.curves();
+          for (auto _ : state) {
+            CurveVector copies;
+            for (const auto &c : curves)
+              copies.push_back(std::make_shared<BSCurve>(*c));
+            benchmark::DoNotOptimize(setup(factory, copies));
+          }
+        });
+        // Moves an inner control point of the first curve back and forth
+        benchmark::RegisterBenchmark(("update/" + suffix).c_str(), [=](benchmark::State &state) {
+          auto curves = input.curves();
+          auto surf = setup(factory, curves);
+          PointVector cps = curves[0]->controlPoints();
+          bool moved = false;
+          for (auto _ : state) {
+            PointVector changed = cps;
+            changed[1] += Vector3D(0, 0, moved ? 0.0 : 0.01);
+            moved = !moved;
+            *curves[0] = BSCurve(curves[0]->basis().degree(), curves[0]->basis().knots(),
+                                 changed);
+            surf->update();
+          }
+        });
+        for (size_t res : resolutions)
+          benchmark::RegisterBenchmark(("eval/" + suffix + "/res=" + std::to_string(res)).c_str(),
+                                       [=](benchmark::State &state) {
+            auto surf = setup(factory, input.curves());
+            measure(state, surf->domain()->parameters(res).size(), mesh_budget, [&]() {
+              benchmark::DoNotOptimize(surf->eval(res));
+            });
+          });
+        // Single points, after a pass filling the caches
+        benchmark::RegisterBenchmark(("point/" + suffix).c_str(), [=](benchmark::State &state) {
+          auto surf = setup(factory, input.curves());
+          Point2DVector uvs = surf->domain()->parameters(point_resolution);
+          for (const auto &uv : uvs)
+            benchmark::DoNotOptimize(surf->eval(uv));
+          measure(state, uvs.size(), point_budget, [&]() {
+            for (const auto &uv : uvs)
+              benchmark::DoNotOptimize(surf->eval(uv));
+          });
+          state.SetItemsProcessed(state.iterations() * uvs.size());
+        });
+      }
+  }
+
+  template<typename S>
+  void registerBezier(const std::string &type) {
+    std::string filename = models + "cagd86.gbp";
+    benchmark::RegisterBenchmark(("setup/" + type + "/cagd86").c_str(),
+                                 [=](benchmark::State &state) {
+      for (auto _ : state) {
+        S surf;
+        loadBezier(filename, &surf);
+        surf.update();
+        benchmark::DoNotOptimize(surf);
+      }
+    });
+    benchmark::RegisterBenchmark(("update/" + type + "/cagd86").c_str(),
+                                 [=](benchmark::State &state) {
+      S surf;
+      loadBezier(filename, &surf);
+      surf.update();
+      Point3D p = surf.controlPoint(0, 1, 1);
+      bool moved = false;
+      for (auto _ : state) {
+        surf.setControlPoint(0, 1, 1, p + Vector3D(0, 0, moved ? 0.0 : 0.01));
+        moved = !moved;
+        surf.update();
+      }
+    });
+    for (size_t res : resolutions)
+      benchmark::RegisterBenchmark(("eval/" + type + "/cagd86/res=" + std::to_string(res)).c_str(),
+                                   [=](benchmark::State &state) {
+        S surf;
+        loadBezier(filename, &surf);
+        surf.update();
+        measure(state, surf.domain()->parameters(res).size(), mesh_budget, [&]() {
+          benchmark::DoNotOptimize(surf.eval(res));
+        });
+      });
+    benchmark::RegisterBenchmark(("point/" + type + "/cagd86").c_str(),
+                                 [=](benchmark::State &state) {
+      S surf;
+      loadBezier(filename, &surf);
+      surf.update();
+      Point2DVector uvs = surf.domain()->parameters(point_resolution);
+      for (const auto &uv : uvs)
+        benchmark::DoNotOptimize(surf.eval(uv));
+      measure(state, uvs.size(), point_budget, [&]() {
+        for (const auto &uv : uvs)
+          benchmark::DoNotOptimize(surf.eval(uv));
+      });
+      state.SetItemsProcessed(state.iterations() * uvs.size());
+    });
+  }
+
+  void registerModels() {
+    registerBezier<SurfaceGeneralizedBezier>("GB");
+    registerBezier<SurfaceGeneralizedBezierCorner>("CornerGB");
+    registerBezier<SurfaceHybrid>("Hybrid");
+
+    std::string spatch = models + "cagd86.sp";
+    benchmark::RegisterBenchmark("setup/SPatch/cagd86", [=](benchmark::State &state) {
+      for (auto _ : state)
+        benchmark::DoNotOptimize(loadSPatch(spatch));
+    });
+    for (size_t res : resolutions)
+      benchmark::RegisterBenchmark(("eval/SPatch/cagd86/res=" + std::to_string(res)).c_str(),
+                                   [=](benchmark::State &state) {
+        auto surf = loadSPatch(spatch);
+        measure(state, surf.domain()->parameters(res).size(), mesh_budget, [&]() {
+          benchmark::DoNotOptimize(surf.eval(res));
+        });
+      });
+
+    std::string superd = models + "trebol.sdm";
+    benchmark::RegisterBenchmark("setup/SuperD/trebol", [=](benchmark::State &state) {
+      for (auto _ : state)
+        benchmark::DoNotOptimize(loadSuperDModel(superd));
+    });
+    for (size_t res : resolutions)
+      benchmark::RegisterBenchmark(("eval/SuperD/trebol/res=" + std::to_string(res)).c_str(),
+                                   [=](benchmark::State &state) {
+        auto surfaces = loadSuperDModel(superd);
+        size_t points = 0;
+        for (const auto &surf : surfaces)
+          points += surf.domain()->parameters(res).size();
+        measure(state, points, mesh_budget, [&]() {
+          benchmark::DoNotOptimize(SurfaceSuperD::eval(surfaces, res));
+        });
+      });
+  }
+
+}
+
+MemoryBudget point_budget, mesh_budget;
+
+namespace {
+
+  bool over_budget = false;
+
+}
+
+void
+reportMemory(benchmark::State &state, size_t items, uint64_t allocations, size_t peak,
+             const MemoryBudget &budget) {
+  if (!Allocations::enabled())
+    return;
+  double count = (double)state.iterations() * items;
+  double per_item = count > 0 ? allocations / count : 0;
+  state.counters["allocs/point"] = per_item;
+  state.counters["heap_peak"] = benchmark::Counter(peak, benchmark::Counter::kDefaults,
+                                                   benchmark::Counter::kIs1024);
+  state.counters["rss_peak"] = benchmark::Counter(Allocations::peakResidentBytes(),
+                                                  benchmark::Counter::kDefaults,
+                                                  benchmark::Counter::kIs1024);
+  char message[128];
+  if (budget.allocations >= 0 && per_item > budget.allocations) {
+    std::snprintf(message, sizeof(message), "%g allocations per point (budget: %g)",
+                  per_item, budget.allocations);
+    state.SkipWithError(message);
+    over_budget = true;
+  } else if (budget.bytes >= 0 && items > 0 && (double)peak / items > budget.bytes) {
+    std::snprintf(message, sizeof(message), "%g bytes per vertex (budget: %g)",
+                  (double)peak / items, budget.bytes);
+    state.SkipWithError(message);
+    over_budget = true;
+  }
+}
+
+CurveVector
+polygonLoop(size_t n) {
+  auto vertex = [n](size_t i) {
+    double alpha = 2.0 * M_PI * i / n;
+    return Point3D(std::cos(alpha), std::sin(alpha), 0.2 * std::sin(3.0 * alpha));
+  };
+  CurveVector curves;
+  for (size_t i = 0; i < n; ++i) {
+    Point3D a = vertex(i), b = vertex(i + 1);
+    Vector3D lift(0, 0, 0.1);
+    curves.push_back(std::make_shared<BSCurve>(PointVector{
+          a, a * 2.0 / 3.0 + b / 3.0 + lift, a / 3.0 + b * 2.0 / 3.0 + lift, b }));
+  }
+  return curves;
+}
+
+int main(int argc, char **argv) {
+  std::vector<char *> args;
+  bool has_out = false;
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--models=", 0) == 0) {
+      models = arg.substr(9);
+      if (!models.empty() && models.back() != '/')
+        models += '/';
+      continue;
+    }
+    if (arg.rfind("--point_allocation_budget=", 0) == 0) {
+      point_budget.allocations = std::stod(arg.substr(26));
+      continue;
+    }
+    if (arg.rfind("--mesh_memory_budget=", 0) == 0) {
+      mesh_budget.bytes = std::stod(arg.substr(21));
+      continue;
+    }
+    if (arg.rfind("--benchmark_out=", 0) == 0)
+      has_out = true;
+    args.push_back(argv[i]);
+  }
+  std::string out = "--benchmark_out=transfinite-bench.json";
+  std::string format = "--benchmark_out_format=json";
+  if (!has_out) {
+    args.push_back(out.data());
+    args.push_back(format.data());
+  }
+  int count = args.size();
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+    return 1;
+
+  registerCurveSurfaces();
+  registerModels();
+  registerKernels();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return over_budget ? 1 : 0;
+}
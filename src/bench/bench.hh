@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "geometry.hh"
+
+#include "allocations.hh"
+
+// Cubic curves between the vertices of a regular polygon, with a wavy height
+Geometry::CurveVector polygonLoop(size_t n);
+
+// Limits of the heap use of a benchmark, per item (e.g. per evaluated point); negative means none
+struct MemoryBudget {
+  double allocations = -1, bytes = -1;
+};
+// Of single point evaluations (--point_allocation_budget) and of tessellations, for the largest
+// heap use during one (--mesh_memory_budget, in bytes per vertex); set from the command line
+extern MemoryBudget point_budget, mesh_budget;
+
+// Counters of the heap allocations per item, the peak heap use of an iteration and the peak
+// resident memory of the benchmark (when allocations are counted); failing the benchmark
+// when over the budget
+void reportMemory(benchmark::State &state, size_t items, uint64_t allocations, size_t peak,
+                  const MemoryBudget &budget);
+
+// Runs `f` once in each iteration of the timed loop, with `items` items, and reports its memory use
+template<typename F>
+void measure(benchmark::State &state, size_t items, const MemoryBudget &budget, F f) {
+  Allocations::resetPeakResident();
+  size_t peak = 0;
+  uint64_t start = Allocations::count();
+  for (auto _ : state) {
+    size_t live = Allocations::liveBytes();
+    Allocations::resetPeak();
+    f();
+    peak = std::max(peak, Allocations::peakBytes() - live);
+  }
+  reportMemory(state, items, Allocations::count() - start, peak, budget);
+}
+
+// Benchmarks of the inner kernels (defined in kernels.cc)
+void registerKernels();
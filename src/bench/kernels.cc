@@ -0,0 +1,296 @@
+// Benchmarks of the inner kernels, at the points of Domain::parameters(30):
+// barycentric coordinates, the ribbon parameterizations, RMF normals, cross-derivatives,
+// the blend functions and the evaluation by FastEvaluator. Cached queries are measured both
+// with an empty (cold) cache, which is cleared by an untimed update() before each pass, and
+// a filled (hot) one; the uncached block versions are measured as "block". The RMF and the
+// ribbons have no caches.
+
+#include <benchmark/benchmark.h>
+
+#include "domain-angular.hh"
+#include "domain-regular.hh"
+#include "parameterization-barycentric.hh"
+#include "parameterization-bilinear.hh"
+#include "parameterization-constrained-barycentric.hh"
+#include "parameterization-interconnected.hh"
+#include "parameterization-overlap.hh"
+#include "parameterization-parallel.hh"
+#include "parameterization-perp-polar.hh"
+#include "parameterization-polar.hh"
+#include "parameterization-superd.hh"
+#include "ribbon-compatible-with-handler.hh"
+#include "ribbon-coons.hh"
+#include "ribbon-nsided.hh"
+#include "ribbon-perpendicular.hh"
+#include "surface-corner-based.hh"
+#include "surface-side-based.hh"
+
+#include "bench.hh"
+
+using namespace Transfinite;
+
+namespace {
+
+  const std::vector<size_t> side_counts = { 3, 4, 5, 6, 8 };
+  const size_t resolution = 30;
+
+  // Side-based surface with a given ribbon type, exposing the blend functions
+  template<typename R>
+  class ProbeSurface : public SurfaceSideBased {
+  public:
+    using Surface::blendCorner;
+    using Surface::blendSideSingular;
+    using Surface::blendCornerDeficient;
+
+  protected:
+    virtual std::shared_ptr<Ribbon> newRibbon() const override {
+      return std::make_shared<R>();
+    }
+  };
+
+  template<typename R>
+  std::shared_ptr<ProbeSurface<R>> probe(size_t n) {
+    auto surf = std::make_shared<ProbeSurface<R>>();
+    surf->setCurves(polygonLoop(n));
+    surf->setupLoop();
+    surf->update();
+    return surf;
+  }
+
+  template<typename D>
+  std::shared_ptr<Domain> domain(size_t n) {
+    auto result = std::make_shared<D>();
+    result->setSides(polygonLoop(n));
+    result->update();
+    return result;
+  }
+
+  std::string suffix(size_t n) {
+    return "/n=" + std::to_string(n);
+  }
+
+  // Runs a pass over the domain points in each iteration, clearing the cache before it if `cold`
+  template<typename P, typename F>
+  void passes(benchmark::State &state, P &param, const Point2DVector &uvs, bool cold, F f) {
+    for (auto _ : state) {
+      if (cold) {
+        state.PauseTiming();
+        param.update();
+        state.ResumeTiming();
+      }
+      for (const auto &uv : uvs)
+        f(uv);
+    }
+    state.SetItemsProcessed(state.iterations() * uvs.size());
+  }
+
+  void registerBarycentric() {
+    using Type = ParameterizationBarycentric::BarycentricType;
+    const std::vector<std::pair<std::string, Type>> types = {
+      { "wachspress", Type::WACHSPRESS }, { "mean-value", Type::MEAN_VALUE },
+      { "harmonic", Type::HARMONIC }
+    };
+    for (const auto &[name, type] : types)
+      for (size_t n : side_counts) {
+        std::string prefix = "kernel/barycentric/" + name + suffix(n);
+        auto setup = [type = type, n]() {
+          auto param = std::make_shared<ParameterizationBarycentric>(type);
+          param->setDomain(domain<DomainRegular>(n));
+          param->update();
+          return param;
+        };
+        for (bool cold : { true, false })
+          benchmark::RegisterBenchmark((prefix + (cold ? "/cold" : "/hot")).c_str(),
+                                       [=](benchmark::State &state) {
+            auto param = setup();
+            Point2DVector uvs = domain<DomainRegular>(n)->parameters(resolution);
+            passes(state, *param, uvs, cold, [&](const Point2D &uv) {
+              benchmark::DoNotOptimize(param->barycentric(uv).data());
+            });
+          });
+        benchmark::RegisterBenchmark((prefix + "/block").c_str(), [=](benchmark::State &state) {
+          auto param = setup();
+          Point2DVector uvs = domain<DomainRegular>(n)->parameters(resolution);
+          DoubleVector l(uvs.size() * n);
+          for (auto _ : state) {
+            param->barycentric(uvs.data(), uvs.size(), l.data());
+            benchmark::ClobberMemory();
+          }
+          state.SetItemsProcessed(state.iterations() * uvs.size());
+        });
+      }
+  }
+
+  using DomainFactory = std::function<std::shared_ptr<Domain>(size_t)>;
+  using ParamFactory = std::function<std::shared_ptr<Parameterization>()>;
+
+  template<typename P>
+  ParamFactory factory() {
+    return []() { return std::make_shared<P>(); };
+  }
+
+  // The parameterizations, with the domains they are used with
+  void registerMappings() {
+    const std::vector<std::tuple<std::string, DomainFactory, ParamFactory>> mappings = {
+      { "barycentric", domain<DomainRegular>, factory<ParameterizationBarycentric>() },
+      { "constrained-barycentric", domain<DomainRegular>,
+        factory<ParameterizationConstrainedBarycentric>() },
+      { "bilinear", domain<DomainRegular>, factory<ParameterizationBilinear>() },
+      { "polar", domain<DomainAngular>, factory<ParameterizationPolar>() },
+      { "perp-polar", domain<DomainAngular>, factory<ParameterizationPerpPolar>() },
+      { "parallel", domain<DomainAngular>, factory<ParameterizationParallel>() },
+      { "superd", domain<DomainRegular>, factory<ParameterizationSuperD>() },
+      { "interconnected", domain<DomainRegular>, factory<ParameterizationInterconnected>() },
+      { "overlap", domain<DomainRegular>, factory<ParameterizationOverlap>() }
+    };
+    for (const auto &[name, domain_factory, param_factory] : mappings)
+      for (size_t n : side_counts) {
+        if (name == "overlap" && n % 2 != 0)
+          continue;             // defined only for even n
+        DomainFactory domains = domain_factory;
+        std::string prefix = "kernel/mapToRibbons/" + name + suffix(n);
+        auto setup = [=, make = param_factory]() {
+          auto param = make();
+          param->setDomain(domains(n));
+          param->update();
+          return param;
+        };
+        for (bool cold : { true, false })
+          benchmark::RegisterBenchmark((prefix + (cold ? "/cold" : "/hot")).c_str(),
+                                       [=](benchmark::State &state) {
+            auto param = setup();
+            Point2DVector uvs = domains(n)->parameters(resolution);
+            passes(state, *param, uvs, cold, [&](const Point2D &uv) {
+              benchmark::DoNotOptimize(param->mapToRibbons(uv)->data());
+            });
+          });
+        benchmark::RegisterBenchmark((prefix + "/block").c_str(), [=](benchmark::State &state) {
+          auto param = setup();
+          Point2DVector uvs = domains(n)->parameters(resolution), sds(uvs.size() * n);
+          for (auto _ : state) {
+            param->mapToRibbons(uvs.data(), uvs.size(), sds.data());
+            benchmark::ClobberMemory();
+          }
+          state.SetItemsProcessed(state.iterations() * uvs.size());
+        });
+      }
+  }
+
+  const size_t samples = 1000;
+
+  void registerRMF() {
+    for (size_t n : side_counts)
+      benchmark::RegisterBenchmark(("kernel/RMF::eval" + suffix(n)).c_str(),
+                                   [=](benchmark::State &state) {
+        auto surf = probe<RibbonCompatibleWithHandler>(n);
+        auto ribbon = surf->ribbon(0);
+        for (auto _ : state)
+          for (size_t i = 0; i <= samples; ++i)
+            benchmark::DoNotOptimize(ribbon->normal((double)i / samples));
+        state.SetItemsProcessed(state.iterations() * (samples + 1));
+      });
+  }
+
+  template<typename R>
+  void registerCrossDerivative(const std::string &name) {
+    for (size_t n : side_counts)
+      benchmark::RegisterBenchmark(("kernel/crossDerivative/" + name + suffix(n)).c_str(),
+                                   [=](benchmark::State &state) {
+        auto surf = probe<R>(n);
+        for (auto _ : state)
+          for (size_t j = 0; j < n; ++j)
+            for (size_t i = 0; i <= samples; ++i)
+              benchmark::DoNotOptimize(surf->ribbon(j)->crossDerivative((double)i / samples));
+        state.SetItemsProcessed(state.iterations() * n * (samples + 1));
+      });
+  }
+
+  // Cold blends map the block first (without caching), hot ones use the parameter table
+  void registerBlends() {
+    using Probe = ProbeSurface<RibbonCompatibleWithHandler>;
+    using PointBlend = void (Probe::*)(const Point2DVector &, DoubleVector &) const;
+    using BlockBlend = void (Probe::*)(const Point2D *, size_t, double *) const;
+    const std::vector<std::tuple<std::string, PointBlend, BlockBlend>> blends = {
+      { "corner", &Probe::blendCorner, &Probe::blendCorner },
+      { "side-singular", &Probe::blendSideSingular, &Probe::blendSideSingular },
+      { "corner-deficient", &Probe::blendCornerDeficient, &Probe::blendCornerDeficient }
+    };
+    for (const auto &[name, point_blend, block_blend] : blends)
+      for (size_t n : side_counts) {
+        std::string prefix = "kernel/blend/" + name + suffix(n);
+        benchmark::RegisterBenchmark((prefix + "/point").c_str(), [=](benchmark::State &state) {
+          auto surf = probe<RibbonCompatibleWithHandler>(n);
+          auto table = surf->parameterization()->parameterTable(resolution);
+          size_t size = table->sds.size() / n;
+          std::vector<Point2DVector> rows;
+          for (size_t j = 0; j < size; ++j)
+            rows.emplace_back(table->row(j), table->row(j) + n);
+          DoubleVector blf;
+          for (auto _ : state)
+            for (const auto &sds : rows) {
+              (surf.get()->*point_blend)(sds, blf);
+              benchmark::DoNotOptimize(blf.data());
+            }
+          state.SetItemsProcessed(state.iterations() * size);
+        });
+        for (bool cold : { true, false })
+          benchmark::RegisterBenchmark((prefix + (cold ? "/cold" : "/hot")).c_str(),
+                                       [=](benchmark::State &state) {
+            auto surf = probe<RibbonCompatibleWithHandler>(n);
+            auto param = surf->parameterization();
+            const Point2DVector &uvs = surf->domain()->parameters(resolution);
+            auto table = param->parameterTable(resolution);
+            Point2DVector sds(uvs.size() * n);
+            DoubleVector blf(uvs.size() * n);
+            for (auto _ : state) {
+              if (cold)
+                param->mapToRibbons(uvs.data(), uvs.size(), sds.data());
+              (surf.get()->*block_blend)(cold ? sds.data() : table->sds.data(), uvs.size(),
+                                         blf.data());
+              benchmark::ClobberMemory();
+            }
+            state.SetItemsProcessed(state.iterations() * uvs.size());
+          });
+      }
+  }
+
+  // The whole evaluation with sampled ribbons, by the FastEvaluator of the surface and by the
+  // dynamic path; n = 8 has no specialized version
+  template<typename S>
+  void registerFastEvaluator(const std::string &type) {
+    for (size_t n : side_counts)
+      for (bool fast : { true, false })
+        benchmark::RegisterBenchmark(("kernel/eval/" + type + suffix(n) +
+                                      (fast ? "/fast" : "/dynamic")).c_str(),
+                                     [=](benchmark::State &state) {
+          S surf;
+          surf.setCurves(polygonLoop(n));
+          surf.setupLoop();
+          surf.setExecutor(serialExecutor());
+          surf.setRibbonSampling(64);
+          surf.useFastEvaluator(fast);
+          surf.update();
+          surf.eval(resolution);
+          size_t size = surf.domain()->parameters(resolution).size();
+          for (auto _ : state)
+            benchmark::DoNotOptimize(surf.eval(resolution));
+          state.SetItemsProcessed(state.iterations() * size);
+        });
+  }
+
+}
+
+void
+registerKernels() {
+  registerBarycentric();
+  registerMappings();
+  registerRMF();
+  registerCrossDerivative<RibbonCompatible>("compatible");
+  registerCrossDerivative<RibbonCompatibleWithHandler>("compatible-with-handler");
+  registerCrossDerivative<RibbonCoons>("coons");
+  registerCrossDerivative<RibbonNSided>("nsided");
+  registerCrossDerivative<RibbonPerpendicular>("perpendicular");
+  registerBlends();
+  registerFastEvaluator<SurfaceSideBased>("SB");
+  registerFastEvaluator<SurfaceCornerBased>("CB");
+}
@@ -0,0 +1,310 @@
+// Python module `transfinite`, for driving the surfaces from numpy:
+//   import numpy as np, transfinite as tf
+//   curves = [tf.Curve(points, knots) for points, knots in ...]  # or tf.read_lop(filename)
+//   surface = tf.Surface("SB", curves)
+//   xyz = surface.eval(uvs)                          # (N, 2) -> (N, 3)
+//   vertices, triangles = surface.tessellate(50)
+// Evaluations run on the executor of the surface (all cores by default, see set_threads)
+// with the GIL released, so other Python threads keep running. Input arrays are read in place
+// when they are of float64 with contiguous rows (others are converted first), and the results
+// are written directly into the returned arrays. The triangle arrays are read-only views
+// of the shared index buffers of the domain topologies, which they keep alive.
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "domain.hh"
+
+#include "io.hh"
+#include "surface-types.hh"
+
+namespace py = pybind11;
+
+using namespace Transfinite;
+
+namespace {
+
+  template<typename F>
+  const F &find(const SurfaceTypes<F> &factories, const std::string &type) {
+    for (const auto &[name, factory] : factories)
+      if (name == type)
+        return factory;
+    std::string names;
+    for (const auto &[name, factory] : factories)
+      names += (names.empty() ? "" : ", ") + name;
+    throw std::invalid_argument("unknown surface type: " + type + " (expected one of " +
+                                names + ")");
+  }
+
+  using Array = py::array_t<double, py::array::forcecast>;
+  using ContiguousArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+  // Rows of `columns` values, e.g. (N, 2) for domain points; a single row can also be 1D
+  void checkShape(const Array &a, py::ssize_t columns, const char *name) {
+    if (!((a.ndim() == 2 && a.shape(1) == columns) || (a.ndim() == 1 && a.shape(0) == columns)))
+      throw std::invalid_argument(std::string(name) + " should have the shape (N, " +
+                                  std::to_string(columns) + ")");
+  }
+
+  py::ssize_t rows(const Array &a) {
+    return a.ndim() == 2 ? a.shape(0) : 1;
+  }
+
+  PointVector points(const Array &a) {
+    checkShape(a, 3, "control points");
+    ContiguousArray c = ContiguousArray::ensure(a);
+    const double *d = c.data();
+    PointVector result;
+    for (py::ssize_t i = 0; i < rows(a); ++i)
+      result.emplace_back(d[3 * i], d[3 * i + 1], d[3 * i + 2]);
+    return result;
+  }
+
+  // A new array of `size` rows of `columns` values (1D for a single point of 1D input)
+  py::array_t<double> rowArray(size_t size, size_t columns, bool flat = false) {
+    if (flat)
+      return py::array_t<double>(std::vector<py::ssize_t>{ (py::ssize_t)columns });
+    return py::array_t<double>(std::vector<py::ssize_t>{ (py::ssize_t)size,
+                                                         (py::ssize_t)columns });
+  }
+
+  std::shared_ptr<BSCurve> makeCurve(const Array &control_points, std::optional<Array> knots) {
+    auto cpts = points(control_points);
+    if (cpts.size() < 2)
+      throw std::invalid_argument("a curve needs at least 2 control points");
+    if (!knots)
+      return std::make_shared<BSCurve>(cpts);
+    if (knots->ndim() != 1 || knots->shape(0) < (py::ssize_t)cpts.size() + 2)
+      throw std::invalid_argument("the knot vector should have at least " +
+                                  std::to_string(cpts.size() + 2) + " values");
+    ContiguousArray k = ContiguousArray::ensure(*knots);
+    DoubleVector knot_vector(k.data(), k.data() + k.size());
+    size_t degree = knot_vector.size() - cpts.size() - 1;
+    if (degree >= cpts.size())
+      throw std::invalid_argument("the knot vector has too many values for the control points");
+    return std::make_shared<BSCurve>(degree, knot_vector, cpts);
+  }
+
+  py::array_t<double> controlPoints(const BSCurve &curve) {
+    const auto &cpts = curve.controlPoints();
+    auto result = rowArray(cpts.size(), 3);
+    auto w = result.mutable_unchecked<2>();
+    for (size_t i = 0; i < cpts.size(); ++i)
+      for (size_t k = 0; k < 3; ++k)
+        w(i, k) = cpts[i][k];
+    return result;
+  }
+
+  py::array_t<double> curvePoint(const BSCurve &curve, double u) {
+    auto p = curve.eval(u);
+    auto result = rowArray(1, 3, true);
+    for (size_t k = 0; k < 3; ++k)
+      result.mutable_at(k) = p[k];
+    return result;
+  }
+
+  // Evaluations take the lock shared, changes exclusively, as both run without the GIL
+  // (which is released before locking, so waiting threads do not block Python)
+  class PySurface {
+  public:
+    PySurface(const std::string &type, const std::shared_ptr<Surface> &surface)
+      : type_(type), surface_(surface) {
+    }
+
+    static std::unique_ptr<PySurface> fromCurves(const std::string &type,
+                                                 const CurveVector &curves) {
+      auto surface = find(curveSurfaces(), type)();
+      auto result = std::make_unique<PySurface>(type, surface);
+      result->setCurves(curves);
+      return result;
+    }
+
+    static std::unique_ptr<PySurface> fromBezier(const std::string &filename,
+                                                 const std::string &type) {
+      auto surface = find(bezierSurfaces(), type)();
+      {
+        py::gil_scoped_release release;
+        loadBezier(filename, surface.get());
+        surface->update();
+      }
+      return std::make_unique<PySurface>(type, surface);
+    }
+
+    const std::string &type() const { return type_; }
+
+    size_t sides() const {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      return surface_->domain()->size();
+    }
+
+    void setThreads(size_t threads) {
+      py::gil_scoped_release release;
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      surface_->setExecutor(threads == 1 ? serialExecutor() : threadExecutor(threads));
+    }
+
+    void setCurves(const CurveVector &curves) {
+      if (curves.size() < 3)
+        throw std::invalid_argument("a surface needs at least 3 curves");
+      for (const auto &c : curves)
+        if (!c)
+          throw std::invalid_argument("curves should not be None");
+      py::gil_scoped_release release;
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      surface_->setCurves(curves);
+      surface_->setupLoop();
+      surface_->update();
+    }
+
+    void setRibbonMultiplier(size_t i, double m) {
+      py::gil_scoped_release release;
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      checkSide(i);
+      surface_->setRibbonMultiplier(i, m);
+      surface_->update(i);
+    }
+
+    py::array_t<double> eval(const Array &uvs) const {
+      checkShape(uvs, 2, "uvs");
+      // Read in place when the rows are contiguous (with any positive row stride)
+      const py::ssize_t d = sizeof(double);
+      Array input = uvs;
+      if (uvs.strides(uvs.ndim() - 1) != d ||
+          (uvs.ndim() == 2 && (uvs.strides(0) <= 0 || uvs.strides(0) % d != 0)))
+        input = ContiguousArray::ensure(uvs);
+      size_t size = rows(input);
+      size_t stride = input.ndim() == 2 ? input.strides(0) / sizeof(double) : 2;
+      auto result = rowArray(size, 3, input.ndim() == 1);
+      InputBuffer<double> in{ input.data(), stride };
+      OutputBuffer<double> out{ result.mutable_data(), 3 };
+      {
+        py::gil_scoped_release release;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        surface_->eval(in, size, out);
+      }
+      return result;
+    }
+
+    // The vertices (and optionally the unit normals) of the mesh of the given resolution,
+    // in the order of parameters(resolution), and the triangles as vertex indices.
+    // The arrays are allocated with the GIL, so outside the lock; when the surface has been
+    // changed to another number of vertices meanwhile, they are allocated again.
+    py::tuple tessellate(size_t resolution, bool normals) const {
+      size_t size;
+      {
+        py::gil_scoped_release release;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        size = surface_->domain()->sharedParameters(resolution)->size();
+      }
+      py::array_t<double> vertices, vertex_normals;
+      std::shared_ptr<const std::vector<uint32_t>> indices;
+      while (!indices) {
+        vertices = rowArray(size, 3);
+        if (normals)
+          vertex_normals = rowArray(size, 3);
+        py::gil_scoped_release release;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        size_t current = surface_->domain()->sharedParameters(resolution)->size();
+        if (current != size) {
+          size = current;
+          continue;
+        }
+        indices = surface_->domain()->meshIndices(resolution);
+        OutputBuffer<double> normal_buffer;
+        if (normals)
+          normal_buffer = { vertex_normals.mutable_data(), 3 };
+        surface_->eval(resolution, OutputBuffer<double>{ vertices.mutable_data(), 3 },
+                       normal_buffer);
+      }
+      // The array keeps the shared indices alive, even after the domain evicts or drops them
+      using SharedIndices = std::shared_ptr<const std::vector<uint32_t>>;
+      py::capsule owner(new SharedIndices(indices),
+                        [](void *p) { delete static_cast<SharedIndices *>(p); });
+      py::array_t<uint32_t> triangles(
+        std::vector<py::ssize_t>{ (py::ssize_t)indices->size() / 3, 3 },
+        std::vector<py::ssize_t>{ 3 * sizeof(uint32_t), sizeof(uint32_t) },
+        indices->data(), owner);
+      triangles.attr("flags").attr("writeable") = false;
+      if (normals)
+        return py::make_tuple(vertices, triangles, vertex_normals);
+      return py::make_tuple(vertices, triangles);
+    }
+
+    // The domain points of the vertices of tessellate(resolution)
+    py::array_t<double> parameters(size_t resolution) const {
+      std::shared_ptr<const Point2DVector> uvs;
+      {
+        py::gil_scoped_release release;
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        uvs = surface_->domain()->sharedParameters(resolution);
+      }
+      auto result = rowArray(uvs->size(), 2);
+      auto w = result.mutable_unchecked<2>();
+      for (size_t i = 0; i < uvs->size(); ++i) {
+        w(i, 0) = (*uvs)[i][0];
+        w(i, 1) = (*uvs)[i][1];
+      }
+      return result;
+    }
+
+  private:
+    void checkSide(size_t i) const {
+      if (i >= surface_->domain()->size())
+        throw std::out_of_range("no side " + std::to_string(i));
+    }
+
+    std::string type_;
+    std::shared_ptr<Surface> surface_;
+    mutable std::shared_mutex mutex_;
+  };
+
+}
+
+PYBIND11_MODULE(transfinite, m) {
+  m.doc() = "Transfinite surface patches, evaluated in batches on numpy arrays";
+
+  py::class_<BSCurve, std::shared_ptr<BSCurve>>(m, "Curve")
+    .def(py::init(&makeCurve), py::arg("control_points"), py::arg("knots") = py::none(),
+         "B-spline curve of (M, 3) control points and a clamped knot vector of M + degree + 1 "
+         "values; a Bezier curve without knots")
+    .def_property_readonly("degree", &BSCurve::degree)
+    .def_property_readonly("knots", [](const BSCurve &c) { return c.basis().knots(); })
+    .def_property_readonly("control_points", &controlPoints)
+    .def("eval", &curvePoint, py::arg("u"));
+
+  m.def("read_lop", [](const std::string &filename) { return readLOP(filename); },
+        py::arg("filename"), py::call_guard<py::gil_scoped_release>(),
+        "The curves of a .lop model file");
+
+  py::class_<PySurface>(m, "Surface")
+    .def(py::init(&PySurface::fromCurves), py::arg("type"), py::arg("curves"),
+         "Surface of the given type (SB, CB, GC, CR, MP, MC, C0Coons, Elastic, Polar, NSided, "
+         "Harmonic or Biharmonic) interpolating the loop of curves")
+    .def_static("load_bezier", &PySurface::fromBezier, py::arg("filename"),
+                py::arg("type") = "GB",
+                "Surface of the given type (GB, CornerGB or Hybrid) read from a .gbp file")
+    .def_property_readonly("type", &PySurface::type)
+    .def_property_readonly("sides", &PySurface::sides)
+    .def("set_threads", &PySurface::setThreads, py::arg("threads"),
+         "Number of evaluating threads (0 means all cores, the default)")
+    .def("set_curves", &PySurface::setCurves, py::arg("curves"))
+    .def("set_ribbon_multiplier", &PySurface::setRibbonMultiplier, py::arg("i"),
+         py::arg("multiplier"))
+    .def("eval", &PySurface::eval, py::arg("uvs"),
+         "Points of the (N, 2) domain points as an (N, 3) array (or a single point)")
+    .def("tessellate", &PySurface::tessellate, py::arg("resolution"),
+         py::arg("normals") = false,
+         "(vertices, triangles) of the uniform mesh, with the vertex normals when asked for")
+    .def("parameters", &PySurface::parameters, py::arg("resolution"),
+         "Domain points of the vertices of tessellate(resolution)");
+}
@@ -1,10 +1,22 @@
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <sstream>
+#include <thread>
 
+#include "continuity.hh"
 #include "domain.hh"
+#include "locator.hh"
+#include "mesh-sink.hh"
+#include "patch-batch.hh"
+#ifdef TRANSFINITE_OFFLOAD
+#include "patch-batch-device.hh"
+#endif
+#include "patch-model.hh"
 #include "ribbon.hh"
 #include "surface-biharmonic.hh"
 #include "surface-c0coons.hh"
@@ -87,70 +99,11 @@ void ribbonTest(const std::shared_ptr<Surface> &surf) {
 }
 
 void showDeviations(const std::shared_ptr<Surface> &surf) {
-  size_t n = surf->domain()->size();
-  size_t res = 40;
-  double step = 1.0e-4;
-  std::shared_ptr<const Domain> domain = surf->domain();
-
-  // Special handling of Generalized Bezier surfaces
-  CurveVector inner_curves;
-  bool is_bezier =
-    bool(std::dynamic_pointer_cast<SurfaceGeneralizedBezier>(surf)) &&
-    !bool(std::dynamic_pointer_cast<SurfaceHybrid>(surf));
-  if (is_bezier) {
-    auto bs = std::dynamic_pointer_cast<SurfaceGeneralizedBezier>(surf);
-    auto degree = bs->degree();
-    DoubleVector knots;
-    knots.insert(knots.end(), degree + 1, 0.0);
-    knots.insert(knots.end(), degree + 1, 1.0);
-    PointVector cpts(degree + 1);
-    for (size_t i = 0; i < n; ++i) {
-      for (size_t j = 0; j <= degree; ++j)
-        cpts[j] = bs->controlPoint(i, j, 1);
-      inner_curves.push_back(std::make_shared<BSCurve>(degree, knots, cpts));
-    }
-  }
-
-  // Positional test
-  double max_pos_error = 0.0;
-  for (size_t i = 0; i < n; ++i) {
-    for (size_t j = 0; j <= res; ++j) {
-      double s = (double)j / (double)res;
-      Point2D uv = domain->edgePoint(i, s);
-      Point3D p = surf->eval(uv), q = surf->ribbon(i)->curve()->eval(s);
-      max_pos_error = std::max(max_pos_error, (p - q).norm());
-    }
-  }
-
-  // Tangential test
-  double max_tan_error = 0.0;
-  VectorVector der;
-  const Point2DVector &v = domain->vertices();
-  for (size_t i = 0; i < n; ++i) {
-    Vector2D perp = v[i] - v[(i+n-1)%n];
-    perp = Vector2D(perp[1], -perp[0]);
-    if ((domain->center() - v[i]) * perp < 0)
-      perp = -perp;
-    perp.normalize();
-    for (size_t j = 0; j <= res; ++j) {
-      double s = (double)j / (double)res;
-      Point2D uv = domain->edgePoint(i, s);
-      Point2D uv2 = uv + perp * step;
-      Point3D p = surf->eval(uv), q = surf->eval(uv2);
-      surf->ribbon(i)->curve()->eval(s, 1, der);
-      Vector3D surf_normal = (der[1] ^ (q - p)).normalize();
-      Vector3D normal;
-      if (is_bezier) {
-        auto cross = inner_curves[i]->eval(s) - surf->ribbon(i)->curve()->eval(s);
-        normal = (der[1] ^ cross).normalize();
-      } else {
-        normal = surf->ribbon(i)->normal(s);
-      }
-      double angle = acos(surf_normal * normal);
-      max_tan_error = std::max(max_tan_error, angle);
-    }
+  double max_pos_error = 0.0, max_tan_error = 0.0;
+  for (const auto &side : analyzeContinuity(*surf)) {
+    max_pos_error = std::max(max_pos_error, side.max_position);
+    max_tan_error = std::max(max_tan_error, side.max_angle);
   }
-
   std::cout << "  positional error: " << max_pos_error << std::endl;
   std::cout << "  tangential error: " << max_tan_error * 180.0 / M_PI << std::endl;
 }
@@ -295,12 +248,13 @@ void superDTest() {
 
   std::chrono::steady_clock::time_point begin, end;
   begin = std::chrono::steady_clock::now();
-  for (size_t i = 0; i < surfaces.size(); ++i) {
+  auto meshes = SurfaceSuperD::eval(surfaces, resolution);
+  end = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < meshes.size(); ++i) {
     std::stringstream s;
     s << "../../models/" << filename << "-SD-" << i << ".obj";
-    surfaces[i].eval(resolution).writeOBJ(s.str());
+    meshes[i].writeOBJ(s.str());
   }
-  end = std::chrono::steady_clock::now();
   std::cout << "  evaluation time : "
             << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
             << "ms" << std::endl;
@@ -316,9 +270,7 @@ void cloudTest() {
   surf->setupLoop();
   surf->update();
   Point2DVector uvs = surf->domain()->parameters(resolution);
-  PointVector points; points.reserve(uvs.size());
-  std::transform(uvs.begin(), uvs.end(), std::back_inserter(points),
-                 [surf](const Point2D &uv) { return surf->eval(uv); });
+  PointVector points = surf->eval(uvs);
 
   writePCP("../../models/" + filename + ".pcp", uvs, points);
 }
@@ -331,29 +283,17 @@ void meshFitTest(const std::string &surfname, const std::string &meshname) {
   surf.eval(resolution).writeOBJ("../../models/bezier.obj");
   writeBezierControlPoints(surf, "../../models/bezier-cpts.obj");
 
-  SurfaceGeneralizedBezier fitted;
-  fitted = fitWithOriginal(surf, mesh.points(), parameterizePoints(surf, mesh.points()));
-  fitted.eval(resolution).writeOBJ("../../models/bezier-fitted.obj");
-  writeBezierControlPoints(fitted, "../../models/bezier-fitted-cpts.obj");
-  saveBezier(fitted, "../../models/bezier-fitted.gbp");
-
-  fitted = fitWithOriginal(surf, mesh.points(), parameterizePoints(surf, mesh.points()),
-                           0.2);
-  fitted.eval(resolution).writeOBJ("../../models/bezier-fitted-smooth02.obj");
-  writeBezierControlPoints(fitted, "../../models/bezier-fitted-smooth02-cpts.obj");
-  saveBezier(fitted, "../../models/bezier-smooth02.gbp");
-
-  fitted = fitWithOriginal(surf, mesh.points(), parameterizePoints(surf, mesh.points()),
-                           0.5);
-  fitted.eval(resolution).writeOBJ("../../models/bezier-fitted-smooth05.obj");
-  writeBezierControlPoints(fitted, "../../models/bezier-fitted-smooth05-cpts.obj");
-  saveBezier(fitted, "../../models/bezier-smooth05.gbp");
-
-  fitted = fitWithOriginal(surf, mesh.points(), parameterizePoints(surf, mesh.points()),
-                           1.0);
-  fitted.eval(resolution).writeOBJ("../../models/bezier-fitted-smooth10.obj");
-  writeBezierControlPoints(fitted, "../../models/bezier-fitted-smooth10-cpts.obj");
-  saveBezier(fitted, "../../models/bezier-smooth10.gbp");
+  // The same parameterization and normal matrices for all smoothing values
+  FittingSession session(surf, mesh.points());
+  auto fits = session.fit({ 0.0, 0.2, 0.5, 1.0 });
+  const std::array<std::string, 4> names = { "fitted", "fitted-smooth02", "fitted-smooth05",
+                                             "fitted-smooth10" };
+  const std::array<std::string, 4> gbp_names = { "fitted", "smooth02", "smooth05", "smooth10" };
+  for (size_t i = 0; i < fits.size(); ++i) {
+    fits[i].eval(resolution).writeOBJ("../../models/bezier-" + names[i] + ".obj");
+    writeBezierControlPoints(fits[i], "../../models/bezier-" + names[i] + "-cpts.obj");
+    saveBezier(fits[i], "../../models/bezier-" + gbp_names[i] + ".gbp");
+  }
 }
 
 void printStatistics(const DoubleVector &data) {
@@ -420,9 +360,11 @@ DoubleVector deviationFromMesh(const Surface &surf, const TriMesh &mesh) {
   size_t resolution = 30;
   TriMesh surf_mesh = surf.eval(resolution);
   PointVector vertices = surf_mesh.points();
+  auto closest = TriangleBVH(surf_mesh).closest(mesh.points());
   DoubleVector result;
-  for (const auto &p : mesh.points()) {
-    TriMesh::Triangle tri = surf_mesh.closestTriangle(p);
+  for (size_t i = 0; i < closest.size(); ++i) {
+    const Point3D &p = mesh.points()[i];
+    const TriMesh::Triangle &tri = closest[i];
     const Point3D &a = vertices[tri[0]], &b = vertices[tri[1]], &c = vertices[tri[2]];
     Vector3D n = ((b - a) ^ (c - a)).normalize();
     Point3D q = p + n * ((a - p) * n);
@@ -453,6 +395,7 @@ void classATest() {
   CurveVector cv = readLOP("../../models/pocket6sided.lop");
 
   CurveVector normal, class_a;
+  std::vector<BCurve::ClassAEnds> ends;
   for (const auto &c : cv) {
     VectorVector der;
     Point3D pa = c->eval(0.0, 1, der);
@@ -461,9 +404,10 @@ void classATest() {
     Vector3D vb = der[1];
     PointVector pv = {pa, pa + va / 3.0, pb - vb / 3.0, pb};
     normal.push_back(std::make_shared<BSCurve>(pv));
-    BCurve bc; bc.fitClassA(14, pa, va, pb, vb);
-    class_a.push_back(std::make_shared<BSCurve>(bc.controlPoints()));
+    ends.push_back({ pa, va, pb, vb });
   }
+  for (const auto &bc : BCurve::fitClassA(14, ends))
+    class_a.push_back(std::make_shared<BSCurve>(bc.controlPoints()));
 
   SurfaceCornerBased surf;
   surf.setCurves(normal);
@@ -476,6 +420,329 @@ void classATest() {
   surf.eval(30).writeOBJ("../../models/bezier-class-a.obj");
 }
 
+// All patch types on copies of the same loop, set up and tessellated as one model
+void modelTest() {
+  CurveVector cv = readLOP("../../models/" + filename + ".lop");
+  if (cv.empty())
+    return;
+
+  PatchModel model;
+  std::vector<std::shared_ptr<Surface>> surfaces = {
+    std::make_shared<SurfaceSideBased>(), std::make_shared<SurfaceCornerBased>(),
+    std::make_shared<SurfaceGeneralizedCoons>(), std::make_shared<SurfaceCompositeRibbon>(),
+    std::make_shared<SurfaceMidpointCoons>(), std::make_shared<SurfaceNSided>(),
+    std::make_shared<SurfaceHarmonic>(), std::make_shared<SurfaceBiharmonic>()
+  };
+  for (auto &surf : surfaces) {
+    CurveVector curves;
+    for (const auto &c : cv)
+      curves.push_back(std::make_shared<BSCurve>(*c));
+    surf->setCurves(curves);
+    model.add(surf);
+  }
+
+  std::chrono::steady_clock::time_point begin, end;
+  begin = std::chrono::steady_clock::now();
+  model.setupLoop();
+  TriMesh mesh = model.evalCombined(resolution);
+  end = std::chrono::steady_clock::now();
+  mesh.writeOBJ("../../models/" + filename + "-model.obj");
+  std::cout << "  setup & evaluation time : "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+            << "ms" << std::endl;
+}
+
+void concurrencyTest() {
+  CurveVector cv = readLOP("../../models/" + filename + ".lop");
+  if (cv.empty())
+    return;
+
+  std::vector<std::shared_ptr<Surface>> surfaces = {
+    std::make_shared<SurfaceSideBased>(), std::make_shared<SurfaceCornerBased>(),
+    std::make_shared<SurfaceGeneralizedCoons>(), std::make_shared<SurfaceCompositeRibbon>(),
+    std::make_shared<SurfaceMidpointCoons>(), std::make_shared<SurfaceNSided>(),
+    std::make_shared<SurfaceElastic>()
+  };
+  for (auto &surf : surfaces) {
+    CurveVector curves;
+    for (const auto &c : cv)
+      curves.push_back(std::make_shared<BSCurve>(*c));
+    surf->setCurves(curves);
+    surf->setupLoop();
+    surf->update();
+    surf->setExecutor(serialExecutor());
+  }
+
+  // Every thread evaluates all ribbons and surfaces, starting at a different one,
+  // and the results should be identical to the serial evaluation
+  auto evaluate = [&](size_t start) {
+    PointVector result;
+    for (size_t k = 0; k < surfaces.size(); ++k) {
+      const auto &surf = surfaces[(start + k) % surfaces.size()];
+      size_t n = surf->domain()->size();
+      for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j <= resolution; ++j) {
+          double u = (double)j / resolution;
+          result.push_back(surf->ribbon(i)->normal(u));
+          result.push_back(surf->ribbon(i)->crossDerivative(u));
+          result.push_back(surf->ribbon(i)->eval(Point2D(u, ribbon_length)));
+        }
+      for (const auto &uv : surf->domain()->parameters(resolution))
+        result.push_back(surf->eval(uv));
+    }
+    return result;
+  };
+
+  size_t threads = std::max(std::thread::hardware_concurrency(), 4u);
+  std::vector<PointVector> expected, results(threads);
+  for (size_t t = 0; t < surfaces.size(); ++t)
+    expected.push_back(evaluate(t));
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < threads; ++t)
+    pool.emplace_back([&, t]() { results[t] = evaluate(t); });
+  for (auto &t : pool)
+    t.join();
+
+  size_t mismatches = 0;
+  for (size_t t = 0; t < threads; ++t) {
+    const auto &e = expected[t % surfaces.size()];
+    for (size_t i = 0; i < e.size(); ++i)
+      if (e[i][0] != results[t][i][0] || e[i][1] != results[t][i][1] ||
+          e[i][2] != results[t][i][2])
+        ++mismatches;
+  }
+  std::cout << "Concurrent evaluation in " << threads << " threads: "
+            << mismatches << " mismatches" << std::endl;
+}
+
+// Collects a streamed mesh, to be compared with eval(resolution)
+class CollectingSink : public MeshSink {
+public:
+  void begin(size_t points, size_t) override {
+    points_.resize(points);
+    triangles_.clear();
+  }
+  void addPoints(size_t first, const PointVector &points) override {
+    std::copy(points.begin(), points.end(), points_.begin() + first);
+  }
+  void addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t) override {
+    triangles_.insert(triangles_.end(), triangles.begin(), triangles.end());
+  }
+  void end() override { }
+
+  PointVector points_;
+  std::vector<TriMesh::Triangle> triangles_;
+};
+
+// Maximal deviation of the streamed mesh from eval(resolution), or infinity when their
+// topologies differ
+double streamDeviation(const Surface &surf) {
+  CollectingSink sink;
+  surf.eval(resolution, sink);
+  TriMesh mesh = surf.eval(resolution);
+  std::vector<TriMesh::Triangle> expected(mesh.triangles().begin(), mesh.triangles().end());
+  auto streamed = sink.triangles_;
+  std::sort(expected.begin(), expected.end());
+  std::sort(streamed.begin(), streamed.end());
+  if (sink.points_.size() != mesh.points().size() || streamed != expected)
+    return std::numeric_limits<double>::infinity();
+  double max_error = 0.0;
+  for (size_t i = 0; i < sink.points_.size(); ++i)
+    max_error = std::max(max_error, (sink.points_[i] - mesh.points()[i]).norm());
+  return max_error;
+}
+
+void streamCompare(const std::string &type, double deviation) {
+  std::cout << type << ": ";
+  if (std::isinf(deviation))
+    std::cout << "different topology" << std::endl;
+  else
+    std::cout << "max. deviation " << deviation << std::endl;
+}
+
+// One surface of each type on the loop of the model (when it has a .lop file),
+// and the Generalized Bezier variants (when it has a .gbp file)
+std::vector<std::pair<std::string, std::shared_ptr<Surface>>> allLoopSurfaces() {
+  std::vector<std::pair<std::string, std::shared_ptr<Surface>>> result;
+  CurveVector cv = readLOP("../../models/" + filename + ".lop");
+  if (!cv.empty()) {
+    result = {
+      { "sb", std::make_shared<SurfaceSideBased>() },
+      { "cb", std::make_shared<SurfaceCornerBased>() },
+      { "gc", std::make_shared<SurfaceGeneralizedCoons>() },
+      { "cr", std::make_shared<SurfaceCompositeRibbon>() },
+      { "mp", std::make_shared<SurfaceMidpoint>() },
+      { "mc", std::make_shared<SurfaceMidpointCoons>() },
+      { "pp", std::make_shared<SurfacePolar>() },
+      { "ns", std::make_shared<SurfaceNSided>() },
+      { "cc", std::make_shared<SurfaceC0Coons>() },
+      { "ep", std::make_shared<SurfaceElastic>() },
+      { "hp", std::make_shared<SurfaceHarmonic>() },
+      { "bp", std::make_shared<SurfaceBiharmonic>() }
+    };
+    for (auto &[type, surf] : result) {
+      surf->setCurves(cv);
+      surf->setupLoop();
+      surf->update();
+    }
+  }
+
+  if (std::ifstream("../../models/" + filename + ".gbp")) {
+    std::vector<std::pair<std::string, std::shared_ptr<SurfaceGeneralizedBezier>>> beziers = {
+      { "GB", std::make_shared<SurfaceGeneralizedBezier>() },
+      { "GBC", std::make_shared<SurfaceGeneralizedBezierCorner>() },
+      { "HB", std::make_shared<SurfaceHybrid>() }
+    };
+    for (auto &[type, surf] : beziers) {
+      loadBezier("../../models/" + filename + ".gbp", surf.get());
+      surf->update();
+      result.emplace_back(type, surf);
+    }
+  }
+  return result;
+}
+
+// The streamed meshes of all surface types, compared with eval(resolution)
+void streamTest() {
+  for (const auto &[type, surf] : allLoopSurfaces())
+    streamCompare(type, streamDeviation(*surf));
+  if (std::ifstream("../../models/" + filename + ".sp"))
+    streamCompare("SP", streamDeviation(loadSPatch("../../models/" + filename + ".sp")));
+  if (std::ifstream("../../models/trebol.sdm")) {
+    double deviation = 0.0;
+    for (const auto &surf : loadSuperDModel("../../models/trebol.sdm"))
+      deviation = std::max(deviation, streamDeviation(surf));
+    streamCompare("SD", deviation);
+  }
+}
+
+// The G1 errors of analyzeContinuity, compared with those of a step of 1e-4 inside the domain
+// (as the deviation test computed them before analyzeContinuity) on each side
+void continuityTest() {
+  const double step = 1.0e-4;
+  const size_t res = 40;
+  VectorVector der;
+  for (const auto &[type, surf] : allLoopSurfaces()) {
+    if (std::dynamic_pointer_cast<SurfaceHarmonic>(surf))
+      continue;                 // no tangential data
+    auto domain = surf->domain();
+    size_t n = domain->size();
+    CurveVector inner_curves;
+    auto bezier = std::dynamic_pointer_cast<SurfaceGeneralizedBezier>(surf);
+    if (bezier && !std::dynamic_pointer_cast<SurfaceHybrid>(surf)) {
+      size_t degree = bezier->degree();
+      DoubleVector knots;
+      knots.insert(knots.end(), degree + 1, 0.0);
+      knots.insert(knots.end(), degree + 1, 1.0);
+      PointVector cpts(degree + 1);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j <= degree; ++j)
+          cpts[j] = bezier->controlPoint(i, j, 1);
+        inner_curves.push_back(std::make_shared<BSCurve>(degree, knots, cpts));
+      }
+    }
+
+    auto sides = analyzeContinuity(*surf);
+    const Point2DVector &v = domain->vertices();
+    double max_difference = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      Vector2D perp = v[i] - v[(i+n-1)%n];
+      perp = Vector2D(perp[1], -perp[0]);
+      if ((domain->center() - v[i]) * perp < 0)
+        perp = -perp;
+      perp.normalize();
+      double max_angle = 0.0;
+      for (size_t j = 0; j <= res; ++j) {
+        double s = (double)j / (double)res;
+        Point2D uv = domain->edgePoint(i, s);
+        Point3D p = surf->eval(uv), q = surf->eval(uv + perp * step);
+        Point3D c = surf->ribbon(i)->curve()->eval(s, 1, der);
+        Vector3D surf_normal = (der[1] ^ (q - p)).normalize();
+        Vector3D normal = inner_curves.empty()
+          ? surf->ribbon(i)->normal(s)
+          : (der[1] ^ (inner_curves[i]->eval(s) - c)).normalize();
+        max_angle = std::max(max_angle, std::acos(std::clamp(surf_normal * normal, -1.0, 1.0)));
+      }
+      max_difference = std::max(max_difference, std::abs(max_angle - sides[i].max_angle));
+    }
+    std::cout << type << ": max. difference of the tangential errors "
+              << max_difference * 180.0 / M_PI << (surf->analyticDerivatives() ? " (analytic)" : "")
+              << std::endl;
+  }
+}
+
+// A batch of the GB patch of the model and a moved copy, compared with the evaluation
+// of the patches (and, when compiled with offload, the device evaluation with the batch)
+void batchTest() {
+  if (!std::ifstream("../../models/" + filename + ".gbp"))
+    return;
+  auto surf = std::make_shared<SurfaceGeneralizedBezier>();
+  loadBezier("../../models/" + filename + ".gbp", surf.get());
+  auto moved = std::make_shared<SurfaceGeneralizedBezier>(*surf);
+  moved->setCentralControlPoint(moved->centralControlPoint() + Vector3D(0, 0, 1));
+  moved->update();
+  PatchBatch batch(resolution);
+  batch.add(surf);
+  batch.add(moved);
+  std::vector<float> points, normals;
+  batch.eval(points, normals);
+
+  double max_error = 0.0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    PointVector expected = (i == 0 ? surf : moved)->eval(resolution).points();
+    size_t first = batch.vertexOffsets()[i];
+    for (size_t j = 0; j < expected.size(); ++j)
+      for (size_t k = 0; k < 3; ++k)
+        max_error = std::max(max_error, std::abs(points[3 * (first + j) + k] - expected[j][k]));
+  }
+  std::cout << "batch: max. deviation " << max_error << std::endl;
+
+#ifdef TRANSFINITE_OFFLOAD
+  PatchBatchDevice device(batch);
+  device.eval();
+  std::vector<float> device_points, device_normals;
+  device.download(device_points, device_normals);
+  double max_point = 0.0, max_normal = 0.0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    max_point = std::max(max_point, (double)std::abs(device_points[i] - points[i]));
+    max_normal = std::max(max_normal, (double)std::abs(device_normals[i] - normals[i]));
+  }
+  std::cout << "device " << device.device() << ": max. deviation of the points " << max_point
+            << ", of the normals " << max_normal << std::endl;
+#endif
+}
+
+// Each surface type is set to the loop of the model, evaluated, then set to the loop of another
+// model (with a different number of sides); the mesh topology should follow the new side count
+void sidesTest(const std::string &other) {
+  const size_t res = 10;
+  CurveVector cv = readLOP("../../models/" + other + ".lop");
+  if (cv.empty())
+    return;
+  for (const auto &[type, surf] : allLoopSurfaces()) {
+    if (std::dynamic_pointer_cast<SurfaceGeneralizedBezier>(surf))
+      continue;                 // the control points are read from the .gbp file
+    surf->eval(res);
+    size_t before = surf->domain()->size();
+    surf->setCurves(cv);
+    surf->setupLoop();
+    surf->update();
+    size_t size = surf->domain()->sharedParameters(res)->size();
+    auto indices = surf->domain()->meshIndices(res);
+    // Every vertex is in some triangle exactly when the topology has the new side count
+    std::vector<bool> used(size, false);
+    bool ok = true;
+    for (uint32_t i : *indices)
+      if (i < size)
+        used[i] = true;
+      else
+        ok = false;
+    ok = ok && std::all_of(used.begin(), used.end(), [](bool u) { return u; });
+    std::cout << type << ": " << before << " -> " << surf->domain()->size() << " sides, "
+              << (ok ? "ok" : "stale topology") << std::endl;
+  }
+}
+
 int main(int argc, char **argv) {
 #ifdef DEBUG
   std::cout << "Compiled in DEBUG mode" << std::endl;
@@ -491,6 +758,12 @@ int main(int argc, char **argv) {
               << argv[0] << " hybrid [model-name]" << std::endl
               << argv[0] << " cloud [model-name]" << std::endl
               << argv[0] << " class-a" << std::endl
+              << argv[0] << " concurrency [model-name]" << std::endl
+              << argv[0] << " stream [model-name]" << std::endl
+              << argv[0] << " continuity [model-name]" << std::endl
+              << argv[0] << " sides [model-name] [other-model-name]" << std::endl
+              << argv[0] << " batch [model-name]" << std::endl
+              << argv[0] << " model [model-name]" << std::endl
               << argv[0] << " mesh-fit [model-name] [mesh-name]" << std::endl
               << argv[0] << " deviation [model-name] [mesh-name]" << std::endl
               << argv[0] << " spatch [model-name]" << std::endl
@@ -514,6 +787,18 @@ int main(int argc, char **argv) {
     cloudTest();
   else if (type == "class-a")
     classATest();
+  else if (type == "concurrency")
+    concurrencyTest();
+  else if (type == "stream")
+    streamTest();
+  else if (type == "continuity")
+    continuityTest();
+  else if (type == "batch")
+    batchTest();
+  else if (type == "sides")
+    sidesTest(argc > 3 ? argv[3] : "pocket6sided");
+  else if (type == "model")
+    modelTest();
   else if (type == "mesh-fit" || type == "deviation") {
     if (argc < 4) {
       std::cerr << "Not enough parameters!" << std::endl;
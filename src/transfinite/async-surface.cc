@@ -0,0 +1,116 @@
+#include "async-surface.hh"
+
+namespace Transfinite {
+
+AsyncSurface::AsyncSurface(const std::shared_ptr<Surface> &surface, size_t resolution,
+                           const Executor &executor)
+  : surface_(surface), resolution_(resolution), executor_(executor),
+    version_(0), busy_(false), stop_(false), cancel_(false) {
+  worker_ = std::thread([this]() { run(); });
+}
+
+AsyncSurface::~AsyncSurface() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cancel_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+  surface_->setExecutor(executor_);
+}
+
+void
+AsyncSurface::setCallback(const std::function<void (const Snapshot &)> &callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  callback_ = callback;
+}
+
+size_t
+AsyncSurface::edit(const Edit &edit) {
+  size_t version;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    edits_.push_back(edit);
+    version = ++version_;
+    cancel_ = true;
+  }
+  changed_.notify_all();
+  return version;
+}
+
+size_t
+AsyncSurface::setResolution(size_t resolution) {
+  return edit([this, resolution](Surface &) { resolution_ = resolution; });
+}
+
+AsyncSurface::Snapshot
+AsyncSurface::latest() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latest_;
+}
+
+AsyncSurface::Snapshot
+AsyncSurface::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [&]() { return edits_.empty() && !busy_; });
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+  return latest_;
+}
+
+void
+AsyncSurface::run() {
+  auto cancellable = cancellableExecutor(executor_, [this]() { return cancel_.load(); });
+  while (true) {
+    std::deque<Edit> edits;
+    size_t version;
+    std::function<void (const Snapshot &)> callback;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [&]() { return stop_ || !edits_.empty(); });
+      if (stop_)
+        break;
+      edits.swap(edits_);
+      version = version_;
+      callback = callback_;
+      cancel_ = false;
+      busy_ = true;
+    }
+
+    try {
+      for (const auto &e : edits)
+        e(*surface_);
+      surface_->setExecutor(executor_);
+      surface_->update();
+      if (!cancel_) {
+        surface_->setExecutor(cancellable);
+        auto mesh = std::make_shared<const TriMesh>(surface_->eval(resolution_));
+        Snapshot snapshot = { version, mesh };
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          latest_ = snapshot;
+        }
+        if (callback)
+          callback(snapshot);
+      }
+    } catch (const Cancelled &) {
+      // Newer edits are waiting
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+    }
+    idle_.notify_all();
+  }
+}
+
+} // namespace Transfinite
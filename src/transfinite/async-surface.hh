@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "surface.hh"
+
+namespace Transfinite {
+
+// Updates and tessellations of a surface on a background thread, for interactive editing.
+// The surface is owned by the worker thread: it should be changed only by edits,
+// which are applied there between two tessellations, followed by update() and eval(resolution).
+// A new edit cancels the tessellation in progress (at the granularity of the executor tasks);
+// update() itself is never interrupted, but the tessellation after it is skipped
+// when newer edits are already waiting. None of the public functions block, except wait().
+class AsyncSurface {
+public:
+  using Edit = std::function<void (Surface &)>;
+  struct Snapshot {
+    size_t version = 0;                  // number of edits included
+    std::shared_ptr<const TriMesh> mesh; // null before the first tessellation
+  };
+
+  // Once constructed, the surface should not be accessed directly
+  AsyncSurface(const std::shared_ptr<Surface> &surface, size_t resolution,
+               const Executor &executor = threadExecutor());
+  // Cancels the work in progress, and discards the queued edits
+  ~AsyncSurface();
+  // Called on the worker thread after each completed tessellation
+  void setCallback(const std::function<void (const Snapshot &)> &callback);
+  // Queues an edit, followed by the recomputation; returns the version of the result
+  size_t edit(const Edit &edit);
+  size_t setResolution(size_t resolution);
+  // The latest complete tessellation
+  Snapshot latest() const;
+  // Blocks until all queued edits are processed; rethrows the first exception
+  // of an edit, update() or eval() since the last wait()
+  Snapshot wait();
+
+private:
+  void run();
+
+  std::shared_ptr<Surface> surface_;
+  size_t resolution_;
+  Executor executor_;
+  std::function<void (const Snapshot &)> callback_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_, idle_;
+  std::deque<Edit> edits_;
+  size_t version_;      // of the last queued edit
+  bool busy_, stop_;
+  std::atomic<bool> cancel_;
+  Snapshot latest_;
+  std::exception_ptr error_;
+  std::thread worker_;
+};
+
+} // namespace Transfinite
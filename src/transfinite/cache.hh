@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+// Size and use of a cache; hits and misses are counted from its construction
+struct CacheStatistics {
+  size_t entries = 0;
+  size_t bytes = 0;                     // estimated, including the bookkeeping
+  uint64_t hits = 0, misses = 0, evictions = 0;
+  CacheStatistics &operator+=(const CacheStatistics &other) {
+    entries += other.entries; bytes += other.bytes;
+    hits += other.hits; misses += other.misses; evictions += other.evictions;
+    return *this;
+  }
+};
+
+// Heap memory owned by a cached value
+template<typename T>
+size_t payloadBytes(const T &) { return 0; }
+template<typename U>
+size_t payloadBytes(const std::vector<U> &v) { return v.capacity() * sizeof(U); }
+
+// Concurrent cache of values computed for exact domain points.
+// The table is split into shards, each guarded by its own reader-writer lock,
+// so lookups proceed in parallel, and threads filling it rarely contend.
+// The values are shared, so they stay valid after an eviction or clear().
+// By default the cache is unlimited; with a limit, each shard keeps two generations:
+// when the current one is full, the previous one is evicted and the current one takes its place;
+// values found in the previous generation are moved back to the current one (approximating LRU).
+// clear() and setLimit() must not run concurrently with other member functions.
+// Copies start empty, with the same limit.
+template<typename T>
+class PointCache {
+public:
+  using Value = std::shared_ptr<const T>;
+
+  PointCache() = default;
+  PointCache(const PointCache &other) : limit_(other.limit_) { }
+  PointCache &operator=(const PointCache &other) {
+    clear();
+    limit_ = other.limit_;
+    return *this;
+  }
+
+  // Null when not found
+  Value find(const Point2D &p) const {
+    Shard &shard = shardOf(p);
+    {
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.current.find(p);
+      if (it != shard.current.end()) {
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+      }
+      if (shard.previous.find(p) == shard.previous.end()) {
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    Value value = promote(shard, p);
+    (value ? shard.hits : shard.misses).fetch_add(1, std::memory_order_relaxed);
+    return value;
+  }
+
+  // When another thread was faster, its (identical) value is kept.
+  Value insert(const Point2D &p, T value) {
+    auto shared = std::make_shared<const T>(std::move(value));
+    Shard &shard = shardOf(p);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (Value existing = promote(shard, p))
+      return existing;
+    add(shard, p, shared);
+    return shared;
+  }
+
+  void clear() {
+    for (auto &shard : shards_) {
+      shard.current.clear();
+      shard.previous.clear();
+      shard.current_bytes = shard.previous_bytes = 0;
+    }
+  }
+
+  // Maximal number of entries (approximately, as it is divided among the shards);
+  // 0 means unlimited. Also clears the cache.
+  void setLimit(size_t limit) {
+    clear();
+    limit_ = limit;
+  }
+
+  size_t limit() const {
+    return limit_;
+  }
+
+  CacheStatistics statistics() const {
+    CacheStatistics result;
+    for (const auto &shard : shards_) {
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      result.entries += shard.current.size() + shard.previous.size();
+      result.bytes += shard.current_bytes + shard.previous_bytes;
+      result.hits += shard.hits.load(std::memory_order_relaxed);
+      result.misses += shard.misses.load(std::memory_order_relaxed);
+      result.evictions += shard.evictions;
+    }
+    return result;
+  }
+
+private:
+  struct Hash {
+    size_t operator()(const Point2D &p) const {
+      size_t h1 = std::hash<double>()(p[0]), h2 = std::hash<double>()(p[1]);
+      return h1 ^ (h2 + 0x9e3779b97f4a7c15ULL + (h1 << 6) + (h1 >> 2));
+    }
+  };
+  struct Equal {
+    bool operator()(const Point2D &p, const Point2D &q) const {
+      return p[0] == q[0] && p[1] == q[1];
+    }
+  };
+  using Map = std::unordered_map<Point2D, Value, Hash, Equal>;
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    Map current, previous;
+    size_t current_bytes = 0, previous_bytes = 0;
+    mutable std::atomic<uint64_t> hits{0}, misses{0};
+    uint64_t evictions = 0;
+  };
+
+  static const size_t shard_count = 16;
+
+  static size_t shardIndex(const Point2D &p) {
+    // Use the high bits, as the buckets inside a shard are selected by the low ones
+    return ((Hash()(p) * 0x9e3779b97f4a7c15ULL) >> 60) % shard_count;
+  }
+  Shard &shardOf(const Point2D &p) const { return shards_[shardIndex(p)]; }
+
+  // The hash node, the shared_ptr control block and the value
+  static size_t entryBytes(const T &value) {
+    return sizeof(typename Map::value_type) + 4 * sizeof(void *) + sizeof(T) + payloadBytes(value);
+  }
+
+  // The rest need a unique lock on the shard
+
+  // Looks up p in both generations, moving it to the current one
+  Value promote(Shard &shard, const Point2D &p) const {
+    auto it = shard.current.find(p);
+    if (it != shard.current.end())
+      return it->second;
+    it = shard.previous.find(p);
+    if (it == shard.previous.end())
+      return nullptr;
+    Value value = it->second;
+    shard.previous_bytes -= entryBytes(*value);
+    shard.previous.erase(it);
+    add(shard, p, value);
+    return value;
+  }
+
+  void add(Shard &shard, const Point2D &p, const Value &value) const {
+    shard.current.emplace(p, value);
+    shard.current_bytes += entryBytes(*value);
+    if (limit_ > 0 && shard.current.size() >= generationSize()) {
+      shard.evictions += shard.previous.size();
+      shard.previous = std::move(shard.current);
+      shard.previous_bytes = shard.current_bytes;
+      shard.current = Map();
+      shard.current_bytes = 0;
+    }
+  }
+
+  size_t generationSize() const {
+    return std::max<size_t>((limit_ + 2 * shard_count - 1) / (2 * shard_count), 1);
+  }
+
+  size_t limit_ = 0;
+  mutable std::array<Shard, shard_count> shards_;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,66 @@
+#include "constrained-solver.hh"
+#include "profiler.hh"
+
+namespace Transfinite {
+
+using namespace Eigen;
+
+ConstrainedSolver::ConstrainedSolver(const SparseMatrix<double> &A,
+                                     const std::vector<size_t> &fixed)
+  : fixed_(fixed) {
+  TRANSFINITE_TIMER("ConstrainedSolver::factorize");
+  // Position of each variable in the reduced system or among the fixed ones
+  size_t n = A.rows();
+  std::vector<bool> is_fixed(n, false);
+  std::vector<size_t> position(n);
+  for (size_t j = 0; j < fixed_.size(); ++j) {
+    is_fixed[fixed_[j]] = true;
+    position[fixed_[j]] = j;
+  }
+  for (size_t i = 0; i < n; ++i)
+    if (!is_fixed[i]) {
+      position[i] = free_.size();
+      free_.push_back(i);
+    }
+
+  std::vector<Triplet<double>> reduced, coupling;
+  for (int k = 0; k < A.outerSize(); ++k)
+    for (SparseMatrix<double>::InnerIterator it(A, k); it; ++it) {
+      size_t i = it.row(), j = it.col();
+      if (is_fixed[i])
+        continue;
+      if (is_fixed[j])
+        coupling.emplace_back(position[i], position[j], it.value());
+      else
+        reduced.emplace_back(position[i], position[j], it.value());
+    }
+  SparseMatrix<double> R(free_.size(), free_.size());
+  R.setFromTriplets(reduced.begin(), reduced.end());
+  coupling_.resize(free_.size(), fixed_.size());
+  coupling_.setFromTriplets(coupling.begin(), coupling.end());
+
+  ldlt_.compute(R);
+  if (ldlt_.info() != Success) {
+    lu_ = std::make_unique<SparseLU<SparseMatrix<double>>>();
+    lu_->compute(R);
+  }
+}
+
+MatrixXd
+ConstrainedSolver::solve(const MatrixXd &f, const MatrixXd &values) const {
+  TRANSFINITE_TIMER("ConstrainedSolver::solve");
+  MatrixXd rhs = -(coupling_ * values);
+  if (f.rows() > 0)
+    for (size_t i = 0; i < free_.size(); ++i)
+      rhs.row(i) += f.row(free_[i]);
+  MatrixXd y = lu_ ? MatrixXd(lu_->solve(rhs)) : MatrixXd(ldlt_.solve(rhs));
+
+  MatrixXd x(free_.size() + fixed_.size(), values.cols());
+  for (size_t i = 0; i < free_.size(); ++i)
+    x.row(free_[i]) = y.row(i);
+  for (size_t j = 0; j < fixed_.size(); ++j)
+    x.row(fixed_[j]) = values.row(j);
+  return x;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Sparse>
+
+namespace Transfinite {
+
+// Solves A x = f, where the values of x are given at some indices (e.g. on the boundary of a mesh).
+// The given values are eliminated to the right-hand side, so when A is symmetric and
+// positive definite on the remaining variables, the reduced system is solved by sparse Cholesky
+// (LDLT) factorization, falling back to LU when that fails.
+// The factorization is computed once, and can be reused for any number of right-hand sides.
+class ConstrainedSolver {
+public:
+  ConstrainedSolver(const Eigen::SparseMatrix<double> &A, const std::vector<size_t> &fixed);
+  // `f` has a row for each variable (or none, meaning zero), `values` for each fixed index
+  Eigen::MatrixXd solve(const Eigen::MatrixXd &f, const Eigen::MatrixXd &values) const;
+
+private:
+  std::vector<size_t> fixed_, free_;
+  Eigen::SparseMatrix<double> coupling_; // free rows, fixed columns
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt_;
+  std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<double>>> lu_;
+};
+
+} // namespace Transfinite
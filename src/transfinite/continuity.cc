@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "continuity.hh"
+#include "domain.hh"
+#include "ribbon.hh"
+#include "surface-generalized-bezier.hh"
+#include "surface-harmonic.hh"
+#include "surface-hybrid.hh"
+
+namespace Transfinite {
+
+// Step into the domain for the cross-boundary tangents of surfaces without analytic derivatives
+static const double inward_step = 1.0e-4;
+
+std::vector<SideContinuity>
+analyzeContinuity(const Surface &surface, const ContinuityOptions &options) {
+  if (options.samples == 0)
+    throw std::invalid_argument("continuity analysis needs at least one interval per side");
+  auto domain = surface.domain();
+  size_t n = domain->size(), m = options.samples + 1;
+  // Harmonic patches have no tangential boundary data
+  bool tangential = options.tangential && !dynamic_cast<const SurfaceHarmonic *>(&surface);
+
+  // Inward directions, perpendicular to the sides in the domain
+  const Point2DVector &v = domain->vertices();
+  std::vector<Vector2D> perps(n);
+  for (size_t i = 0; i < n; ++i) {
+    Vector2D perp = v[i] - v[(i+n-1)%n];
+    perp = Vector2D(perp[1], -perp[0]);
+    if ((domain->center() - v[i]) * perp < 0)
+      perp = -perp;
+    perps[i] = perp.normalize();
+  }
+
+  Point2DVector uvs;
+  uvs.reserve(n * m);
+  for (size_t i = 0; i < n; ++i)
+    for (size_t j = 0; j < m; ++j)
+      uvs.push_back(domain->edgePoint(i, (double)j / options.samples));
+  bool analytic = tangential && surface.analyticDerivatives();
+  std::vector<Surface::Derivatives> ders;
+  PointVector points, inner;
+  if (analytic) {
+    ders = surface.evalDerivatives(uvs);
+    for (const auto &d : ders)
+      points.push_back(d.point);
+  } else {
+    points = surface.eval(uvs);
+    if (tangential) {
+      Point2DVector steps(uvs.size());
+      for (size_t k = 0; k < uvs.size(); ++k)
+        steps[k] = uvs[k] + perps[k / m] * inward_step;
+      inner = surface.eval(steps);
+    }
+  }
+
+  // Generalized Bezier patches have no ribbons, the tangent planes are given by the control points
+  auto bezier = dynamic_cast<const SurfaceGeneralizedBezier *>(&surface);
+  if (dynamic_cast<const SurfaceHybrid *>(&surface))
+    bezier = nullptr;
+  CurveVector inner_curves;
+  if (bezier && tangential) {
+    size_t degree = bezier->degree();
+    DoubleVector knots;
+    knots.insert(knots.end(), degree + 1, 0.0);
+    knots.insert(knots.end(), degree + 1, 1.0);
+    PointVector cpts(degree + 1);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j <= degree; ++j)
+        cpts[j] = bezier->controlPoint(i, j, 1);
+      inner_curves.push_back(std::make_shared<BSCurve>(degree, knots, cpts));
+    }
+  }
+
+  DoubleVector distances(n * m), angles(n * m, 0.0);
+  options.executor(n * m, [&](size_t begin, size_t end) {
+    VectorVector der;
+    for (size_t k = begin; k < end; ++k) {
+      size_t i = k / m;
+      double s = (double)(k % m) / options.samples;
+      auto ribbon = surface.ribbon(i);
+      Point3D p = ribbon->curve()->eval(s, 1, der);
+      distances[k] = (points[k] - p).norm();
+      if (!tangential)
+        continue;
+      Vector3D inward = analytic ? ders[k].du * perps[i][0] + ders[k].dv * perps[i][1]
+                                 : inner[k] - points[k];
+      Vector3D surface_normal = (der[1] ^ inward).normalize();
+      Vector3D normal = bezier ? (der[1] ^ (inner_curves[i]->eval(s) - p)).normalize()
+                               : ribbon->normal(s);
+      angles[k] = std::acos(std::clamp(surface_normal * normal, -1.0, 1.0));
+    }
+  });
+
+  std::vector<SideContinuity> result(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto &side = result[i];
+    for (size_t k = i * m; k < (i + 1) * m; ++k) {
+      side.max_position = std::max(side.max_position, distances[k]);
+      side.rms_position += distances[k] * distances[k];
+      side.max_angle = std::max(side.max_angle, angles[k]);
+      side.rms_angle += angles[k] * angles[k];
+    }
+    side.rms_position = std::sqrt(side.rms_position / m);
+    side.rms_angle = std::sqrt(side.rms_angle / m);
+  }
+  return result;
+}
+
+} // namespace Transfinite
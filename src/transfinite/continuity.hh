@@ -0,0 +1,33 @@
+#pragma once
+
+#include "executor.hh"
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+class Surface;
+
+struct ContinuityOptions {
+  size_t samples = 40;                   // intervals on each side
+  bool tangential = true;                // also measure the G1 error
+  Executor executor = serialExecutor();  // compares the samples with the boundary data
+};
+
+// Deviations along a side: the distance from the boundary curve, and the angle (in radians)
+// between the normals of the surface and of the ribbon (for generalized Bezier patches,
+// of the plane spanned by the first two control rows)
+struct SideContinuity {
+  double max_position = 0.0, rms_position = 0.0;
+  double max_angle = 0.0, rms_angle = 0.0;
+};
+
+// Samples each side uniformly; the surface points are evaluated in one batch by the executor
+// of the surface. The cross-boundary tangents are analytic when the surface provides them
+// (see Surface::analyticDerivatives), and are given by a small step inside the domain otherwise;
+// harmonic patches, which interpolate only the curves, have no G1 error.
+std::vector<SideContinuity> analyzeContinuity(const Surface &surface,
+                                              const ContinuityOptions &options = {});
+
+} // namespace Transfinite
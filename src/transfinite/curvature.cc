@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+
+#include "curvature.hh"
+#include "domain.hh"
+#include "surface-biharmonic.hh"
+#include "surface-harmonic.hh"
+
+namespace Transfinite {
+
+Incidence
+incidence(const TriMesh &mesh, size_t n_all) {
+  Incidence result;
+  result.triangles.assign(mesh.triangles().begin(), mesh.triangles().end());
+  result.corners.resize(n_all);
+  for (size_t i = 0; i < result.triangles.size(); ++i)
+    for (size_t k = 0; k < 3; ++k)
+      result.corners[result.triangles[i][k]].emplace_back(i, k);
+  return result;
+}
+
+static double computeAngle(Vector3D u, Vector3D v) {
+  u.normalize(); v.normalize();
+  return std::acos(std::min(std::max(u * v, -1.0), 1.0));
+}
+
+static double voronoiArea(const Point3D &p1, const Point3D &p2, const Point3D &p3) {
+  double a2 = (p3 - p2).normSqr(), b2 = (p1 - p3).normSqr(), c2 = (p2 - p1).normSqr();
+  double alpha = computeAngle(p2 - p1, p3 - p1);
+
+  if (a2 + b2 < c2)                // obtuse gamma
+    return 0.125 * b2 * std::tan(alpha);
+  if (a2 + c2 < b2)                // obtuse beta
+    return 0.125 * c2 * std::tan(alpha);
+  if (b2 + c2 < a2) {              // obtuse alpha
+    double b = std::sqrt(b2), c = std::sqrt(c2);
+    double total_area = 0.5 * b * c * std::sin(alpha);
+    double beta = computeAngle(p1 - p2, p3 - p2);
+    double gamma = computeAngle(p1 - p3, p2 - p3);
+    return total_area - 0.125 * (b2 * std::tan(gamma) + c2 * std::tan(beta));
+  }
+
+  double r2 = 0.25 * a2 / std::pow(std::sin(alpha), 2); // squared circumradius
+  auto area = [r2](double x2) {
+    return 0.125 * std::sqrt(x2) * std::sqrt(std::max(4.0 * r2 - x2, 0.0));
+  };
+  return area(b2) + area(c2);
+}
+
+DoubleVector
+voronoiAreas(const Incidence &incidence, const PointVector &points, const Executor &executor) {
+  size_t n_all = points.size();
+  DoubleVector areas(n_all);
+  executor(n_all, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      for (auto [j, k] : incidence.corners[i]) {
+        const auto &t = incidence.triangles[j];
+        areas[i] += voronoiArea(points[t[k]], points[t[(k+1)%3]], points[t[(k+2)%3]]);
+      }
+  });
+  return areas;
+}
+
+// Cotangent of the angle at p between the directions to q and r
+static double cotangent(const Point3D &p, const Point3D &q, const Point3D &r) {
+  Vector3D u = q - p, v = r - p;
+  return (u * v) / (u ^ v).norm();
+}
+
+// Replaces the curvatures of the flagged vertices by the average of their unflagged neighbors
+static void extrapolate(CurvatureMap &map, const Incidence &incidence,
+                        const std::vector<char> &flagged, const Executor &executor) {
+  executor(flagged.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!flagged[i])
+        continue;
+      size_t count = 0;
+      double k = 0.0, h = 0.0;
+      for (auto [j, l] : incidence.corners[i])
+        for (size_t m : { (l + 1) % 3, (l + 2) % 3 }) {
+          size_t q = incidence.triangles[j][m];
+          if (!flagged[q]) {         // once for each shared triangle
+            k += map.gaussian[q];
+            h += map.mean[q];
+            ++count;
+          }
+        }
+      map.gaussian[i] = count ? k / count : 0.0;
+      map.mean[i] = count ? h / count : 0.0;
+    }
+  });
+}
+
+static void integrate(CurvatureMap &map, const DoubleVector &areas) {
+  for (size_t i = 0; i < areas.size(); ++i) {
+    double k = map.gaussian[i], h = map.mean[i];
+    map.area += areas[i];
+    map.bending_energy += areas[i] * (4.0 * h * h - 2.0 * k);
+    map.willmore_energy += areas[i] * h * h;
+    map.max_gaussian = std::max(map.max_gaussian, std::abs(k));
+    map.max_mean = std::max(map.max_mean, std::abs(h));
+  }
+}
+
+CurvatureMap
+analyzeCurvature(const TriMesh &mesh, const Executor &executor) {
+  const PointVector &points = mesh.points();
+  size_t n_all = points.size();
+  auto inc = incidence(mesh, n_all);
+  auto areas = voronoiAreas(inc, points, executor);
+
+  CurvatureMap result;
+  result.mesh = mesh;
+  result.gaussian.resize(n_all);
+  result.mean.resize(n_all);
+  std::vector<char> on_edge(n_all, false); // not vector<bool>, as it is written concurrently
+  executor(n_all, [&](size_t begin, size_t end) {
+    std::vector<std::pair<size_t, size_t>> edges; // (neighbor, number of triangles)
+    for (size_t i = begin; i < end; ++i) {
+      const Point3D &p1 = points[i];
+      double angles = 0.0;
+      Vector3D laplace(0, 0, 0), normal(0, 0, 0);
+      edges.clear();
+      for (auto [j, k] : inc.corners[i]) {
+        const auto &t = inc.triangles[j];
+        size_t i2 = t[(k+1)%3], i3 = t[(k+2)%3];
+        const Point3D &p2 = points[i2], &p3 = points[i3];
+        angles += computeAngle(p2 - p1, p3 - p1);
+        laplace += (p2 - p1) * cotangent(p3, p1, p2) + (p3 - p1) * cotangent(p2, p3, p1);
+        normal += (p2 - p1) ^ (p3 - p1);
+        for (size_t q : { i2, i3 }) {
+          auto it = std::find_if(edges.begin(), edges.end(),
+                                 [q](const auto &e) { return e.first == q; });
+          if (it == edges.end())
+            edges.emplace_back(q, 1);
+          else
+            it->second++;
+        }
+      }
+      for (const auto &e : edges)
+        if (e.second == 1)
+          on_edge[i] = true;
+      result.gaussian[i] = (2.0 * M_PI - angles) / areas[i];
+      result.mean[i] = laplace * normal.normalize() / (4.0 * areas[i]);
+    }
+  });
+
+  // The formulas above assume a closed fan
+  extrapolate(result, inc, on_edge, executor);
+  integrate(result, areas);
+  return result;
+}
+
+namespace {
+
+  // Differences of the derivatives at a vertex in two directions (u and v, where possible):
+  // central ones at points uv +- h d while both are in the domain, and one-sided ones
+  // (of second order) at uv + h d and uv + 2h d from the inside where a step leaves it;
+  // where both steps along u or v leave it (at some corners), the directions are 30 degrees
+  // either side of the direction towards the center, as in Surface::evalDerivativesNumerically
+  struct Stencil {
+    Vector2D directions[2];
+    double steps[2];
+    bool central[2];
+    // The derivative of f in direction k, given its values at uv and the two stencil points
+    Vector3D derivative(size_t k, const Vector3D &f, const Vector3D &a, const Vector3D &b) const {
+      if (central[k])
+        return (a - b) / (2.0 * steps[k]);
+      return ((a - f) * 4 - (b - f)) / (2.0 * steps[k]);
+    }
+  };
+
+  Stencil stencil(const Domain &domain, const Point2D &uv) {
+    static const double step = 1.0e-4;
+    Stencil result;
+    auto direction = [&](size_t k, const Vector2D &d) {
+      bool forward = domain.contains(uv + d * step), backward = domain.contains(uv - d * step);
+      result.directions[k] = d;
+      result.central[k] = forward == backward;
+      result.steps[k] = forward || !backward ? step : -step;
+      return forward || backward;
+    };
+    if (direction(0, Vector2D(1, 0)) && direction(1, Vector2D(0, 1)))
+      return result;
+
+    Vector2D c = (domain.center() - uv).normalize();
+    double cos30 = std::sqrt(3.0) / 2, sin30 = 0.5;
+    direction(0, Vector2D(c[0] * cos30 - c[1] * sin30, c[0] * sin30 + c[1] * cos30));
+    direction(1, Vector2D(c[0] * cos30 + c[1] * sin30, c[1] * cos30 - c[0] * sin30));
+    return result;
+  }
+
+}
+
+CurvatureMap
+analyzeCurvature(const Surface &surface, size_t resolution, const Executor &executor) {
+  if (dynamic_cast<const SurfaceHarmonic *>(&surface) ||
+      dynamic_cast<const SurfaceBiharmonic *>(&surface))
+    return analyzeCurvature(surface.eval(resolution), executor);
+
+  auto domain = surface.domain();
+  auto shared_uvs = domain->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  size_t n_all = uvs.size();
+  std::vector<Stencil> stencils(n_all);
+  Point2DVector stencil_uvs;
+  stencil_uvs.reserve(5 * n_all);
+  for (size_t i = 0; i < n_all; ++i) {
+    stencils[i] = stencil(*domain, uvs[i]);
+    stencil_uvs.push_back(uvs[i]);
+    for (size_t k = 0; k < 2; ++k) {
+      const Vector2D &d = stencils[i].directions[k];
+      double h = stencils[i].steps[k];
+      stencil_uvs.push_back(uvs[i] + d * h);
+      stencil_uvs.push_back(stencils[i].central[k] ? uvs[i] - d * h : uvs[i] + d * (2 * h));
+    }
+  }
+  auto ders = surface.evalDerivatives(stencil_uvs);
+
+  CurvatureMap result;
+  result.mesh = domain->meshTopology(resolution);
+  result.gaussian.resize(n_all);
+  result.mean.resize(n_all);
+  PointVector points(n_all);
+  std::vector<char> singular(n_all, false);
+  executor(n_all, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const auto *d = &ders[5 * i];
+      const Stencil &st = stencils[i];
+      points[i] = d[0].point;
+      // Derivatives of du and dv in the two directions, then by u and v
+      Vector3D du1 = st.derivative(0, d[0].du, d[1].du, d[2].du);
+      Vector3D du2 = st.derivative(1, d[0].du, d[3].du, d[4].du);
+      Vector3D dv1 = st.derivative(0, d[0].dv, d[1].dv, d[2].dv);
+      Vector3D dv2 = st.derivative(1, d[0].dv, d[3].dv, d[4].dv);
+      const Vector2D &d1 = st.directions[0], &d2 = st.directions[1];
+      double d12 = d1[0] * d2[1] - d1[1] * d2[0];
+      Vector3D duu = (du1 * d2[1] - du2 * d1[1]) / d12;
+      Vector3D duv = ((du2 * d1[0] - du1 * d2[0]) + (dv1 * d2[1] - dv2 * d1[1])) / (2.0 * d12);
+      Vector3D dvv = (dv2 * d1[0] - dv1 * d2[0]) / d12;
+      Vector3D normal = (d[0].du ^ d[0].dv).normalize();
+      double E = d[0].du * d[0].du, F = d[0].du * d[0].dv, G = d[0].dv * d[0].dv;
+      double L = duu * normal, M = duv * normal, N = dvv * normal;
+      double det = E * G - F * F;
+      result.gaussian[i] = (L * N - M * M) / det;
+      result.mean[i] = (E * N - 2.0 * F * M + G * L) / (2.0 * det);
+      singular[i] = !std::isfinite(result.gaussian[i]) || !std::isfinite(result.mean[i]);
+    }
+  });
+  result.mesh.setPoints(points);
+
+  // E.g. at the corners of generalized Bezier patches, where a derivative vanishes
+  auto inc = incidence(result.mesh, n_all);
+  extrapolate(result, inc, singular, executor);
+  integrate(result, voronoiAreas(inc, points, executor));
+  return result;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "executor.hh"
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+class Surface;
+
+// The triangles of a mesh, and the ones incident to each vertex (with the position of the vertex
+// in them, in the order of the triangles), for loops over the vertices
+struct Incidence {
+  std::vector<TriMesh::Triangle> triangles;
+  std::vector<std::vector<std::pair<size_t, size_t>>> corners;
+};
+
+Incidence incidence(const TriMesh &mesh, size_t n_all);
+
+// Mixed Voronoi areas of the vertices (as in Meyer et al., with obtuse triangles split
+// at the midpoint of the opposite side); computed for each vertex in parallel,
+// adding the contributions in the order of the triangles
+DoubleVector voronoiAreas(const Incidence &incidence, const PointVector &points,
+                          const Executor &executor);
+
+// Curvatures at the vertices of a mesh, and fairness measures integrated with the vertex areas
+struct CurvatureMap {
+  TriMesh mesh;
+  DoubleVector gaussian, mean;          // the mean curvature is positive with the normal
+  double area = 0.0;
+  double bending_energy = 0.0;          // integral of k1^2 + k2^2 (thin plate energy)
+  double willmore_energy = 0.0;         // integral of H^2
+  double max_gaussian = 0.0, max_mean = 0.0; // maximal absolute values
+};
+
+// Discrete curvatures of any mesh: the angle defect and the cotangent Laplacian,
+// divided by the Voronoi areas; boundary vertices take the average of their interior neighbors
+CurvatureMap analyzeCurvature(const TriMesh &mesh, const Executor &executor = serialExecutor());
+
+// Curvatures at the vertices of the mesh of eval(resolution), computed in the same pass as
+// the points; the second derivatives are differences of evalDerivatives() (analytic where
+// the surface provides them), one-sided from the inside on the boundary; vertices where
+// the surface is singular take the average of their neighbors, as in the discrete case.
+// The harmonic and biharmonic surfaces are analyzed as meshes. The derivatives are evaluated
+// by the executor of the surface, the curvatures by the one given.
+CurvatureMap analyzeCurvature(const Surface &surface, size_t resolution,
+                              const Executor &executor = serialExecutor());
+
+} // namespace Transfinite
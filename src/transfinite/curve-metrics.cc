@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#include "curve-metrics.hh"
+
+namespace Transfinite {
+
+namespace {
+
+  struct Entry {
+    std::weak_ptr<const BSCurve> curve;
+    BSCurve state;              // as of the computation of the metrics
+    std::shared_ptr<const CurveMetrics> metrics;
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    std::unordered_map<const BSCurve *, Entry> entries;
+    size_t prune_size = 64;     // expired entries are dropped when the table grows beyond this
+  };
+
+  Registry &registry() {
+    static Registry r;
+    return r;
+  }
+
+  CurveMetrics computeMetrics(const BSCurve &curve) {
+    CurveMetrics result;
+    VectorVector der;
+    result.length = curve.arcLength(0.0, 1.0);
+    result.start = curve.eval(0.0, 1, der);
+    result.start_tangent = der[1];
+    result.end = curve.eval(1.0, 1, der);
+    result.end_tangent = der[1];
+    return result;
+  }
+
+}
+
+bool
+sameCurve(const BSCurve &a, const BSCurve &b) {
+  const auto &p1 = a.controlPoints(), &p2 = b.controlPoints();
+  auto same = [](const Point3D &p, const Point3D &q) {
+    return p[0] == q[0] && p[1] == q[1] && p[2] == q[2];
+  };
+  return a.basis().degree() == b.basis().degree() && a.basis().knots() == b.basis().knots() &&
+    std::equal(p1.begin(), p1.end(), p2.begin(), p2.end(), same);
+}
+
+std::shared_ptr<const CurveMetrics>
+curveMetrics(const std::shared_ptr<const BSCurve> &curve) {
+  Registry &r = registry();
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.entries.find(curve.get());
+    if (it != r.entries.end() && it->second.curve.lock() == curve &&
+        sameCurve(it->second.state, *curve))
+      return it->second.metrics;
+  }
+
+  // Computed outside the lock; concurrent users of the same curve may compute it more than once
+  auto metrics = std::make_shared<const CurveMetrics>(computeMetrics(*curve));
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.entries[curve.get()] = { curve, *curve, metrics };
+  if (r.entries.size() > r.prune_size) {
+    for (auto it = r.entries.begin(); it != r.entries.end(); )
+      if (it->second.curve.expired())
+        it = r.entries.erase(it);
+      else
+        ++it;
+    r.prune_size = std::max<size_t>(64, 2 * r.entries.size());
+  }
+  return metrics;
+}
+
+} // namespace Transfinite
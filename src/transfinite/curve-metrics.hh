@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+// Arc length and end data of a curve, over the parameter range [0, 1]
+struct CurveMetrics {
+  double length;
+  Point3D start, end;                   // eval(0) and eval(1)
+  Vector3D start_tangent, end_tangent;  // the first derivatives there
+};
+
+// Metrics of the current state of the curve, shared by all its users (domains, ribbons and their
+// neighbors, and patches sharing the curve), so they are computed once for each change.
+// Each entry of the registry keeps a copy of its curve, and is recomputed when the curve
+// differs from it; entries of destroyed curves are dropped. Thread-safe.
+std::shared_ptr<const CurveMetrics> curveMetrics(const std::shared_ptr<const BSCurve> &curve);
+
+// Same degree, knots and control points
+bool sameCurve(const BSCurve &a, const BSCurve &b);
+
+} // namespace Transfinite
@@ -1,3 +1,4 @@
+#include "curve-metrics.hh"
 #include "domain-angular.hh"
 #include "utilities.hh"
 
@@ -9,6 +10,11 @@ namespace Transfinite {
 DomainAngular::~DomainAngular() {
 }
 
+std::shared_ptr<Domain>
+DomainAngular::clone() const {
+  return std::make_shared<DomainAngular>(*this);
+}
+
 bool
 DomainAngular::update() {
   n_ = curves_.size();
@@ -16,18 +22,15 @@ DomainAngular::update() {
   // Compute lengths
   DoubleVector lengths; lengths.reserve(curves_.size());
   std::transform(curves_.begin(), curves_.end(), std::back_inserter(lengths),
-                 [](const std::shared_ptr<BSCurve> &c) { return c->arcLength(0.0, 1.0); });
+                 [](const std::shared_ptr<BSCurve> &c) { return curveMetrics(c)->length; });
   double length_sum = std::accumulate(lengths.begin(), lengths.end(), 0.0);
 
   // Compute angles
-  VectorVector der;
   DoubleVector angles; angles.reserve(n_);
   double angle_sum = 0.0;
   for (size_t i = 0; i < n_; ++i) {
-    curves_[i]->eval(1.0, 1, der);
-    Vector3D v1 = -der[1].normalize();
-    curves_[next(i)]->eval(0.0, 1, der);
-    Vector3D v2 = der[1].normalize();
+    Vector3D v1 = -Vector3D(curveMetrics(curves_[i])->end_tangent).normalize();
+    Vector3D v2 = Vector3D(curveMetrics(curves_[next(i)])->start_tangent).normalize();
     angles.push_back(std::acos(inrange(-1, v1 * v2, 1)));
     angle_sum += angles.back();
   }
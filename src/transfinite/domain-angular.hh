@@ -7,6 +7,7 @@ namespace Transfinite {
 class DomainAngular : public DomainCircular {
 public:
   virtual ~DomainAngular();
+  virtual std::shared_ptr<Domain> clone() const override;
   virtual bool update() override;
 };
 
@@ -1,3 +1,4 @@
+#include "curve-metrics.hh"
 #include "domain-circular.hh"
 
 #include <algorithm>
@@ -8,13 +9,18 @@ namespace Transfinite {
 DomainCircular::~DomainCircular() {
 }
 
+std::shared_ptr<Domain>
+DomainCircular::clone() const {
+  return std::make_shared<DomainCircular>(*this);
+}
+
 bool
 DomainCircular::update() {
   n_ = curves_.size();
 
   DoubleVector lengths; lengths.reserve(n_);
   std::transform(curves_.begin(), curves_.end(), std::back_inserter(lengths),
-                 [](const std::shared_ptr<BSCurve> &c) { return c->arcLength(0.0, 1.0); });
+                 [](const std::shared_ptr<BSCurve> &c) { return curveMetrics(c)->length; });
   double normalizer = 2.0 * M_PI / std::accumulate(lengths.begin(), lengths.end(), 0.0);
   std::transform(lengths.begin(), lengths.end(), lengths.begin(),
                  [normalizer](double x) { return x * normalizer; });
@@ -7,6 +7,7 @@ namespace Transfinite {
 class DomainCircular : public Domain {
 public:
   virtual ~DomainCircular();
+  virtual std::shared_ptr<Domain> clone() const override;
   virtual bool update() override;
 };
 
@@ -5,6 +5,11 @@ namespace Transfinite {
 DomainRegular::~DomainRegular() {
 }
 
+std::shared_ptr<Domain>
+DomainRegular::clone() const {
+  return std::make_shared<DomainRegular>(*this);
+}
+
 bool
 DomainRegular::update() {
   size_t m = curves_.size();
@@ -24,6 +29,11 @@ DomainRegular::update() {
   return Domain::update();
 }
 
+bool
+DomainRegular::curveIndependent() const {
+  return true;
+}
+
 void
 DomainRegular::computeCenter() {
   center_ = Point2D(0.0, 0.0);
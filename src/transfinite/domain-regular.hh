@@ -7,7 +7,9 @@ namespace Transfinite {
 class DomainRegular : public Domain {
 public:
   virtual ~DomainRegular();
+  virtual std::shared_ptr<Domain> clone() const override;
   virtual bool update() override;
+  virtual bool curveIndependent() const override;
   virtual void computeCenter() override;
 };
 
@@ -1,14 +1,47 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <numeric>
+#include <stdexcept>
+#include <unordered_map>
 
 #include "domain.hh"
+#include "executor.hh"
+#include "locator.hh"
 #include "utilities.hh"
 
 namespace Transfinite {
 
+namespace {
+
+  uint64_t nextRevision() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+  }
+
+  // Meshes of at least this many points are generated in parallel, by layers
+  const size_t parallel_points = 1 << 18;
+
+  Executor generationExecutor(size_t points) {
+    return points < parallel_points ? serialExecutor() : threadExecutor(0, 1);
+  }
+
+}
+
 Domain::Domain()
-  : n_(0) {
+  : n_(0), revision_(nextRevision()) {
+}
+
+Domain::Domain(const Domain &other)
+  : curves_(other.curves_), n_(other.n_), center_(other.center_), vertices_(other.vertices_),
+    du_(other.du_), dv_(other.dv_), updated_vertices_(other.updated_vertices_),
+    revision_(other.revision_) {
+  std::lock_guard<std::mutex> lock(other.parameters_mutex_);
+  parameters_.entries = other.parameters_.entries;
+  parameters_.limit = other.parameters_.limit;
+  topologies_.entries = other.topologies_.entries;
+  locators_.entries = other.locators_.entries;
 }
 
 Domain::~Domain() {
@@ -27,12 +60,24 @@ Domain::setSides(const CurveVector &curves) {
 }
 
 // Computes everything from vertices
-// except for parameters, which are computed only when needed
+// except for parameters, which are computed only when needed;
+// returns false (keeping the caches) when the vertices have not changed
 bool
 Domain::update() {
+  auto same = [](const Point2D &p, const Point2D &q) { return p[0] == q[0] && p[1] == q[1]; };
+  if (n_ == vertices_.size() &&
+      std::equal(vertices_.begin(), vertices_.end(), updated_vertices_.begin(),
+                 updated_vertices_.end(), same))
+    return false;
+  updated_vertices_ = vertices_;
+  revision_ = nextRevision();
   n_ = vertices_.size();
   computeCenter();
-  parameters_.clear();
+  {
+    std::lock_guard<std::mutex> lock(parameters_mutex_);
+    parameters_.entries.clear();
+    locators_.entries.clear();
+  }
   du_.resize(n_); dv_.resize(n_);
   for (size_t i = 0; i < n_; ++i) {
     du_[i] = vertices_[i] - vertices_[prev(i)];
@@ -43,6 +88,16 @@ Domain::update() {
   return true;
 }
 
+uint64_t
+Domain::revision() const {
+  return revision_;
+}
+
+bool
+Domain::curveIndependent() const {
+  return false;
+}
+
 Point2DVector const &
 Domain::vertices() const {
   return vertices_;
@@ -77,6 +132,38 @@ Domain::intersectEdgeWithRay(size_t i, const Point2D &p, const Vector2D &v, Poin
   return true;
 }
 
+static double segmentDistance(const Point2D &a, const Point2D &b, const Point2D &p) {
+  Vector2D e = b - a;
+  double s = inrange(0.0, ((p - a) * e) / (e * e), 1.0);
+  return (p - (a + e * s)).norm();
+}
+
+// Winding number test, also accepting points within epsilon of the boundary
+bool
+Domain::contains(const Point2D &uv) const {
+  int winding = 0;
+  for (size_t i = 0; i < n_; ++i) {
+    const Point2D &a = vertices_[i], &b = vertices_[next(i)];
+    if (segmentDistance(a, b, uv) < epsilon)
+      return true;
+    Vector2D e = b - a;
+    double side = e[0] * (uv[1] - a[1]) - (uv[0] - a[0]) * e[1];
+    if (a[1] <= uv[1] && b[1] > uv[1] && side > 0)
+      ++winding;
+    else if (a[1] > uv[1] && b[1] <= uv[1] && side < 0)
+      --winding;
+  }
+  return winding != 0;
+}
+
+bool
+Domain::onBoundary(const Point2D &uv) const {
+  for (size_t i = 0; i < n_; ++i)
+    if (segmentDistance(vertices_[i], vertices_[next(i)], uv) < epsilon)
+      return true;
+  return false;
+}
+
 size_t
 Domain::size() const {
   return n_;
@@ -92,113 +179,506 @@ static size_t meshSize(size_t n, size_t resolution) {
 
 const Point2DVector &
 Domain::parameters(size_t resolution) const {
-  size_t size = meshSize(n_, resolution);
-  if (parameters_.size() == size)
-    return parameters_;
-  parameters_.clear();
-  parameters_.reserve(size);
+  return *sharedParameters(resolution);
+}
+
+// Evicts the least recently used entries of the parameter cache, until at most `keep` remain
+template<typename Cache>
+static void
+evictParameters(Cache &cache, size_t keep) {
+  while (cache.entries.size() > keep) {
+    auto lru = std::min_element(cache.entries.begin(), cache.entries.end(),
+                                [](const auto &a, const auto &b) {
+                                  return a.second.last_use < b.second.last_use;
+                                });
+    cache.entries.erase(lru);
+    ++cache.evictions;
+  }
+}
+
+std::shared_ptr<const Point2DVector>
+Domain::sharedParameters(size_t resolution) const {
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  auto it = parameters_.entries.find(resolution);
+  if (it != parameters_.entries.end()) {
+    ++parameters_.hits;
+    it->second.last_use = ++parameters_.clock;
+    return it->second.points;
+  }
+  ++parameters_.misses;
+  if (parameters_.limit > 0)
+    evictParameters(parameters_, parameters_.limit - 1);
+  auto points = std::make_shared<const Point2DVector>(computeParameters(resolution));
+  parameters_.entries[resolution] = { points, ++parameters_.clock };
+  return points;
+}
+
+CacheStatistics
+Domain::parameterCacheStatistics() const {
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  CacheStatistics result;
+  result.entries = parameters_.entries.size();
+  for (const auto &entry : parameters_.entries)
+    result.bytes += sizeof(entry) + 4 * sizeof(void *) + payloadBytes(*entry.second.points);
+  result.hits = parameters_.hits;
+  result.misses = parameters_.misses;
+  result.evictions = parameters_.evictions;
+  return result;
+}
+
+void
+Domain::setParameterCacheLimit(size_t resolutions) {
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  parameters_.limit = resolutions;
+  if (resolutions > 0) {
+    evictParameters(parameters_, resolutions);
+    evictParameters(topologies_, resolutions);
+    evictParameters(locators_, resolutions);
+  }
+}
+
+size_t
+Domain::parameterCacheLimit() const {
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  return parameters_.limit;
+}
+
+std::shared_ptr<const TriangleLocator>
+Domain::locator(size_t resolution) const {
+  {
+    std::lock_guard<std::mutex> lock(parameters_mutex_);
+    auto it = locators_.entries.find(resolution);
+    if (it != locators_.entries.end()) {
+      it->second.last_use = ++locators_.clock;
+      return it->second.locator;
+    }
+  }
+  // Built outside the lock, as it needs the parameters; the first one inserted is kept
+  auto result = std::make_shared<const TriangleLocator>(*sharedParameters(resolution),
+                                                        meshTopology(resolution).triangles());
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  auto it = locators_.entries.find(resolution);
+  if (it != locators_.entries.end())
+    return it->second.locator;
+  if (parameters_.limit > 0)
+    evictParameters(locators_, parameters_.limit - 1);
+  locators_.entries[resolution] = { result, ++locators_.clock };
+  return result;
+}
 
+Point2DVector
+Domain::computeParameters(size_t resolution) const {
+  return layerParameters(resolution, 0, resolution + 1);
+}
+
+// Each layer is written at its offset in meshLayers, so the layers are independent
+Point2DVector
+Domain::layerParameters(size_t resolution, size_t first, size_t last) const {
+  auto layers = meshLayers(resolution);
+  Point2DVector parameters(layers[last] - layers[first]);
+  generationExecutor(parameters.size())(last - first, [&](size_t begin, size_t end) {
+    for (size_t j = first + begin; j < first + end; ++j)
+      layerPoints(resolution, j, &parameters[layers[j] - layers[first]]);
+  });
+  return parameters;
+}
+
+void
+Domain::layerPoints(size_t resolution, size_t j, Point2D *points) const {
   if (n_ == 3) {
-    for (size_t j = 0; j <= resolution; ++j) {
-      double u = (double)j / resolution;
-      auto p = vertices_[0] * u + vertices_[2] * (1 - u);
-      auto q = vertices_[1] * u + vertices_[2] * (1 - u);
-      for (size_t k = 0; k <= j; ++k) {
-        double v = j == 0 ? 1.0 : (double)k / j;
-        parameters_.push_back(p * (1 - v) + q * v);
-      }
+    double u = (double)j / resolution;
+    auto p = vertices_[0] * u + vertices_[2] * (1 - u);
+    auto q = vertices_[1] * u + vertices_[2] * (1 - u);
+    for (size_t k = 0; k <= j; ++k) {
+      double v = j == 0 ? 1.0 : (double)k / j;
+      *points++ = p * (1 - v) + q * v;
     }
   } else if (n_ == 4) {
-    for (size_t j = 0; j <= resolution; ++j) {
-      double u = (double)j / resolution;
-      auto p = vertices_[0] * (1 - u) + vertices_[1] * u;
-      auto q = vertices_[3] * (1 - u) + vertices_[2] * u;
-      for (size_t k = 0; k <= resolution; ++k) {
-        double v = (double)k / resolution;
-        parameters_.push_back(p * (1 - v) + q * v);
-      }
-    }
-  } else { // n_ > 4
-    parameters_.push_back(center_);
-    for (size_t j = 1; j <= resolution; ++j) {
-      double u = (double)j / (double)resolution;
-      for (size_t k = 0; k < n_; ++k)
-        for (size_t i = 0; i < j; ++i) {
-          double v = (double)i / (double)j;
-          Point2D ep = vertices_[prev(k)] * (1.0 - v) + vertices_[k] * v;
-          Point2D p = center_ * (1.0 - u) + ep * u;
-          parameters_.push_back(p);
-        }
+    double u = (double)j / resolution;
+    auto p = vertices_[0] * (1 - u) + vertices_[1] * u;
+    auto q = vertices_[3] * (1 - u) + vertices_[2] * u;
+    for (size_t k = 0; k <= resolution; ++k) {
+      double v = (double)k / resolution;
+      *points++ = p * (1 - v) + q * v;
     }
+  } else if (j == 0) { // n_ > 4
+    *points = center_;
+  } else {
+    double u = (double)j / (double)resolution;
+    for (size_t k = 0; k < n_; ++k)
+      for (size_t i = 0; i < j; ++i) {
+        double v = (double)i / (double)j;
+        Point2D ep = vertices_[prev(k)] * (1.0 - v) + vertices_[k] * v;
+        *points++ = center_ * (1.0 - u) + ep * u;
+      }
   }
-  return parameters_;
 }
 
 bool
 Domain::onEdge(size_t resolution, size_t index) const {
+  return topology(resolution)->boundary.on_edge[index];
+}
+
+// The grids are nested, as doubling the resolution halves each step exactly
+std::vector<size_t>
+Domain::nestedIndices(size_t resolution) const {
+  std::vector<size_t> result;
+  result.reserve(meshSize(n_, resolution));
   if (n_ == 3) {
-    if (index >= meshSize(3, resolution) - resolution - 1)
-      return true;
-    auto issquare = [](size_t n) {
-                      size_t root = std::round(std::sqrt(n));
-                      return root * root == n;
-                    };
-    size_t n = index * 8 + 1;
-    return issquare(n) || issquare(n + 8);
-  }
-  if (n_ == 4) {
-    return index <= resolution || index >= (resolution + 1) * resolution ||
-      index % (resolution + 1) == 0 || index % (resolution + 1) == resolution;
+    for (size_t j = 0; j <= resolution; ++j)
+      for (size_t k = 0; k <= j; ++k)
+        result.push_back(j * (2 * j + 1) + 2 * k);
+  } else if (n_ == 4) {
+    for (size_t j = 0; j <= resolution; ++j)
+      for (size_t k = 0; k <= resolution; ++k)
+        result.push_back(2 * j * (2 * resolution + 1) + 2 * k);
+  } else { // n_ > 4
+    result.push_back(0);
+    for (size_t j = 1; j <= resolution; ++j) {
+      size_t start = 1 + n_ * j * (2 * j - 1);
+      for (size_t k = 0; k < n_; ++k)
+        for (size_t i = 0; i < j; ++i)
+          result.push_back(start + 2 * (k * j + i));
+    }
   }
-  return index >= meshSize(n_, resolution) - n_ * resolution;
+  return result;
 }
 
+// The list of the mesh can only be filled serially, but from the generated indices
 TriMesh
 Domain::meshTopology(size_t resolution) const {
-  TriMesh mesh;
-  mesh.resizePoints(meshSize(n_, resolution));
+  auto topology = this->topology(resolution);
+  std::call_once(topology->mesh_built, [&]() {
+    const auto &indices = topology->indices;
+    if (indices.empty()) {
+      topology->mesh = computeTriangles(n_, resolution);
+      return;
+    }
+    topology->mesh.resizePoints(meshSize(n_, resolution));
+    for (size_t i = 0; i < indices.size(); i += 3)
+      topology->mesh.addTriangle(indices[i], indices[i + 1], indices[i + 2]);
+  });
+  return topology->mesh;
+}
 
-  if (n_ == 3) {
-    size_t prev = 0, current = 1;
-    for (size_t i = 0; i < resolution; ++i) {
-      for (size_t j = 0; j < i; ++j) {
-        mesh.addTriangle(current + j, current + j + 1, prev + j);
-        mesh.addTriangle(current + j + 1, prev + j + 1, prev + j);
+// The pointers to the parts share the ownership of the whole topology
+std::shared_ptr<const Domain::MeshBoundary>
+Domain::meshBoundary(size_t resolution) const {
+  auto topology = this->topology(resolution);
+  return { topology, &topology->boundary };
+}
+
+std::shared_ptr<const std::vector<uint32_t>>
+Domain::meshIndices(size_t resolution) const {
+  auto topology = this->topology(resolution);
+  if (topology->indices.empty() && resolution > 0)
+    throw std::length_error("too many vertices for 32-bit indices");
+  return { topology, &topology->indices };
+}
+
+std::shared_ptr<const std::vector<uint16_t>>
+Domain::meshIndices16(size_t resolution) const {
+  auto topology = this->topology(resolution);
+  if (topology->indices16.empty() && resolution > 0)
+    throw std::length_error("too many vertices for 16-bit indices");
+  return { topology, &topology->indices16 };
+}
+
+// Greedy: each strip starts at the first unused triangle (in the rotation giving the longest
+// strip), and is continued by the unused neighbor across its last edge, found by its directed edges
+std::vector<uint32_t>
+Domain::meshStrips(size_t resolution) const {
+  auto shared_indices = meshIndices(resolution);
+  const auto &indices = *shared_indices;
+  size_t count = indices.size() / 3;
+  auto key = [](uint64_t a, uint64_t b) { return (a << 32) | b; };
+  std::unordered_map<uint64_t, size_t> edges;
+  edges.reserve(indices.size());
+  for (size_t t = 0; t < count; ++t)
+    for (size_t k = 0; k < 3; ++k)
+      edges[key(indices[3*t+k], indices[3*t+(k+1)%3])] = t;
+
+  // Marks the triangles of earlier strips, and those of the current trial walk
+  std::vector<bool> visited(count, false);
+  std::vector<uint32_t> strip, best, result;
+  std::vector<size_t> triangles, best_triangles;
+  auto walk = [&](size_t start, size_t rotation) {
+    strip.clear();
+    triangles.assign(1, start);
+    visited[start] = true;
+    for (size_t k = 0; k < 3; ++k)
+      strip.push_back(indices[3*start+(rotation+k)%3]);
+    for (size_t i = 1; ; ++i) {
+      uint32_t p = strip[strip.size()-2], q = strip.back();
+      // Triangle i of the strip is (p, q, x) when i is even, and (q, p, x) when odd
+      auto it = edges.find(i % 2 == 0 ? key(p, q) : key(q, p));
+      if (it == edges.end() || visited[it->second])
+        break;
+      size_t t = it->second;
+      uint32_t x = indices[3*t];
+      for (size_t k = 1; k < 3 && (x == p || x == q); ++k)
+        x = indices[3*t+k];
+      strip.push_back(x);
+      triangles.push_back(t);
+      visited[t] = true;
+    }
+    for (size_t t : triangles)
+      visited[t] = false;
+  };
+
+  result.reserve(2 * indices.size());
+  for (size_t start = 0; start < count; ++start) {
+    if (visited[start])
+      continue;
+    best.clear();
+    for (size_t rotation = 0; rotation < 3; ++rotation) {
+      walk(start, rotation);
+      if (strip.size() > best.size()) {
+        std::swap(strip, best);
+        std::swap(triangles, best_triangles);
       }
-      mesh.addTriangle(current + i, current + i + 1, prev + i);
-      prev = current;
-      current += i + 2;
     }
-  } else if (n_ == 4) {
-    for (size_t i = 0; i < resolution; ++i)
-      for (size_t j = 0; j < resolution; ++j) {
-        size_t index = i * (resolution + 1) + j;
-        mesh.addTriangle(index, index + resolution + 1, index + 1);
-        mesh.addTriangle(index + 1, index + resolution + 1, index + resolution + 2);
+    for (size_t t : best_triangles)
+      visited[t] = true;
+    if (!result.empty())
+      result.push_back(strip_restart);
+    result.insert(result.end(), best.begin(), best.end());
+  }
+  return result;
+}
+
+Domain::Meshlets
+Domain::meshMeshlets(size_t resolution, size_t max_vertices, size_t max_triangles) const {
+  if (max_vertices < 3 || max_vertices > 256 || max_triangles == 0)
+    throw std::invalid_argument("meshlets need 3-256 vertices and at least one triangle");
+  auto shared_indices = meshIndices(resolution);
+  const auto &indices = *shared_indices;
+  auto shared_uvs = sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  size_t count = indices.size() / 3;
+  Point2DVector centroids(count);
+  for (size_t t = 0; t < count; ++t)
+    centroids[t] = (uvs[indices[3*t]] + uvs[indices[3*t+1]] + uvs[indices[3*t+2]]) / 3.0;
+
+  Meshlets result;
+  std::unordered_map<uint32_t, uint8_t> local; // of the current meshlet
+  Meshlet current = { 0, 0, 0, 0 };
+  for (size_t t : mortonOrder(centroids)) {
+    size_t added = 0;
+    for (size_t k = 0; k < 3; ++k)
+      added += local.count(indices[3*t+k]) == 0;
+    if (current.vertex_count + added > max_vertices || current.triangle_count == max_triangles) {
+      result.meshlets.push_back(current);
+      current = { (uint32_t)result.vertices.size(), 0, (uint32_t)result.triangles.size() / 3, 0 };
+      local.clear();
+    }
+    for (size_t k = 0; k < 3; ++k) {
+      uint32_t v = indices[3*t+k];
+      auto it = local.find(v);
+      if (it == local.end()) {
+        it = local.emplace(v, (uint8_t)current.vertex_count++).first;
+        result.vertices.push_back(v);
       }
-  } else { // n_ > 4
-    size_t inner_start = 0, outer_vert = 1;
-    for (size_t layer = 1; layer <= resolution; ++layer) {
-      size_t inner_vert = inner_start, outer_start = outer_vert;
-      for (size_t side = 0; side < n_; ++side) {
-        size_t vert = 0;
-        while(true) {
-          size_t next_vert = (side == n_ - 1 && vert == layer - 1) ? outer_start : (outer_vert + 1);
-          mesh.addTriangle(inner_vert, outer_vert, next_vert);
-          ++outer_vert;
-          if (++vert == layer)
-            break;
-          size_t inner_next = (side == n_ - 1 && vert == layer - 1) ? inner_start : (inner_vert + 1);
-          mesh.addTriangle(inner_vert, next_vert, inner_next);
-          inner_vert = inner_next;
-        }
+      result.triangles.push_back(it->second);
+    }
+    current.triangle_count++;
+  }
+  if (current.triangle_count > 0)
+    result.meshlets.push_back(current);
+  return result;
+}
+
+std::shared_ptr<const Domain::Topology>
+Domain::topology(size_t resolution) const {
+  {
+    std::lock_guard<std::mutex> lock(parameters_mutex_);
+    auto it = topologies_.entries.find({ n_, resolution });
+    if (it != topologies_.entries.end()) {
+      it->second.last_use = ++topologies_.clock;
+      return it->second.topology;
+    }
+  }
+  auto result = sharedTopology(n_, resolution);
+  std::lock_guard<std::mutex> lock(parameters_mutex_);
+  if (parameters_.limit > 0)
+    evictParameters(topologies_, parameters_.limit - 1);
+  topologies_.entries[{ n_, resolution }] = { result, ++topologies_.clock };
+  return result;
+}
+
+// The topology is computed once for each (n, resolution) pair while anything refers to it,
+// and shared by all domains; expired entries are swept at each insertion
+std::shared_ptr<const Domain::Topology>
+Domain::sharedTopology(size_t n, size_t resolution) {
+  static std::map<std::pair<size_t, size_t>, std::weak_ptr<const Topology>> topologies;
+  static std::mutex topologies_mutex;
+
+  std::lock_guard<std::mutex> lock(topologies_mutex);
+  auto &cached = topologies[{n, resolution}];
+  if (auto topology = cached.lock())
+    return topology;
+  auto topology = std::make_shared<Topology>();
+  if (meshSize(n, resolution) <= std::numeric_limits<uint32_t>::max())
+    topology->indices = computeIndices(n, resolution);
+  topology->boundary = computeBoundary(n, resolution);
+  if (meshSize(n, resolution) <= std::numeric_limits<uint16_t>::max())
+    topology->indices16.assign(topology->indices.begin(), topology->indices.end());
+  cached = topology;
+  for (auto it = topologies.begin(); it != topologies.end(); )
+    if (it->second.expired())
+      it = topologies.erase(it);
+    else
+      ++it;
+  return topology;
+}
+
+std::vector<size_t>
+Domain::meshLayers(size_t resolution) const {
+  std::vector<size_t> result;
+  result.reserve(resolution + 2);
+  for (size_t j = 0; j <= resolution; ++j) {
+    if (n_ == 3)
+      result.push_back(j * (j + 1) / 2);
+    else if (n_ == 4)
+      result.push_back(j * (resolution + 1));
+    else
+      result.push_back(j == 0 ? 0 : 1 + n_ * j * (j - 1) / 2);
+  }
+  result.push_back(meshSize(n_, resolution));
+  return result;
+}
+
+void
+Domain::meshTriangles(size_t resolution, size_t layer,
+                      std::vector<TriMesh::Triangle> &triangles) const {
+  layerTriangles(n_, resolution, layer, [&](size_t a, size_t b, size_t c) {
+    triangles.push_back({ a, b, c });
+  });
+}
+
+size_t
+Domain::meshTriangleCount(size_t resolution) const {
+  return layerTriangleOffset(n_, resolution, resolution + 1);
+}
+
+// Layer l has 2l - 1 triangles for n = 3, 2 * resolution for n = 4, and n (2l - 1) otherwise
+size_t
+Domain::layerTriangleOffset(size_t n, size_t resolution, size_t layer) {
+  size_t i = layer - 1;
+  return n == 4 ? 2 * resolution * i : (n == 3 ? 1 : n) * i * i;
+}
+
+template<typename F>
+void
+Domain::layerTriangles(size_t n, size_t resolution, size_t layer, F add) {
+  if (n == 3) {
+    size_t i = layer - 1, prev = i * (i + 1) / 2, current = prev + i + 1;
+    for (size_t j = 0; j < i; ++j) {
+      add(current + j, current + j + 1, prev + j);
+      add(current + j + 1, prev + j + 1, prev + j);
+    }
+    add(current + i, current + i + 1, prev + i);
+  } else if (n == 4) {
+    size_t i = layer - 1;
+    for (size_t j = 0; j < resolution; ++j) {
+      size_t index = i * (resolution + 1) + j;
+      add(index, index + resolution + 1, index + 1);
+      add(index + 1, index + resolution + 1, index + resolution + 2);
+    }
+  } else { // n > 4
+    size_t inner_start = layer == 1 ? 0 : 1 + n * (layer - 1) * (layer - 2) / 2;
+    size_t outer_start = 1 + n * layer * (layer - 1) / 2;
+    size_t inner_vert = inner_start, outer_vert = outer_start;
+    for (size_t side = 0; side < n; ++side) {
+      size_t vert = 0;
+      while(true) {
+        size_t next_vert = (side == n - 1 && vert == layer - 1) ? outer_start : (outer_vert + 1);
+        add(inner_vert, outer_vert, next_vert);
+        ++outer_vert;
+        if (++vert == layer)
+          break;
+        size_t inner_next = (side == n - 1 && vert == layer - 1) ? inner_start : (inner_vert + 1);
+        add(inner_vert, next_vert, inner_next);
+        inner_vert = inner_next;
       }
-      inner_start = outer_start;
     }
   }
+}
+
+TriMesh
+Domain::computeTriangles(size_t n, size_t resolution) {
+  TriMesh mesh;
+  mesh.resizePoints(meshSize(n, resolution));
+  for (size_t layer = 1; layer <= resolution; ++layer)
+    layerTriangles(n, resolution, layer, [&](size_t a, size_t b, size_t c) {
+      mesh.addTriangle(a, b, c);
+    });
   return mesh;
 }
 
+// Each layer is written at its offset, so the layers are independent
+std::vector<uint32_t>
+Domain::computeIndices(size_t n, size_t resolution) {
+  std::vector<uint32_t> indices(3 * layerTriangleOffset(n, resolution, resolution + 1));
+  generationExecutor(meshSize(n, resolution))(resolution, [&](size_t begin, size_t end) {
+    for (size_t layer = begin + 1; layer <= end; ++layer) {
+      uint32_t *index = &indices[3 * layerTriangleOffset(n, resolution, layer)];
+      layerTriangles(n, resolution, layer, [&](size_t a, size_t b, size_t c) {
+        *index++ = static_cast<uint32_t>(a);
+        *index++ = static_cast<uint32_t>(b);
+        *index++ = static_cast<uint32_t>(c);
+      });
+    }
+  });
+  return indices;
+}
+
+// The edge parameters follow the layout of parameters(resolution)
+Domain::MeshBoundary
+Domain::computeBoundary(size_t n, size_t resolution) {
+  MeshBoundary boundary;
+  boundary.on_edge.resize(meshSize(n, resolution), false);
+  auto add = [&](size_t index, size_t side, double s) {
+    boundary.on_edge[index] = true;
+    boundary.vertices.push_back({ index, side, s });
+  };
+  double r = resolution;
+
+  if (n == 3) {
+    for (size_t j = 0, index = 0; j <= resolution; ++j)
+      for (size_t k = 0; k <= j; ++k, ++index) {
+        if (j == resolution && k > 0)
+          add(index, 1, k / r);
+        else if (k == 0 && j > 0)
+          add(index, 0, j / r);
+        else if (k == j)
+          add(index, 2, 1.0 - j / r);
+      }
+  } else if (n == 4) {
+    for (size_t j = 0, index = 0; j <= resolution; ++j)
+      for (size_t k = 0; k <= resolution; ++k, ++index) {
+        if (k == 0 && j > 0)
+          add(index, 1, j / r);
+        else if (j == resolution && k > 0)
+          add(index, 2, k / r);
+        else if (k == resolution)
+          add(index, 3, 1.0 - j / r);
+        else if (j == 0)
+          add(index, 0, 1.0 - k / r);
+      }
+  } else { // n > 4
+    size_t start = meshSize(n, resolution) - n * resolution;
+    for (size_t k = 0; k < n; ++k)
+      for (size_t i = 0; i < resolution; ++i) {
+        if (i == 0)
+          add(start + k * resolution, (k + n - 1) % n, 1.0);
+        else
+          add(start + k * resolution + i, k, i / r);
+      }
+  }
+  return boundary;
+}
+
 const Point2D &
 Domain::center() const {
   return center_;
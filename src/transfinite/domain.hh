@@ -1,8 +1,12 @@
 #pragma once
 
+#include "cache.hh"
 #include "geometry.hh"
 
 #include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -16,17 +20,96 @@ namespace Transfinite {
 
 using namespace Geometry;
 
+class TriangleLocator;
+
 class Domain {
 public:
+  // Boundary of the mesh of a given resolution: a flag for each vertex, and the boundary vertices
+  // in index order, with their side and edge parameter (corners belong to the side ending there)
+  struct BoundaryVertex {
+    size_t index, side;
+    double s;
+  };
+  struct MeshBoundary {
+    std::vector<bool> on_edge;
+    std::vector<BoundaryVertex> vertices;
+  };
+  // Separates the strips of meshStrips (as the primitive restart index of 32-bit buffers)
+  static constexpr uint32_t strip_restart = 0xffffffff;
+  // A group of triangles for mesh shaders, as ranges in the arrays of Meshlets
+  struct Meshlet {
+    uint32_t vertex_offset, vertex_count, triangle_offset, triangle_count;
+  };
+  struct Meshlets {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // mesh vertex indices, by meshlet
+    std::vector<uint8_t> triangles; // three indices into the vertices of the meshlet each
+  };
+
   Domain();
+  // Copies share the cached parameters and locators
+  Domain(const Domain &other);
   virtual ~Domain();
+  Domain &operator=(const Domain &) = delete;
+  virtual std::shared_ptr<Domain> clone() const = 0;
   void setSide(size_t i, const std::shared_ptr<BSCurve> &curve);
   void setSides(const CurveVector &curves);
   virtual bool update();
+  // Changed by each update that changes the domain; unique among all domains (but equal in
+  // copies), and never 0
+  uint64_t revision() const;
+  // True when the vertices depend only on the number of sides, not on the curves,
+  // so all domains of the same type and size are equal (see Parameterization::parameterTable)
+  virtual bool curveIndependent() const;
   size_t size() const;
+  // Cached for each resolution until the next update (thread-safe); with a cache limit,
+  // the reference can also be invalidated by calls for other resolutions (see sharedParameters)
   virtual const Point2DVector &parameters(size_t resolution) const;
+  // The same, sharing the cached points, so they stay valid after an update or an eviction
+  std::shared_ptr<const Point2DVector> sharedParameters(size_t resolution) const;
+  // Statistics of the parameter cache, with an entry for each resolution
+  CacheStatistics parameterCacheStatistics() const;
+  // Keeps the parameters of at most this many resolutions, evicting the least recently used
+  // (0 means unlimited, the default); the same limit applies to the topologies and locators held
+  void setParameterCacheLimit(size_t resolutions);
+  size_t parameterCacheLimit() const;
+  // Point location in the mesh of parameters(resolution) and meshTopology(resolution);
+  // built on the first call for each resolution, and shared until the next update
+  // (or until evicted by the limit of setParameterCacheLimit)
+  std::shared_ptr<const TriangleLocator> locator(size_t resolution) const;
+  // Depends only on the number of sides, so it is shared by all domains (and kept while any
+  // domain, or a pointer given out by the functions below, refers to it); each domain holds
+  // the topologies of the resolutions it has used, also after updates, up to the limit of
+  // setParameterCacheLimit. The triangle list is filled at the first call
+  // (for large meshes, meshIndices is much faster when it suffices).
   virtual TriMesh meshTopology(size_t resolution) const;
+  // The mesh is built of layers of points (rows for n = 3 and 4, rings around the center
+  // otherwise); these are the first indices of the layers, with the number of points at the end
+  std::vector<size_t> meshLayers(size_t resolution) const;
+  // Appends the triangles between layers `layer - 1` and `layer` (as ordered in meshTopology)
+  void meshTriangles(size_t resolution, size_t layer,
+                     std::vector<TriMesh::Triangle> &triangles) const;
+  size_t meshTriangleCount(size_t resolution) const;
+  // The points of parameters(resolution) in layers [first, last), computed without caching
+  // (in parallel for large meshes, as is the topology)
+  Point2DVector layerParameters(size_t resolution, size_t first, size_t last) const;
+  // Parts of the shared topology, which they keep alive
+  std::shared_ptr<const MeshBoundary> meshBoundary(size_t resolution) const;
+  // The triangles of meshTopology, as three vertex indices each (e.g. for an index buffer)
+  std::shared_ptr<const std::vector<uint32_t>> meshIndices(size_t resolution) const;
+  // The same in 16 bits, for meshes of at most 65535 vertices (throws std::length_error otherwise)
+  std::shared_ptr<const std::vector<uint16_t>> meshIndices16(size_t resolution) const;
+  // The triangles of meshTopology as triangle strips (with the usual alternating orientation,
+  // so the triangles keep theirs), separated by strip_restart; computed on each call
+  std::vector<uint32_t> meshStrips(size_t resolution) const;
+  // The triangles of meshTopology in meshlets of at most `max_vertices` (<= 256) vertices and
+  // `max_triangles` triangles, filled greedily in the Z-order of the triangle centroids
+  // in this domain (see mortonOrder); the triangles keep their orientation. Computed on each call.
+  Meshlets meshMeshlets(size_t resolution, size_t max_vertices = 64,
+                        size_t max_triangles = 124) const;
   virtual bool onEdge(size_t resolution, size_t index) const;
+  // Indices of the points of parameters(resolution) in parameters(2 * resolution)
+  virtual std::vector<size_t> nestedIndices(size_t resolution) const;
   const Point2D &center() const;
   Point2D edgePoint(size_t i, double s) const;
   double edgeLength(size_t i) const;
@@ -35,6 +118,10 @@ public:
   Point2D toLocal(size_t i, const Vector2D &v) const;
   Point2D fromLocal(size_t i, const Vector2D &v) const;
   bool intersectEdgeWithRay(size_t i, const Point2D &p, const Vector2D &v, Point2D &result) const;
+  // Whether the point is inside the domain polygon or within epsilon of its boundary
+  bool contains(const Point2D &uv) const;
+  // Whether the point is within epsilon of one of the sides (as segments)
+  bool onBoundary(const Point2D &uv) const;
 
 protected:
   size_t next(size_t i, size_t j = 1) const { return (i + j) % n_; }
@@ -48,7 +135,61 @@ protected:
   Vector2DVector du_, dv_;
 
 private:
-  mutable Point2DVector parameters_; // cache
+  struct Topology {
+    mutable TriMesh mesh;       // built at the first meshTopology call, as it is slow to fill
+    mutable std::once_flag mesh_built;
+    MeshBoundary boundary;
+    std::vector<uint32_t> indices; // empty when they do not fit in 32 bits
+    std::vector<uint16_t> indices16; // the same for 16 bits
+  };
+
+  Point2DVector computeParameters(size_t resolution) const;
+  // Writes the points of layer j of parameters(resolution)
+  void layerPoints(size_t resolution, size_t j, Point2D *points) const;
+  // Held by this domain, and found or computed in the process-wide registry when it is not
+  std::shared_ptr<const Topology> topology(size_t resolution) const;
+  static std::shared_ptr<const Topology> sharedTopology(size_t n, size_t resolution);
+  static TriMesh computeTriangles(size_t n, size_t resolution);
+  // The triangles of meshTopology as three indices each, for meshes fitting in 32 bits
+  static std::vector<uint32_t> computeIndices(size_t n, size_t resolution);
+  // The number of triangles in the layers before `layer`
+  static size_t layerTriangleOffset(size_t n, size_t resolution, size_t layer);
+  template<typename F>
+  static void layerTriangles(size_t n, size_t resolution, size_t layer, F add);
+  static MeshBoundary computeBoundary(size_t n, size_t resolution);
+
+  struct CachedParameters {
+    std::shared_ptr<const Point2DVector> points;
+    uint64_t last_use;
+  };
+  struct ParameterCache {
+    std::map<size_t, CachedParameters> entries;
+    size_t limit = 0;
+    uint64_t clock = 0, hits = 0, misses = 0, evictions = 0;
+  };
+  struct CachedTopology {
+    std::shared_ptr<const Topology> topology;
+    uint64_t last_use;
+  };
+  struct TopologyCache {
+    std::map<std::pair<size_t, size_t>, CachedTopology> entries; // by (n, resolution)
+    uint64_t clock = 0, evictions = 0;
+  };
+  struct CachedLocator {
+    std::shared_ptr<const TriangleLocator> locator;
+    uint64_t last_use;
+  };
+  struct LocatorCache {
+    std::map<size_t, CachedLocator> entries; // by resolution
+    uint64_t clock = 0, evictions = 0;
+  };
+
+  Point2DVector updated_vertices_; // as of the last update
+  uint64_t revision_;
+  mutable ParameterCache parameters_;
+  mutable TopologyCache topologies_; // not cleared by updates (keyed by the side count)
+  mutable LocatorCache locators_;
+  mutable std::mutex parameters_mutex_;
 };
 
 } // namespace Transfinite
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "executor.hh"
+
+namespace Transfinite {
+
+Executor
+serialExecutor() {
+  return [](size_t size, const Task &task) {
+    if (size > 0)
+      task(0, size);
+  };
+}
+
+Executor
+threadExecutor(size_t threads, size_t grain) {
+  if (threads == 0)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  grain = std::max<size_t>(grain, 1);
+  return [threads, grain](size_t size, const Task &task) {
+    size_t chunks = (size + grain - 1) / grain;
+    size_t workers = std::min(threads, chunks);
+    if (workers <= 1) {
+      if (size > 0)
+        task(0, size);
+      return;
+    }
+
+    // Chunks are handed out dynamically, so uneven evaluation costs are balanced
+    std::atomic<size_t> next_chunk(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&]() {
+      size_t chunk;
+      while ((chunk = next_chunk++) < chunks) {
+        try {
+          task(chunk * grain, std::min((chunk + 1) * grain, size));
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error)
+            error = std::current_exception();
+          next_chunk = chunks;
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (size_t i = 1; i < workers; ++i)
+      pool.emplace_back(work);
+    work();
+    for (auto &t : pool)
+      t.join();
+
+    if (error)
+      std::rethrow_exception(error);
+  };
+}
+
+Executor
+cancellableExecutor(const Executor &executor, const std::function<bool ()> &cancel, size_t grain) {
+  grain = std::max<size_t>(grain, 1);
+  return [executor, cancel, grain](size_t size, const Task &task) {
+    executor(size, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i += grain) {
+        if (cancel())
+          throw Cancelled();
+        task(i, std::min(i + grain, end));
+      }
+    });
+    if (cancel())
+      throw Cancelled();
+  };
+}
+
+} // namespace Transfinite
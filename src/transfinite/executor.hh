@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+
+namespace Transfinite {
+
+// An executor calls `task(begin, end)` on disjoint ranges covering [0, size),
+// possibly concurrently, and returns only when all of them are finished.
+// Exceptions thrown by the task are propagated to the caller.
+// Any thread pool, TBB arena or std::execution policy can be wrapped in this form.
+using Task = std::function<void(size_t begin, size_t end)>;
+using Executor = std::function<void(size_t size, const Task &task)>;
+
+Executor serialExecutor();
+
+// Splits the range into chunks of `grain` elements, processed by `threads` threads
+// (0 means std::thread::hardware_concurrency()); the calling thread also takes part.
+Executor threadExecutor(size_t threads = 0, size_t grain = 256);
+
+// Thrown by the tasks of cancellableExecutor after a cancellation
+class Cancelled : public std::runtime_error {
+public:
+  Cancelled() : std::runtime_error("cancelled") { }
+};
+
+// Runs the tasks on `executor` in pieces of `grain` elements, checking `cancel` before each;
+// once it returns true, the remaining pieces are skipped, and Cancelled is thrown
+Executor cancellableExecutor(const Executor &executor, const std::function<bool ()> &cancel,
+                             size_t grain = 256);
+
+} // namespace Transfinite
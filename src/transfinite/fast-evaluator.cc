@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <utility>
+
+#include "fast-evaluator.hh"
+
+namespace Transfinite {
+
+namespace {
+
+  // As in Surface::evalMappedBlock
+  const size_t block_size = 64;
+
+  // Calls f(integral_constant<I>) for I = 0 .. N-1, without a loop
+  template<typename F, size_t... I>
+  void unrolled(F f, std::index_sequence<I...>) {
+    (f(std::integral_constant<size_t, I>()), ...);
+  }
+
+  template<size_t N, typename F>
+  void forSides(F f) {
+    unrolled(f, std::make_index_sequence<N>());
+  }
+
+  // inrange(0, x, 1), inline
+  double unitRange(double x) {
+    return x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x);
+  }
+
+  double gamma(double d, bool use_gamma) {
+    return use_gamma ? d / (2.0 * d + 1.0) : d;
+  }
+
+}
+
+BlockEvaluator::~BlockEvaluator() {
+}
+
+template<size_t N, SurfaceKind K>
+FastEvaluator<N, K>::FastEvaluator(const Surface &surface)
+  : sampling_(surface.ribbon_samples_) {
+  samples_.reserve(N * (sampling_ + 1));
+  for (size_t i = 0; i < N; ++i) {
+    const auto &table = surface.ribbons_[i]->samples();
+    samples_.insert(samples_.end(), table.begin(), table.end());
+    corners_[i] = surface.corner_data_[i];
+  }
+}
+
+// The same Hermite interpolation as Ribbon::evalSampled
+template<size_t N, SurfaceKind K>
+Point3D
+FastEvaluator<N, K>::ribbon(size_t i, double s, double d) const {
+  double x = s * sampling_;
+  size_t j = std::min((size_t)x, sampling_ - 1);
+  double t = x - j, t1 = 1.0 - t;
+  double h0 = t1 * t1 * (1.0 + 2.0 * t), h1 = t1 * t1 * t;
+  double h2 = t1 * t * t, h3 = t * t * (3.0 - 2.0 * t);
+  const Ribbon::Sample &a = samples_[i * (sampling_ + 1) + j], &b = (&a)[1];
+  Point3D p = a.p * h0 + a.dp * h1 - b.dp * h2 + b.p * h3;
+  Vector3D c = a.c * h0 + a.dc * h1 - b.dc * h2 + b.c * h3;
+  return p + c * d;
+}
+
+template<size_t N, SurfaceKind K>
+Point3D
+FastEvaluator<N, K>::sideInterpolant(size_t i, double si, double di, bool use_gamma) const {
+  return ribbon(i, unitRange(si), std::max(gamma(di, use_gamma), 0.0));
+}
+
+template<size_t N, SurfaceKind K>
+Point3D
+FastEvaluator<N, K>::cornerCorrection(size_t i, double s1, double s2, bool use_gamma) const {
+  s1 = unitRange(gamma(s1, use_gamma));
+  s2 = unitRange(gamma(s2, use_gamma));
+  const Surface::CornerData &cd = corners_[i];
+  Vector3D twist(0, 0, 0);
+  if (std::abs(s1 + s2) >= epsilon)
+    twist = (cd.twist2 * s1 + cd.twist1 * s2) / (s1 + s2);
+  return cd.point + cd.tangent1 * s1 + cd.tangent2 * s2 + twist * s1 * s2;
+}
+
+template<size_t N, SurfaceKind K>
+Point3D
+FastEvaluator<N, K>::cornerInterpolant(size_t i, const Point2D *sds, bool use_gamma) const {
+  size_t ip = (i + 1) % N;
+  double si = sds[i][0], si1 = sds[ip][0];
+  return sideInterpolant(i, si, si1, use_gamma) + sideInterpolant(ip, si1, 1.0 - si, use_gamma)
+    - cornerCorrection(i, 1.0 - si, si1, use_gamma);
+}
+
+// The terms of SurfaceSideBased::evalBlended and SurfaceCornerBased::evalBlended
+template<size_t N, SurfaceKind K>
+void
+FastEvaluator<N, K>::evalBlock(const Surface &surface, const Point2D *sds, size_t size,
+                               Point3D *points) const {
+  bool use_gamma = surface.use_gamma_;
+  double blends[block_size * N];
+  for (size_t start = 0; start < size; start += block_size) {
+    size_t m = std::min(block_size, size - start);
+    const Point2D *rows = sds + start * N;
+    surface.blendBlock(rows, m, blends);
+    for (size_t k = 0; k < m; ++k) {
+      const Point2D *row = rows + k * N;
+      const double *blf = blends + k * N;
+      Point3D p(0, 0, 0);
+      double skipped = 0;
+      forSides<N>([&](auto side) {
+        constexpr size_t i = decltype(side)::value;
+        if (surface.negligibleBlend(blf[i]))
+          skipped += blf[i];
+        else if constexpr (K == SurfaceKind::SIDE_BASED)
+          p += sideInterpolant(i, row[i][0], row[i][1], use_gamma) * blf[i];
+        else
+          p += cornerInterpolant(i, row, use_gamma) * blf[i];
+      });
+      points[start + k] = p + surface.corner_centroid_ * skipped;
+    }
+  }
+}
+
+namespace {
+
+  template<SurfaceKind K>
+  std::shared_ptr<const BlockEvaluator> makeForSides(const Surface &surface, size_t n) {
+    switch (n) {
+    case 3: return std::make_shared<FastEvaluator<3, K>>(surface);
+    case 4: return std::make_shared<FastEvaluator<4, K>>(surface);
+    case 5: return std::make_shared<FastEvaluator<5, K>>(surface);
+    case 6: return std::make_shared<FastEvaluator<6, K>>(surface);
+    default: return nullptr;
+    }
+  }
+
+}
+
+std::shared_ptr<const BlockEvaluator>
+makeFastEvaluator(const Surface &surface) {
+  if (surface.ribbon_samples_ == 0)
+    return nullptr;
+  for (const auto &ribbon : surface.ribbons_)
+    if (ribbon->sampling() != surface.ribbon_samples_)
+      return nullptr;
+  switch (surface.fast_kind_) {
+  case SurfaceKind::SIDE_BASED:
+    return makeForSides<SurfaceKind::SIDE_BASED>(surface, surface.n_);
+  case SurfaceKind::CORNER_BASED:
+    return makeForSides<SurfaceKind::CORNER_BASED>(surface, surface.n_);
+  default: return nullptr;
+  }
+}
+
+} // namespace Transfinite
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ribbon.hh"
+#include "surface.hh"
+
+namespace Transfinite {
+
+// Evaluation of `size` points given their ribbon parameters in rows of n
+// (as in ParameterTable), in place of the dynamic path of Surface::evalMappedBlock
+class BlockEvaluator {
+public:
+  virtual ~BlockEvaluator();
+  virtual void evalBlock(const Surface &surface, const Point2D *sds, size_t size,
+                         Point3D *points) const = 0;
+};
+
+// The blended evaluation of an N-sided surface of kind K with sampled ribbons.
+// The ribbon samples and the corner data of the updated surface are copied into fixed-size
+// storage, the side loops are unrolled with constant neighbor indices, and the ribbons are
+// interpolated inline instead of by virtual calls; the blends, the gamma setting and the blend
+// cutoff are taken from the surface, so the results are exactly those of evalBlended().
+template<size_t N, SurfaceKind K>
+class FastEvaluator : public BlockEvaluator {
+public:
+  explicit FastEvaluator(const Surface &surface);
+  void evalBlock(const Surface &surface, const Point2D *sds, size_t size,
+                 Point3D *points) const override;
+
+private:
+  Point3D ribbon(size_t i, double s, double d) const;
+  Point3D sideInterpolant(size_t i, double si, double di, bool use_gamma) const;
+  Point3D cornerCorrection(size_t i, double s1, double s2, bool use_gamma) const;
+  Point3D cornerInterpolant(size_t i, const Point2D *sds, bool use_gamma) const;
+
+  size_t sampling_;
+  std::vector<Ribbon::Sample> samples_; // sampling_ + 1 for each side
+  std::array<Surface::CornerData, N> corners_;
+};
+
+// The evaluator of an updated surface, or null when there is no specialization
+// for its kind and side count, or its ribbons are not sampled
+std::shared_ptr<const BlockEvaluator> makeFastEvaluator(const Surface &surface);
+
+} // namespace Transfinite
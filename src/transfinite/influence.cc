@@ -0,0 +1,38 @@
+#include <cmath>
+
+#include "influence.hh"
+
+namespace Transfinite {
+
+InfluenceMap::InfluenceMap(const TriMesh &mesh, size_t size,
+                           const std::vector<std::vector<std::pair<size_t, double>>> &rows,
+                           double threshold)
+  : mesh_(mesh), influences_(size) {
+  for (size_t v = 0; v < rows.size(); ++v)
+    for (const auto &[i, w] : rows[v])
+      if (std::abs(w) >= threshold && w != 0.0)
+        influences_[i].emplace_back(v, w);
+}
+
+const TriMesh &
+InfluenceMap::mesh() const {
+  return mesh_;
+}
+
+size_t
+InfluenceMap::size() const {
+  return influences_.size();
+}
+
+const InfluenceMap::Influence &
+InfluenceMap::influence(size_t i) const {
+  return influences_[i];
+}
+
+void
+InfluenceMap::move(size_t i, const Vector3D &delta) {
+  for (const auto &[v, w] : influences_[i])
+    mesh_[v] += delta * w;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+// Influence images of the control points of a surface that is linear in them:
+// the weight of each control point at the vertices of a mesh, so that moving a control point
+// by a vector moves each vertex by the same vector times its weight (an AXPY over the support).
+// Weights with absolute value below a threshold are dropped when building the images,
+// trading some accuracy for smaller supports.
+class InfluenceMap {
+public:
+  using Influence = std::vector<std::pair<size_t, double>>; // (vertex, weight)
+  // Transposes rows of (control point, weight) pairs for each vertex
+  InfluenceMap(const TriMesh &mesh, size_t size,
+               const std::vector<std::vector<std::pair<size_t, double>>> &rows,
+               double threshold);
+  const TriMesh &mesh() const;
+  size_t size() const;
+  const Influence &influence(size_t i) const;
+  // Updates the mesh after control point i has been moved by `delta`
+  void move(size_t i, const Vector3D &delta);
+
+private:
+  TriMesh mesh_;
+  std::vector<Influence> influences_;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "locator.hh"
+
+namespace Transfinite {
+
+TriangleLocator::TriangleLocator(const Point2DVector &points, const std::list<Triangle> &triangles)
+  : points_(points), triangles_(triangles.begin(), triangles.end()) {
+  min_ = points_[0];
+  Point2D max = points_[0];
+  for (const auto &p : points_)
+    for (size_t k = 0; k < 2; ++k) {
+      min_[k] = std::min(min_[k], p[k]);
+      max[k] = std::max(max[k], p[k]);
+    }
+
+  // About one triangle per bucket
+  double width = max[0] - min_[0], height = max[1] - min_[1];
+  cell_size_ = std::max(std::sqrt(width * height / std::max<size_t>(triangles_.size(), 1)),
+                        std::max(width, height) * 1.0e-6);
+  columns_ = (size_t)(width / cell_size_) + 1;
+  rows_ = (size_t)(height / cell_size_) + 1;
+  buckets_.resize(columns_ * rows_);
+
+  for (size_t i = 0; i < triangles_.size(); ++i) {
+    const auto &t = triangles_[i];
+    Point2D lo = points_[t[0]], hi = points_[t[0]];
+    for (size_t j = 1; j < 3; ++j)
+      for (size_t k = 0; k < 2; ++k) {
+        lo[k] = std::min(lo[k], points_[t[j]][k]);
+        hi[k] = std::max(hi[k], points_[t[j]][k]);
+      }
+    size_t b1 = bucket(lo), b2 = bucket(hi);
+    for (size_t r = b1 / columns_; r <= b2 / columns_; ++r)
+      for (size_t c = b1 % columns_; c <= b2 % columns_; ++c)
+        buckets_[r * columns_ + c].push_back(i);
+  }
+}
+
+const TriangleLocator::Triangle &
+TriangleLocator::locate(const Point2D &p, std::array<double, 3> &bary) const {
+  // The triangle with the largest minimal barycentric coordinate contains p, if any does;
+  // when the bucket has no good candidate (p outside the triangulation), all are searched
+  size_t best = 0;
+  double best_min = -std::numeric_limits<double>::max();
+  auto test = [&](size_t i) {
+    auto b = barycentric(triangles_[i], p);
+    double m = *std::min_element(b.begin(), b.end());
+    if (m > best_min) {
+      best_min = m;
+      best = i;
+      bary = b;
+    }
+  };
+  for (auto i : buckets_[bucket(p)])
+    test(i);
+  if (best_min < -epsilon)
+    for (size_t i = 0; i < triangles_.size(); ++i)
+      test(i);
+  return triangles_[best];
+}
+
+size_t
+TriangleLocator::bucket(const Point2D &p) const {
+  auto index = [&](double x, double min, size_t size) {
+    double i = std::floor((x - min) / cell_size_);
+    return (size_t)std::min(std::max(i, 0.0), (double)(size - 1));
+  };
+  return index(p[1], min_[1], rows_) * columns_ + index(p[0], min_[0], columns_);
+}
+
+std::array<double, 3>
+TriangleLocator::barycentric(const Triangle &t, const Point2D &p) const {
+  const Point2D &a = points_[t[0]], &b = points_[t[1]], &c = points_[t[2]];
+  Vector2D u = b - a, v = c - a, w = p - a;
+  double det = u[0] * v[1] - u[1] * v[0];
+  if (std::abs(det) < epsilon * epsilon)
+    return { 1.0, -std::numeric_limits<double>::max(), 0.0 };
+  double l1 = (w[0] * v[1] - w[1] * v[0]) / det, l2 = (u[0] * w[1] - u[1] * w[0]) / det;
+  return { 1.0 - l1 - l2, l1, l2 };
+}
+
+MeshInterpolant::MeshInterpolant(const Point2DVector &uvs, const TriMesh &mesh)
+  : locator_(std::make_shared<const TriangleLocator>(uvs, mesh.triangles())),
+    points_(mesh.points()) {
+}
+
+MeshInterpolant::MeshInterpolant(std::shared_ptr<const TriangleLocator> locator,
+                                 const PointVector &points)
+  : locator_(std::move(locator)), points_(points) {
+}
+
+Point3D
+MeshInterpolant::eval(const Point2D &uv) const {
+  std::array<double, 3> bary;
+  const auto &t = locator_->locate(uv, bary);
+  return points_[t[0]] * bary[0] + points_[t[1]] * bary[1] + points_[t[2]] * bary[2];
+}
+
+// Leaves hold at most this many triangles
+static const size_t bvh_leaf_size = 4;
+
+TriangleBVH::TriangleBVH(const TriMesh &mesh)
+  : points_(mesh.points()), triangles_(mesh.triangles().begin(), mesh.triangles().end()) {
+  nodes_.reserve(2 * triangles_.size() / bvh_leaf_size + 1);
+  build(0, triangles_.size());
+}
+
+// Sets the box of the node to that of its triangle range
+void
+TriangleBVH::fit(Node &node) const {
+  node.min = Point3D(std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                     std::numeric_limits<double>::max());
+  node.max = -node.min;
+  for (size_t i = node.first; i < node.first + node.count; ++i)
+    for (auto v : triangles_[i])
+      for (size_t k = 0; k < 3; ++k) {
+        node.min[k] = std::min(node.min[k], points_[v][k]);
+        node.max[k] = std::max(node.max[k], points_[v][k]);
+      }
+}
+
+// Splits the triangles at the median of their centroids along the longest axis of the box
+size_t
+TriangleBVH::build(size_t first, size_t count) {
+  size_t index = nodes_.size();
+  nodes_.emplace_back();
+  nodes_[index].first = first;
+  nodes_[index].count = count;
+  fit(nodes_[index]);
+  if (count <= bvh_leaf_size)
+    return index;
+  Point3D min = nodes_[index].min, max = nodes_[index].max;
+
+  size_t axis = 0;
+  for (size_t k = 1; k < 3; ++k)
+    if (max[k] - min[k] > max[axis] - min[axis])
+      axis = k;
+  auto centroid = [&](const Triangle &t) {
+    return points_[t[0]][axis] + points_[t[1]][axis] + points_[t[2]][axis];
+  };
+  auto begin = triangles_.begin() + first;
+  std::nth_element(begin, begin + count / 2, begin + count,
+                   [&](const Triangle &a, const Triangle &b) { return centroid(a) < centroid(b); });
+  build(first, count / 2);     // the left child is index + 1
+  size_t right = build(first + count / 2, count - count / 2);
+  nodes_[index].first = right;
+  nodes_[index].count = 0;
+  return index;
+}
+
+// Squared distance to the closest point of the triangle (see Ericson: Real-Time Collision Detection, 5.1.5)
+double
+TriangleBVH::distanceSqr(size_t i, const Point3D &p) const {
+  const Point3D &a = points_[triangles_[i][0]], &b = points_[triangles_[i][1]],
+    &c = points_[triangles_[i][2]];
+  Vector3D ab = b - a, ac = c - a, ap = p - a;
+  double d1 = ab * ap, d2 = ac * ap;
+  if (d1 <= 0 && d2 <= 0)
+    return ap.normSqr();
+  Vector3D bp = p - b;
+  double d3 = ab * bp, d4 = ac * bp;
+  if (d3 >= 0 && d4 <= d3)
+    return bp.normSqr();
+  double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    return (ap - ab * (d1 / (d1 - d3))).normSqr();
+  Vector3D cp = p - c;
+  double d5 = ab * cp, d6 = ac * cp;
+  if (d6 >= 0 && d5 <= d6)
+    return cp.normSqr();
+  double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    return (ap - ac * (d2 / (d2 - d6))).normSqr();
+  double va = d3 * d6 - d5 * d4;
+  if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+    return (bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))).normSqr();
+  double denom = va + vb + vc;
+  if (std::abs(denom) < epsilon * epsilon) // degenerate triangle
+    return std::min({ ap.normSqr(), bp.normSqr(), cp.normSqr() });
+  return (ap - ab * (vb / denom) - ac * (vc / denom)).normSqr();
+}
+
+const TriangleBVH::Triangle &
+TriangleBVH::closest(const Point3D &p) const {
+  auto boxDistanceSqr = [&](const Node &node) {
+    double d = 0;
+    for (size_t k = 0; k < 3; ++k) {
+      double x = std::max({ node.min[k] - p[k], 0.0, p[k] - node.max[k] });
+      d += x * x;
+    }
+    return d;
+  };
+
+  // Depth-first, visiting the nearer child first, and skipping boxes farther than the best so far
+  size_t best = 0;
+  double best_distance = std::numeric_limits<double>::max();
+  std::vector<std::pair<double, size_t>> stack = { { boxDistanceSqr(nodes_[0]), 0 } };
+  while (!stack.empty()) {
+    auto [distance, index] = stack.back();
+    stack.pop_back();
+    if (distance >= best_distance)
+      continue;
+    const Node &node = nodes_[index];
+    if (node.count > 0) {
+      for (size_t i = node.first; i < node.first + node.count; ++i) {
+        double d = distanceSqr(i, p);
+        if (d < best_distance) {
+          best_distance = d;
+          best = i;
+        }
+      }
+      continue;
+    }
+    size_t left = index + 1, right = node.first;
+    double dl = boxDistanceSqr(nodes_[left]), dr = boxDistanceSqr(nodes_[right]);
+    if (dl < dr) {
+      stack.emplace_back(dr, right);
+      stack.emplace_back(dl, left);
+    } else {
+      stack.emplace_back(dl, left);
+      stack.emplace_back(dr, right);
+    }
+  }
+  return triangles_[best];
+}
+
+// Moller-Trumbore test for each triangle (from both sides), and slab tests for the boxes
+bool
+TriangleBVH::intersect(const Point3D &origin, const Vector3D &direction, Triangle &triangle,
+                       double &t, std::array<double, 3> &bary) const {
+  auto boxEntry = [&](const Node &node) {
+    double t0 = 0, t1 = std::numeric_limits<double>::max();
+    for (size_t k = 0; k < 3; ++k) {
+      if (std::abs(direction[k]) < std::numeric_limits<double>::min()) {
+        if (origin[k] < node.min[k] || origin[k] > node.max[k])
+          return std::numeric_limits<double>::infinity();
+        continue;
+      }
+      double a = (node.min[k] - origin[k]) / direction[k];
+      double b = (node.max[k] - origin[k]) / direction[k];
+      t0 = std::max(t0, std::min(a, b));
+      t1 = std::min(t1, std::max(a, b));
+    }
+    return t0 <= t1 ? t0 : std::numeric_limits<double>::infinity();
+  };
+
+  // Depth-first, nearer child first, skipping boxes entered beyond the nearest hit so far
+  bool found = false;
+  t = std::numeric_limits<double>::infinity();
+  std::vector<std::pair<double, size_t>> stack = { { boxEntry(nodes_[0]), 0 } };
+  while (!stack.empty()) {
+    auto [entry, index] = stack.back();
+    stack.pop_back();
+    if (entry >= t)
+      continue;
+    const Node &node = nodes_[index];
+    if (node.count > 0) {
+      for (size_t i = node.first; i < node.first + node.count; ++i) {
+        const Point3D &a = points_[triangles_[i][0]], &b = points_[triangles_[i][1]],
+          &c = points_[triangles_[i][2]];
+        Vector3D ab = b - a, ac = c - a, p = direction ^ ac;
+        double det = ab * p;
+        if (std::abs(det) < std::numeric_limits<double>::min())
+          continue;
+        Vector3D s = origin - a, q = s ^ ab;
+        double u = (s * p) / det, v = (direction * q) / det, ti = (ac * q) / det;
+        if (u < 0 || v < 0 || u + v > 1 || ti < 0 || ti >= t)
+          continue;
+        found = true;
+        t = ti;
+        triangle = triangles_[i];
+        bary = { 1 - u - v, u, v };
+      }
+      continue;
+    }
+    size_t left = index + 1, right = node.first;
+    double el = boxEntry(nodes_[left]), er = boxEntry(nodes_[right]);
+    if (el < er) {
+      stack.emplace_back(er, right);
+      stack.emplace_back(el, left);
+    } else {
+      stack.emplace_back(el, left);
+      stack.emplace_back(er, right);
+    }
+  }
+  return found;
+}
+
+void
+TriangleBVH::refit(const PointVector &points) {
+  points_ = points;
+  refit(0);
+}
+
+void
+TriangleBVH::refit(size_t index) {
+  Node &node = nodes_[index];
+  if (node.count > 0) {
+    fit(node);
+    return;
+  }
+  size_t left = index + 1, right = node.first;
+  refit(left);
+  refit(right);
+  for (size_t k = 0; k < 3; ++k) {
+    node.min[k] = std::min(nodes_[left].min[k], nodes_[right].min[k]);
+    node.max[k] = std::max(nodes_[left].max[k], nodes_[right].max[k]);
+  }
+}
+
+std::vector<TriangleBVH::Triangle>
+TriangleBVH::closest(const PointVector &points, const Executor &executor) const {
+  std::vector<Triangle> result(points.size());
+  executor(points.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      result[i] = closest(points[i]);
+  });
+  return result;
+}
+
+} // namespace Transfinite
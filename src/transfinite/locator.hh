@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+
+#include "executor.hh"
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+// Point location in a triangulation of (a part of) the plane, using a uniform grid of buckets,
+// each holding the triangles whose bounding boxes overlap it.
+class TriangleLocator {
+public:
+  using Triangle = TriMesh::Triangle;
+  TriangleLocator(const Point2DVector &points, const std::list<Triangle> &triangles);
+  // The triangle containing p (or the nearest one, when p is slightly outside),
+  // and the barycentric coordinates of p with respect to its vertices
+  const Triangle &locate(const Point2D &p, std::array<double, 3> &bary) const;
+
+private:
+  size_t bucket(const Point2D &p) const;
+  std::array<double, 3> barycentric(const Triangle &t, const Point2D &p) const;
+
+  Point2DVector points_;
+  std::vector<Triangle> triangles_;
+  Point2D min_;
+  double cell_size_;
+  size_t columns_, rows_;
+  std::vector<std::vector<size_t>> buckets_;
+};
+
+// Piecewise linear interpolation of a mesh over the domain, given by its domain points,
+// or by a locator of the same triangulation (e.g. Domain::locator, for its meshes)
+class MeshInterpolant {
+public:
+  MeshInterpolant(const Point2DVector &uvs, const TriMesh &mesh);
+  MeshInterpolant(std::shared_ptr<const TriangleLocator> locator, const PointVector &points);
+  Point3D eval(const Point2D &uv) const;
+
+private:
+  std::shared_ptr<const TriangleLocator> locator_;
+  PointVector points_;
+};
+
+// Closest-triangle queries in a 3D mesh, using a bounding volume hierarchy of axis-aligned boxes
+class TriangleBVH {
+public:
+  using Triangle = TriMesh::Triangle;
+  explicit TriangleBVH(const TriMesh &mesh); // should have at least one triangle
+  // The triangle closest to p, as by TriMesh::closestTriangle
+  const Triangle &closest(const Point3D &p) const;
+  // The closest triangles to all points, with the queries distributed by the executor
+  std::vector<Triangle> closest(const PointVector &points,
+                                const Executor &executor = threadExecutor()) const;
+  // The first triangle hit by the ray origin + direction * t (t >= 0), with t and the barycentric
+  // coordinates of the hit point; false when the ray misses the mesh
+  bool intersect(const Point3D &origin, const Vector3D &direction, Triangle &triangle,
+                 double &t, std::array<double, 3> &bary) const;
+  // Moves the vertices, keeping the hierarchy and only recomputing its boxes
+  // (so its quality degrades with large deformations)
+  void refit(const PointVector &points);
+
+private:
+  struct Node {
+    Point3D min, max;
+    size_t first, count;        // triangle range of a leaf (count > 0), or the right child index
+  };
+  size_t build(size_t first, size_t count);
+  void refit(size_t index);
+  void fit(Node &node) const;
+  double distanceSqr(size_t i, const Point3D &p) const;
+
+  PointVector points_;
+  std::vector<Triangle> triangles_;
+  std::vector<Node> nodes_;
+};
+
+} // namespace Transfinite
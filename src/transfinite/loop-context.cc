@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <typeinfo>
+
+#include "domain.hh"
+#include "loop-context.hh"
+
+namespace Transfinite {
+
+LoopContext::LoopContext(const CurveVector &curves) {
+  for (const auto &c : curves)
+    curves_.push_back(std::make_shared<BSCurve>(*c));
+}
+
+const CurveVector &
+LoopContext::curves() const {
+  return curves_;
+}
+
+// The first surface also orients the curves in setupLoop, so the others see them unchanged;
+// sharing with one live surface of the domain type is enough, as all of them have the same domain
+void
+LoopContext::attach(const std::shared_ptr<Surface> &surface) {
+  surface->setCurves(curves_);
+  surface->setupLoop();
+  surfaces_.erase(std::remove_if(surfaces_.begin(), surfaces_.end(),
+                                 [](const std::weak_ptr<Surface> &s) { return s.expired(); }),
+                  surfaces_.end());
+  const Domain &domain = *surface->domain();
+  for (const auto &s : surfaces_) {
+    auto other = s.lock();
+    if (typeid(*other->domain()) == typeid(domain)) {
+      surface->shareDomain(*other);
+      break;
+    }
+  }
+  surface->update();
+  surfaces_.push_back(surface);
+}
+
+} // namespace Transfinite
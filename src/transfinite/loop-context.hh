@@ -0,0 +1,37 @@
+#pragma once
+
+#include "surface.hh"
+
+namespace Transfinite {
+
+// Surfaces of different types on the same loop of curves, sharing what depends only on the loop:
+// the curves themselves with their metrics, the rotation minimizing frames of the ribbons
+// (see sharedRMF), the domain with its parameters and locators, and the parameterization
+// with its tables where the surfaces use the same one (see Surface::shareDomain), so e.g.
+// comparing side-based, corner-based and Generalized Coons patches of a loop computes these once.
+// Surfaces with different domain types share only the curves and the frames.
+// Only for surfaces built on the given curves, not for those setting up their curves from
+// control nets (Generalized Bezier, S-patch and SuperD). After changing a curve (see curves()),
+// all surfaces should be updated, one after the other.
+class LoopContext {
+public:
+  // Copies the curves
+  explicit LoopContext(const CurveVector &curves);
+  const CurveVector &curves() const;
+  // Sets up the surface on the curves, shares the domain of the surfaces attached before
+  // (if there is one of the same type), and updates it; the surfaces are not kept alive
+  // by the context
+  void attach(const std::shared_ptr<Surface> &surface);
+  template<typename S>
+  std::shared_ptr<S> create() {
+    auto surface = std::make_shared<S>();
+    attach(surface);
+    return surface;
+  }
+
+private:
+  CurveVector curves_;
+  std::vector<std::weak_ptr<Surface>> surfaces_;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "geometry.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+// Receiver of a mesh streamed by Surface::eval(resolution, sink), e.g. a file writer.
+// Points arrive in index order; triangles arrive only after all of their points.
+class MeshSink {
+public:
+  virtual ~MeshSink() = default;
+  // Called first, with the size of the whole mesh
+  virtual void begin(size_t points, size_t triangles) = 0;
+  // The points with indices from `first` on
+  virtual void addPoints(size_t first, const PointVector &points) = 0;
+  // No triangle coming later refers to points before `oldest`, so these can be discarded
+  virtual void addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t oldest) = 0;
+  // Called last, after everything has been added
+  virtual void end() = 0;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cmath>
+
+#include "domain.hh"
+#include "locator.hh"
+#include "multigrid-solver.hh"
+#include "profiler.hh"
+
+namespace Transfinite {
+
+using namespace Eigen;
+
+// Convergence is reached when an iteration changes no value by more than this
+// (relative to the largest fixed value)
+static const double multigrid_tolerance = 1.0e-10;
+static const size_t multigrid_max_iterations = 200;
+
+MultigridSolver::MultigridSolver(const SparseMatrix<double> &A, const std::vector<size_t> &fixed,
+                                 const std::vector<SparseMatrix<double>> &prolongations)
+  : levels_(prolongations.size() + 1) {
+  TRANSFINITE_TIMER("MultigridSolver::setup");
+  Level &finest = levels_.back();
+  finest.A = A;
+  finest.fixed_indices = fixed;
+  for (size_t l = levels_.size() - 1; l > 0; --l) {
+    Level &fine = levels_[l], &coarse = levels_[l-1];
+    fine.P = prolongations[l-1];
+    fine.R = fine.P.transpose();
+    coarse.A = SparseMatrix<double>(fine.R * SparseMatrix<double>(fine.A) * fine.P);
+
+    // The coarse variables interpolated by fixed fine ones are fixed,
+    // and take their values from the fine variables they coincide with
+    fine.fixed.assign(fine.A.rows(), false);
+    for (auto i : fine.fixed_indices)
+      fine.fixed[i] = true;
+    std::vector<size_t> at(coarse.A.rows(), 0);
+    SparseMatrix<double, RowMajor> P = fine.P;
+    for (size_t j = 0; j < fine.fixed_indices.size(); ++j)
+      for (SparseMatrix<double, RowMajor>::InnerIterator it(P, fine.fixed_indices[j]); it; ++it)
+        if (!at[it.col()] || it.value() == 1.0)
+          at[it.col()] = j + 1;
+    for (size_t i = 0; i < at.size(); ++i)
+      if (at[i]) {
+        coarse.fixed_indices.push_back(i);
+        fine.coarse_values.push_back(at[i] - 1);
+      }
+  }
+  Level &coarsest = levels_.front();
+  coarsest.fixed.assign(coarsest.A.rows(), false);
+  for (auto i : coarsest.fixed_indices)
+    coarsest.fixed[i] = true;
+  coarsest_ = std::make_unique<ConstrainedSolver>(SparseMatrix<double>(coarsest.A),
+                                                  coarsest.fixed_indices);
+}
+
+MatrixXd
+MultigridSolver::solve(const MatrixXd &f, const MatrixXd &values, const MatrixXd &guess) const {
+  TRANSFINITE_TIMER("MultigridSolver::solve");
+  size_t finest = levels_.size() - 1;
+  const Level &level = levels_.back();
+  if (finest == 0)
+    return coarsest_->solve(f, values);
+
+  MatrixXd rhs = f.size() ? f : MatrixXd::Zero(level.A.rows(), values.cols());
+  MatrixXd x;
+  if (guess.rows() == level.A.rows() && guess.cols() == values.cols()) {
+    x = guess;
+    for (size_t j = 0; j < level.fixed_indices.size(); ++j)
+      x.row(level.fixed_indices[j]) = values.row(j);
+  } else
+    x = fullMultigrid(finest, rhs, values);
+
+  iterate(level.A, x, rhs, values, multigrid_max_iterations);
+  return x;
+}
+
+MatrixXd
+MultigridSolver::solve(const SparseMatrix<double, RowMajor> &A, const MatrixXd &f,
+                       const MatrixXd &values, const MatrixXd &guess,
+                       size_t max_iterations) const {
+  TRANSFINITE_TIMER("MultigridSolver::preview");
+  const Level &level = levels_.back();
+  MatrixXd rhs = f.size() ? f : MatrixXd::Zero(A.rows(), values.cols());
+  MatrixXd x;
+  if (guess.rows() == A.rows() && guess.cols() == values.cols()) {
+    x = guess;
+    for (size_t j = 0; j < level.fixed_indices.size(); ++j)
+      x.row(level.fixed_indices[j]) = values.row(j);
+  } else
+    x = solve(rhs, values);
+  iterate(A, x, rhs, values, max_iterations);
+  return x;
+}
+
+// Conjugate gradients on the free variables, preconditioned by a V-cycle
+// (or by the coarsest solver, when there is only one level)
+void
+MultigridSolver::iterate(const SparseMatrix<double, RowMajor> &A, MatrixXd &x, const MatrixXd &f,
+                         const MatrixXd &values, size_t max_iterations) const {
+  size_t finest = levels_.size() - 1;
+  const Level &level = levels_.back();
+  auto precondition = [&](MatrixXd &z, const MatrixXd &r) {
+    if (finest == 0)
+      z = coarsest_->solve(r, MatrixXd::Zero(level.fixed_indices.size(), r.cols()));
+    else {
+      z.setZero();
+      vcycle(finest, z, r);
+    }
+  };
+
+  double scale = values.size() ? values.cwiseAbs().maxCoeff() : 0.0;
+  if (scale == 0.0)
+    scale = 1.0;
+  size_t k = x.cols();
+  MatrixXd r = f - A * x;
+  for (auto i : level.fixed_indices)
+    r.row(i).setZero();
+  MatrixXd z = MatrixXd::Zero(r.rows(), k);
+  precondition(z, r);
+  MatrixXd p = z;
+  VectorXd rz = (r.cwiseProduct(z)).colwise().sum();
+  for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+    MatrixXd q = A * p;
+    for (auto i : level.fixed_indices)
+      q.row(i).setZero();
+    VectorXd pq = (p.cwiseProduct(q)).colwise().sum();
+    double change = 0.0;
+    for (size_t j = 0; j < k; ++j) {
+      if (pq(j) <= 0.0)
+        continue;
+      double alpha = rz(j) / pq(j);
+      x.col(j) += alpha * p.col(j);
+      r.col(j) -= alpha * q.col(j);
+      change = std::max(change, std::abs(alpha) * p.col(j).cwiseAbs().maxCoeff());
+    }
+    if (change <= multigrid_tolerance * scale || iteration + 1 == max_iterations)
+      break;
+    precondition(z, r);
+    VectorXd rz_next = (r.cwiseProduct(z)).colwise().sum();
+    for (size_t j = 0; j < k; ++j)
+      p.col(j) = z.col(j) + (rz(j) != 0.0 ? rz_next(j) / rz(j) : 0.0) * p.col(j);
+    rz = rz_next;
+  }
+}
+
+std::vector<SparseMatrix<double>>
+MultigridSolver::prolongations(const Domain &domain, size_t resolution, size_t min_resolution) {
+  size_t coarsest = resolution;
+  while (coarsest % 2 == 0 && coarsest / 2 >= min_resolution)
+    coarsest /= 2;
+
+  std::vector<SparseMatrix<double>> result;
+  for (size_t r = coarsest; r < resolution; r *= 2) {
+    auto shared_coarse = domain.sharedParameters(r), shared_fine = domain.sharedParameters(2 * r);
+    const Point2DVector &coarse_uvs = *shared_coarse, &fine_uvs = *shared_fine;
+    auto coarse_boundary = domain.meshBoundary(r), fine_boundary = domain.meshBoundary(2 * r);
+    const auto &coarse_edge = coarse_boundary->on_edge, &fine_edge = fine_boundary->on_edge;
+    auto locator = domain.locator(r);
+
+    std::vector<bool> nested(fine_uvs.size(), false);
+    std::vector<Triplet<double>> triplets;
+    auto indices = domain.nestedIndices(r);
+    for (size_t j = 0; j < indices.size(); ++j) {
+      nested[indices[j]] = true;
+      triplets.emplace_back(indices[j], j, 1.0);
+    }
+    for (size_t i = 0; i < fine_uvs.size(); ++i) {
+      if (nested[i])
+        continue;
+      // Boundary points are interpolated only along the boundary
+      std::array<double, 3> bary;
+      const auto &t = locator->locate(fine_uvs[i], bary);
+      double sum = 0.0;
+      for (size_t k = 0; k < 3; ++k) {
+        if (bary[k] < epsilon || (fine_edge[i] && !coarse_edge[t[k]]))
+          bary[k] = 0.0;
+        sum += bary[k];
+      }
+      for (size_t k = 0; k < 3; ++k)
+        if (bary[k] > 0.0)
+          triplets.emplace_back(i, t[k], bary[k] / sum);
+    }
+    SparseMatrix<double> P(fine_uvs.size(), coarse_uvs.size());
+    P.setFromTriplets(triplets.begin(), triplets.end());
+    result.push_back(P);
+  }
+  return result;
+}
+
+// Solves on the coarser levels first, and interpolates the result as a starting point
+MatrixXd
+MultigridSolver::fullMultigrid(size_t l, const MatrixXd &f, const MatrixXd &values) const {
+  if (l == 0)
+    return coarsest_->solve(f, values);
+  const Level &level = levels_[l];
+  MatrixXd coarse_values(level.coarse_values.size(), values.cols());
+  for (size_t j = 0; j < level.coarse_values.size(); ++j)
+    coarse_values.row(j) = values.row(level.coarse_values[j]);
+  MatrixXd x = level.P * fullMultigrid(l - 1, level.R * f, coarse_values);
+  for (size_t j = 0; j < level.fixed_indices.size(); ++j)
+    x.row(level.fixed_indices[j]) = values.row(j);
+  vcycle(l, x, f);
+  return x;
+}
+
+void
+MultigridSolver::vcycle(size_t l, MatrixXd &x, const MatrixXd &f) const {
+  const Level &level = levels_[l], &coarse = levels_[l-1];
+  smooth(level, x, f);
+  MatrixXd r = f - level.A * x;
+  for (auto i : level.fixed_indices)
+    r.row(i).setZero();
+  MatrixXd rc = level.R * r, ec;
+  if (l == 1)
+    ec = coarsest_->solve(rc, MatrixXd::Zero(coarse.fixed_indices.size(), x.cols()));
+  else {
+    ec = MatrixXd::Zero(rc.rows(), rc.cols());
+    vcycle(l - 1, ec, rc);
+  }
+  x += level.P * ec;
+  smooth(level, x, f);
+}
+
+// One forward and one backward Gauss-Seidel sweep over the free variables
+void
+MultigridSolver::smooth(const Level &level, MatrixXd &x, const MatrixXd &f) const {
+  size_t n = level.A.rows();
+  RowVectorXd s(x.cols());
+  auto relax = [&](size_t i) {
+    if (level.fixed[i])
+      return;
+    double diagonal = 0.0;
+    s = f.row(i);
+    for (SparseMatrix<double, RowMajor>::InnerIterator it(level.A, i); it; ++it)
+      if ((size_t)it.col() == i)
+        diagonal = it.value();
+      else
+        s -= it.value() * x.row(it.col());
+    x.row(i) = s / diagonal;
+  };
+  for (size_t i = 0; i < n; ++i)
+    relax(i);
+  for (size_t i = n; i > 0; --i)
+    relax(i - 1);
+}
+
+} // namespace Transfinite
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Sparse>
+
+#include "constrained-solver.hh"
+
+namespace Transfinite {
+
+class Domain;
+
+// Solves A x = f with some of the values of x given (as ConstrainedSolver), by geometric multigrid
+// on a hierarchy of nested meshes, without factorizing the system of the finest level.
+// The coarser systems are the Galerkin products P^T A P with the prolongation matrices,
+// and the coarsest one is solved directly. A V-cycle with symmetric Gauss-Seidel smoothing
+// preconditions conjugate gradient iterations (plain V-cycles converge too slowly
+// for the squared Laplacians of biharmonic surfaces), which are repeated
+// until the largest change is below a tolerance relative to the given values.
+// The initial guess is computed on the coarser levels (full multigrid), unless one is supplied,
+// e.g. the previous solution of a slightly changed problem.
+// A should be symmetric and positive definite on the free variables.
+class MultigridSolver {
+public:
+  // `prolongations[l]` interpolates level l+1 from level l, level 0 being the coarsest;
+  // `fixed` indexes the finest level, and its rows in the prolongation should only refer to
+  // fixed variables of the coarser level (as on the boundary of nested meshes).
+  // Without prolongations the system is solved directly.
+  MultigridSolver(const Eigen::SparseMatrix<double> &A, const std::vector<size_t> &fixed,
+                  const std::vector<Eigen::SparseMatrix<double>> &prolongations);
+  // `f` has a row for each variable (or none, meaning zero), `values` for each fixed index
+  Eigen::MatrixXd solve(const Eigen::MatrixXd &f, const Eigen::MatrixXd &values,
+                        const Eigen::MatrixXd &guess = Eigen::MatrixXd()) const;
+  // Solves a slightly changed system `A` (with the same fixed indices) by at most
+  // `max_iterations` conjugate gradient iterations, preconditioned by this solver
+  // (by the V-cycle, or by the factorization without prolongations), e.g. for a quick preview;
+  // `A` is row-major, as the matrices of the levels, so that it is used without conversion
+  Eigen::MatrixXd solve(const Eigen::SparseMatrix<double, Eigen::RowMajor> &A,
+                        const Eigen::MatrixXd &f, const Eigen::MatrixXd &values,
+                        const Eigen::MatrixXd &guess, size_t max_iterations) const;
+
+  // Linear interpolation matrices between the uniform meshes of the domain, up to the given
+  // resolution; it is halved while it is even, and the result is not below `min_resolution`
+  static std::vector<Eigen::SparseMatrix<double>>
+  prolongations(const Domain &domain, size_t resolution, size_t min_resolution = 8);
+
+private:
+  struct Level {
+    Eigen::SparseMatrix<double, Eigen::RowMajor> A;
+    std::vector<bool> fixed;
+    std::vector<size_t> fixed_indices;
+    Eigen::SparseMatrix<double> P, R;  // from/to the next coarser level
+    std::vector<size_t> coarse_values; // fixed values of the coarser level, as indices in ours
+  };
+
+  Eigen::MatrixXd fullMultigrid(size_t l, const Eigen::MatrixXd &f,
+                                const Eigen::MatrixXd &values) const;
+  void vcycle(size_t l, Eigen::MatrixXd &x, const Eigen::MatrixXd &f) const;
+  void iterate(const Eigen::SparseMatrix<double, Eigen::RowMajor> &A, Eigen::MatrixXd &x,
+               const Eigen::MatrixXd &f, const Eigen::MatrixXd &values,
+               size_t max_iterations) const;
+  void smooth(const Level &level, Eigen::MatrixXd &x, const Eigen::MatrixXd &f) const;
+
+  std::vector<Level> levels_; // the coarsest first
+  std::unique_ptr<ConstrainedSolver> coarsest_;
+};
+
+} // namespace Transfinite
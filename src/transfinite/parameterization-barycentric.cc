@@ -1,11 +1,148 @@
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 
 #include "domain.hh"
 #include "parameterization-barycentric.hh"
 
+// The batched kernel is compiled for several instruction sets, selected at load time
+// (GCC / Clang on x86-64 Linux); elsewhere it is vectorized for the baseline target.
+// FMA contraction is disabled, so that the results match the scalar code exactly.
+#if defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+# define TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#elif defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+# define TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default"), \
+                                      optimize("fp-contract=off")))
+#else
+# define TARGET_CLONES
+#endif
+
 namespace Transfinite {
 
+namespace {
+
+  using BarycentricType = ParameterizationBarycentric::BarycentricType;
+
+  // Number of points processed together by the batched kernel
+  const size_t lanes = 64;
+
+  size_t kernelWorkSize(size_t n) {
+    return (6 * n + 5) * lanes;
+  }
+
+  // The same computation as in computeBarycentric(), for m <= lanes points at once.
+  // Intermediate arrays are indexed by [vertex * lanes + point], and all inner loops
+  // run over the points, so they compile to SIMD instructions.
+  // Points at a vertex (for mean value and harmonic coordinates) get fallback[b] = 1,
+  // and have to be recomputed by the scalar code.
+  TARGET_CLONES
+  void barycentricKernel(BarycentricType type, const Point2DVector &vertices,
+                         const double *u, const double *v, size_t m,
+                         double *work, double *l, unsigned char *fallback) {
+#ifdef __clang__
+#pragma clang fp contract(off)
+#endif
+    size_t n = vertices.size();
+    double *dx = work, *dy = dx + n * lanes, *area = dy + n * lanes, *r = area + n * lanes;
+    double *prefix = r + n * lanes, *suffix = prefix + (n + 1) * lanes;
+    double *a0 = suffix + (n + 1) * lanes, *sum = a0 + lanes, *li = sum + lanes;
+
+    for (size_t j = 0; j < n; ++j) {
+      double vu = vertices[j][0], vv = vertices[j][1];
+      double *x = dx + j * lanes, *y = dy + j * lanes;
+      for (size_t b = 0; b < m; ++b) {
+        x[b] = u[b] - vu;
+        y[b] = v[b] - vv;
+      }
+    }
+
+    for (size_t j = 0; j < n; ++j) {
+      const double *x0 = dx + j * lanes, *y0 = dy + j * lanes;
+      const double *x1 = dx + (j + 1) % n * lanes, *y1 = dy + (j + 1) % n * lanes;
+      double *a = area + j * lanes, *rj = r + j * lanes;
+      for (size_t b = 0; b < m; ++b)
+        a[b] = (x0[b] * y1[b] - y0[b] * x1[b]) / 2.0;
+      switch (type) {
+      case BarycentricType::WACHSPRESS:
+        for (size_t b = 0; b < m; ++b)
+          rj[b] = 1.0;
+        break;
+      case BarycentricType::MEAN_VALUE:
+        for (size_t b = 0; b < m; ++b)
+          rj[b] = std::sqrt(x0[b] * x0[b] + y0[b] * y0[b]);
+        break;
+      case BarycentricType::HARMONIC:
+        for (size_t b = 0; b < m; ++b)
+          rj[b] = x0[b] * x0[b] + y0[b] * y0[b];
+        break;
+      }
+    }
+
+    for (size_t b = 0; b < m; ++b) {
+      prefix[b] = 1.0;
+      suffix[n * lanes + b] = 1.0;
+      a0[b] = 1.0;
+      sum[b] = 0.0;
+      fallback[b] = 0;
+    }
+    for (size_t j = 0; j < n; ++j)
+      for (size_t b = 0; b < m; ++b)
+        prefix[(j + 1) * lanes + b] = prefix[j * lanes + b] * area[j * lanes + b];
+    for (size_t j = n; j > 0; --j)
+      for (size_t b = 0; b < m; ++b)
+        suffix[(j - 1) * lanes + b] = suffix[j * lanes + b] * area[(j - 1) * lanes + b];
+    for (size_t j = 1; j + 1 < n; ++j)
+      for (size_t b = 0; b < m; ++b)
+        a0[b] *= area[j * lanes + b];
+
+    // Products are taken as in computeBarycentric(); suffix row n holds ones
+    for (size_t i = 0; i < n; ++i) {
+      size_t i_1 = (i + n - 1) % n, i1 = (i + 1) % n;
+      const double *x_1 = dx + i_1 * lanes, *y_1 = dy + i_1 * lanes;
+      const double *x1 = dx + i1 * lanes, *y1 = dy + i1 * lanes;
+      const double *ri_1 = r + i_1 * lanes, *ri = r + i * lanes, *ri1 = r + i1 * lanes;
+      const double *pi = prefix + i * lanes, *si = suffix + (i + 1) * lanes;
+      const double *pi_1 = prefix + i_1 * lanes, *si_1 = suffix + (i_1 + 1) * lanes;
+      const double *pi_1i = i == 0 ? a0 : pi_1, *si_1i = i == 0 ? suffix + n * lanes : si;
+      for (size_t b = 0; b < m; ++b) {
+        double Ai = pi[b] * si[b];
+        double Ai_1 = pi_1[b] * si_1[b];
+        double Ai_1i = pi_1i[b] * si_1i[b];
+        double Bi = (x_1[b] * y1[b] - y_1[b] * x1[b]) / 2.0;
+        li[b] = ri_1[b] * Ai_1 + ri1[b] * Ai - ri[b] * Bi * Ai_1i;
+        sum[b] += li[b];
+        if (ri[b] < epsilon)
+          fallback[b] = 1;
+      }
+      for (size_t b = 0; b < m; ++b)
+        l[b * n + i] = li[b];
+    }
+
+    for (size_t b = 0; b < m; ++b)
+      for (size_t i = 0; i < n; ++i)
+        l[b * n + i] /= sum[b];
+  }
+
+  // The last coordinates returned from the cache in this thread, kept alive against evictions
+  thread_local std::shared_ptr<const DoubleVector> pinned;
+
+  // Value with its gradient with respect to (u, v)
+  struct Dual {
+    double x;
+    Vector2D d;
+  };
+
+  Dual operator+(const Dual &a, const Dual &b) { return { a.x + b.x, a.d + b.d }; }
+  Dual operator-(const Dual &a, const Dual &b) { return { a.x - b.x, a.d - b.d }; }
+  Dual operator*(const Dual &a, const Dual &b) { return { a.x * b.x, a.d * b.x + b.d * a.x }; }
+
+  // Signed area of the triangle spanned by a = uv - p and b = uv - q
+  Dual area(const Vector2D &a, const Vector2D &b) {
+    return { (a[0] * b[1] - a[1] * b[0]) / 2.0, Vector2D(b[1] - a[1], a[0] - b[0]) / 2.0 };
+  }
+
+}
+
 ParameterizationBarycentric::ParameterizationBarycentric() : type_(BarycentricType::WACHSPRESS) {
 }
 
@@ -15,9 +152,29 @@ ParameterizationBarycentric::ParameterizationBarycentric(BarycentricType type) :
 ParameterizationBarycentric::~ParameterizationBarycentric() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationBarycentric::clone() const {
+  return std::make_shared<ParameterizationBarycentric>(*this);
+}
+
+std::string
+ParameterizationBarycentric::tableKey() const {
+  return Parameterization::tableKey() + "/" + std::to_string(static_cast<int>(type_));
+}
+
 Point2D
 ParameterizationBarycentric::mapToRibbon(size_t i, const Point2D &uv) const {
-  const DoubleVector &l = barycentric(uv);
+  return ribbonParameters(i, uv, barycentric(uv).data());
+}
+
+Point2D
+ParameterizationBarycentric::ribbonParameters(size_t i, const Point2D &uv,
+                                              const double *l) const {
+  return sideParameters(i, uv, l);
+}
+
+Point2D
+ParameterizationBarycentric::sideParameters(size_t i, const Point2D &uv, const double *l) const {
   Point2D sd;
   double denom = l[prev(i)] + l[i];
   if (denom < epsilon) {
@@ -45,58 +202,208 @@ ParameterizationBarycentric::update() {
   Parameterization::update();
 }
 
+CacheStatistics
+ParameterizationBarycentric::cacheStatistics() const {
+  CacheStatistics result = Parameterization::cacheStatistics();
+  result += cache_.statistics();
+  return result;
+}
+
+void
+ParameterizationBarycentric::setCacheLimit(size_t points) {
+  Parameterization::setCacheLimit(points);
+  cache_.setLimit(points);
+}
+
+void
+ParameterizationBarycentric::mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const {
+  thread_local DoubleVector l;
+  computeBarycentric(uv, l);
+  for (size_t i = 0; i < n_; ++i)
+    sds[i] = ribbonParameters(i, uv, l.data());
+}
+
+void
+ParameterizationBarycentric::mapToRibbonsBlock(const Point2D *uvs, size_t size, Point2D *sds) const {
+  thread_local DoubleVector l;
+  l.resize(size * n_);
+  barycentric(uvs, size, l.data());
+  for (size_t j = 0; j < size; ++j)
+    for (size_t i = 0; i < n_; ++i)
+      sds[j * n_ + i] = ribbonParameters(i, uvs[j], &l[j * n_]);
+}
+
+void
+ParameterizationBarycentric::mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                                     Vector2D *ds, Vector2D *dd) const {
+  if (!barycentricDerivatives(uv, sds, ds, dd))
+    Parameterization::mapToRibbonsDerivatives(uv, sds, ds, dd);
+}
+
+bool
+ParameterizationBarycentric::barycentricDerivatives(const Point2D &uv, Point2D *sds,
+                                                    Vector2D *ds, Vector2D *dd) const {
+  // Same as computeBarycentric(), but also differentiating the unnormalized coordinates
+  thread_local DoubleVector l;
+  thread_local Vector2DVector vectors;
+  thread_local std::vector<Dual> areas, radii, prefix, suffix, w;
+  computeBarycentric(uv, l);
+
+  vectors.clear(); vectors.reserve(n_);
+  for (const auto &p : domain_->vertices())
+    vectors.push_back(uv - p);
+
+  areas.clear(); areas.reserve(n_);
+  for (size_t i = 0; i < n_; ++i)
+    areas.push_back(area(vectors[i], vectors[next(i)]));
+
+  radii.assign(n_, { 1.0, Vector2D(0, 0) });
+  switch (type_) {
+  case BarycentricType::WACHSPRESS:
+    break;
+  case BarycentricType::MEAN_VALUE:
+    for (size_t i = 0; i < n_; ++i) {
+      double r = vectors[i].norm();
+      if (r < epsilon)
+        return false;
+      radii[i] = { r, vectors[i] / r };
+    }
+    break;
+  case BarycentricType::HARMONIC:
+    for (size_t i = 0; i < n_; ++i) {
+      double r = vectors[i].normSqr();
+      if (r < epsilon)
+        return false;
+      radii[i] = { r, vectors[i] * 2.0 };
+    }
+    break;
+  };
+
+  prefix.resize(n_ + 1); suffix.resize(n_ + 1);
+  prefix[0] = suffix[n_] = { 1.0, Vector2D(0, 0) };
+  for (size_t j = 0; j < n_; ++j)
+    prefix[j+1] = prefix[j] * areas[j];
+  for (size_t j = n_; j > 0; --j)
+    suffix[j-1] = suffix[j] * areas[j-1];
+  Dual A0_1 = { 1.0, Vector2D(0, 0) };
+  for (size_t j = 1; j + 1 < n_; ++j)
+    A0_1 = A0_1 * areas[j];
+
+  w.clear(); w.reserve(n_);
+  Dual sum = { 0.0, Vector2D(0, 0) };
+  for (size_t i = 0; i < n_; ++i) {
+    size_t i_1 = prev(i), i1 = next(i);
+    Dual Ai = prefix[i] * suffix[i+1];
+    Dual Ai_1 = prefix[i_1] * suffix[i_1+1];
+    Dual Ai_1i = i == 0 ? A0_1 : prefix[i_1] * suffix[i+1];
+    Dual Bi = area(vectors[i_1], vectors[i1]);
+    w.push_back(radii[i_1] * Ai_1 + radii[i1] * Ai - radii[i] * Bi * Ai_1i);
+    sum = sum + w.back();
+  }
+
+  // The gradients of the normalized coordinates are stored in the `w` duals
+  for (size_t i = 0; i < n_; ++i)
+    w[i].d = (w[i].d - sum.d * l[i]) / sum.x;
+
+  for (size_t i = 0; i < n_; ++i) {
+    size_t i_1 = prev(i);
+    double denom = l[i_1] + l[i];
+    if (denom < epsilon)
+      return false;
+    sds[i] = Point2D(l[i] / denom, 1.0 - l[i] - l[i_1]);
+    ds[i] = (w[i].d * denom - (w[i_1].d + w[i].d) * l[i]) / (denom * denom);
+    dd[i] = (w[i].d + w[i_1].d) * -1.0;
+  }
+  return true;
+}
+
 const DoubleVector &
 ParameterizationBarycentric::barycentric(const Point2D &uv) const {
-  auto cached = cache_.find(uv);
-  if (cached != cache_.end())
-    return cached->second;
+  pinned = cache_.find(uv);
+  if (!pinned) {
+    DoubleVector l;
+    computeBarycentric(uv, l);
+    pinned = cache_.insert(uv, std::move(l));
+  }
+  return *pinned;
+}
+
+void
+ParameterizationBarycentric::barycentric(const Point2D *uvs, size_t size, double *l) const {
+  thread_local DoubleVector u(lanes), v(lanes), work, scalar;
+  thread_local std::vector<unsigned char> fallback(lanes);
+  work.resize(kernelWorkSize(n_));
+  const Point2DVector &vertices = domain_->vertices();
+  for (size_t start = 0; start < size; start += lanes) {
+    size_t m = std::min(lanes, size - start);
+    for (size_t b = 0; b < m; ++b) {
+      u[b] = uvs[start+b][0];
+      v[b] = uvs[start+b][1];
+    }
+    double *result = l + start * n_;
+    barycentricKernel(type_, vertices, u.data(), v.data(), m, work.data(), result, fallback.data());
+    for (size_t b = 0; b < m; ++b)
+      if (fallback[b]) {
+        computeBarycentric(uvs[start+b], scalar);
+        std::copy(scalar.begin(), scalar.end(), result + b * n_);
+      }
+  }
+}
 
-  Vector2DVector vectors; vectors.reserve(n_);
+void
+ParameterizationBarycentric::computeBarycentric(const Point2D &uv, DoubleVector &l) const {
+  thread_local Vector2DVector vectors;
+  thread_local DoubleVector areas, radii, prefix, suffix;
+
+  vectors.clear(); vectors.reserve(n_);
   std::transform(domain_->vertices().begin(), domain_->vertices().end(),
                  std::back_inserter(vectors),
                  [uv](const Point2D &p) { return uv - p; });
 
-  DoubleVector areas; areas.reserve(n_);
+  areas.clear(); areas.reserve(n_);
   for (size_t i = 0; i < n_; ++i) {
     const Vector2D &si = vectors[i];
     const Vector2D &si1 = vectors[next(i)];
     areas.push_back((si[0] * si1[1] - si[1] * si1[0]) / 2.0);
   }
 
-  DoubleVector l; l.reserve(n_);
+  radii.assign(n_, 1.0);
+  switch (type_) {
+  case BarycentricType::WACHSPRESS:
+    break;
+  case BarycentricType::MEAN_VALUE:
+    for (size_t i = 0; i < n_; ++i)
+      radii[i] = vectors[i].norm();
+    break;
+  case BarycentricType::HARMONIC:
+    for (size_t i = 0; i < n_; ++i)
+      radii[i] = vectors[i].normSqr();
+    break;
+  };
+
+  // Products of all areas except the j-th one are prefix[j] * suffix[j+1],
+  // so each coordinate is computed in constant time
+  prefix.resize(n_ + 1); suffix.resize(n_ + 1);
+  prefix[0] = 1.0; suffix[n_] = 1.0;
+  for (size_t j = 0; j < n_; ++j)
+    prefix[j+1] = prefix[j] * areas[j];
+  for (size_t j = n_; j > 0; --j)
+    suffix[j-1] = suffix[j] * areas[j-1];
+  double A0_1 = 1.0;            // all areas except the first and the last
+  for (size_t j = 1; j + 1 < n_; ++j)
+    A0_1 *= areas[j];
+
+  l.clear(); l.reserve(n_);
 
   for (size_t i = 0; i < n_; ++i) {
     size_t i_1 = prev(i), i1 = next(i);
-    double Ai = 1.0, Ai_1 = 1.0, Ai_1i = 1.0;
-    for (size_t j = 0; j < n_; ++j) {
-      if (j == i)
-        Ai_1 *= areas[j];
-      else if (j == i_1)
-        Ai *= areas[j];
-      else {
-        Ai_1 *= areas[j];
-        Ai *= areas[j];
-        Ai_1i *= areas[j];
-      }
-    }
+    double Ai = prefix[i] * suffix[i+1];
+    double Ai_1 = prefix[i_1] * suffix[i_1+1];
+    double Ai_1i = i == 0 ? A0_1 : prefix[i_1] * suffix[i+1];
     const Vector2D &si_1 = vectors[i_1];
     const Vector2D &si1 = vectors[i1];
     double Bi = (si_1[0] * si1[1] - si_1[1] * si1[0]) / 2.0;
-    double ri_1 = 1.0, ri = 1.0, ri1 = 1.0;
-    switch (type_) {
-    case BarycentricType::WACHSPRESS:
-      break;
-    case BarycentricType::MEAN_VALUE:
-      ri_1 = vectors[i_1].norm();
-      ri = vectors[i].norm();
-      ri1 = vectors[i1].norm();
-      break;
-    case BarycentricType::HARMONIC:
-      ri_1 = vectors[i_1].normSqr();
-      ri = vectors[i].normSqr();
-      ri1 = vectors[i1].normSqr();
-      break;
-    };
+    double ri_1 = radii[i_1], ri = radii[i], ri1 = radii[i1];
     if (ri < epsilon) {         // at a vertex of the domain (mean/harmonic)
       l.assign(n_, 0.0);
       l[i] = 1.0;
@@ -107,9 +414,6 @@ ParameterizationBarycentric::barycentric(const Point2D &uv) const {
 
   double sum = std::accumulate(l.begin(), l.end(), 0.0);
   std::transform(l.begin(), l.end(), l.begin(), [sum](double x) { return x / sum; });
-
-  cache_[uv] = l;
-  return cache_[uv];
 }
 
 } // namespace Transfinite
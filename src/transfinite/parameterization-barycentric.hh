@@ -11,15 +11,38 @@ public:
   ParameterizationBarycentric();
   ParameterizationBarycentric(BarycentricType type);
   virtual ~ParameterizationBarycentric();
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
   virtual void update() override;
+  virtual CacheStatistics cacheStatistics() const override;
+  virtual void setCacheLimit(size_t points) override;
+  virtual void mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                       Vector2D *ds, Vector2D *dd) const override;
+  // Cached; the reference is valid until the next call in the same thread
   const DoubleVector &barycentric(const Point2D &uv) const;
+  // Coordinates of `size` points without caching; those of uvs[j] are stored from l[j * n]
+  void barycentric(const Point2D *uvs, size_t size, double *l) const;
+
+protected:
+  virtual std::string tableKey() const override;
+  virtual void mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const override;
+  virtual void mapToRibbonsBlock(const Point2D *uvs, size_t size, Point2D *sds) const override;
+  // The mapping of side i at uv, given the barycentric coordinates l of uv;
+  // derived classes override this instead of mapToRibbon(), so that all sides of a point
+  // are mapped from one set of coordinates, passed to them explicitly
+  virtual Point2D ribbonParameters(size_t i, const Point2D &uv, const double *l) const;
+  // The side parameters of this class, as in ribbonParameters()
+  Point2D sideParameters(size_t i, const Point2D &uv, const double *l) const;
+  // Analytic version of mapToRibbonsDerivatives() for the mapping of this class;
+  // returns false at degenerate points (domain vertices and where the denominators vanish)
+  bool barycentricDerivatives(const Point2D &uv, Point2D *sds, Vector2D *ds, Vector2D *dd) const;
 
 private:
+  void computeBarycentric(const Point2D &uv, DoubleVector &l) const;
+
   const BarycentricType type_;
 
-  using CoordinateCache = std::map<Point2D, DoubleVector, PointComparator>;
-  mutable CoordinateCache cache_;
+  mutable PointCache<DoubleVector> cache_;
 };
 
 } // namespace Transfinite
@@ -8,8 +8,18 @@ namespace Transfinite {
 ParameterizationBilinear::~ParameterizationBilinear() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationBilinear::clone() const {
+  return std::make_shared<ParameterizationBilinear>(*this);
+}
+
 Point2D
 ParameterizationBilinear::mapToRibbon(size_t i, const Point2D &uv) const {
+  return bilinearLocal(i, domain_->toLocal(i, uv - domain_->vertices()[prev(i)]));
+}
+
+Point2D
+ParameterizationBilinear::bilinearLocal(size_t i, const Point2D &p) const {
   Point2DVector const &vertices = domain_->vertices();
 
   const Point2D &v0 = vertices[prev(i, 2)];
@@ -20,7 +30,6 @@ ParameterizationBilinear::mapToRibbon(size_t i, const Point2D &uv) const {
   // bilinear: p1 - (0,0) - (1,0) - p2
   Point2D p1 = domain_->toLocal(i, v0 - v1);
   Point2D p2 = domain_->toLocal(i, v3 - v2);
-  Point2D p = domain_->toLocal(i, uv - v1);
 
   double a = p1[1] - p2[1];
   double b = p[0] * p2[1] - (p[0] + 1.0) * p1[1] + (p1[0] - p2[0]) * p[1];
@@ -59,4 +68,47 @@ ParameterizationBilinear::mapToRibbon(size_t i, const Point2D &uv) const {
   return sd;
 }
 
+void
+ParameterizationBilinear::mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                                  Vector2D *ds, Vector2D *dd) const {
+  if (!bilinearDerivatives(uv, sds, ds, dd))
+    Parameterization::mapToRibbonsDerivatives(uv, sds, ds, dd);
+}
+
+bool
+ParameterizationBilinear::bilinearDerivatives(const Point2D &uv, Point2D *sds,
+                                              Vector2D *ds, Vector2D *dd) const {
+  Point2DVector const &vertices = domain_->vertices();
+  for (size_t i = 0; i < n_; ++i) {
+    const Point2D &v0 = vertices[prev(i, 2)];
+    const Point2D &v1 = vertices[prev(i)];
+    const Point2D &v2 = vertices[i];
+    const Point2D &v3 = vertices[next(i)];
+
+    Point2D p1 = domain_->toLocal(i, v0 - v1);
+    Point2D p2 = domain_->toLocal(i, v3 - v2);
+    Point2D p = domain_->toLocal(i, uv - v1);
+    Point2D pu = domain_->toLocal(i, Vector2D(1, 0));
+    Point2D pv = domain_->toLocal(i, Vector2D(0, 1));
+    Vector2D dpx(pu[0], pv[0]), dpy(pu[1], pv[1]);
+
+    // Implicit differentiation of a s^2 + b s + c = 0 (a is constant)
+    Point2D sd = ParameterizationBilinear::mapToRibbon(i, uv);
+    double s = sd[0];
+    double a = p1[1] - p2[1];
+    double b = p[0] * p2[1] - (p[0] + 1.0) * p1[1] + (p1[0] - p2[0]) * p[1];
+    Vector2D db = dpx * (p2[1] - p1[1]) + dpy * (p1[0] - p2[0]);
+    Vector2D dc = dpx * p1[1] - dpy * p1[0];
+    double denom = 2.0 * a * s + b;
+    if (std::abs(denom) < epsilon)
+      return false;
+
+    sds[i] = sd;
+    ds[i] = (db * s + dc) / -denom;
+    double width = p1[1] * (1.0 - s) + p2[1] * s;
+    dd[i] = (dpy - ds[i] * (sd[1] * (p2[1] - p1[1]))) / width;
+  }
+  return true;
+}
+
 } // namespace Transfinite
@@ -7,7 +7,17 @@ namespace Transfinite {
 class ParameterizationBilinear : public Parameterization {
 public:
   virtual ~ParameterizationBilinear();
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
+  virtual void mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                       Vector2D *ds, Vector2D *dd) const override;
+
+protected:
+  // Analytic version of mapToRibbonsDerivatives() for the mapping of this class;
+  // returns false at degenerate points (where the parameter s is singular)
+  bool bilinearDerivatives(const Point2D &uv, Point2D *sds, Vector2D *ds, Vector2D *dd) const;
+  // The mapping of side i, given p = domain_->toLocal(i, uv - domain_->vertices()[prev(i)])
+  Point2D bilinearLocal(size_t i, const Point2D &p) const;
 };
 
 } // namespace Transfinite
@@ -1,4 +1,3 @@
-#include <algorithm>
 #include <cmath>
 
 #include "parameterization-constrained-barycentric.hh"
@@ -8,34 +7,130 @@ namespace Transfinite {
 ParameterizationConstrainedBarycentric::~ParameterizationConstrainedBarycentric() {
 }
 
-Point2D
-ParameterizationConstrainedBarycentric::mapToRibbon(size_t i, const Point2D &uv) const {
-  Point2D sd = ParameterizationBarycentric::mapToRibbon(     i , uv);
-  double s_1 = ParameterizationBarycentric::mapToRibbon(prev(i), uv)[0];
-  double s1  = ParameterizationBarycentric::mapToRibbon(next(i), uv)[0];
-
-  // As in Surface::blendSideSingular
-  std::vector<double> blends, weights = { sd[1], 1.0 - sd[0], 1.0 - sd[1], sd[0] };
-  size_t small = 0;
-  for (const auto &w : weights)
-    if (w < epsilon)
-      ++small;
-  if (small > 0) {
-    double val = 1.0 / small;
-    for (const auto &w : weights)
-      blends.push_back(w < epsilon ? val : 0.0);
-  } else {
-    double denominator = 0.0;
-    for (const auto &w : weights) {
-      blends.push_back(std::pow(w, -2));
-      denominator += blends.back();
+std::shared_ptr<Parameterization>
+ParameterizationConstrainedBarycentric::clone() const {
+  return std::make_shared<ParameterizationConstrainedBarycentric>(*this);
+}
+
+namespace {
+
+  // Blends the distance parameter of a side with the side parameters of its neighbors,
+  // as in Surface::blendSideSingular
+  Point2D constrain(Point2D sd, double s_1, double s1) {
+    double weights[] = { sd[1], 1.0 - sd[0], 1.0 - sd[1], sd[0] }, blends[4];
+    size_t small = 0;
+    for (double w : weights)
+      if (w < epsilon)
+        ++small;
+    if (small > 0) {
+      double val = 1.0 / small;
+      for (size_t k = 0; k < 4; ++k)
+        blends[k] = weights[k] < epsilon ? val : 0.0;
+    } else {
+      double denominator = 0.0;
+      for (size_t k = 0; k < 4; ++k) {
+        blends[k] = std::pow(weights[k], -2);
+        denominator += blends[k];
+      }
+      for (auto &b : blends)
+        b /= denominator;
     }
-    std::transform(blends.begin(), blends.end(), blends.begin(),
-                   [denominator](double x) { return x / denominator; });
+
+    sd[1] = sd[1] * (blends[0] + blends[2]) + s1 * blends[1] + (1.0 - s_1) * blends[3];
+    return sd;
+  }
+
+}
+
+Point2D
+ParameterizationConstrainedBarycentric::ribbonParameters(size_t i, const Point2D &uv,
+                                                         const double *l) const {
+  return constrain(sideParameters(i, uv, l),
+                   sideParameters(prev(i), uv, l)[0], sideParameters(next(i), uv, l)[0]);
+}
+
+void
+ParameterizationConstrainedBarycentric::mapToRibbonsUncached(const Point2D &uv,
+                                                             Point2D *sds) const {
+  thread_local DoubleVector l;
+  l.resize(n_);
+  barycentric(&uv, 1, l.data());
+  constrainedRibbons(uv, l.data(), sds);
+}
+
+void
+ParameterizationConstrainedBarycentric::mapToRibbonsBlock(const Point2D *uvs, size_t size,
+                                                          Point2D *sds) const {
+  thread_local DoubleVector l;
+  l.resize(size * n_);
+  barycentric(uvs, size, l.data());
+  for (size_t j = 0; j < size; ++j)
+    constrainedRibbons(uvs[j], &l[j * n_], sds + j * n_);
+}
+
+void
+ParameterizationConstrainedBarycentric::constrainedRibbons(const Point2D &uv, const double *l,
+                                                           Point2D *sds) const {
+  thread_local Point2DVector raw;
+  raw.resize(n_);
+  for (size_t i = 0; i < n_; ++i)
+    raw[i] = sideParameters(i, uv, l);
+  for (size_t i = 0; i < n_; ++i)
+    sds[i] = constrain(raw[i], raw[prev(i)][0], raw[next(i)][0]);
+}
+
+void
+ParameterizationConstrainedBarycentric::mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                                                Vector2D *ds, Vector2D *dd) const {
+  thread_local Point2DVector raw;
+  thread_local Vector2DVector raw_ds, raw_dd;
+  raw.resize(n_); raw_ds.resize(n_); raw_dd.resize(n_);
+  if (!barycentricDerivatives(uv, raw.data(), raw_ds.data(), raw_dd.data())) {
+    Parameterization::mapToRibbonsDerivatives(uv, sds, ds, dd);
+    return;
   }
 
-  sd[1] = sd[1] * (blends[0] + blends[2]) + s1 * blends[1] + (1.0 - s_1) * blends[3];
-  return sd;
+  for (size_t i = 0; i < n_; ++i) {
+    const Point2D &sd = raw[i];
+    double s_1 = raw[prev(i)][0], s1 = raw[next(i)][0];
+    const Vector2D &ds_1 = raw_ds[prev(i)], &ds1 = raw_ds[next(i)];
+
+    // As in mapToRibbon(), with the blends differentiated
+    double weights[] = { sd[1], 1.0 - sd[0], 1.0 - sd[1], sd[0] };
+    Vector2D dweights[] = { raw_dd[i], raw_ds[i] * -1.0, raw_dd[i] * -1.0, raw_ds[i] };
+    double blends[4];
+    Vector2D dblends[4];
+    size_t small = 0;
+    for (double w : weights)
+      if (w < epsilon)
+        ++small;
+    if (small > 0) {
+      double val = 1.0 / small;
+      for (size_t k = 0; k < 4; ++k) {
+        blends[k] = weights[k] < epsilon ? val : 0.0;
+        dblends[k] = Vector2D(0, 0);
+      }
+    } else {
+      double denominator = 0.0;
+      Vector2D ddenominator(0, 0);
+      for (size_t k = 0; k < 4; ++k) {
+        blends[k] = std::pow(weights[k], -2);
+        dblends[k] = dweights[k] * (-2.0 * blends[k] / weights[k]);
+        denominator += blends[k];
+        ddenominator += dblends[k];
+      }
+      for (size_t k = 0; k < 4; ++k) {
+        blends[k] /= denominator;
+        dblends[k] = (dblends[k] - ddenominator * blends[k]) / denominator;
+      }
+    }
+
+    sds[i] = Point2D(sd[0], sd[1] * (blends[0] + blends[2]) + s1 * blends[1]
+                     + (1.0 - s_1) * blends[3]);
+    ds[i] = raw_ds[i];
+    dd[i] = raw_dd[i] * (blends[0] + blends[2]) + (dblends[0] + dblends[2]) * sd[1]
+      + ds1 * blends[1] + dblends[1] * s1 - ds_1 * blends[3] + dblends[3] * (1.0 - s_1);
+  }
 }
 
 } // namespace Transfinite
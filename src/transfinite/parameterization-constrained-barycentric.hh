@@ -7,7 +7,18 @@ namespace Transfinite {
 class ParameterizationConstrainedBarycentric : public ParameterizationBarycentric {
 public:
   virtual ~ParameterizationConstrainedBarycentric();
-  virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
+  virtual std::shared_ptr<Parameterization> clone() const override;
+  virtual void mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                       Vector2D *ds, Vector2D *dd) const override;
+
+protected:
+  virtual Point2D ribbonParameters(size_t i, const Point2D &uv, const double *l) const override;
+  // Both map all sides from one set of barycentric coordinates per point
+  virtual void mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const override;
+  virtual void mapToRibbonsBlock(const Point2D *uvs, size_t size, Point2D *sds) const override;
+
+private:
+  void constrainedRibbons(const Point2D &uv, const double *l, Point2D *sds) const;
 };
 
 } // namespace Transfinite
@@ -9,6 +9,11 @@ namespace Transfinite {
 ParameterizationInterconnected::~ParameterizationInterconnected() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationInterconnected::clone() const {
+  return std::make_shared<ParameterizationInterconnected>(*this);
+}
+
 Point2D
 ParameterizationInterconnected::mapToRibbon(size_t i, const Point2D &uv) const {
   double s_prev = ParameterizationBilinear::mapToRibbon(prev(i), uv)[0];
@@ -19,14 +24,29 @@ ParameterizationInterconnected::mapToRibbon(size_t i, const Point2D &uv) const {
   return sd;
 }
 
-Point2DVector
-ParameterizationInterconnected::mapToRibbons(const Point2D &uv) const {
-  Point2DVector sds = ParameterizationBilinear::mapToRibbons(uv);
+void
+ParameterizationInterconnected::mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const {
+  ParameterizationBilinear::mapToRibbonsUncached(uv, sds);
+  for (size_t i = 0; i < n_; ++i) {
+    double Hs = hermite(0, sds[i][0]);
+    sds[i][1] = (1.0 - sds[prev(i)][0]) * Hs + sds[next(i)][0] * (1.0 - Hs);
+  }
+}
+
+void
+ParameterizationInterconnected::mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                                        Vector2D *ds, Vector2D *dd) const {
+  if (!bilinearDerivatives(uv, sds, ds, dd)) {
+    Parameterization::mapToRibbonsDerivatives(uv, sds, ds, dd);
+    return;
+  }
   for (size_t i = 0; i < n_; ++i) {
     double Hs = hermite(0, sds[i][0]);
+    double dHs = hermiteDerivative(0, sds[i][0]);
     sds[i][1] = (1.0 - sds[prev(i)][0]) * Hs + sds[next(i)][0] * (1.0 - Hs);
+    dd[i] = ds[next(i)] * (1.0 - Hs) - ds[prev(i)] * Hs
+      + ds[i] * ((1.0 - sds[prev(i)][0] - sds[next(i)][0]) * dHs);
   }
-  return sds;
 }
 
 } // namespace Transfinite
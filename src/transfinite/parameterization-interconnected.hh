@@ -7,8 +7,13 @@ namespace Transfinite {
 class ParameterizationInterconnected : public ParameterizationBilinear {
 public:
   virtual ~ParameterizationInterconnected();
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
-  virtual Point2DVector mapToRibbons(const Point2D &uv) const override;
+  virtual void mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                       Vector2D *ds, Vector2D *dd) const override;
+
+protected:
+  virtual void mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const override;
 };
 
 } // namespace Transfinite
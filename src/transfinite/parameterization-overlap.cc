@@ -7,12 +7,17 @@ namespace Transfinite {
 ParameterizationOverlap::~ParameterizationOverlap() {
 }
 
-Point2D ParameterizationOverlap::mapToRibbon(size_t i, const Point2D &uv) const {
+std::shared_ptr<Parameterization>
+ParameterizationOverlap::clone() const {
+  return std::make_shared<ParameterizationOverlap>(*this);
+}
+
+Point2D ParameterizationOverlap::ribbonParameters(size_t i, const Point2D &,
+                                                  const double *l) const {
   assert(n_ % 2 == 0);
-  auto bc = barycentric(uv);
   double result = 0.0;
   for (size_t j = 0; j < n_ / 2; ++j)
-    result += bc[(i+j)%n_];
+    result += l[(i+j)%n_];
   return { result, 0.0 };
 }
 
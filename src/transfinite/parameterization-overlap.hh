@@ -7,7 +7,10 @@ namespace Transfinite {
 class ParameterizationOverlap : public ParameterizationBarycentric {
 public:
   virtual ~ParameterizationOverlap();
-  virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
+  virtual std::shared_ptr<Parameterization> clone() const override;
+
+protected:
+  virtual Point2D ribbonParameters(size_t i, const Point2D &uv, const double *l) const override;
 };
 
 } // namespace Transfinite
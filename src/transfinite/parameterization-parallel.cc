@@ -8,10 +8,21 @@ namespace Transfinite {
 ParameterizationParallel::~ParameterizationParallel() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationParallel::clone() const {
+  return std::make_shared<ParameterizationParallel>(*this);
+}
+
 Point2D
 ParameterizationParallel::mapToRibbon(size_t i, const Point2D &uv) const {
-  Point2D sd = ParameterizationBilinear::mapToRibbon(i, uv);
-  sd[1] = domain_->toLocal(i, uv - domain_->vertices()[i])[1] * multipliers_[i];
+  return mapLocal(i, domain_->toLocal(i, uv - domain_->vertices()[prev(i)]));
+}
+
+Point2D
+ParameterizationParallel::mapLocal(size_t i, const Point2D &p) const {
+  // The distance from the line of side i is the same from either end of the side
+  Point2D sd = bilinearLocal(i, p);
+  sd[1] = p[1] * multipliers_[i];
   return sd;
 }
 
@@ -9,13 +9,22 @@ namespace Transfinite {
 ParameterizationPerpPolar::~ParameterizationPerpPolar() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationPerpPolar::clone() const {
+  return std::make_shared<ParameterizationPerpPolar>(*this);
+}
+
 Point2D
 ParameterizationPerpPolar::mapToRibbon(size_t i, const Point2D &uv) const {
+  return mapLocal(i, uv, domain_->toLocal(i, uv - domain_->vertices()[prev(i)]));
+}
+
+Point2D
+ParameterizationPerpPolar::mapLocal(size_t i, const Point2D &uv, const Point2D &p) const {
   Point2DVector const &vertices = domain_->vertices();
 
   const Point2D &base = vertices[prev(i)];
 
-  Point2D p = domain_->toLocal(i, uv - base);
   if (p[0] >= 0 && p[0] <= 1)
     return p;
 
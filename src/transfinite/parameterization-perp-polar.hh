@@ -7,7 +7,10 @@ namespace Transfinite {
 class ParameterizationPerpPolar : public Parameterization {
 public:
   virtual ~ParameterizationPerpPolar();
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
+  // The mapping of side i, given p = domain_->toLocal(i, uv - domain_->vertices()[prev(i)])
+  Point2D mapLocal(size_t i, const Point2D &uv, const Point2D &p) const;
 };
 
 } // namespace Transfinite
@@ -11,52 +11,81 @@ ParameterizationPolar::ParameterizationPolar() :
 ParameterizationPolar::~ParameterizationPolar() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationPolar::clone() const {
+  return std::make_shared<ParameterizationPolar>(*this);
+}
+
 Point2D
-ParameterizationPolar::mapToRibbon(size_t i, const Point2D &uv) const {
+ParameterizationPolar::ribbonParameters(size_t i, const Point2D &uv, const double *l) const {
   Vector2D v1 = domain_->vertices()[prev(i)] - domain_->vertices()[i];
   Vector2D v2 = uv - domain_->vertices()[i];
   if (v2.norm() < epsilon)
     return Point2D(0.0, 1.0);
   double phi = std::acos(inrange(-1, v1.normalize() * v2.normalize(), 1));
-  return Point2D(phi / domain_->angle(i), barycentric(uv)[i]);
+  return Point2D(phi / domain_->angle(i), l[i]);
 }
 
 Point2D
 ParameterizationPolar::inverse(size_t i, const Point2D &pd) const {
-  if (pd[0] < epsilon)
-    return domain_->edgePoint(i, pd[1]);
-  else if (pd[0] > 1 - epsilon)
-    return domain_->edgePoint(next(i), 1 - pd[1]);
+  return inverse(i, pd[0], { pd[1] })[0];
+}
 
-  const size_t precision = 20;  // 2^-20 ~ 1e-6 precision
+Point2DVector
+ParameterizationPolar::inverse(size_t i, double s, const DoubleVector &ds) const {
+  if (s < epsilon || s > 1 - epsilon) {
+    Point2DVector result;
+    for (double d : ds)
+      result.push_back(s < epsilon ? domain_->edgePoint(i, d) : domain_->edgePoint(next(i), 1 - d));
+    return result;
+  }
 
   Vector2D v1 = domain_->vertices()[prev(i)] - domain_->vertices()[i];
   Vector2D v2 = domain_->vertices()[next(i)] - domain_->vertices()[i];
   v1.normalize(); v2.normalize();
-  double phi = pd[0] * domain_->angle(i);
+  double phi = s * domain_->angle(i);
   Vector2D v1p(v1[1], -v1[0]);
   if (v1p * v2 < -epsilon)
     v1p *= -1;
   Point2D p = domain_->vertices()[i], q;
   Vector2D d = v1 * cos(phi) + v1p * sin(phi);
 
-  // Intersect far sides with the sweepline
+  // Intersect far sides with the sweepline (once for all distances)
   for (size_t j = next(next(i)); j != i; j = next(j))
     if (domain_->intersectEdgeWithRay(j, p, d, q))
       break;
 
-  double lo = 0, hi = 1;
-  Point2D next;
-  for (size_t k = 0; k < precision; ++k) {
-    double mid = (lo + hi) / 2;
-    next = p * (1 - mid) + q * mid;
-    if (mapToRibbon(i, next)[1] > pd[1])
-      lo = mid;
-    else
-      hi = mid;
+  // Along the sweepline the distance parameter (the i-th barycentric coordinate) decreases
+  // from 1 at p to 0 at q; its root is found by the Illinois variant of regula falsi
+  // (the bracket always has flo > 0 > fhi, so the secant step stays inside)
+  const size_t max_iterations = 50;
+  const double tolerance = 1.0e-10;
+  Point2DVector result;
+  for (double target : ds) {
+    auto f = [&](double t) { return barycentric(p * (1 - t) + q * t)[i] - target; };
+    double lo = 0, hi = 1, flo = 1 - target, fhi = -target;
+    double t = 0.5;
+    int side = 0;
+    for (size_t k = 0; k < max_iterations && hi - lo > tolerance; ++k) {
+      t = lo + (hi - lo) * flo / (flo - fhi);
+      double ft = f(t);
+      if (std::abs(ft) < tolerance)
+        break;
+      if (ft > 0) {
+        lo = t; flo = ft;
+        if (side == 1)
+          fhi /= 2;
+        side = 1;
+      } else {
+        hi = t; fhi = ft;
+        if (side == -1)
+          flo /= 2;
+        side = -1;
+      }
+    }
+    result.push_back(p * (1 - t) + q * t);
   }
-
-  return next;
+  return result;
 }
 
 } // namespace Transfinite
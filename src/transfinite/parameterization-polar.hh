@@ -8,8 +8,13 @@ class ParameterizationPolar : public ParameterizationBarycentric {
 public:
   ParameterizationPolar();
   virtual ~ParameterizationPolar();
-  virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const override;
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual Point2D inverse(size_t i, const Point2D &pd) const override;
+  // Inverses of (s, d) for all d in ds, sharing the sweepline of s
+  Point2DVector inverse(size_t i, double s, const DoubleVector &ds) const;
+
+protected:
+  virtual Point2D ribbonParameters(size_t i, const Point2D &uv, const double *l) const override;
 };
 
 } // namespace Transfinite
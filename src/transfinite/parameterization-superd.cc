@@ -8,6 +8,11 @@ namespace Transfinite {
 ParameterizationSuperD::~ParameterizationSuperD() {
 }
 
+std::shared_ptr<Parameterization>
+ParameterizationSuperD::clone() const {
+  return std::make_shared<ParameterizationSuperD>(*this);
+}
+
 void
 ParameterizationSuperD::updateMultipliers() { // assumes regular domain
   const Point2DVector &v = domain_->vertices();
@@ -7,6 +7,7 @@ namespace Transfinite {
 class ParameterizationSuperD : public ParameterizationParallel {
 public:
   virtual ~ParameterizationSuperD();
+  virtual std::shared_ptr<Parameterization> clone() const override;
   virtual void updateMultipliers() override;
 };
 
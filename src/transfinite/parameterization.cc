@@ -1,11 +1,27 @@
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <stdexcept>
+#include <typeinfo>
 
 #include "domain.hh"
+#include "locator.hh"
 #include "parameterization.hh"
+#include "profiler.hh"
 
 namespace Transfinite {
 
+Parameterization::Parameterization(const Parameterization &other)
+  : n_(other.n_), domain_(other.domain_), approximation_(other.approximation_),
+    domain_revision_(other.domain_revision_) {
+  {
+    std::lock_guard<std::mutex> lock(other.tables_mutex_);
+    tables_ = other.tables_;
+  }
+  std::lock_guard<std::mutex> lock(other.approximation_mutex_);
+  approximation_data_ = other.approximation_data_;
+}
+
 Parameterization::~Parameterization() {
 }
 
@@ -17,21 +33,224 @@ Parameterization::setDomain(const std::shared_ptr<Domain> &new_domain) {
 void
 Parameterization::update() {
   n_ = domain_->vertices().size();
+  domain_revision_ = domain_->revision();
   cache_.clear();
+  {
+    std::lock_guard<std::mutex> lock(tables_mutex_);
+    tables_.clear();
+  }
+  std::lock_guard<std::mutex> lock(approximation_mutex_);
+  approximation_data_.reset();
+}
+
+uint64_t
+Parameterization::domainRevision() const {
+  return domain_revision_;
 }
 
-Point2DVector
+bool
+Parameterization::sameMapping(const Parameterization &other) const {
+  if (typeid(*this) != typeid(other))
+    return false;
+  std::string key = tableKey();
+  return !key.empty() && key == other.tableKey();
+}
+
+std::shared_ptr<const Point2DVector>
 Parameterization::mapToRibbons(const Point2D &uv) const {
-  auto cached = cache_.find(uv);
-  if (cached != cache_.end())
-    return cached->second;
+  if (approximation_ > 0) {
+    auto result = std::make_shared<Point2DVector>(n_);
+    approximate(uv, result->data());
+    return result;
+  }
+  if (auto cached = cache_.find(uv))
+    return cached;
+  Point2DVector result(n_);
+  mapToRibbonsUncached(uv, result.data());
+  return cache_.insert(uv, std::move(result));
+}
+
+void
+Parameterization::mapToRibbons(const Point2D *uvs, size_t size, Point2D *sds) const {
+  mapToRibbonsBlock(uvs, size, sds);
+}
+
+// Tables of curve-independent domains, by domain type, size, tableKey() and resolution
+namespace {
+
+  struct SharedTables {
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const ParameterTable>> tables;
+  };
+
+  SharedTables &sharedTables() {
+    static SharedTables registry;
+    return registry;
+  }
+
+}
+
+std::shared_ptr<const ParameterTable>
+Parameterization::parameterTable(size_t resolution, const Executor &executor) const {
+  std::lock_guard<std::mutex> lock(tables_mutex_);
+  auto &table = tables_[resolution];
+  if (table)
+    return table;
+
+  std::string key;
+  if (domain_->curveIndependent()) {
+    key = tableKey();
+    if (!key.empty())
+      key = Profiler::typeName(typeid(*domain_)) + "/" + std::to_string(n_) + "/" + key + "/" +
+        std::to_string(resolution);
+  }
+  if (!key.empty()) {
+    SharedTables &shared = sharedTables();
+    std::lock_guard<std::mutex> shared_lock(shared.mutex);
+    auto it = shared.tables.find(key);
+    if (it != shared.tables.end() && (table = it->second.lock()))
+      return table;
+  }
+
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  auto result = std::make_shared<ParameterTable>();
+  result->n = n_;
+  result->sds.resize(uvs.size() * n_);
+  executor(uvs.size(), [&](size_t begin, size_t end) {
+    mapToRibbonsBlock(&uvs[begin], end - begin, &result->sds[begin * n_]);
+  });
+  table = result;
+
+  if (!key.empty()) {
+    // Another thread may have computed the same table meanwhile; then that one is kept
+    SharedTables &shared = sharedTables();
+    std::lock_guard<std::mutex> shared_lock(shared.mutex);
+    for (auto it = shared.tables.begin(); it != shared.tables.end(); )
+      if (it->second.expired() && it->first != key)
+        it = shared.tables.erase(it);
+      else
+        ++it;
+    auto &entry = shared.tables[key];
+    if (auto existing = entry.lock())
+      table = existing;
+    else
+      entry = table;
+  }
+  return table;
+}
+
+std::string
+Parameterization::tableKey() const {
+  return Profiler::typeName(typeid(*this));
+}
+
+void
+Parameterization::setParameterTable(size_t resolution,
+                                    std::shared_ptr<const ParameterTable> table) const {
+  if (table->n != n_ || table->sds.size() != domain_->parameters(resolution).size() * n_)
+    throw std::invalid_argument("parameter table does not match the domain");
+  std::lock_guard<std::mutex> lock(tables_mutex_);
+  tables_[resolution] = std::move(table);
+}
 
-  Point2DVector result; result.reserve(n_);
+void
+Parameterization::mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                          Vector2D *ds, Vector2D *dd) const {
+  static const double step = 1.0e-5;
+  thread_local Point2DVector plus, minus;
+  plus.resize(n_); minus.resize(n_);
+  mapToRibbonsUncached(uv, sds);
+  for (size_t k = 0; k < 2; ++k) {
+    Vector2D h(0, 0);
+    h[k] = step;
+    mapToRibbonsUncached(uv + h, plus.data());
+    mapToRibbonsUncached(uv - h, minus.data());
+    for (size_t i = 0; i < n_; ++i) {
+      ds[i][k] = (plus[i][0] - minus[i][0]) / (2.0 * step);
+      dd[i][k] = (plus[i][1] - minus[i][1]) / (2.0 * step);
+    }
+  }
+}
+
+void
+Parameterization::mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const {
   for (size_t i = 0; i < n_; ++i)
-    result.push_back(mapToRibbon(i, uv));
+    sds[i] = mapToRibbon(i, uv);
+}
+
+void
+Parameterization::mapToRibbonsBlock(const Point2D *uvs, size_t size, Point2D *sds) const {
+  for (size_t j = 0; j < size; ++j)
+    mapToRibbonsUncached(uvs[j], sds + j * n_);
+}
+
+CacheStatistics
+Parameterization::cacheStatistics() const {
+  return cache_.statistics();
+}
+
+void
+Parameterization::setCacheLimit(size_t points) {
+  cache_.setLimit(points);
+}
+
+void
+Parameterization::setApproximation(size_t resolution) {
+  approximation_ = resolution;
+  std::lock_guard<std::mutex> lock(approximation_mutex_);
+  approximation_data_.reset();
+}
+
+size_t
+Parameterization::approximation() const {
+  return approximation_;
+}
 
-  cache_[uv] = result;
-  return result;
+double
+Parameterization::approximationError() const {
+  if (approximation_ == 0)
+    return 0.0;
+  auto shared_indices = domain_->meshIndices(approximation_);
+  const auto &indices = *shared_indices;
+  auto shared_uvs = domain_->sharedParameters(approximation_);
+  const Point2DVector &uvs = *shared_uvs;
+  Point2DVector exact(n_), approximated(n_);
+  double error = 0.0;
+  for (size_t k = 0; k < indices.size(); k += 3) {
+    Point2D centroid = (uvs[indices[k]] + uvs[indices[k+1]] + uvs[indices[k+2]]) / 3.0;
+    mapToRibbonsUncached(centroid, exact.data());
+    approximate(centroid, approximated.data());
+    for (size_t i = 0; i < n_; ++i)
+      for (size_t j = 0; j < 2; ++j)
+        error = std::max(error, std::abs(exact[i][j] - approximated[i][j]));
+  }
+  return error;
+}
+
+// Built at the first approximated query after an update
+std::shared_ptr<const Parameterization::Approximation>
+Parameterization::approximationData() const {
+  std::lock_guard<std::mutex> lock(approximation_mutex_);
+  if (!approximation_data_) {
+    TRANSFINITE_TIMER("Parameterization::approximationData");
+    auto data = std::make_shared<Approximation>();
+    data->locator = domain_->locator(approximation_);
+    data->table = parameterTable(approximation_);
+    approximation_data_ = data;
+  }
+  return approximation_data_;
+}
+
+void
+Parameterization::approximate(const Point2D &uv, Point2D *sds) const {
+  auto data = approximationData();
+  std::array<double, 3> bary;
+  const auto &triangle = data->locator->locate(uv, bary);
+  const Point2D *a = data->table->row(triangle[0]), *b = data->table->row(triangle[1]),
+    *c = data->table->row(triangle[2]);
+  for (size_t i = 0; i < n_; ++i)
+    sds[i] = a[i] * bary[0] + b[i] * bary[1] + c[i] * bary[2];
 }
 
 Point2D
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <map>
+#include <mutex>
+#include <string>
 
+#include "cache.hh"
+#include "executor.hh"
 #include "geometry.hh"
 
 namespace Transfinite {
@@ -9,22 +13,72 @@ namespace Transfinite {
 using namespace Geometry;
 
 class Domain;
+class TriangleLocator;
+
+// Ribbon parameters of all sides at the points of Domain::parameters(resolution),
+// stored contiguously: row j holds the n mapped points of the j-th domain point.
+struct ParameterTable {
+  size_t n;
+  Point2DVector sds;
+  const Point2D *row(size_t j) const { return &sds[j * n]; }
+};
 
 class Parameterization {
 public:
+  Parameterization() = default;
+  // Copies share the domain and the parameter tables (but not the cache of mapToRibbons)
+  Parameterization(const Parameterization &other);
   virtual ~Parameterization();
+  Parameterization &operator=(const Parameterization &) = delete;
+  virtual std::shared_ptr<Parameterization> clone() const = 0;
   void setDomain(const std::shared_ptr<Domain> &new_domain);
   virtual void update();
+  // Domain::revision() as of the last update (0 before the first one); differs from that of
+  // the domain after its change, or after setDomain with a different domain
+  uint64_t domainRevision() const;
+  // True when the two compute the same mapping on the same domain, i.e. they have the same type
+  // and tableKey() (not empty), so one can be used in place of the other (see Surface::shareDomain)
+  bool sameMapping(const Parameterization &other) const;
   virtual Point2D mapToRibbon(size_t i, const Point2D &uv) const = 0;
-  virtual Point2DVector mapToRibbons(const Point2D &uv) const;
+  // Cached; the result stays valid after the cache is cleared or evicted
+  // (approximated, when set by setApproximation)
+  std::shared_ptr<const Point2DVector> mapToRibbons(const Point2D &uv) const;
+  // Maps `size` points without caching, storing the results like the rows of ParameterTable
+  void mapToRibbons(const Point2D *uvs, size_t size, Point2D *sds) const;
+  // Cached until the next update; with a curve-independent domain (see Domain::curveIndependent),
+  // the tables are also shared by all parameterizations with the same tableKey() and domain type
+  // and size, in a process-wide registry (keeping them while any of them is in use)
+  std::shared_ptr<const ParameterTable>
+  parameterTable(size_t resolution, const Executor &executor = serialExecutor()) const;
+  // Stores a table computed elsewhere (e.g. loaded by PlanStore) as if computed by parameterTable;
+  // it should have a row for each point of Domain::parameters(resolution)
+  void setParameterTable(size_t resolution, std::shared_ptr<const ParameterTable> table) const;
+  // Maps uv without caching, also computing the gradients of the s (ds) and d (dd) parameters
+  // with respect to (u, v); by default these are approximated by central differences
+  virtual void mapToRibbonsDerivatives(const Point2D &uv, Point2D *sds,
+                                       Vector2D *ds, Vector2D *dd) const;
   virtual Point2D inverse(size_t i, const Point2D &pd) const;
+  // Approximates mapToRibbons(uv) by linear interpolation of parameterTable(resolution)
+  // in the triangles of the domain mesh (see Domain::locator), without the cache;
+  // 0 (the default) turns this off. Block mapping, tables and derivatives stay exact.
+  void setApproximation(size_t resolution);
+  size_t approximation() const;
+  // Largest deviation of the approximated parameters (s or d) from the exact ones at the centroids
+  // of the mesh triangles, mapping them on each call (0 without approximation)
+  double approximationError() const;
+  // Statistics of the point caches (of mapToRibbons, and those of subclasses)
+  virtual CacheStatistics cacheStatistics() const;
+  // Limits each point cache to about `points` entries (0 means unlimited, the default)
+  virtual void setCacheLimit(size_t points);
 
 protected:
-  struct PointComparator {
-    bool operator()(const Point2D &p, const Point2D &q) const {
-      return p[0] < q[0] || (p[0] == q[0] && p[1] < q[1]);
-    }
-  };
+  // Identifies the mapping for the shared tables of parameterTable(); the type name by default.
+  // Subclasses with settings should add them, or return an empty string to opt out.
+  virtual std::string tableKey() const;
+  // Computes the n values of mapToRibbons(uv) into sds, without caching
+  virtual void mapToRibbonsUncached(const Point2D &uv, Point2D *sds) const;
+  // The same for a block of points, as in mapToRibbons(uvs, size, sds)
+  virtual void mapToRibbonsBlock(const Point2D *uvs, size_t size, Point2D *sds) const;
 
   size_t next(size_t i, size_t j = 1) const { return (i + j) % n_; }
   size_t prev(size_t i, size_t j = 1) const { return (i + n_ - j) % n_; }
@@ -33,8 +87,20 @@ protected:
   std::shared_ptr<Domain> domain_;
 
 private:
-  using ParameterCache = std::map<Point2D, Point2DVector, PointComparator>;
-  mutable ParameterCache cache_;
+  struct Approximation {
+    std::shared_ptr<const TriangleLocator> locator;
+    std::shared_ptr<const ParameterTable> table;
+  };
+  std::shared_ptr<const Approximation> approximationData() const;
+  void approximate(const Point2D &uv, Point2D *sds) const;
+
+  mutable PointCache<Point2DVector> cache_;
+  mutable std::map<size_t, std::shared_ptr<const ParameterTable>> tables_;
+  mutable std::mutex tables_mutex_;
+  size_t approximation_ = 0;
+  mutable std::shared_ptr<const Approximation> approximation_data_; // until the next update
+  mutable std::mutex approximation_mutex_;
+  uint64_t domain_revision_ = 0;
 };
 
 } // namespace Transfinite
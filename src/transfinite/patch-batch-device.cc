@@ -0,0 +1,188 @@
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "patch-batch-device.hh"
+
+namespace Transfinite {
+
+namespace {
+
+  template<typename T>
+  T *allocate(size_t count, int device) {
+    void *result = omp_target_alloc(std::max<size_t>(count, 1) * sizeof(T), device);
+    if (!result)
+      throw std::runtime_error("cannot allocate device memory");
+    return static_cast<T *>(result);
+  }
+
+  template<typename T>
+  void upload(T *target, const T *source, size_t count, int device) {
+    if (count > 0 &&
+        omp_target_memcpy(target, const_cast<T *>(source), count * sizeof(T), 0, 0,
+                          device, omp_get_initial_device()) != 0)
+      throw std::runtime_error("cannot copy to the device");
+  }
+
+  template<typename T>
+  void release(T *&data, int device) {
+    if (data)
+      omp_target_free(data, device);
+    data = nullptr;
+  }
+
+}
+
+PatchBatchDevice::PatchBatchDevice(const PatchBatch &batch, int device)
+  : batch_(batch), size_(batch.vertexOffsets().back()),
+    triangle_count_(batch.triangles().size() / 3),
+    row_offsets_(nullptr), incidence_offsets_(nullptr), indices_(nullptr), triangles_(nullptr),
+    incidence_(nullptr), blends_(nullptr), cps_(nullptr), positions_(nullptr),
+    face_normals_(nullptr), points_(nullptr), normals_(nullptr) {
+  if (device < 0)
+    device = omp_get_num_devices() > 0 ? omp_get_default_device() : omp_get_initial_device();
+  device_ = device;
+  try {
+    const auto &row_offsets = batch.rowOffsets(), &incidence_offsets = batch.incidenceOffsets();
+    const auto &indices = batch.indices(), &triangles = batch.triangles();
+    const auto &incidence = batch.incidence();
+    const auto &blends = batch.blends();
+    row_offsets_ = allocate<size_t>(row_offsets.size(), device_);
+    incidence_offsets_ = allocate<size_t>(incidence_offsets.size(), device_);
+    indices_ = allocate<uint32_t>(indices.size(), device_);
+    triangles_ = allocate<uint32_t>(triangles.size(), device_);
+    incidence_ = allocate<uint32_t>(incidence.size(), device_);
+    blends_ = allocate<double>(blends.size(), device_);
+    cps_ = allocate<double>(3 * batch.controlPoints().size(), device_);
+    positions_ = allocate<double>(3 * size_, device_);
+    face_normals_ = allocate<double>(3 * triangle_count_, device_);
+    points_ = allocate<float>(3 * size_, device_);
+    normals_ = allocate<float>(3 * size_, device_);
+    upload(row_offsets_, row_offsets.data(), row_offsets.size(), device_);
+    upload(incidence_offsets_, incidence_offsets.data(), incidence_offsets.size(), device_);
+    upload(indices_, indices.data(), indices.size(), device_);
+    upload(triangles_, triangles.data(), triangles.size(), device_);
+    upload(incidence_, incidence.data(), incidence.size(), device_);
+    upload(blends_, blends.data(), blends.size(), device_);
+    updateControlPoints();
+  } catch (...) {
+    releaseAll();
+    throw;
+  }
+}
+
+PatchBatchDevice::~PatchBatchDevice() {
+  releaseAll();
+}
+
+void
+PatchBatchDevice::releaseAll() {
+  release(row_offsets_, device_);
+  release(incidence_offsets_, device_);
+  release(indices_, device_);
+  release(triangles_, device_);
+  release(incidence_, device_);
+  release(blends_, device_);
+  release(cps_, device_);
+  release(positions_, device_);
+  release(face_normals_, device_);
+  release(points_, device_);
+  release(normals_, device_);
+}
+
+int
+PatchBatchDevice::device() const {
+  return device_;
+}
+
+// The control points are flattened on the host, as the layout of Point3D is not known
+void
+PatchBatchDevice::updateControlPoints() {
+  const PointVector &cps = batch_.controlPoints();
+  std::vector<double> flat(3 * cps.size());
+  for (size_t i = 0; i < cps.size(); ++i)
+    for (size_t k = 0; k < 3; ++k)
+      flat[3 * i + k] = cps[i][k];
+  upload(cps_, flat.data(), flat.size(), device_);
+}
+
+// The same passes as PatchBatch::eval, on plain arrays (is_device_ptr needs local pointers)
+void
+PatchBatchDevice::eval() {
+  size_t size = size_, triangle_count = triangle_count_;
+  const size_t *row_offsets = row_offsets_, *incidence_offsets = incidence_offsets_;
+  const uint32_t *indices = indices_, *triangles = triangles_, *incidence = incidence_;
+  const double *blends = blends_, *cps = cps_;
+  double *positions = positions_, *face_normals = face_normals_;
+  float *points = points_, *normals = normals_;
+
+#pragma omp target teams distribute parallel for device(device_) \
+  is_device_ptr(row_offsets, indices, blends, cps, positions, points)
+  for (size_t i = 0; i < size; ++i) {
+    double p[3] = { 0.0, 0.0, 0.0 };
+    for (size_t j = row_offsets[i]; j < row_offsets[i+1]; ++j)
+      for (size_t k = 0; k < 3; ++k)
+        p[k] += cps[3 * indices[j] + k] * blends[j];
+    for (size_t k = 0; k < 3; ++k) {
+      positions[3 * i + k] = p[k];
+      points[3 * i + k] = static_cast<float>(p[k]);
+    }
+  }
+
+#pragma omp target teams distribute parallel for device(device_) \
+  is_device_ptr(triangles, positions, face_normals)
+  for (size_t i = 0; i < triangle_count; ++i) {
+    const double *a = &positions[3 * triangles[3 * i]];
+    const double *b = &positions[3 * triangles[3 * i + 1]];
+    const double *c = &positions[3 * triangles[3 * i + 2]];
+    double u[3], v[3];
+    for (size_t k = 0; k < 3; ++k) {
+      u[k] = b[k] - a[k];
+      v[k] = c[k] - a[k];
+    }
+    face_normals[3 * i] = u[1] * v[2] - u[2] * v[1];
+    face_normals[3 * i + 1] = u[2] * v[0] - u[0] * v[2];
+    face_normals[3 * i + 2] = u[0] * v[1] - u[1] * v[0];
+  }
+
+#pragma omp target teams distribute parallel for device(device_) \
+  is_device_ptr(incidence_offsets, incidence, face_normals, normals)
+  for (size_t i = 0; i < size; ++i) {
+    double n[3] = { 0.0, 0.0, 0.0 };
+    for (size_t j = incidence_offsets[i]; j < incidence_offsets[i+1]; ++j)
+      for (size_t k = 0; k < 3; ++k)
+        n[k] += face_normals[3 * incidence[j] + k];
+    double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.0)
+      for (size_t k = 0; k < 3; ++k)
+        n[k] /= length;
+    for (size_t k = 0; k < 3; ++k)
+      normals[3 * i + k] = static_cast<float>(n[k]);
+  }
+}
+
+const float *
+PatchBatchDevice::points() const {
+  return points_;
+}
+
+const float *
+PatchBatchDevice::normals() const {
+  return normals_;
+}
+
+void
+PatchBatchDevice::download(std::vector<float> &points, std::vector<float> &normals) const {
+  points.resize(3 * size_);
+  normals.resize(3 * size_);
+  if (size_ > 0 &&
+      (omp_target_memcpy(points.data(), points_, points.size() * sizeof(float), 0, 0,
+                         omp_get_initial_device(), device_) != 0 ||
+       omp_target_memcpy(normals.data(), normals_, normals.size() * sizeof(float), 0, 0,
+                         omp_get_initial_device(), device_) != 0))
+    throw std::runtime_error("cannot copy from the device");
+}
+
+} // namespace Transfinite
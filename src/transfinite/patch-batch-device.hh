@@ -0,0 +1,45 @@
+#pragma once
+
+#include "patch-batch.hh"
+
+namespace Transfinite {
+
+// Evaluation of a PatchBatch on an accelerator, by OpenMP target offload
+// (compiled only with the TRANSFINITE_OFFLOAD CMake option; the offload target is given by
+// TRANSFINITE_OFFLOAD_FLAGS, e.g. -foffload=nvptx-none for GCC).
+// The flat arrays of the batch are uploaded once, the control points again by
+// updateControlPoints(), and eval() runs the three passes of PatchBatch::eval on the device.
+// The points and normals stay in device buffers (for a renderer sharing the device memory),
+// and are copied back only by download(). Without an offload device the host is used.
+// The batch should outlive this object, and should not get new patches meanwhile.
+class PatchBatchDevice {
+public:
+  // A negative device means the default device (or the host, when there is none)
+  explicit PatchBatchDevice(const PatchBatch &batch, int device = -1);
+  ~PatchBatchDevice();
+  PatchBatchDevice(const PatchBatchDevice &) = delete;
+  PatchBatchDevice &operator=(const PatchBatchDevice &) = delete;
+
+  int device() const;
+  // Uploads the current control points of the batch (see PatchBatch::updateControlPoints)
+  void updateControlPoints();
+  void eval();
+  // Device pointers to x, y, z of each vertex, and to the unit vertex normals
+  const float *points() const;
+  const float *normals() const;
+  // Copies the results of the last eval() to the host, laid out as by PatchBatch::eval
+  void download(std::vector<float> &points, std::vector<float> &normals) const;
+
+private:
+  void releaseAll();
+
+  const PatchBatch &batch_;
+  int device_;
+  size_t size_, triangle_count_;
+  size_t *row_offsets_, *incidence_offsets_;
+  uint32_t *indices_, *triangles_, *incidence_;
+  double *blends_, *cps_, *positions_, *face_normals_;
+  float *points_, *normals_;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,148 @@
+#include <limits>
+#include <stdexcept>
+
+#include "domain.hh"
+#include "patch-batch.hh"
+
+namespace Transfinite {
+
+PatchBatch::PatchBatch(size_t resolution, const Executor &executor)
+  : resolution_(resolution), executor_(executor), vertex_offsets_(1, 0), cp_offsets_(1, 0),
+    row_offsets_(1, 0), incidence_offsets_(1, 0) {
+}
+
+size_t
+PatchBatch::add(const std::shared_ptr<const SurfaceGeneralizedBezier> &surface) {
+  auto matrix = surface->blendMatrix(resolution_);
+  PointVector cps = surface->controlPoints();
+  TriMesh mesh = surface->domain()->meshTopology(resolution_);
+  size_t first = vertex_offsets_.back(), size = matrix->offsets.size() - 1;
+  size_t cp_first = cp_offsets_.back(), triangle_first = triangles_.size() / 3;
+  const size_t limit = std::numeric_limits<uint32_t>::max();
+  if (first + size > limit || cp_first + cps.size() > limit ||
+      triangle_first + mesh.triangles().size() > limit)
+    throw std::length_error("too many vertices for 32-bit indices");
+
+  size_t base = row_offsets_.back();
+  for (size_t i = 1; i <= size; ++i)
+    row_offsets_.push_back(base + matrix->offsets[i]);
+  for (uint32_t j : matrix->indices)
+    indices_.push_back(static_cast<uint32_t>(cp_first + j));
+  blends_.insert(blends_.end(), matrix->blends.begin(), matrix->blends.end());
+  cps_.insert(cps_.end(), cps.begin(), cps.end());
+
+  // The triangles of this patch refer only to its own vertices
+  std::vector<std::vector<uint32_t>> around(size);
+  size_t t = triangle_first;
+  for (const auto &tri : mesh.triangles()) {
+    for (size_t i : tri) {
+      triangles_.push_back(static_cast<uint32_t>(first + i));
+      around[i].push_back(static_cast<uint32_t>(t));
+    }
+    ++t;
+  }
+  for (const auto &triangles : around) {
+    incidence_.insert(incidence_.end(), triangles.begin(), triangles.end());
+    incidence_offsets_.push_back(incidence_.size());
+  }
+
+  vertex_offsets_.push_back(first + size);
+  cp_offsets_.push_back(cp_first + cps.size());
+  surfaces_.push_back(surface);
+  return surfaces_.size() - 1;
+}
+
+size_t
+PatchBatch::size() const {
+  return surfaces_.size();
+}
+
+void
+PatchBatch::updateControlPoints() {
+  for (size_t i = 0; i < surfaces_.size(); ++i) {
+    PointVector cps = surfaces_[i]->controlPoints();
+    if (cps.size() != cp_offsets_[i+1] - cp_offsets_[i])
+      throw std::logic_error("the control network of a batched patch has changed");
+    std::copy(cps.begin(), cps.end(), cps_.begin() + cp_offsets_[i]);
+  }
+}
+
+const std::vector<size_t> &
+PatchBatch::vertexOffsets() const {
+  return vertex_offsets_;
+}
+
+const std::vector<size_t> &
+PatchBatch::rowOffsets() const {
+  return row_offsets_;
+}
+
+const std::vector<uint32_t> &
+PatchBatch::indices() const {
+  return indices_;
+}
+
+const DoubleVector &
+PatchBatch::blends() const {
+  return blends_;
+}
+
+const PointVector &
+PatchBatch::controlPoints() const {
+  return cps_;
+}
+
+const std::vector<uint32_t> &
+PatchBatch::triangles() const {
+  return triangles_;
+}
+
+const std::vector<size_t> &
+PatchBatch::incidenceOffsets() const {
+  return incidence_offsets_;
+}
+
+const std::vector<uint32_t> &
+PatchBatch::incidence() const {
+  return incidence_;
+}
+
+// The normals are computed from the double precision points
+void
+PatchBatch::eval(std::vector<float> &points, std::vector<float> &normals) const {
+  size_t size = vertex_offsets_.back(), triangle_count = triangles_.size() / 3;
+  PointVector positions(size);
+  points.resize(3 * size);
+  executor_(size, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Point3D p(0, 0, 0);
+      for (size_t j = row_offsets_[i]; j < row_offsets_[i+1]; ++j)
+        p += cps_[indices_[j]] * blends_[j];
+      positions[i] = p;
+      for (size_t k = 0; k < 3; ++k)
+        points[3 * i + k] = static_cast<float>(p[k]);
+    }
+  });
+
+  VectorVector face_normals(triangle_count);
+  executor_(triangle_count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t *t = &triangles_[3 * i];
+      face_normals[i] = (positions[t[1]] - positions[t[0]]) ^ (positions[t[2]] - positions[t[0]]);
+    }
+  });
+
+  normals.resize(3 * size);
+  executor_(size, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vector3D normal(0, 0, 0);
+      for (size_t j = incidence_offsets_[i]; j < incidence_offsets_[i+1]; ++j)
+        normal += face_normals[incidence_[j]];
+      normal.normalize();
+      for (size_t k = 0; k < 3; ++k)
+        normals[3 * i + k] = static_cast<float>(normal[k]);
+    }
+  });
+}
+
+} // namespace Transfinite
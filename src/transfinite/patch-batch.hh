@@ -0,0 +1,55 @@
+#pragma once
+
+#include "executor.hh"
+#include "surface-generalized-bezier.hh"
+
+namespace Transfinite {
+
+// Tessellation of many Generalized Bezier patches (with planned evaluation) in one pass.
+// The blend matrices (see SurfaceGeneralizedBezier::blendMatrix) and control points
+// of all patches are concatenated into flat arrays, with global vertex and control point indices,
+// so evaluating every patch is a single sparse matrix-vector product, followed by a pass
+// over the triangles and one over the vertices for the normals.
+// The passes run on the CPU, by the executor; see PatchBatchDevice for evaluating them
+// on an accelerator.
+// The vertices of the patches are not shared.
+class PatchBatch {
+public:
+  explicit PatchBatch(size_t resolution, const Executor &executor = threadExecutor());
+  // Returns the index of the patch; its domain should not change while it is in the batch,
+  // but its control points can be moved (see updateControlPoints)
+  size_t add(const std::shared_ptr<const SurfaceGeneralizedBezier> &surface);
+  size_t size() const;
+  // Reads the control points of all patches again
+  void updateControlPoints();
+
+  // The vertices of patch i are [vertexOffsets()[i], vertexOffsets()[i+1])
+  const std::vector<size_t> &vertexOffsets() const;
+  // Compressed rows as in BlendMatrix, for all vertices
+  const std::vector<size_t> &rowOffsets() const;
+  const std::vector<uint32_t> &indices() const;
+  const DoubleVector &blends() const;
+  const PointVector &controlPoints() const;
+  // Three indices for each triangle
+  const std::vector<uint32_t> &triangles() const;
+  // The triangles around vertex i are incidence()[incidenceOffsets()[i]..incidenceOffsets()[i+1])
+  const std::vector<size_t> &incidenceOffsets() const;
+  const std::vector<uint32_t> &incidence() const;
+
+  // Writes x, y, z of each vertex, and the unit vertex normals (weighted by triangle areas)
+  void eval(std::vector<float> &points, std::vector<float> &normals) const;
+
+private:
+  size_t resolution_;
+  Executor executor_;
+  std::vector<std::shared_ptr<const SurfaceGeneralizedBezier>> surfaces_;
+  std::vector<size_t> vertex_offsets_, cp_offsets_, row_offsets_;
+  std::vector<uint32_t> indices_, triangles_;
+  DoubleVector blends_;
+  PointVector cps_;
+  // Triangles around each vertex, in compressed rows
+  std::vector<size_t> incidence_offsets_;
+  std::vector<uint32_t> incidence_;
+};
+
+} // namespace Transfinite
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "domain.hh"
+#include "patch-model.hh"
+#include "ribbon.hh"
+#include "utilities.hh"
+
+namespace Transfinite {
+
+// Index of the vertices not on shared curves
+static const size_t none = std::numeric_limits<size_t>::max();
+
+PatchModel::PatchModel(const Executor &executor)
+  : executor_(executor) {
+}
+
+void
+PatchModel::setExecutor(const Executor &executor) {
+  executor_ = executor;
+}
+
+size_t
+PatchModel::addCurve(const std::shared_ptr<BSCurve> &curve) {
+  curves_.push_back(std::make_shared<BSCurve>(*curve));
+  curves_.back()->normalize();
+  return curves_.size() - 1;
+}
+
+size_t
+PatchModel::add(const std::shared_ptr<Surface> &surface) {
+  surface->setExecutor(serialExecutor());
+  patches_.push_back(surface);
+  sides_.emplace_back();
+  return patches_.size() - 1;
+}
+
+size_t
+PatchModel::add(const std::shared_ptr<Surface> &surface, const std::vector<size_t> &curves) {
+  // Each patch orients and normalizes its own copies in setupLoop()
+  CurveVector copies;
+  for (size_t c : curves)
+    copies.push_back(std::make_shared<BSCurve>(*curves_.at(c)));
+  surface->setCurves(copies);
+  add(surface);
+  sides_.back() = curves;
+  return patches_.size() - 1;
+}
+
+size_t
+PatchModel::size() const {
+  return patches_.size();
+}
+
+std::shared_ptr<Surface>
+PatchModel::patch(size_t i) const {
+  return patches_[i];
+}
+
+void
+PatchModel::setupLoop() {
+  executor_(patches_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      patches_[i]->setupLoop();
+      patches_[i]->update();
+    }
+  });
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  levels_.clear();
+}
+
+void
+PatchModel::update() {
+  executor_(patches_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      patches_[i]->update();
+  });
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  levels_.clear();
+}
+
+std::vector<TriMesh>
+PatchModel::eval(size_t resolution) const {
+  auto b = boundary(std::vector<size_t>(curves_.size(), resolution));
+  std::vector<TriMesh> result(patches_.size());
+  executor_(patches_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = patches_[i]->eval(resolution);
+      if (sides_[i].empty())
+        continue;
+      PointVector points = result[i].points();
+      auto indices = boundaryIndices(b, resolution, i);
+      for (size_t j = 0; j < points.size(); ++j)
+        if (indices[j] != none)
+          points[j] = b.points[indices[j]];
+      result[i].setPoints(points);
+    }
+  });
+  return result;
+}
+
+TriMesh
+PatchModel::evalCombined(size_t resolution) const {
+  return combine(eval(resolution), std::vector<size_t>(patches_.size(), resolution));
+}
+
+std::vector<size_t>
+PatchModel::levelOfDetail(const View &view, size_t min_resolution, size_t max_resolution) const {
+  if (min_resolution == 0 || max_resolution < min_resolution)
+    throw std::invalid_argument("invalid resolution range");
+  size_t max_level = 0;
+  while ((min_resolution << (max_level + 1)) <= max_resolution)
+    ++max_level;
+
+  const size_t samples = 16;  // for each boundary curve
+  std::vector<size_t> levels(patches_.size());
+  executor_(patches_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      // Bounding sphere and maximal curvature of the boundary
+      PointVector points;
+      double curvature = 0.0;
+      for (size_t j = 0, n = patches_[i]->domain()->size(); j < n; ++j) {
+        const auto &curve = *patches_[i]->ribbon(j)->curve();
+        for (size_t k = 0; k <= samples; ++k) {
+          Vector3D der[3];
+          evalCurve(curve, static_cast<double>(k) / samples, 2, der);
+          points.push_back(der[0]);
+          double speed = der[1].norm();
+          if (speed > epsilon)
+            curvature = std::max(curvature, (der[1] ^ der[2]).norm() / std::pow(speed, 3));
+        }
+      }
+      Point3D min = points.front(), max = min;
+      for (const auto &p : points)
+        for (size_t k = 0; k < 3; ++k) {
+          min[k] = std::min(min[k], p[k]);
+          max[k] = std::max(max[k], p[k]);
+        }
+      Point3D center = (min + max) / 2;
+      double radius = 0.0;
+      for (const auto &p : points)
+        radius = std::max(radius, (p - center).norm());
+
+      // c (2r / res)^2 / 8 <= tolerance * distance * pixel_angle
+      double distance = (view.eye - center).norm() - radius;
+      double error = view.tolerance * distance * view.pixel_angle;
+      size_t level = max_level;
+      if (error > 0.0) {
+        double resolution = 2 * radius * std::sqrt(curvature / (8 * error));
+        level = 0;
+        while (level < max_level && (min_resolution << level) < resolution)
+          ++level;
+      }
+      levels[i] = level;
+    }
+  });
+
+  // Neighbors at most one level apart, by raising the coarser ones
+  std::vector<std::vector<size_t>> curve_patches(curves_.size());
+  for (size_t i = 0; i < patches_.size(); ++i)
+    for (size_t c : sides_[i])
+      curve_patches[c].push_back(i);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const auto &ps : curve_patches) {
+      size_t finest = 0;
+      for (size_t i : ps)
+        finest = std::max(finest, levels[i]);
+      for (size_t i : ps)
+        if (levels[i] + 1 < finest) {
+          levels[i] = finest - 1;
+          changed = true;
+        }
+    }
+  }
+
+  std::vector<size_t> result;
+  for (size_t level : levels)
+    result.push_back(min_resolution << level);
+  return result;
+}
+
+std::vector<TriMesh>
+PatchModel::eval(const std::vector<size_t> &resolutions) const {
+  if (resolutions.size() != patches_.size())
+    throw std::invalid_argument("there should be a resolution for each patch");
+  auto b = boundary(curveResolutions(resolutions));
+  std::vector<TriMesh> result(patches_.size());
+  executor_(patches_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      size_t resolution = resolutions[i];
+      PointVector points = levelPoints(i, resolution);
+      TriMesh mesh = patches_[i]->domain()->meshTopology(resolution);
+      if (!sides_[i].empty()) {
+        std::vector<size_t> kept;
+        auto indices = boundaryIndices(b, resolution, i, &kept);
+        for (size_t j = 0; j < points.size(); ++j)
+          if (indices[j] != none)
+            points[j] = b.points[indices[j]];
+        bool collapsed = false;
+        for (size_t j = 0; j < kept.size() && !collapsed; ++j)
+          collapsed = kept[j] != j;
+        if (collapsed) {
+          TriMesh welded;
+          for (const auto &t : mesh.triangles()) {
+            size_t v0 = kept[t[0]], v1 = kept[t[1]], v2 = kept[t[2]];
+            if (v0 != v1 && v1 != v2 && v2 != v0)
+              welded.addTriangle(v0, v1, v2);
+          }
+          mesh = welded;
+        }
+      }
+      mesh.setPoints(points);
+      result[i] = mesh;
+    }
+  });
+  return result;
+}
+
+TriMesh
+PatchModel::evalCombined(const std::vector<size_t> &resolutions) const {
+  return combine(eval(resolutions), resolutions);
+}
+
+TriMesh
+PatchModel::combine(const std::vector<TriMesh> &meshes,
+                    const std::vector<size_t> &resolutions) const {
+  auto b = boundary(curveResolutions(resolutions));
+  PointVector points = b.points;
+  TriMesh result;
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    auto indices = boundaryIndices(b, resolutions[i], i);
+    const auto &mesh_points = meshes[i].points();
+    for (size_t j = 0; j < mesh_points.size(); ++j)
+      if (indices[j] == none) {
+        indices[j] = points.size();
+        points.push_back(mesh_points[j]);
+      }
+    for (const auto &t : meshes[i].triangles())
+      result.addTriangle(indices[t[0]], indices[t[1]], indices[t[2]]);
+  }
+  result.setPoints(points);
+  return result;
+}
+
+size_t
+PatchModel::Boundary::index(size_t curve, size_t k) const {
+  if (k == 0)
+    return ends[2 * curve];
+  if (k == resolutions[curve])
+    return ends[2 * curve + 1];
+  return offsets[curve] + k - 1;
+}
+
+PatchModel::Boundary
+PatchModel::boundary(const std::vector<size_t> &curve_resolutions) const {
+  Boundary result;
+  result.resolutions = curve_resolutions;
+  size_t nc = curves_.size();
+
+  // The orientations of the shared curves in the (already set up) patches
+  result.reversed.resize(patches_.size());
+  for (size_t i = 0; i < patches_.size(); ++i)
+    for (size_t j = 0; j < sides_[i].size(); ++j) {
+      const auto &c = *curves_[sides_[i][j]];
+      Point3D p = patches_[i]->ribbon(j)->curve()->eval(0.0);
+      result.reversed[i].push_back((p - c.eval(1.0)).norm() < (p - c.eval(0.0)).norm());
+    }
+
+  // Curve ends meeting in a patch corner are the same vertex
+  std::vector<size_t> parent(2 * nc);
+  std::iota(parent.begin(), parent.end(), 0);
+  auto root = [&](size_t e) {
+    while (parent[e] != e)
+      e = parent[e] = parent[parent[e]];
+    return e;
+  };
+  for (size_t i = 0; i < patches_.size(); ++i) {
+    const auto &sides = sides_[i];
+    const auto &reversed = result.reversed[i];
+    for (size_t j = 0, n = sides.size(); j < n; ++j) {
+      size_t k = (j + n - 1) % n;
+      size_t prev_end = 2 * sides[k] + (reversed[k] ? 0 : 1);
+      size_t start = 2 * sides[j] + (reversed[j] ? 1 : 0);
+      parent[root(prev_end)] = root(start);
+    }
+  }
+  result.ends.resize(2 * nc);
+  std::vector<size_t> corner(2 * nc, none);
+  result.corners = 0;
+  for (size_t e = 0; e < 2 * nc; ++e) {
+    size_t r = root(e);
+    if (corner[r] == none) {
+      corner[r] = result.corners++;
+      result.points.push_back(curves_[e / 2]->eval(e % 2 == 0 ? 0.0 : 1.0));
+    }
+    result.ends[e] = corner[r];
+  }
+
+  // Inner points, sampled once for each curve
+  size_t size = result.corners;
+  for (size_t c = 0; c < nc; ++c) {
+    result.offsets.push_back(size);
+    size += curve_resolutions[c] > 0 ? curve_resolutions[c] - 1 : 0;
+  }
+  result.points.resize(size);
+  executor_(nc, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      for (size_t k = 1; k < curve_resolutions[c]; ++k)
+        result.points[result.offsets[c] + k - 1] =
+          curves_[c]->eval(static_cast<double>(k) / curve_resolutions[c]);
+  });
+  return result;
+}
+
+std::vector<size_t>
+PatchModel::curveResolutions(const std::vector<size_t> &resolutions) const {
+  std::vector<size_t> result(curves_.size(), 0);
+  for (size_t i = 0; i < patches_.size(); ++i)
+    for (size_t c : sides_[i])
+      if (result[c] == 0 || resolutions[i] < result[c])
+        result[c] = resolutions[i];
+  for (size_t i = 0; i < patches_.size(); ++i)
+    for (size_t c : sides_[i])
+      if (resolutions[i] % result[c] != 0)
+        throw std::invalid_argument("the resolutions of patches with a shared curve "
+                                    "should divide each other");
+  return result;
+}
+
+std::vector<size_t>
+PatchModel::boundaryIndices(const Boundary &boundary, size_t resolution, size_t patch,
+                            std::vector<size_t> *kept) const {
+  const auto &domain = patches_[patch]->domain();
+  std::vector<size_t> result(domain->parameters(resolution).size(), none);
+  if (kept) {
+    kept->resize(result.size());
+    std::iota(kept->begin(), kept->end(), 0);
+  }
+  const auto &sides = sides_[patch];
+  if (sides.empty())
+    return result;
+  std::unordered_map<size_t, size_t> vertex; // of the points not collapsed
+  std::vector<size_t> collapsed;
+  auto mesh_boundary = domain->meshBoundary(resolution);
+  for (const auto &v : mesh_boundary->vertices) {
+    size_t k = std::lround(v.s * resolution);
+    if (boundary.reversed[patch][v.side])
+      k = resolution - k;
+    size_t ratio = resolution / boundary.resolutions[sides[v.side]];
+    result[v.index] = boundary.index(sides[v.side], k / ratio);
+    if (k % ratio == 0)
+      vertex[result[v.index]] = v.index;
+    else
+      collapsed.push_back(v.index);
+  }
+  if (kept)
+    for (size_t j : collapsed)
+      (*kept)[j] = vertex.at(result[j]);
+  return result;
+}
+
+PointVector
+PatchModel::levelPoints(size_t patch, size_t resolution) const {
+  std::shared_ptr<const Level> cached;
+  {
+    std::lock_guard<std::mutex> lock(levels_mutex_);
+    if (patch < levels_.size())
+      cached = levels_[patch];
+  }
+  const auto &surface = *patches_[patch];
+  auto domain = surface.domain();
+  if (cached && (cached->revision != surface.revision() ||
+                 cached->domain_revision != domain->revision()))
+    cached.reset();
+  auto level = std::make_shared<Level>();
+  level->resolution = resolution;
+  level->revision = surface.revision();
+  level->domain_revision = domain->revision();
+  if (cached && cached->resolution == resolution)
+    return cached->points;
+  if (cached && cached->resolution == 2 * resolution) {
+    for (size_t j : domain->nestedIndices(resolution))
+      level->points.push_back(cached->points[j]);
+  } else if (cached && 2 * cached->resolution == resolution) {
+    level->points.resize(domain->parameters(resolution).size());
+    std::vector<bool> known(level->points.size(), false);
+    auto nested = domain->nestedIndices(cached->resolution);
+    for (size_t j = 0; j < nested.size(); ++j) {
+      level->points[nested[j]] = cached->points[j];
+      known[nested[j]] = true;
+    }
+    std::vector<size_t> missing;
+    for (size_t j = 0; j < known.size(); ++j)
+      if (!known[j])
+        missing.push_back(j);
+    auto points = surface.eval(resolution, missing);
+    for (size_t j = 0; j < missing.size(); ++j)
+      level->points[missing[j]] = points[j];
+  } else
+    level->points = surface.eval(resolution).points();
+
+  std::lock_guard<std::mutex> lock(levels_mutex_);
+  if (levels_.size() < patches_.size())
+    levels_.resize(patches_.size());
+  levels_[patch] = level;
+  return level->points;
+}
+
+} // namespace Transfinite
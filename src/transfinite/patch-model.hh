@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "executor.hh"
+#include "surface.hh"
+
+namespace Transfinite {
+
+// A network of patches of any types and side counts, set up and tessellated together.
+// Each patch is a task of the executor, and the tasks are handed out dynamically
+// (as by threadExecutor with a grain of 1), so cheap and expensive patches balance.
+// The patches evaluate serially inside their tasks, so that threads are not nested.
+// Boundary curves can be shared by adjacent patches: the boundary vertices on a shared curve
+// (sampled uniformly in its parameter at every resolution) are then computed once per curve,
+// and they are the same vertices in the meshes of both patches, which are thus watertight
+// (patches that only approximate their boundaries are snapped onto the curves).
+// The ribbons are still built by each patch, as their frames depend on the neighboring sides.
+class PatchModel {
+public:
+  explicit PatchModel(const Executor &executor = threadExecutor(0, 1));
+  void setExecutor(const Executor &executor);
+  // Returns the index of a curve that can be shared by several patches
+  size_t addCurve(const std::shared_ptr<BSCurve> &curve);
+  // The curves of the patch should be set; returns its index
+  size_t add(const std::shared_ptr<Surface> &surface);
+  // Sets the curves of the patch to (copies of) the given shared curves, in loop order
+  size_t add(const std::shared_ptr<Surface> &surface, const std::vector<size_t> &curves);
+  size_t size() const;
+  std::shared_ptr<Surface> patch(size_t i) const;
+  // setupLoop() and update() of all patches
+  void setupLoop();
+  void update();
+  std::vector<TriMesh> eval(size_t resolution) const;
+  // All meshes in one, in the order of the patches, with the vertices of shared curves welded:
+  // first the corners, then the inner vertices of each shared curve, and then the rest
+  TriMesh evalCombined(size_t resolution) const;
+
+  // Camera of the view-dependent resolutions
+  struct View {
+    Point3D eye;
+    double pixel_angle;         // of a pixel, in radians (e.g. the field of view / height)
+    double tolerance = 1.0;     // in pixels
+  };
+  // Resolutions of the patches for eval(resolutions), each min_resolution * 2^k (at most
+  // max_resolution): the lowest ones whose chord error, seen from the eye at the distance of
+  // the bounding sphere of the patch boundary, is within the tolerance. The error is estimated
+  // as c h^2 / 8, by the maximal curvature c of the boundary curves and the edge length
+  // h = 2r / resolution (r is the radius of the sphere). Patches sharing a curve are at most
+  // one level apart, so that the seams between them stay well-shaped.
+  std::vector<size_t> levelOfDetail(const View &view, size_t min_resolution,
+                                    size_t max_resolution) const;
+  // Meshes of the patches at their own resolutions. A shared curve is sampled at the lowest
+  // resolution of its patches, which should divide the others (throws std::invalid_argument
+  // otherwise); the boundary vertices of the finer patches between those samples are collapsed
+  // onto the preceding ones, and the degenerate triangles dropped, so the seams are watertight
+  // without T-junctions (the collapsed vertices are left unreferenced).
+  // The points of the last resolution of each patch are kept until the patch or its domain
+  // changes (by an update of the model, or of the patch through patch(i)), and from there
+  // a halved one is taken as a subset (see Domain::nestedIndices), while a doubled one
+  // evaluates only the new points (as ProgressiveTessellator); the topologies are the
+  // cached ones of the domains.
+  std::vector<TriMesh> eval(const std::vector<size_t> &resolutions) const;
+  // All meshes of eval(resolutions) in one, welded as in evalCombined(resolution)
+  TriMesh evalCombined(const std::vector<size_t> &resolutions) const;
+
+private:
+  // Vertices of the shared curves, with a resolution for each curve
+  struct Boundary {
+    size_t corners;                      // number of distinct curve ends
+    std::vector<size_t> ends;            // corner of each curve end (2 * curve + end)
+    std::vector<size_t> resolutions;     // by curve
+    std::vector<size_t> offsets;         // of the inner points of each curve
+    PointVector points;                  // the corners, then res - 1 inner points by curve
+    std::vector<std::vector<bool>> reversed; // by patch and side
+    // Index in `points` of the curve point with parameter k / resolutions[curve]
+    size_t index(size_t curve, size_t k) const;
+  };
+  struct Level {
+    size_t resolution;
+    uint64_t revision, domain_revision; // of the patch and its domain, when evaluated
+    PointVector points;
+  };
+  Boundary boundary(const std::vector<size_t> &curve_resolutions) const;
+  // The lowest resolution of the patches of each curve
+  std::vector<size_t> curveResolutions(const std::vector<size_t> &resolutions) const;
+  // For each vertex of the patch mesh, its index in Boundary::points
+  // (the maximal size_t when it is not on a shared curve); when given, `kept` is set to the
+  // vertex of the same point that stays in the mesh (itself, when it is not collapsed)
+  std::vector<size_t> boundaryIndices(const Boundary &boundary, size_t resolution,
+                                      size_t patch, std::vector<size_t> *kept = nullptr) const;
+  // The meshes of eval(resolutions) welded for evalCombined
+  TriMesh combine(const std::vector<TriMesh> &meshes, const std::vector<size_t> &resolutions) const;
+  // Points of the patch at the given resolution, reusing and replacing its cached level
+  PointVector levelPoints(size_t patch, size_t resolution) const;
+
+  Executor executor_;
+  std::vector<std::shared_ptr<Surface>> patches_;
+  CurveVector curves_;
+  std::vector<std::vector<size_t>> sides_; // shared curves of each patch (empty when none)
+  mutable std::mutex levels_mutex_;
+  mutable std::vector<std::shared_ptr<const Level>> levels_; // by patch
+};
+
+} // namespace Transfinite
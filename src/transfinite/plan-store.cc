@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <typeinfo>
+
+#include "domain.hh"
+#include "parameterization.hh"
+#include "plan-store.hh"
+#include "profiler.hh"
+
+namespace Transfinite {
+
+namespace {
+
+  const char magic[8] = { 'T', 'F', 'P', 'L', 'A', 'N', '0', '1' };
+
+  // 64-bit FNV-1a
+  class Hash {
+  public:
+    void add(const void *data, size_t size) {
+      auto bytes = static_cast<const unsigned char *>(data);
+      for (size_t i = 0; i < size; ++i) {
+        value_ ^= bytes[i];
+        value_ *= 0x100000001b3ULL;
+      }
+    }
+    void add(uint64_t x) { add(&x, sizeof(x)); }
+    void add(double x) { add(&x, sizeof(x)); }
+    void add(const std::string &s) { add((uint64_t)s.size()); add(s.data(), s.size()); }
+    uint64_t value() const { return value_; }
+
+  private:
+    uint64_t value_ = 0xcbf29ce484222325ULL;
+  };
+
+  struct Header {
+    char magic[8];
+    uint64_t key, n, resolution, points;
+  };
+
+}
+
+PlanStore::PlanStore(const std::string &directory) : directory_(directory) {
+  if (!directory_.empty() && directory_.back() != '/')
+    directory_ += '/';
+}
+
+uint64_t
+PlanStore::key(const Surface &surface, size_t resolution) const {
+  auto domain = surface.domain();
+  Hash hash;
+  hash.add(Profiler::typeName(typeid(surface)));
+  hash.add(Profiler::typeName(typeid(*domain)));
+  hash.add(Profiler::typeName(typeid(*surface.parameterization())));
+  hash.add((uint64_t)resolution);
+  hash.add((uint64_t)domain->vertices().size());
+  for (const auto &v : domain->vertices()) {
+    hash.add(v[0]);
+    hash.add(v[1]);
+  }
+  return hash.value();
+}
+
+std::string
+PlanStore::filename(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.plan", (unsigned long long)key);
+  return directory_ + name;
+}
+
+bool
+PlanStore::load(const Surface &surface, size_t resolution) const {
+  TRANSFINITE_TIMER("PlanStore::load");
+  uint64_t k = key(surface, resolution);
+  std::ifstream f(filename(k), std::ios::binary);
+  if (!f.is_open())
+    return false;
+
+  auto param = surface.parameterization();
+  auto shared_uvs = surface.domain()->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  size_t n = surface.domain()->vertices().size();
+  Header header;
+  if (!f.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.key != k ||
+      header.n != n || header.resolution != resolution || header.points != uvs.size())
+    return false;
+  std::vector<double> data(2 * n * uvs.size());
+  if (!f.read(reinterpret_cast<char *>(data.data()), data.size() * sizeof(double)))
+    return false;
+
+  auto table = std::make_shared<ParameterTable>();
+  table->n = n;
+  table->sds.resize(n * uvs.size());
+  for (size_t i = 0; i < table->sds.size(); ++i)
+    table->sds[i] = Point2D(data[2 * i], data[2 * i + 1]);
+
+  // Spot check of the settings not in the key
+  Point2DVector sds(n);
+  for (size_t j = 0; j < 4; ++j) {
+    size_t row = j * (uvs.size() - 1) / 3;
+    param->mapToRibbons(&uvs[row], 1, sds.data());
+    for (size_t i = 0; i < n; ++i)
+      if ((sds[i] - table->row(row)[i]).norm() > epsilon)
+        return false;
+  }
+
+  param->setParameterTable(resolution, table);
+  return true;
+}
+
+void
+PlanStore::save(const Surface &surface, size_t resolution) const {
+  TRANSFINITE_TIMER("PlanStore::save");
+  uint64_t k = key(surface, resolution);
+  auto table = surface.parameterization()->parameterTable(resolution);
+  Header header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.key = k;
+  header.n = table->n;
+  header.resolution = resolution;
+  header.points = table->sds.size() / table->n;
+  std::vector<double> data;
+  data.reserve(2 * table->sds.size());
+  for (const auto &p : table->sds) {
+    data.push_back(p[0]);
+    data.push_back(p[1]);
+  }
+
+  // Renamed only when complete, so readers never see a partial file
+  std::string name = filename(k);
+  std::string temporary = name + "." + std::to_string(std::random_device()()) + ".tmp";
+  {
+    std::ofstream f(temporary, std::ios::binary);
+    if (!f.is_open())
+      throw std::runtime_error("unable to open file: " + temporary);
+    f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(double));
+    if (!f) {
+      f.close();
+      std::remove(temporary.c_str());
+      throw std::runtime_error("unable to write file: " + temporary);
+    }
+  }
+  if (std::rename(temporary.c_str(), name.c_str()) != 0) {
+    // Fails on some systems when another job has written the same table in the meantime
+    std::remove(temporary.c_str());
+    std::ifstream existing(name);
+    if (!existing.is_open())
+      throw std::runtime_error("unable to write file: " + name);
+  }
+}
+
+bool
+PlanStore::loadOrSave(const Surface &surface, size_t resolution) const {
+  if (load(surface, resolution))
+    return true;
+  save(surface, resolution);
+  return false;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "surface.hh"
+
+namespace Transfinite {
+
+// On-disk cache of the parameter tables of surfaces, so that batch jobs reloading unchanged
+// patches skip the mapping of the domain points, which dominates their setup; the evaluation
+// plans built from the tables (e.g. of Generalized Bezier patches) are then quick to recompute.
+// A table depends only on the domain and the parameterization, so the key is a content hash of
+// the domain vertices, the types of the surface, its domain and its parameterization, and the
+// resolution. Parameterization settings not in the key (e.g. the type of barycentric coordinates)
+// are checked by remapping a few points of the table when it is loaded.
+// Each table is a file, written to a temporary name and then renamed, so concurrent jobs
+// can share a directory; files of other versions or keys are ignored.
+// Only the tables are stored: the surface is still set up and updated as usual (the domain,
+// the ribbons and their rotation-minimizing frames), which is the cheaper part for most
+// surfaces, and the other precomputed data (e.g. the solutions of harmonic surfaces) are
+// recomputed as well.
+class PlanStore {
+public:
+  // The directory should exist
+  explicit PlanStore(const std::string &directory);
+  // The surface should be updated, as the key depends on its domain
+  uint64_t key(const Surface &surface, size_t resolution) const;
+  // Sets the stored parameter table of the surface (until its next update), if there is a valid
+  // one; returns false otherwise
+  bool load(const Surface &surface, size_t resolution) const;
+  // Stores the parameter table of the surface (computing it, if needed); throws on write errors
+  void save(const Surface &surface, size_t resolution) const;
+  // Loads the table when possible, and saves it otherwise; returns true on a hit
+  bool loadOrSave(const Surface &surface, size_t resolution) const;
+
+private:
+  std::string filename(uint64_t key) const;
+
+  std::string directory_;
+};
+
+} // namespace Transfinite
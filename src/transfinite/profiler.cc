@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+#ifdef TRANSFINITE_ZONES_ITT
+#include <ittnotify.h>
+#endif
+
+#include "profiler.hh"
+
+namespace Transfinite {
+
+namespace Profiler {
+
+  namespace {
+
+    struct Event {
+      const char *name;
+      size_t thread;
+      uint64_t start, duration; // ns from the epoch
+    };
+
+    struct Registry {
+      std::mutex mutex;
+      std::deque<StageData> stages;
+      std::deque<CounterData> counters;
+      std::atomic<bool> tracing{false};
+      std::vector<Event> events;
+      std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+      std::deque<ZoneSite> zones;
+      ZoneHooks hooks;
+#ifdef TRANSFINITE_ZONES_ITT
+      __itt_domain *itt_domain = __itt_domain_create("Transfinite");
+      __itt_string_handle *itt_text = __itt_string_handle_create("text");
+#endif
+    };
+
+    Registry &registry() {
+      static Registry r;
+      return r;
+    }
+
+    // Small consecutive thread ids for the trace
+    size_t threadIndex() {
+      static std::atomic<size_t> next{0};
+      thread_local size_t index = next++;
+      return index;
+    }
+
+    uint64_t nanoseconds(std::chrono::steady_clock::duration d) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    }
+
+    // A name can be registered from different translation units, with different pointers
+    template<typename T>
+    T &find(std::deque<T> &data, const char *name) {
+      for (auto &d : data)
+        if (std::strcmp(d.name, name) == 0)
+          return d;
+      data.emplace_back();
+      data.back().name = name;
+      return data.back();
+    }
+
+    void writeString(std::ostream &os, const std::string &s) {
+      os << '"';
+      for (char c : s)
+        if (c == '"' || c == '\\')
+          os << '\\' << c;
+        else
+          os << c;
+      os << '"';
+    }
+
+    // In microseconds, with full precision
+    void writeTime(std::ostream &os, uint64_t ns) {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%llu.%03u", (unsigned long long)(ns / 1000),
+                    (unsigned)(ns % 1000));
+      os << buffer;
+    }
+
+  }
+
+  StageData &
+  stage(const char *name) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return find(r.stages, name);
+  }
+
+  CounterData &
+  counter(const char *name) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return find(r.counters, name);
+  }
+
+  ScopedTimer::ScopedTimer(StageData &stage)
+    : stage_(stage), start_(std::chrono::steady_clock::now()) {
+  }
+
+  ScopedTimer::~ScopedTimer() {
+    auto end = std::chrono::steady_clock::now();
+    uint64_t ns = nanoseconds(end - start_);
+    stage_.calls.fetch_add(1, std::memory_order_relaxed);
+    stage_.nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = stage_.max_nanoseconds.load(std::memory_order_relaxed);
+    while (ns > max && !stage_.max_nanoseconds.compare_exchange_weak(max, ns))
+      ;
+    Registry &r = registry();
+    if (r.tracing.load(std::memory_order_relaxed)) {
+      Event e { stage_.name, threadIndex(), nanoseconds(start_ - r.epoch), ns };
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.events.push_back(e);
+    }
+  }
+
+  std::vector<Stage>
+  stages() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<Stage> result;
+    for (const auto &s : r.stages)
+      result.push_back({ s.name, s.calls.load(), s.nanoseconds.load() * 1e-9,
+                         s.max_nanoseconds.load() * 1e-9 });
+    return result;
+  }
+
+  std::vector<Counter>
+  counters() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<Counter> result;
+    for (const auto &c : r.counters)
+      result.push_back({ c.name, c.value.load() });
+    return result;
+  }
+
+  void
+  reset() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto &s : r.stages) {
+      s.calls = 0;
+      s.nanoseconds = 0;
+      s.max_nanoseconds = 0;
+    }
+    for (auto &c : r.counters)
+      c.value = 0;
+    r.events.clear();
+    r.epoch = std::chrono::steady_clock::now();
+  }
+
+  void
+  setTracing(bool on) {
+    registry().tracing = on;
+  }
+
+  void
+  writeChromeTrace(const std::string &filename) {
+    std::ofstream f(filename);
+    if (!f.is_open())
+      throw std::runtime_error("unable to open file: " + filename);
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    f << "{\"traceEvents\":[";
+    bool first = true;
+    uint64_t last = 0;
+    for (const auto &e : r.events) {
+      f << (first ? "\n" : ",\n") << "{\"name\":";
+      writeString(f, e.name);
+      f << ",\"cat\":\"transfinite\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+        << ",\"ts\":";
+      writeTime(f, e.start);
+      f << ",\"dur\":";
+      writeTime(f, e.duration);
+      f << '}';
+      last = std::max(last, e.start + e.duration);
+      first = false;
+    }
+    for (const auto &c : r.counters) {
+      f << (first ? "\n" : ",\n") << "{\"name\":";
+      writeString(f, c.name);
+      f << ",\"cat\":\"transfinite\",\"ph\":\"C\",\"pid\":0,\"ts\":";
+      writeTime(f, last);
+      f << ",\"args\":{\"value\":" << c.value.load() << "}}";
+      first = false;
+    }
+    f << "\n]}\n";
+    if (!f)
+      throw std::runtime_error("unable to write file: " + filename);
+  }
+
+  void
+  setZoneHooks(const ZoneHooks &hooks) {
+    registry().hooks = hooks;
+  }
+
+  std::string
+  typeName(const std::type_info &type) {
+    std::string name = type.name();
+#ifdef __GNUG__
+    int status;
+    char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (status == 0)
+      name = demangled;
+    std::free(demangled);
+#endif
+    for (std::string prefix : { "class ", "struct ", "Transfinite::" })
+      if (name.rfind(prefix, 0) == 0)
+        name.erase(0, prefix.size());
+    return name;
+  }
+
+  ZoneSite &
+  zoneSite(const char *name) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    ZoneSite &site = find(r.zones, name);
+#ifdef TRANSFINITE_ZONES_ITT
+    if (!site.handle)
+      site.handle = __itt_string_handle_create(name);
+#endif
+    return site;
+  }
+
+  void
+  zoneText(const std::string &text) {
+    Registry &r = registry();
+#ifdef TRANSFINITE_ZONES_ITT
+    __itt_metadata_str_add(r.itt_domain, __itt_null, r.itt_text, text.c_str(), text.size());
+#else
+    if (r.hooks.text)
+      r.hooks.text(text.c_str(), text.size(), r.hooks.data);
+#endif
+  }
+
+  ScopedZone::ScopedZone(const ZoneSite &site) : site_(site) {
+    Registry &r = registry();
+#ifdef TRANSFINITE_ZONES_ITT
+    __itt_task_begin(r.itt_domain, __itt_null, __itt_null,
+                     static_cast<__itt_string_handle *>(site_.handle));
+#else
+    if (r.hooks.begin)
+      r.hooks.begin(site_.name, r.hooks.data);
+#endif
+  }
+
+  ScopedZone::~ScopedZone() {
+    Registry &r = registry();
+#ifdef TRANSFINITE_ZONES_ITT
+    __itt_task_end(r.itt_domain);
+#else
+    if (r.hooks.end)
+      r.hooks.end(site_.name, r.hooks.data);
+#endif
+  }
+
+} // namespace Profiler
+
+} // namespace Transfinite
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#ifdef TRANSFINITE_ZONES_TRACY
+#include <tracy/Tracy.hpp>
+#endif
+
+// Stage timers and counters, compiled in only with TRANSFINITE_PROFILING
+// (see the CMake option of the same name); otherwise the macros expand to nothing,
+// and the query functions return empty results.
+//   TRANSFINITE_TIMER("name");      times the rest of the enclosing scope
+//   TRANSFINITE_COUNT("name", n);   adds n to a counter
+// Names should be string literals. The statistics are kept in atomics, so timers and counters
+// can be used concurrently; the trace events (when enabled) are collected under a lock,
+// so timers should be placed around stages, not in per-point loops.
+//
+// Independently, the timed scopes can be annotated as zones for an external profiler,
+// selected by the CMake variable TRANSFINITE_ZONES: TRACY, ITT (VTune), or CALLBACK
+// (the functions given to setZoneHooks()). Without it the zones are not compiled in.
+//   TRANSFINITE_ZONE_TEXT(text);    attaches a string to the zone of the enclosing timer
+// The text expression is evaluated only when zones are enabled. With Tracy, there can be
+// only one timer in a scope. Applications can also use these macros, e.g. to mark each patch.
+
+namespace Transfinite {
+
+namespace Profiler {
+
+  struct Stage {
+    std::string name;
+    uint64_t calls;
+    double seconds, max_seconds;
+  };
+
+  struct Counter {
+    std::string name;
+    uint64_t value;
+  };
+
+  // In the order of their first use
+  std::vector<Stage> stages();
+  std::vector<Counter> counters();
+  // Zeroes all statistics and drops the trace events
+  void reset();
+  // Records every timed scope as an event for writeChromeTrace() (off by default)
+  void setTracing(bool on);
+  // Writes the events recorded since the last reset() in the Chrome trace event format
+  // (loadable in chrome://tracing or Perfetto), with the final counter values
+  void writeChromeTrace(const std::string &filename);
+
+  // Receives the zones with TRANSFINITE_ZONES=CALLBACK, in the thread running them;
+  // a null function is not called. Should be set before any zone is entered.
+  struct ZoneHooks {
+    void (*begin)(const char *name, void *data) = nullptr;
+    void (*text)(const char *text, size_t length, void *data) = nullptr;
+    void (*end)(const char *name, void *data) = nullptr;
+    void *data = nullptr;
+  };
+  void setZoneHooks(const ZoneHooks &hooks);
+
+  // Readable name of a type (e.g. the type of a surface, for zone texts)
+  std::string typeName(const std::type_info &type);
+
+  // Internals of the macros
+
+  struct StageData {
+    const char *name = nullptr;
+    std::atomic<uint64_t> calls{0}, nanoseconds{0}, max_nanoseconds{0};
+  };
+
+  struct CounterData {
+    const char *name = nullptr;
+    std::atomic<uint64_t> value{0};
+  };
+
+  // Registered once by name; the references stay valid
+  StageData &stage(const char *name);
+  CounterData &counter(const char *name);
+
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(StageData &stage);
+    ~ScopedTimer();
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  private:
+    StageData &stage_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Zones of the CALLBACK and ITT backends; Tracy has its own macros
+  struct ZoneSite {
+    const char *name = nullptr;
+    void *handle = nullptr;     // of the backend
+  };
+  ZoneSite &zoneSite(const char *name);
+  void zoneText(const std::string &text);
+
+  class ScopedZone {
+  public:
+    explicit ScopedZone(const ZoneSite &site);
+    ~ScopedZone();
+    ScopedZone(const ScopedZone &) = delete;
+    ScopedZone &operator=(const ScopedZone &) = delete;
+
+  private:
+    const ZoneSite &site_;
+  };
+
+} // namespace Profiler
+
+} // namespace Transfinite
+
+#define TRANSFINITE_CONCAT_(a, b) a##b
+#define TRANSFINITE_CONCAT(a, b) TRANSFINITE_CONCAT_(a, b)
+
+#if defined(TRANSFINITE_ZONES_TRACY)
+#define TRANSFINITE_ZONE_(name) ZoneScopedN(name)
+#define TRANSFINITE_ZONE_TEXT(text)                                                             \
+  do {                                                                                          \
+    std::string profiler_text = (text);                                                         \
+    ZoneText(profiler_text.data(), profiler_text.size());                                       \
+  } while (false)
+#elif defined(TRANSFINITE_ZONES_CALLBACK) || defined(TRANSFINITE_ZONES_ITT)
+#define TRANSFINITE_ZONE_(name)                                                                 \
+  static Transfinite::Profiler::ZoneSite &TRANSFINITE_CONCAT(profiler_site_, __LINE__) =       \
+    Transfinite::Profiler::zoneSite(name);                                                      \
+  Transfinite::Profiler::ScopedZone                                                            \
+  TRANSFINITE_CONCAT(profiler_zone_, __LINE__)(TRANSFINITE_CONCAT(profiler_site_, __LINE__))
+#define TRANSFINITE_ZONE_TEXT(text) Transfinite::Profiler::zoneText(text)
+#else
+#define TRANSFINITE_ZONE_(name) do { } while (false)
+#define TRANSFINITE_ZONE_TEXT(text) do { } while (false)
+#endif
+
+#ifdef TRANSFINITE_PROFILING
+#define TRANSFINITE_TIMER(name)                                                                 \
+  TRANSFINITE_ZONE_(name);                                                                      \
+  static Transfinite::Profiler::StageData &TRANSFINITE_CONCAT(profiler_stage_, __LINE__) =     \
+    Transfinite::Profiler::stage(name);                                                         \
+  Transfinite::Profiler::ScopedTimer                                                           \
+  TRANSFINITE_CONCAT(profiler_timer_, __LINE__)(TRANSFINITE_CONCAT(profiler_stage_, __LINE__))
+#define TRANSFINITE_COUNT(name, n)                                                              \
+  do {                                                                                          \
+    static Transfinite::Profiler::CounterData &profiler_counter =                              \
+      Transfinite::Profiler::counter(name);                                                     \
+    profiler_counter.value.fetch_add(n, std::memory_order_relaxed);                             \
+  } while (false)
+#else
+#define TRANSFINITE_TIMER(name) TRANSFINITE_ZONE_(name)
+#define TRANSFINITE_COUNT(name, n) do { } while (false)
+#endif
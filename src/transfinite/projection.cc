@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+
+#include "domain.hh"
+#include "projection.hh"
+#include "surface.hh"
+
+namespace Transfinite {
+
+static TriMesh
+coarseMesh(const Surface &surface, const Point2DVector &uvs, size_t resolution) {
+  TriMesh mesh = surface.domain()->meshTopology(resolution);
+  mesh.setPoints(surface.eval(uvs));
+  return mesh;
+}
+
+SurfaceProjector::SurfaceProjector(const std::shared_ptr<const Surface> &surface,
+                                   size_t resolution)
+  : surface_(surface), uvs_(surface->domain()->sharedParameters(resolution)),
+    mesh_(coarseMesh(*surface, *uvs_, resolution)), bvh_(mesh_),
+    vertices_(surface->domain()->vertices()), iterations_(20), tolerance_(1.0e-10)
+{
+  double area = 0.0;
+  for (size_t i = 0, n = vertices_.size(); i < n; ++i) {
+    const Point2D &p = vertices_[i], &q = vertices_[(i+1)%n];
+    area += p[0] * q[1] - p[1] * q[0];
+  }
+  orientation_ = area > 0 ? 1.0 : -1.0;
+}
+
+void
+SurfaceProjector::setIterations(size_t iterations) {
+  iterations_ = iterations;
+}
+
+void
+SurfaceProjector::setTolerance(double tolerance) {
+  tolerance_ = tolerance;
+}
+
+// The closest point of the plane of the closest triangle, with its barycentric coordinates
+// clamped into the triangle, mapped to the domain
+Point2D
+SurfaceProjector::initialGuess(const Point3D &p) const {
+  const auto &t = bvh_.closest(p);
+  const PointVector &points = mesh_.points();
+  const Point3D &a = points[t[0]], &b = points[t[1]], &c = points[t[2]];
+  Vector3D ab = b - a, ac = c - a, ap = p - a;
+  double d00 = ab * ab, d01 = ab * ac, d11 = ac * ac, d20 = ap * ab, d21 = ap * ac;
+  double denom = d00 * d11 - d01 * d01;
+  double v = 1.0 / 3.0, w = 1.0 / 3.0;
+  if (denom > 0) {
+    v = std::max((d11 * d20 - d01 * d21) / denom, 0.0);
+    w = std::max((d00 * d21 - d01 * d20) / denom, 0.0);
+    if (v + w > 1) {
+      v /= v + w;
+      w = 1.0 - v;
+    }
+  }
+  const Point2DVector &uvs = *uvs_;
+  return uvs[t[0]] * (1.0 - v - w) + uvs[t[1]] * v + uvs[t[2]] * w;
+}
+
+// The part of the step inside the domain; when it would leave the domain through a side
+// the point is already on (within epsilon), the outward component is removed first
+Vector2D
+SurfaceProjector::clip(const Point2D &uv, const Vector2D &step) const {
+  size_t n = vertices_.size();
+  Vector2D d = step;
+  for (size_t pass = 0; pass < 2; ++pass) {
+    double t_min = 1.0;
+    size_t blocking = n;
+    for (size_t i = 0; i < n; ++i) {
+      const Point2D &q1 = vertices_[(i+n-1)%n], &q2 = vertices_[i];
+      Vector2D e = q2 - q1;
+      Vector2D outward = Vector2D(e[1], -e[0]) * (orientation_ / e.norm());
+      double speed = d * outward;
+      if (speed <= 0)
+        continue;
+      double gap = (q1 - uv) * outward;       // distance from the line of the side
+      double t = gap < epsilon ? 0.0 : gap / speed;
+      if (t >= t_min)
+        continue;
+      Point2D x = uv + d * t;
+      double s = ((x - q1) * e) / (e * e);
+      if (s < -epsilon || s > 1.0 + epsilon)
+        continue;
+      t_min = t;
+      blocking = i;
+    }
+    if (blocking == n || t_min > 0)
+      return d * t_min;
+    // Sliding along the side
+    const Point2D &q1 = vertices_[(blocking+n-1)%n], &q2 = vertices_[blocking];
+    Vector2D e = (q2 - q1).normalize();
+    d = e * (d * e);
+  }
+  return Vector2D(0, 0);
+}
+
+SurfaceProjector::Projection
+SurfaceProjector::project(const Point3D &p) const {
+  Point2D uv = initialGuess(p);
+  Point3D point = surface_->eval(uv);
+  double distance = (point - p).norm();
+  for (size_t iteration = 0; iteration < iterations_; ++iteration) {
+    auto d = surface_->evalDerivatives(uv);
+    Vector3D r = d.point - p;
+    double a = d.du * d.du, b = d.du * d.dv, c = d.dv * d.dv;
+    double g1 = d.du * r, g2 = d.dv * r, det = a * c - b * b;
+    Vector2D step;
+    if (det > epsilon * a * c)
+      step = Vector2D(b * g2 - c * g1, b * g1 - a * g2) / det;
+    else if (a + c > 0)
+      step = Vector2D(-g1, -g2) / (a + c); // singular point, e.g. a collapsed side
+    else
+      break;
+    step = clip(uv, step);
+
+    // Halve the step until the distance decreases
+    bool improved = false;
+    for (size_t k = 0; k < 10 && step.norm() > tolerance_; ++k, step /= 2.0) {
+      Point3D q = surface_->eval(uv + step);
+      double dq = (q - p).norm();
+      if (dq < distance) {
+        uv += step;
+        point = q;
+        distance = dq;
+        improved = true;
+        break;
+      }
+    }
+    if (!improved || step.norm() <= tolerance_)
+      break;
+  }
+  return { uv, point, distance };
+}
+
+std::vector<SurfaceProjector::Projection>
+SurfaceProjector::project(const PointVector &points, const Executor &executor) const {
+  std::vector<Projection> result(points.size());
+  executor(points.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      result[i] = project(points[i]);
+  });
+  return result;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+
+#include "executor.hh"
+#include "geometry.hh"
+#include "locator.hh"
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+class Surface;
+
+// Closest points of a surface (inverse evaluation). The initial guess is the closest point
+// of a coarse tessellation (located by a bounding volume hierarchy), refined by Gauss-Newton
+// iterations in the domain with the derivatives of Surface::evalDerivatives (analytic where
+// the surface provides them); steps leaving the domain are cut at its boundary and continue
+// along it. The surface should not change while the projector is used (see Surface::snapshot).
+class SurfaceProjector {
+public:
+  struct Projection {
+    Point2D uv;
+    Point3D point;
+    double distance;
+  };
+
+  explicit SurfaceProjector(const std::shared_ptr<const Surface> &surface,
+                            size_t resolution = 20);
+  // Maximal number of iterations (default: 20)
+  void setIterations(size_t iterations);
+  // Iterations stop at steps shorter than this in the domain (default: 1e-10)
+  void setTolerance(double tolerance);
+  Projection project(const Point3D &p) const;
+  // The queries are distributed by the executor
+  std::vector<Projection> project(const PointVector &points,
+                                  const Executor &executor = threadExecutor()) const;
+
+private:
+  Point2D initialGuess(const Point3D &p) const;
+  Vector2D clip(const Point2D &uv, const Vector2D &step) const;
+
+  std::shared_ptr<const Surface> surface_;
+  std::shared_ptr<const Point2DVector> uvs_;
+  TriMesh mesh_;                // of the domain mesh, so the vertices correspond to uvs_
+  TriangleBVH bvh_;
+  Point2DVector vertices_;      // of the domain
+  double orientation_;          // 1 for counterclockwise domains, -1 otherwise
+  size_t iterations_;
+  double tolerance_;
+};
+
+} // namespace Transfinite
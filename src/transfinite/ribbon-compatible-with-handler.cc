@@ -5,6 +5,11 @@ namespace Transfinite {
 RibbonCompatibleWithHandler::~RibbonCompatibleWithHandler() {
 }
 
+std::shared_ptr<Ribbon>
+RibbonCompatibleWithHandler::clone() const {
+  return std::make_shared<RibbonCompatibleWithHandler>(*this);
+}
+
 void
 RibbonCompatibleWithHandler::update() {
   RibbonCompatible::update();
@@ -14,12 +19,26 @@ RibbonCompatibleWithHandler::update() {
     handler_ = handler_ - n * (handler_ * n);
     handler_.normalize();
   }
-  central_ = handler_ * (prev_tangent_.norm() + next_tangent_.norm()) / 2.0 * multiplier_;
+  central_ = handler_ * scale() * multiplier_;
+}
+
+const Vector3D &
+RibbonCompatibleWithHandler::central() const {
+  return central_;
+}
+
+const Vector3D &
+RibbonCompatibleWithHandler::direction() const {
+  return handler_;
+}
+
+double
+RibbonCompatibleWithHandler::scale() const {
+  return (prev_tangent_.norm() + next_tangent_.norm()) / 2.0;
 }
 
 Vector3D
-RibbonCompatibleWithHandler::crossDerivative(double s) const {
-  Vector3D n = normal(s);
+RibbonCompatibleWithHandler::crossDerivative(double s, const Vector3D &n) const {
   Vector3D pt = prev_tangent_ - n * (prev_tangent_ * n);
   Vector3D ch = central_ - n * (central_ * n);
   Vector3D nt = next_tangent_ - n * (next_tangent_ * n);
@@ -28,4 +47,15 @@ RibbonCompatibleWithHandler::crossDerivative(double s) const {
     + nt * 2.0 * s * (s - 0.5);
 }
 
+Vector3D
+RibbonCompatibleWithHandler::twist(double s, const Vector3D &n, const Vector3D &dn) const {
+  Vector3D pt = prev_tangent_ - n * (prev_tangent_ * n);
+  Vector3D ch = central_ - n * (central_ * n);
+  Vector3D nt = next_tangent_ - n * (next_tangent_ * n);
+  return projectionDerivative(prev_tangent_, n, dn) * 2.0 * (s - 1.0) * (s - 0.5)
+    + projectionDerivative(central_, n, dn) * -4.0 * s * (s - 1.0)
+    + projectionDerivative(next_tangent_, n, dn) * 2.0 * s * (s - 0.5)
+    + pt * (4.0 * s - 3.0) + ch * (4.0 - 8.0 * s) + nt * (4.0 * s - 1.0);
+}
+
 } // namespace Transfinite
@@ -7,10 +7,22 @@ namespace Transfinite {
 class RibbonCompatibleWithHandler : public RibbonCompatible {
 public:
   virtual ~RibbonCompatibleWithHandler();
+  virtual std::shared_ptr<Ribbon> clone() const override;
   virtual void update() override;
-  virtual Vector3D crossDerivative(double s) const override;
+  // The cross-derivative at the middle (before the projection to the normal plane), computed by
+  // update() as direction() * multiplier() * scale()
+  const Vector3D &central() const;
+  // Handler direction of the last update(), also when the handler is not set
+  const Vector3D &direction() const;
+  // The mean length of the corner tangents
+  double scale() const;
+  using RibbonCompatible::crossDerivative;
+  using RibbonCompatible::twist;
 
 protected:
+  virtual Vector3D crossDerivative(double s, const Vector3D &n) const override;
+  virtual Vector3D twist(double s, const Vector3D &n, const Vector3D &dn) const override;
+
   Vector3D central_;
 };
 
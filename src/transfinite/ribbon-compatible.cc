@@ -1,27 +1,64 @@
+#include "curve-metrics.hh"
 #include "ribbon-compatible.hh"
+#include "utilities.hh"
 
 namespace Transfinite {
 
 RibbonCompatible::~RibbonCompatible() {
 }
 
+std::shared_ptr<Ribbon>
+RibbonCompatible::clone() const {
+  return std::make_shared<RibbonCompatible>(*this);
+}
+
 void
 RibbonCompatible::update() {
-  VectorVector der;
-  prev_.lock()->curve()->eval(1.0, 1, der);
-  prev_tangent_ = -der[1];
-  next_.lock()->curve()->eval(0.0, 1, der);
-  next_tangent_ = der[1];
+  prev_tangent_ = -curveMetrics(prev_.lock()->curve())->end_tangent;
+  next_tangent_ = curveMetrics(next_.lock()->curve())->start_tangent;
 
   Ribbon::update();
 }
 
 Vector3D
 RibbonCompatible::crossDerivative(double s) const {
-  Vector3D n = normal(s);
+  return crossDerivative(s, normal(s));
+}
+
+Ribbon::Frame
+RibbonCompatible::frame(double s) const {
+  Frame f;
+  Vector3D der[2];
+  f.point = evalCurve(*curve_, s, 1, der);
+  f.tangent = der[1];
+  f.normal = normal(s);
+  f.cross = crossDerivative(s, f.normal);
+  return f;
+}
+
+Vector3D
+RibbonCompatible::crossDerivative(double s, const Vector3D &n) const {
   Vector3D pt = prev_tangent_ - n * (prev_tangent_ * n);
   Vector3D nt = next_tangent_ - n * (next_tangent_ * n);
   return pt * (1.0 - s) + nt * s;
 }
 
+Vector3D
+RibbonCompatible::projectionDerivative(const Vector3D &v, const Vector3D &n, const Vector3D &dn) {
+  return -(dn * (v * n) + n * (v * dn));
+}
+
+Vector3D
+RibbonCompatible::twist(double s) const {
+  return twist(s, normal(s), normalDerivative(s));
+}
+
+Vector3D
+RibbonCompatible::twist(double s, const Vector3D &n, const Vector3D &dn) const {
+  Vector3D pt = prev_tangent_ - n * (prev_tangent_ * n);
+  Vector3D nt = next_tangent_ - n * (next_tangent_ * n);
+  return nt - pt + projectionDerivative(prev_tangent_, n, dn) * (1.0 - s)
+    + projectionDerivative(next_tangent_, n, dn) * s;
+}
+
 } // namespace Transfinite
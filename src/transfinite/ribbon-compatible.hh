@@ -7,10 +7,20 @@ namespace Transfinite {
 class RibbonCompatible : public Ribbon {
 public:
   virtual ~RibbonCompatible();
+  virtual std::shared_ptr<Ribbon> clone() const override;
   virtual void update() override;
   virtual Vector3D crossDerivative(double s) const override;
+  virtual Frame frame(double s) const override;
+  virtual Vector3D twist(double s) const override;
 
 protected:
+  // Cross-derivative with the normal at `s` already known
+  virtual Vector3D crossDerivative(double s, const Vector3D &n) const;
+  // Twist with the normal at `s` and its derivative already known
+  virtual Vector3D twist(double s, const Vector3D &n, const Vector3D &dn) const;
+  // Derivative of the projection of a constant vector onto the plane of the normal
+  static Vector3D projectionDerivative(const Vector3D &v, const Vector3D &n, const Vector3D &dn);
+
   Vector3D prev_tangent_, next_tangent_;
 };
 
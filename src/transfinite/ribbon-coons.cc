@@ -7,6 +7,24 @@ namespace Transfinite {
 RibbonCoons::~RibbonCoons() {
 }
 
+std::shared_ptr<Ribbon>
+RibbonCoons::clone() const {
+  return std::make_shared<RibbonCoons>(*this);
+}
+
+void
+RibbonCoons::relink(const std::shared_ptr<Ribbon> &prev, const std::shared_ptr<Ribbon> &next) {
+  Ribbon::relink(prev, next);
+  left_ = prev->curve();
+  right_ = next->curve();
+}
+
+// The top curve uses the tangents of the second neighbors
+size_t
+RibbonCoons::dependencyRange() const {
+  return 2;
+}
+
 void
 RibbonCoons::update() {
   left_ = prev_.lock()->curve();
@@ -42,10 +60,32 @@ Point3D
 RibbonCoons::eval(const Point2D &sd) const {
   auto s = inrange(0, sd[0], 1), d = inrange(0, sd[1], 1);
   auto s1 = inrange(0, 1 - s, 1), d1 = inrange(0, 1 - d, 1);
-  auto p1 = curve_->eval(s) * d1 + top_->eval(s1) * d;
-  auto p2 = left_->eval(d1) * s1 + right_->eval(d) * s;
+  Vector3D der[1];
+  auto p1 = evalCurve(*curve_, s, 0, der) * d1 + evalCurve(*top_, s1, 0, der) * d;
+  auto p2 = evalCurve(*left_, d1, 0, der) * s1 + evalCurve(*right_, d, 0, der) * s;
   auto p12 = (bl_ * s1 + br_ * s) * d1 + (tl_ * s1 + tr_ * s) * d;
   return p1 + p2 - p12;
 }
 
+Point3D
+RibbonCoons::evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const {
+  auto s = inrange(0, sd[0], 1), d = inrange(0, sd[1], 1);
+  auto s1 = inrange(0, 1 - s, 1), d1 = inrange(0, 1 - d, 1);
+  Vector3D der_base[2], der_top[2], der_left[2], der_right[2];
+  auto base = evalCurve(*curve_, s, 1, der_base), top = evalCurve(*top_, s1, 1, der_top);
+  auto left = evalCurve(*left_, d1, 1, der_left), right = evalCurve(*right_, d, 1, der_right);
+  auto p1 = base * d1 + top * d;
+  auto p2 = left * s1 + right * s;
+  auto p12 = (bl_ * s1 + br_ * s) * d1 + (tl_ * s1 + tr_ * s) * d;
+
+  // Zero outside of [0, 1]^2 (with a tolerance), where the parameters are clamped
+  ds = dd = Vector3D(0, 0, 0);
+  if (std::abs(s - sd[0]) < epsilon)
+    ds = der_base[1] * d1 - der_top[1] * d + right - left - (br_ - bl_) * d1 - (tr_ - tl_) * d;
+  if (std::abs(d - sd[1]) < epsilon)
+    dd = top - base + der_right[1] * s - der_left[1] * s1
+      + (bl_ * s1 + br_ * s) - (tl_ * s1 + tr_ * s);
+  return p1 + p2 - p12;
+}
+
 } // namespace Transfinite
@@ -7,9 +7,14 @@ namespace Transfinite {
 class RibbonCoons : public Ribbon {
 public:
   virtual ~RibbonCoons();
+  virtual std::shared_ptr<Ribbon> clone() const override;
+  virtual void relink(const std::shared_ptr<Ribbon> &prev,
+                      const std::shared_ptr<Ribbon> &next) override;
+  virtual size_t dependencyRange() const override;
   virtual void update() override;
   virtual Vector3D crossDerivative(double s) const override;
   virtual Point3D eval(const Point2D &sd) const override;
+  virtual Point3D evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const override;
 
 protected:
   std::shared_ptr<BSCurve> left_, right_, top_;
@@ -7,8 +7,17 @@ namespace Transfinite {
 class RibbonDummy : public Ribbon {
 public:
   virtual ~RibbonDummy() {}
+  virtual std::shared_ptr<Ribbon> clone() const override {
+    return std::make_shared<RibbonDummy>(*this);
+  }
   virtual void update() override {}
   virtual Vector3D crossDerivative(double) const override { return Vector3D(0,0,0); }
+  virtual Vector3D twist(double) const override { return Vector3D(0,0,0); }
+  virtual Frame frame(double s) const override {
+    VectorVector der;
+    Point3D p = curve_->eval(s, 1, der);
+    return { p, der[1], Vector3D(0,0,0), Vector3D(0,0,0) };
+  }
 };
 
 } // namespace Transfinite
@@ -1,5 +1,6 @@
 #include <cmath>
 
+#include "curve-metrics.hh"
 #include "ribbon-nsided.hh"
 #include "utilities.hh"
 
@@ -8,29 +9,67 @@ namespace Transfinite {
 RibbonNSided::~RibbonNSided() {
 }
 
+std::shared_ptr<Ribbon>
+RibbonNSided::clone() const {
+  return std::make_shared<RibbonNSided>(*this);
+}
+
 void
 RibbonNSided::update() {
-  base_length_ = curve_->arcLength(0, 1);
+  base_length_ = curveMetrics(curve_)->length;
 
   Ribbon::update();
 }
 
 Vector3D
 RibbonNSided::crossDerivative(double s) const {
-  Vector3D n = normal(s);
+  return frame(s).cross;
+}
+
+Ribbon::Frame
+RibbonNSided::frame(double s) const {
+  // The point and the tangent are those of the nearest curve end for s outside [0, 1]
+  Frame f;
   double u = inrange(0, s, 1);
-  VectorVector der;
-  curve_->eval(u, 1, der);
-  Vector3D &d = der[1].normalize();
-  if (s == u)
-    return n ^ d;
+  Vector3D der[2];
+  f.point = evalCurve(*curve_, u, 1, der);
+  f.tangent = der[1];
+  f.normal = normal(s);
+  Vector3D d = f.tangent;
+  d.normalize();
+  if (s == u) {
+    f.cross = f.normal ^ d;
+    return f;
+  }
 
   // Polar lines
   double phi = s < 0 ? -s : s - 1;
+  if (s < 0)
+    d *= -1;
+  Vector3D b = d ^ f.normal;
+  f.cross = b * std::cos(phi) + d * std::sin(phi);
+  return f;
+}
+
+Vector3D
+RibbonNSided::twist(double s) const {
+  double u = inrange(0, s, 1);
+  Vector3D der[3];
+  evalCurve(*curve_, u, 2, der);
+  double speed = der[1].norm();
+  Vector3D d = der[1] / speed;
+  Vector3D n = normal(s);
+  if (s == u) {
+    Vector3D dd = (der[2] - d * (d * der[2])) / speed;
+    return (normalDerivative(s) ^ d) + (n ^ dd);
+  }
+
+  // Polar lines (the base point and the normal are fixed)
+  double phi = s < 0 ? -s : s - 1;
   if (s < 0)
     d *= -1;
   Vector3D b = d ^ n;
-  return b * std::cos(phi) + d * std::sin(phi);
+  return (d * std::cos(phi) - b * std::sin(phi)) * (s < 0 ? -1.0 : 1.0);
 }
 
 Point3D
@@ -38,10 +77,20 @@ RibbonNSided::eval(const Point2D &sd) const {
   // s ranges from -pi to 1+pi, where values <0 and >1 are meant as angles
   // d is the ratio of the sweep in the domain to the length of the base side
   // d is negative for points "behind" the ribbon
-  double u = inrange(0, sd[0], 1);
-  Point3D p = curve_->eval(u);
+  Frame f = frame(sd[0]);
+  double length = sd[1] * base_length_;
+  return f.point + f.cross * length;
+}
+
+Point3D
+RibbonNSided::evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const {
+  Frame f = frame(sd[0]);
   double length = sd[1] * base_length_;
-  return p + crossDerivative(sd[0]) * length;
+  ds = twist(sd[0]) * length;
+  if (sd[0] > -epsilon && sd[0] < 1.0 + epsilon)
+    ds += f.tangent;
+  dd = f.cross * base_length_;
+  return f.point + f.cross * length;
 }
 
 } // namespace Transfinite
@@ -7,9 +7,13 @@ namespace Transfinite {
 class RibbonNSided : public Ribbon {
 public:
   virtual ~RibbonNSided();
+  virtual std::shared_ptr<Ribbon> clone() const override;
   virtual void update() override;
   virtual Vector3D crossDerivative(double s) const override;
+  virtual Frame frame(double s) const override;
+  virtual Vector3D twist(double s) const override;
   virtual Point3D eval(const Point2D &sd) const override;
+  virtual Point3D evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const override;
 
 protected:
   double base_length_;
@@ -1,23 +1,26 @@
+#include "curve-metrics.hh"
 #include "ribbon-perpendicular.hh"
+#include "utilities.hh"
 
 namespace Transfinite {
 
 RibbonPerpendicular::~RibbonPerpendicular() {
 }
 
+std::shared_ptr<Ribbon>
+RibbonPerpendicular::clone() const {
+  return std::make_shared<RibbonPerpendicular>(*this);
+}
+
 void
 RibbonPerpendicular::update() {
   Ribbon::update();
 
-  VectorVector der;
-  curve_->eval(0.0, 1, der);
-  auto t0 = der[1].normalize();
-  curve_->eval(1.0, 1, der);
-  auto t1 = der[1].normalize();
-  prev_.lock()->curve()->eval(1.0, 1, der);
-  auto pt = -der[1];
-  next_.lock()->curve()->eval(0.0, 1, der);
-  auto nt = der[1];
+  auto metrics = curveMetrics(curve_);
+  auto t0 = Vector3D(metrics->start_tangent).normalize();
+  auto t1 = Vector3D(metrics->end_tangent).normalize();
+  auto pt = -curveMetrics(prev_.lock()->curve())->end_tangent;
+  auto nt = curveMetrics(next_.lock()->curve())->start_tangent;
   auto n0 = normal(0.0);    auto n1 = normal(1.0);
   auto b0 = n0 ^ t0;        auto b1 = n1 ^ t1;
   prev_norm_ = pt.norm();   next_norm_ = nt.norm();
@@ -28,10 +31,24 @@ RibbonPerpendicular::update() {
 
 Vector3D
 RibbonPerpendicular::crossDerivative(double s) const {
-  VectorVector der;
-  curve_->eval(s, 1, der);
-  auto t = der[1].normalize();
-  auto n = normal(s);
+  Vector3D der[2];
+  evalCurve(*curve_, s, 1, der);
+  return crossDerivative(s, der[1].normalize(), normal(s));
+}
+
+Ribbon::Frame
+RibbonPerpendicular::frame(double s) const {
+  Frame f;
+  Vector3D der[2];
+  f.point = evalCurve(*curve_, s, 1, der);
+  f.tangent = der[1];
+  f.normal = normal(s);
+  f.cross = crossDerivative(s, der[1].normalize(), f.normal);
+  return f;
+}
+
+Vector3D
+RibbonPerpendicular::crossDerivative(double s, const Vector3D &t, const Vector3D &n) const {
   auto size = prev_norm_ * (1.0 - s) + next_norm_ * s;
   auto alpha = prev_alpha_ * 2.0 * (s - 1.0) * (s - 0.5) + next_alpha_ * 2.0 * s * (s - 0.5)
     - 4.0 * s * (s - 1.0);
@@ -40,4 +57,25 @@ RibbonPerpendicular::crossDerivative(double s) const {
   return ((n ^ t) * alpha + t * beta) * size;
 }
 
+Vector3D
+RibbonPerpendicular::twist(double s) const {
+  Vector3D der[3];
+  evalCurve(*curve_, s, 2, der);
+  double speed = der[1].norm();
+  auto t = der[1] / speed;
+  auto dt = (der[2] - t * (t * der[2])) / speed;
+  auto n = normal(s), dn = normalDerivative(s);
+  auto size = prev_norm_ * (1.0 - s) + next_norm_ * s;
+  auto dsize = next_norm_ - prev_norm_;
+  auto alpha = prev_alpha_ * 2.0 * (s - 1.0) * (s - 0.5) + next_alpha_ * 2.0 * s * (s - 0.5)
+    - 4.0 * s * (s - 1.0);
+  auto dalpha = prev_alpha_ * (4.0 * s - 3.0) + next_alpha_ * (4.0 * s - 1.0) - 8.0 * s + 4.0;
+  auto beta = prev_beta_ * 2.0 * (s - 1.0) * (s - 0.5) + next_beta_ * 2.0 * s * (s - 0.5);
+  auto dbeta = prev_beta_ * (4.0 * s - 3.0) + next_beta_ * (4.0 * s - 1.0);
+
+  auto cross = (n ^ t) * alpha + t * beta;
+  auto dcross = ((dn ^ t) + (n ^ dt)) * alpha + (n ^ t) * dalpha + dt * beta + t * dbeta;
+  return dcross * size + cross * dsize;
+}
+
 } // namespace Transfinite
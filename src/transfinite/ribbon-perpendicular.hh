@@ -7,10 +7,16 @@ namespace Transfinite {
 class RibbonPerpendicular : public Ribbon {
 public:
   virtual ~RibbonPerpendicular();
+  virtual std::shared_ptr<Ribbon> clone() const override;
   virtual void update() override;
   virtual Vector3D crossDerivative(double s) const override;
+  virtual Frame frame(double s) const override;
+  virtual Vector3D twist(double s) const override;
 
 protected:
+  // Cross-derivative with the unit tangent and the normal at `s` already known
+  Vector3D crossDerivative(double s, const Vector3D &t, const Vector3D &n) const;
+
   double prev_alpha_, prev_beta_, prev_norm_;
   double next_alpha_, next_beta_, next_norm_;
 };
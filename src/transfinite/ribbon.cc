@@ -1,13 +1,34 @@
+#include <algorithm>
+#include <cmath>
+
+#include "curve-metrics.hh"
 #include "ribbon.hh"
+#include "utilities.hh"
 
 namespace Transfinite {
 
-Ribbon::Ribbon() : multiplier_(1.0), handler_initialized_(false) {
+Ribbon::Ribbon()
+  : multiplier_(1.0), rmf_resolution_(RMF::default_resolution), adaptive_arc_length_(false),
+    handler_initialized_(false), modified_(true),
+    position_error_(0.0), cross_error_(0.0) {
 }
 
 Ribbon::~Ribbon() {
 }
 
+std::shared_ptr<Ribbon>
+Ribbon::snapshot() const {
+  auto result = clone();
+  result->curve_ = std::make_shared<BSCurve>(*curve_);
+  return result;
+}
+
+void
+Ribbon::relink(const std::shared_ptr<Ribbon> &prev, const std::shared_ptr<Ribbon> &next) {
+  prev_ = prev;
+  next_ = next;
+}
+
 std::shared_ptr<const BSCurve>
 Ribbon::curve() const {
   return curve_;
@@ -21,12 +42,14 @@ Ribbon::curve() {
 void
 Ribbon::setCurve(const std::shared_ptr<BSCurve> &curve) {
   curve_ = curve;
+  modified_ = true;
 }
 
 void
 Ribbon::setNeighbors(const std::shared_ptr<Ribbon> &prev, const std::shared_ptr<Ribbon> &next) {
   prev_ = prev;
   next_ = next;
+  modified_ = true;
 }
 
 double
@@ -37,6 +60,7 @@ Ribbon::multiplier() const {
 void
 Ribbon::setMultiplier(double m) {
   multiplier_ = m;
+  modified_ = true;
 }
 
 std::optional<Vector3D>
@@ -51,52 +75,180 @@ Ribbon::setHandler(const Vector3D &h) {
   handler_ = h;
   handler_.normalize();
   handler_initialized_ = true;
+  modified_ = true;
 }
 
 void
 Ribbon::overrideNormalFence(const std::shared_ptr<NormalFence> &fence) {
   normal_fence_ = fence;
+  modified_ = true;
+}
+
+size_t
+Ribbon::rmfResolution() const {
+  return rmf_resolution_;
+}
+
+void
+Ribbon::setRMFResolution(size_t resolution) {
+  rmf_resolution_ = std::max<size_t>(resolution, 1);
+  modified_ = true;
+}
+
+bool
+Ribbon::adaptiveArcLength() const {
+  return adaptive_arc_length_;
+}
+
+void
+Ribbon::useAdaptiveArcLength(bool use) {
+  adaptive_arc_length_ = use;
+  modified_ = true;
 }
 
 void
 Ribbon::reset() {
   multiplier_ = 1.0;
   handler_initialized_ = false;
+  modified_ = true;
 }
 
-void
-Ribbon::update() {
-  Vector3D normal;
-  VectorVector der;
-  rmf_.setCurve(curve_);
-
-  prev_.lock()->curve_->eval(1.0, 1, der);
-  normal = der[1];
-  curve_->eval(0.0, 1, der);
-  normal = normal ^ der[1];
-  normal.normalize();
-  rmf_.setStart(normal);
+// The curves may be edited in place, so they are compared with a copy
+bool
+Ribbon::modified() const {
+  if (modified_)
+    return true;
+  return !sameCurve(*curve_, updated_curve_);
+}
 
-  curve_->eval(1.0, 1, der);
-  normal = der[1];
-  next_.lock()->curve_->eval(0.0, 1, der);
-  normal = normal ^ der[1];
-  normal.normalize();
-  rmf_.setEnd(normal);
+size_t
+Ribbon::dependencyRange() const {
+  return 1;
+}
 
-  rmf_.update();
+void
+Ribbon::update() {
+  auto metrics = curveMetrics(curve_);
+  Vector3D start = curveMetrics(prev_.lock()->curve_)->end_tangent ^ metrics->start_tangent;
+  Vector3D end = metrics->end_tangent ^ curveMetrics(next_.lock()->curve_)->start_tangent;
+  rmf_ = sharedRMF(curve_, start.normalize(), end.normalize(),
+                   rmf_resolution_, adaptive_arc_length_);
+
+  updated_curve_ = *curve_;
+  modified_ = false;
 }
 
 Point3D
 Ribbon::eval(const Point2D &sd) const {
-  return curve_->eval(sd[0]) + crossDerivative(sd[0]) * sd[1];
+  if (!samples_.empty() && sd[0] >= 0.0 && sd[0] <= 1.0)
+    return evalSampled(sd[0], sd[1]);
+  Frame f = frame(sd[0]);
+  return f.point + f.cross * sd[1];
+}
+
+Point3D
+Ribbon::evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const {
+  // The derivatives are always exact, even when the point is sampled
+  Frame f = frame(sd[0]);
+  ds = f.tangent + twist(sd[0]) * sd[1];
+  dd = f.cross;
+  if (!samples_.empty())
+    return eval(sd);
+  return f.point + f.cross * sd[1];
+}
+
+Ribbon::Frame
+Ribbon::frame(double s) const {
+  Frame f;
+  Vector3D der[2];
+  f.point = evalCurve(*curve_, s, 1, der);
+  f.tangent = der[1];
+  f.normal = normal(s);
+  f.cross = crossDerivative(s);
+  return f;
 }
 
 Vector3D
 Ribbon::normal(double s) const {
   if (normal_fence_)
     return normal_fence_->operator()(s);
-  return rmf_.eval(s);
+  return rmf_->eval(s);
+}
+
+Vector3D
+Ribbon::twist(double s) const {
+  static const double step = 1.0e-4;
+  double h = s + step > 1.0 ? -step : step;
+  return (crossDerivative(s + h) - crossDerivative(s)) / h;
+}
+
+Vector3D
+Ribbon::normalDerivative(double s) const {
+  static const double step = 1.0e-4;
+  if (normal_fence_) {
+    double h = s + step > 1.0 ? -step : step;
+    return (normal_fence_->operator()(s + h) - normal_fence_->operator()(s)) / h;
+  }
+  return rmf_->derivative(s);
+}
+
+size_t
+Ribbon::sampling() const {
+  return samples_.empty() ? 0 : samples_.size() - 1;
+}
+
+void
+Ribbon::updateSampling(size_t samples) {
+  samples_.clear();
+  position_error_ = cross_error_ = 0.0;
+  if (samples == 0)
+    return;
+
+  // The derivative of the cross-derivative is the twist
+  double step = 1.0 / samples;
+  std::vector<Sample> table(samples + 1);
+  for (size_t i = 0; i <= samples; ++i) {
+    double s = (double)i / (double)samples;
+    Frame f = frame(s);
+    table[i].p = f.point;
+    table[i].dp = f.tangent * step;
+    table[i].c = f.cross;
+    table[i].dc = twist(s) * step;
+  }
+  samples_ = std::move(table);
+
+  // The error is measured at the midpoints, where it is (nearly) maximal
+  for (size_t i = 0; i < samples; ++i) {
+    double s = (i + 0.5) / samples;
+    Frame f = frame(s);
+    Point3D q = evalSampled(s, 0.0), r = evalSampled(s, 1.0);
+    position_error_ = std::max(position_error_, (q - f.point).norm());
+    cross_error_ = std::max(cross_error_, ((r - q) - f.cross).norm());
+  }
+}
+
+const std::vector<Ribbon::Sample> &
+Ribbon::samples() const {
+  return samples_;
+}
+
+double
+Ribbon::samplingError(double d) const {
+  return position_error_ + cross_error_ * std::abs(d);
+}
+
+Point3D
+Ribbon::evalSampled(double s, double d) const {
+  size_t samples = samples_.size() - 1;
+  double x = s * samples;
+  size_t i = std::min((size_t)x, samples - 1);
+  double t = x - i, t1 = 1.0 - t;
+  double h0 = t1 * t1 * (1.0 + 2.0 * t), h1 = t1 * t1 * t;
+  double h2 = t1 * t * t, h3 = t * t * (3.0 - 2.0 * t);
+  const Sample &a = samples_[i], &b = samples_[i+1];
+  Point3D p = a.p * h0 + a.dp * h1 - b.dp * h2 + b.p * h3;
+  Vector3D c = a.c * h0 + a.dc * h1 - b.dc * h2 + b.c * h3;
+  return p + c * d;
 }
 
 } // namespace Transfinite
@@ -12,8 +12,21 @@ using NormalFence = std::function<Vector3D(double)>;
 
 class Ribbon {
 public:
+  // Boundary point, tangent, normal and cross-derivative at a given parameter
+  struct Frame {
+    Point3D point;
+    Vector3D tangent, normal, cross;
+  };
+
   Ribbon();
   virtual ~Ribbon();
+  // Plain copy, sharing the curve
+  virtual std::shared_ptr<Ribbon> clone() const = 0;
+  // Copy with a private copy of the curve, for Surface::snapshot();
+  // its neighbors are set by relink(), once all ribbons of the surface are copied
+  std::shared_ptr<Ribbon> snapshot() const;
+  // Sets the neighbors, keeping everything computed by update()
+  virtual void relink(const std::shared_ptr<Ribbon> &prev, const std::shared_ptr<Ribbon> &next);
   std::shared_ptr<const BSCurve> curve() const;
   std::shared_ptr<BSCurve> curve();
   void setCurve(const std::shared_ptr<BSCurve> &curve);
@@ -23,20 +36,60 @@ public:
   std::optional<Vector3D> handler() const;
   void setHandler(const Vector3D &h);
   void overrideNormalFence(const std::shared_ptr<NormalFence> &fence);
+  // Settings of the rotation-minimizing frame of the normals (see RMF)
+  size_t rmfResolution() const;
+  void setRMFResolution(size_t resolution);
+  bool adaptiveArcLength() const;
+  void useAdaptiveArcLength(bool use);
   void reset();
+  // True when the curve or a setting has changed since the last update()
+  bool modified() const;
+  // Number of neighbors on each side whose curves are used by update()
+  virtual size_t dependencyRange() const;
   virtual void update();
   virtual Vector3D crossDerivative(double s) const = 0;
+  // Computes everything in one pass, sharing the curve and normal evaluations
+  virtual Frame frame(double s) const;
+  // Derivative of crossDerivative() with respect to s
+  // (the default is a one-sided finite difference towards the inside of [0, 1])
+  virtual Vector3D twist(double s) const;
   virtual Point3D eval(const Point2D &sd) const;
+  // Also computes the partial derivatives with respect to s (ds) and d (dd)
+  virtual Point3D evalDerivatives(const Point2D &sd, Vector3D &ds, Vector3D &dd) const;
   Vector3D normal(double s) const;
+  Vector3D normalDerivative(double s) const;
+  // Tabulates the ribbon at `samples` + 1 points, to be Hermite-interpolated by eval()
+  // (0 turns this off); should be called after update()
+  void updateSampling(size_t samples);
+  size_t sampling() const;
+  // Estimated maximal deviation of the sampled eval({s, d}) from the exact one
+  double samplingError(double d = 1.0) const;
+  // Values and derivatives (scaled by the sampling step) of the curve and the cross-derivative
+  struct Sample {
+    Point3D p;
+    Vector3D dp, c, dc;
+  };
+  // The table of updateSampling(), e.g. for copying into a FastEvaluator
+  const std::vector<Sample> &samples() const;
 
 protected:
   std::shared_ptr<BSCurve> curve_;
   std::weak_ptr<Ribbon> prev_, next_;
-  RMF rmf_;
+  std::shared_ptr<const RMF> rmf_; // see sharedRMF
   std::shared_ptr<NormalFence> normal_fence_;
   Vector3D handler_;
   double multiplier_;
-  bool handler_initialized_;
+  size_t rmf_resolution_;
+  bool adaptive_arc_length_;
+  bool handler_initialized_, modified_;
+
+private:
+  Point3D evalSampled(double s, double d) const;
+
+  std::vector<Sample> samples_;
+  double position_error_, cross_error_;
+  BSCurve updated_curve_; // copy of the curve as of the last update
+
 };
 
 } // namespace Transfinite
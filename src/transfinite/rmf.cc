@@ -1,12 +1,18 @@
 #include <algorithm>
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
 
+#include "curve-metrics.hh"
+#include "profiler.hh"
 #include "rmf.hh"
 #include "utilities.hh"
 
 namespace Transfinite {
 
-const size_t RMF::resolution_ = 100;
+RMF::RMF() : resolution_(default_resolution), adaptive_arc_length_(false) {
+}
 
 void
 RMF::setCurve(const std::shared_ptr<BSCurve> &c) {
@@ -23,43 +29,104 @@ RMF::setEnd(const Vector3D &end) {
   end_ = end;
 }
 
+void
+RMF::setResolution(size_t resolution) {
+  resolution_ = std::max<size_t>(resolution, 1);
+}
+
+void
+RMF::useAdaptiveArcLength(bool use) {
+  adaptive_arc_length_ = use;
+}
+
 void
 RMF::update() {
+  TRANSFINITE_TIMER("RMF::update");
   // As described in `Computation of Rotation Minimizing Frames', Wang et al., 2008.
   // A limitation of this method is that it is determined by the starting frame
   // and the curve tangents, so an end frame cannot be supplied.
-  frames_.clear();
-  frames_.reserve(resolution_ + 1);
-  VectorVector der; curve_->eval(0.0, 1, der);
-  Frame f(0.0, 0.0, der[0], der[1].normalize(), start_);
+
+  // The curve is evaluated once at each sample, and this is shared
+  // by the frame computation, the arc lengths and the normal derivatives
+  std::vector<VectorVector> ders(resolution_ + 1);
+  for (size_t i = 0; i <= resolution_; ++i)
+    curve_->eval((double)i / (double)resolution_, 2, ders[i]);
+  DoubleVector lengths = arcLengths(ders);
+
+  std::vector<Frame> frames;
+  frames.reserve(resolution_ + 1);
+  Frame f(0.0, 0.0, ders[0][0], Vector3D(ders[0][1]).normalize(), start_);
   for (size_t i = 1; i <= resolution_; ++i) {
     double u = (double)i / (double)resolution_;
-    frames_.push_back(f);
-    f = nextFrame(f, u);
+    frames.push_back(f);
+    f = nextFrame(f, u, ders[i][0], Vector3D(ders[i][1]).normalize(), lengths[i]);
   }
-  frames_.push_back(f);
+  frames.push_back(f);
 
   // As a workaround, we can add a rotation gradually,
   // by minimizing the total squared angular speed, see section 6.3 in the paper.
   const Vector3D &rmfEnd = f.n;
-  angleCorrection_ = std::acos(inrange(-1, end_ * rmfEnd, 1));
+  double angle_correction = std::acos(inrange(-1, end_ * rmfEnd, 1));
   if (((rmfEnd - end_) ^ end_) * f.d < 0.0)
-    angleCorrection_ *= -1.0;
-  angleCorrection_ /= f.s;
+    angle_correction *= -1.0;
+  angle_correction /= f.s;
+
+  // The corrected frames are tabulated, to be interpolated by eval().
+  // The derivative of the normal consists of the rotation-minimizing part,
+  // which has no component around the tangent, and the gradual rotation of the correction.
+  samples_.resize(resolution_ + 1);
+  double step = 1.0 / resolution_;
+  for (size_t i = 0; i <= resolution_; ++i) {
+    Frame &fi = frames[i];
+    rotateFrame(fi, fi.s * angle_correction);
+    const VectorVector &der = ders[i];
+    double speed = der[1].norm();
+    samples_[i].n = fi.n;
+    if (speed < epsilon) {
+      samples_[i].dn = Vector3D(0, 0, 0);
+      continue;
+    }
+    Vector3D t = der[1] / speed;
+    Vector3D dt = (der[2] - t * (der[2] * t)) / speed;
+    samples_[i].dn = (t * -(fi.n * dt) + (t ^ fi.n) * (angle_correction * speed)) * step;
+  }
 }
 
 Vector3D
 RMF::eval(double u) const {
-  auto i = std::upper_bound(frames_.begin(), frames_.end(), u,
-                            [](double x, const Frame &f) { return x < f.u; });
-  Frame f = nextFrame(*(--i), u);
-  rotateFrame(f, f.s * angleCorrection_);
-  return f.n;
+  // Cubic Hermite interpolation between the neighboring samples
+  // (parameters outside [0, 1] are clamped)
+  double x = inrange(0, u, 1) * resolution_;
+  size_t i = std::min((size_t)x, resolution_ - 1);
+  double t = x - i, t1 = 1.0 - t;
+  const Sample &a = samples_[i], &b = samples_[i+1];
+  Vector3D n = a.n * (t1 * t1 * (1.0 + 2.0 * t)) + a.dn * (t1 * t1 * t)
+    + b.n * (t * t * (3.0 - 2.0 * t)) - b.dn * (t1 * t * t);
+  return n.normalize();
 }
 
-const RMF::Matrix3x3 &
+Vector3D
+RMF::derivative(double u) const {
+  if (u < 0.0 || u > 1.0)
+    return Vector3D(0, 0, 0);
+  double x = u * resolution_;
+  size_t i = std::min((size_t)x, resolution_ - 1);
+  double t = x - i, t1 = 1.0 - t;
+  const Sample &a = samples_[i], &b = samples_[i+1];
+  Vector3D n = a.n * (t1 * t1 * (1.0 + 2.0 * t)) + a.dn * (t1 * t1 * t)
+    + b.n * (t * t * (3.0 - 2.0 * t)) - b.dn * (t1 * t * t);
+  Vector3D dn = (b.n - a.n) * (6.0 * t * t1) + a.dn * (t1 * (1.0 - 3.0 * t))
+    - b.dn * (t * (2.0 - 3.0 * t));
+  dn *= resolution_;
+  // Derivative of the normalized vector
+  double length = n.norm();
+  n /= length;
+  return (dn - n * (n * dn)) / length;
+}
+
+RMF::Matrix3x3
 RMF::rotationMatrix(const Vector3D &u, double theta) {
-  static Matrix3x3 m;
+  Matrix3x3 m;
 
   double x = u[0], y = u[1], z = u[2];
   double c = std::cos(theta), c1 = 1.0 - c, s = std::sin(theta);
@@ -78,7 +145,7 @@ RMF::rotationMatrix(const Vector3D &u, double theta) {
 
 void
 RMF::rotateFrame(Frame &f, double angle) {
-  const Matrix3x3 &r = rotationMatrix(f.d, angle);
+  Matrix3x3 r = rotationMatrix(f.d, angle);
   Vector3D n(0.0, 0.0, 0.0);
   for (size_t i = 0; i < 3; ++i)
     for (size_t j = 0; j < 3; ++j)
@@ -87,24 +154,156 @@ RMF::rotateFrame(Frame &f, double angle) {
 }
 
 RMF::Frame
-RMF::nextFrame(const Frame &prev, double u) const {
-  VectorVector der; curve_->eval(u, 1, der);
-  der[1].normalize();
-  Vector3D v1 = der[0] - prev.p;
+RMF::nextFrame(const Frame &prev, double u, const Point3D &p, const Vector3D &d, double s) const {
+  Vector3D v1 = p - prev.p;
   double c1 = v1.normSqr();
   if (c1 < epsilon)
     return prev;
   Vector3D v2 = v1 * 2 / c1;
   Vector3D nL = prev.n - v2 * (v1 * prev.n);
   Vector3D dL = prev.d - v2 * (v1 * prev.d);
-  v2 = der[1] - dL;
+  v2 = d - dL;
   double c2 = v2.normSqr();
   Vector3D nNext;
   if (c2 < epsilon)
     nNext = nL;
   else
     nNext = nL - v2 * 2 / c2 * (v2 * nL);
-  return Frame(u, prev.s + curve_->arcLength(prev.u, u), der[0], der[1], nNext);
+  return Frame(u, s, p, d, nNext);
+}
+
+// Cumulative arc length at the samples.
+// By default each segment is integrated by the Hermite (corrected trapezoidal) rule,
+// which needs only the speed and its derivative at the ends, and has O(h^5) error.
+DoubleVector
+RMF::arcLengths(const std::vector<VectorVector> &ders) const {
+  DoubleVector lengths(resolution_ + 1, 0.0);
+  double h = 1.0 / resolution_;
+  if (adaptive_arc_length_) {
+    for (size_t i = 1; i <= resolution_; ++i)
+      lengths[i] = lengths[i-1] + adaptiveArcLength((i - 1) * h, i * h, 1.0e-12, 0);
+    return lengths;
+  }
+  DoubleVector speed(resolution_ + 1), dspeed(resolution_ + 1);
+  for (size_t i = 0; i <= resolution_; ++i) {
+    speed[i] = ders[i][1].norm();
+    dspeed[i] = speed[i] < epsilon ? 0.0 : ders[i][1] * ders[i][2] / speed[i];
+  }
+  for (size_t i = 1; i <= resolution_; ++i)
+    lengths[i] = lengths[i-1] + h / 2.0 * (speed[i-1] + speed[i])
+      + h * h / 12.0 * (dspeed[i-1] - dspeed[i]);
+  return lengths;
+}
+
+// Adaptive 7-15 point Gauss-Kronrod quadrature of the speed
+double
+RMF::adaptiveArcLength(double from, double to, double tolerance, size_t depth) const {
+  static const double xk[] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.0
+  };
+  static const double wk[] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+  };
+  static const double wg[] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+  };
+
+  double center = (from + to) / 2.0, half = (to - from) / 2.0;
+  VectorVector der;
+  auto speed = [&](double x) {
+    curve_->eval(center + half * x, 1, der);
+    return der[1].norm();
+  };
+  double kronrod = 0.0, gauss = 0.0;
+  for (size_t j = 0; j < 7; ++j) {
+    double f = speed(xk[j]) + speed(-xk[j]);
+    kronrod += wk[j] * f;
+    if (j % 2 == 1)
+      gauss += wg[j / 2] * f;
+  }
+  double f0 = speed(0.0);
+  kronrod += wk[7] * f0;
+  gauss += wg[3] * f0;
+  kronrod *= half;
+  gauss *= half;
+
+  if (std::abs(kronrod - gauss) <= tolerance * std::max(kronrod, 1.0) || depth >= 20)
+    return kronrod;
+  return adaptiveArcLength(from, center, tolerance / 2.0, depth + 1) +
+    adaptiveArcLength(center, to, tolerance / 2.0, depth + 1);
+}
+
+namespace {
+
+  struct Entry {
+    std::weak_ptr<const BSCurve> curve;
+    BSCurve state;              // as of the computation of the frames
+    Vector3D start, end;
+    std::shared_ptr<const RMF> rmf;
+  };
+
+  // Curve, resolution and adaptive arc length
+  using Key = std::tuple<const BSCurve *, size_t, bool>;
+
+  struct Registry {
+    std::mutex mutex;
+    std::map<Key, Entry> entries;
+    size_t prune_size = 64;     // expired entries are dropped when the table grows beyond this
+  };
+
+  Registry &registry() {
+    static Registry r;
+    return r;
+  }
+
+  bool sameVector(const Vector3D &u, const Vector3D &v) {
+    return u[0] == v[0] && u[1] == v[1] && u[2] == v[2];
+  }
+
+}
+
+std::shared_ptr<const RMF>
+sharedRMF(const std::shared_ptr<BSCurve> &curve, const Vector3D &start, const Vector3D &end,
+          size_t resolution, bool adaptive_arc_length) {
+  resolution = std::max<size_t>(resolution, 1); // as in RMF::setResolution
+  Key key{ curve.get(), resolution, adaptive_arc_length };
+  Registry &r = registry();
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.entries.find(key);
+    if (it != r.entries.end() && it->second.curve.lock() == curve &&
+        sameVector(it->second.start, start) && sameVector(it->second.end, end) &&
+        sameCurve(it->second.state, *curve))
+      return it->second.rmf;
+  }
+
+  // Computed outside the lock; concurrent users of the same curve may compute it more than once
+  auto rmf = std::make_shared<RMF>();
+  rmf->setCurve(curve);
+  rmf->setStart(start);
+  rmf->setEnd(end);
+  rmf->setResolution(resolution);
+  rmf->useAdaptiveArcLength(adaptive_arc_length);
+  rmf->update();
+  rmf->setCurve(nullptr);       // the samples are enough for the evaluation
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.entries[key] = { curve, *curve, start, end, rmf };
+  if (r.entries.size() > r.prune_size) {
+    for (auto it = r.entries.begin(); it != r.entries.end(); )
+      if (it->second.curve.expired())
+        it = r.entries.erase(it);
+      else
+        ++it;
+    r.prune_size = std::max<size_t>(64, 2 * r.entries.size());
+  }
+  return rmf;
 }
 
 } // namespace Transfinite
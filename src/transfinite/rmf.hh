@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "geometry.hh"
 
 namespace Transfinite {
@@ -8,11 +10,18 @@ using namespace Geometry;
 
 class RMF {
 public:
+  static constexpr size_t default_resolution = 100;
+
+  RMF();
   void setCurve(const std::shared_ptr<BSCurve> &c);
   void setStart(const Vector3D &start);
   void setEnd(const Vector3D &end);
+  void setResolution(size_t resolution);
+  void useAdaptiveArcLength(bool use);
   void update();
   Vector3D eval(double u) const;
+  // Derivative of eval() (zero outside [0, 1], where the normal is constant)
+  Vector3D derivative(double u) const;
 
 private:
   struct Frame {
@@ -23,16 +32,32 @@ private:
     Point3D p;
     Vector3D d, n;
   };
+  // Corrected normal at u = i / resolution_, and its derivative scaled by the step
+  struct Sample {
+    Vector3D n, dn;
+  };
   using Matrix3x3 = std::array<std::array<double, 3>, 3>;
-  static const Matrix3x3 &rotationMatrix(const Vector3D &u, double theta);
+  static Matrix3x3 rotationMatrix(const Vector3D &u, double theta);
   static void rotateFrame(Frame &f, double angle);
-  Frame nextFrame(const Frame &prev, double u) const;
+  Frame nextFrame(const Frame &prev, double u, const Point3D &p, const Vector3D &d, double s) const;
+  DoubleVector arcLengths(const std::vector<VectorVector> &ders) const;
+  double adaptiveArcLength(double from, double to, double tolerance, size_t depth) const;
 
-  const static size_t resolution_;
+  size_t resolution_;
+  bool adaptive_arc_length_;
   std::shared_ptr<BSCurve> curve_;
   Vector3D start_, end_;
-  std::vector<Frame> frames_;
-  double angleCorrection_;
+  std::vector<Sample> samples_;
 };
 
+// Frames of the current state of the curve with the given end normals and settings, shared by
+// the ribbons on the same curve object and with the same ends (e.g. of surfaces of different
+// types on one loop, see LoopContext), so they are computed once for each change; as
+// curveMetrics, with one entry for each curve and settings. The shared frames do not keep the
+// curve. Thread-safe.
+std::shared_ptr<const RMF> sharedRMF(const std::shared_ptr<BSCurve> &curve,
+                                     const Vector3D &start, const Vector3D &end,
+                                     size_t resolution = RMF::default_resolution,
+                                     bool adaptive_arc_length = false);
+
 } // namespace Transfinite
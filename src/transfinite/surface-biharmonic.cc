@@ -1,4 +1,7 @@
-#include <exception>
+#include <algorithm>
+#include <future>
+#include <map>
+#include <mutex>
 
 #include <Eigen/Geometry>
 #include <Eigen/Sparse>
@@ -13,8 +16,13 @@ extern "C" {
 }
 #endif // HAVE_LIBTRIANGLE
 
+#include "curvature.hh"
+#include "curve-metrics.hh"
 #include "domain-angular.hh"
+#include "locator.hh"
+#include "multigrid-solver.hh"
 #include "parameterization-barycentric.hh"
+#include "profiler.hh"
 #include "ribbon-compatible.hh"
 #include "surface-biharmonic.hh"
 #include "utilities.hh"
@@ -32,38 +40,141 @@ using DomainType = DomainAngular;
 using ParamType = ParameterizationBarycentric;
 using RibbonType = RibbonCompatible;
 
-SurfaceBiharmonic::SurfaceBiharmonic() {
+// Kept for each resolution (and domain mesh type) until their inputs change:
+// the domain mesh with the factorized propagation system depends only on the domain
+// (or on the boundary samples triangulated by libtriangle); the propagated surface with
+// the final system only on the boundary points, so a change of the normals needs no factorization.
+// In multigrid and interactive modes the last solutions are also kept, as the initial guesses
+// of the next ones. In interactive mode a propagated surface may be a preview: its final matrix
+// is kept with the solver of an earlier one, and it is factorized only when the mode is left.
+// The entries are limited as the domain parameters (see Surface::setCacheLimits).
+struct SurfaceBiharmonic::SolutionCache {
+  struct Mesh {
+    Point2DVector key;
+    double max_area;
+    TriMesh mesh;
+    Incidence incidence;
+    PointVector uvs3d;
+    std::function<bool(size_t)> on_edge;
+    std::function<std::pair<size_t, double>(size_t)> vertex_boundary;
+    std::vector<size_t> boundary;
+    bool multigrid;                     // the solvers have prolongations
+    std::vector<SparseMatrix<double>> prolongations;
+    std::unique_ptr<MultigridSolver> propagation;
+  };
+  struct Propagated {
+    MatrixXd boundary_points, Vstar;
+    DoubleVector areas;
+    SparseMatrix<double> L;
+    std::shared_ptr<const MultigridSolver> system;
+    bool preview = false;
+    SparseMatrix<double, RowMajor> A;   // the final matrix of a preview, in the solver's order
+  };
+  struct Solutions {
+    MatrixXd points, normals, surface;
+  };
+  struct Entry {
+    std::shared_ptr<const Mesh> mesh;
+    std::shared_ptr<const Propagated> propagated;
+    Solutions solutions;
+    uint64_t last_use = 0;
+  };
+  std::map<std::pair<size_t, bool>, Entry> entries; // by (resolution, uniform)
+  uint64_t clock = 0;
+  std::shared_ptr<const MeshInterpolant> interpolant; // for eval(uv), until the next update
+  std::mutex mutex;
+};
+
+SurfaceBiharmonic::SurfaceBiharmonic()
+  : solutions_(std::make_shared<SolutionCache>()), use_multigrid_(false), interactive_(false),
+    preview_iterations_(4), eval_resolution_(64) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  pointwise_mesh_ = false;
 }
 
 SurfaceBiharmonic::~SurfaceBiharmonic() {
 }
 
+std::shared_ptr<Surface>
+SurfaceBiharmonic::clone() const {
+  return std::make_shared<SurfaceBiharmonic>(*this);
+}
+
+// The snapshot gets a copy of the cache, as the two would replace each other's entries
+void
+SurfaceBiharmonic::detach() {
+  Surface::detach();
+  auto solutions = std::make_shared<SolutionCache>();
+  {
+    std::lock_guard<std::mutex> lock(solutions_->mutex);
+    solutions->entries = solutions_->entries;
+    solutions->interpolant = solutions_->interpolant;
+  }
+  solutions_ = solutions;
+}
+
+void
+SurfaceBiharmonic::update(size_t i) {
+  Surface::update(i);
+  std::lock_guard<std::mutex> lock(solutions_->mutex);
+  solutions_->interpolant.reset();
+}
+
+void
+SurfaceBiharmonic::update() {
+  Surface::update();
+  std::lock_guard<std::mutex> lock(solutions_->mutex);
+  solutions_->interpolant.reset();
+}
+
+// The mesh is computed on the uniform domain mesh, as the points of the other one
+// are not in the domain
 Point3D
 SurfaceBiharmonic::eval(const Point2D &uv) const {
-  throw std::runtime_error("single-point evaluation is not supported for biharmonic surfaces");
+  std::shared_ptr<const MeshInterpolant> interpolant;
+  {
+    std::lock_guard<std::mutex> lock(solutions_->mutex);
+    interpolant = solutions_->interpolant;
+  }
+  if (!interpolant) {
+    // Concurrent first calls may compute it more than once, but with the same result
+    interpolant = std::make_shared<MeshInterpolant>(domain_->locator(eval_resolution_),
+                                                    solve(eval_resolution_, true).points());
+    std::lock_guard<std::mutex> lock(solutions_->mutex);
+    solutions_->interpolant = interpolant;
+  }
+  return interpolant->eval(uv);
 }
 
-static SparseMatrix<double> laplaceMatrix(const TriMesh &mesh, const PointVector &uvs) {
-  size_t n_all = uvs.size();
+void
+SurfaceBiharmonic::useMultigrid(bool use) {
+  use_multigrid_ = use;
+}
 
-  // Set up valences
-  std::vector<size_t> valences(n_all, 0);
-  for (const auto &t : mesh.triangles())
-    for (auto i : t)
-      valences[i]++;
+// Leaving the mode also drops the interpolant, which may be computed from a preview
+void
+SurfaceBiharmonic::setInteractive(bool interactive, size_t iterations) {
+  interactive_ = interactive;
+  preview_iterations_ = iterations;
+  std::lock_guard<std::mutex> lock(solutions_->mutex);
+  solutions_->interpolant.reset();
+}
 
-  // Sparse matrix handling
-  SparseMatrix<double> Ls(n_all, n_all);
-  VectorXd nnz(n_all);
-  for (size_t i = 0; i < n_all; ++i)
-    nnz(i) = valences[i] + 1;
-  Ls.makeCompressed();
-  Ls.reserve(nnz);
+void
+SurfaceBiharmonic::setEvaluationResolution(size_t resolution) {
+  eval_resolution_ = resolution;
+  std::lock_guard<std::mutex> lock(solutions_->mutex);
+  solutions_->interpolant.reset();
+}
 
-  // Laplacian coeficients
+// Assembled from a triplet list in one pass (duplicates are summed by setFromTriplets)
+static SparseMatrix<double> laplaceMatrix(const TriMesh &mesh, const PointVector &uvs) {
+  size_t n_all = uvs.size();
+
+  std::vector<Triplet<double>> triplets;
+  triplets.reserve(mesh.triangles().size() * 9);
   for (const auto &t : mesh.triangles()) {
     auto p1 = uvs[t[0]], p2 = uvs[t[1]], p3 = uvs[t[2]];
     auto a = p3 - p2, b = p1 - p3, c = p2 - p1;
@@ -72,114 +183,68 @@ static SparseMatrix<double> laplaceMatrix(const TriMesh &mesh, const PointVector
     double v2_cot = -0.5 * (c * a) / Ai;
     double v3_cot = -0.5 * (a * b) / Ai;
 
-    Ls.coeffRef(t[0], t[0]) += v3_cot + v2_cot;
-    Ls.coeffRef(t[0], t[1]) += -v3_cot;
-    Ls.coeffRef(t[0], t[2]) += -v2_cot;
+    triplets.emplace_back(t[0], t[0], v3_cot + v2_cot);
+    triplets.emplace_back(t[0], t[1], -v3_cot);
+    triplets.emplace_back(t[0], t[2], -v2_cot);
 
-    Ls.coeffRef(t[1], t[0]) += -v3_cot;
-    Ls.coeffRef(t[1], t[1]) += v3_cot + v1_cot;
-    Ls.coeffRef(t[1], t[2]) += -v1_cot;
+    triplets.emplace_back(t[1], t[0], -v3_cot);
+    triplets.emplace_back(t[1], t[1], v3_cot + v1_cot);
+    triplets.emplace_back(t[1], t[2], -v1_cot);
 
-    Ls.coeffRef(t[2], t[0]) += -v2_cot;
-    Ls.coeffRef(t[2], t[1]) += -v1_cot;
-    Ls.coeffRef(t[2], t[2]) += v2_cot + v1_cot;
+    triplets.emplace_back(t[2], t[0], -v2_cot);
+    triplets.emplace_back(t[2], t[1], -v1_cot);
+    triplets.emplace_back(t[2], t[2], v2_cot + v1_cot);
   }
 
+  SparseMatrix<double> Ls(n_all, n_all);
+  Ls.setFromTriplets(triplets.begin(), triplets.end());
   return Ls;
 }
 
-static double computeAngle(Vector3D u, Vector3D v) {
-  u.normalize(); v.normalize();
-  return std::acos(std::min(std::max(u * v, -1.0), 1.0));
-}
-
-static double voronoiArea(const Point3D &p1, const Point3D &p2, const Point3D &p3) {
-  double a2 = (p3 - p2).normSqr(), b2 = (p1 - p3).normSqr(), c2 = (p2 - p1).normSqr();
-  double alpha = computeAngle(p2 - p1, p3 - p1);
-
-  if (a2 + b2 < c2)                // obtuse gamma
-    return 0.125 * b2 * std::tan(alpha);
-  if (a2 + c2 < b2)                // obtuse beta
-    return 0.125 * c2 * std::tan(alpha);
-  if (b2 + c2 < a2) {              // obtuse alpha
-    double b = std::sqrt(b2), c = std::sqrt(c2);
-    double total_area = 0.5 * b * c * std::sin(alpha);
-    double beta = computeAngle(p1 - p2, p3 - p2);
-    double gamma = computeAngle(p1 - p3, p2 - p3);
-    return total_area - 0.125 * (b2 * std::tan(gamma) + c2 * std::tan(beta));
-  }
-
-  double r2 = 0.25 * a2 / std::pow(std::sin(alpha), 2); // squared circumradius
-  auto area = [r2](double x2) {
-    return 0.125 * std::sqrt(x2) * std::sqrt(std::max(4.0 * r2 - x2, 0.0));
-  };
-  return area(b2) + area(c2);
-}
-
-static DoubleVector voronoiAreas(const TriMesh &mesh, const PointVector &uvs) {
-  size_t n_all = uvs.size();
-  DoubleVector areas(n_all);
-  for (const auto &t : mesh.triangles()) {
-    auto p1 = uvs[t[0]], p2 = uvs[t[1]], p3 = uvs[t[2]];
-    areas[t[0]] += voronoiArea(p1, p2, p3);
-    areas[t[1]] += voronoiArea(p2, p3, p1);
-    areas[t[2]] += voronoiArea(p3, p1, p2);
-  }  
-  return areas;
-}
-
-static DoubleVector computeCurvatures(const TriMesh &mesh, const DoubleVector &areas,
+static DoubleVector computeCurvatures(const Incidence &incidence, const DoubleVector &areas,
                                       std::function<bool(size_t i)> on_edge,
-                                      const MatrixXd &points, const MatrixXd &normals) {
+                                      const MatrixXd &points, const MatrixXd &normals,
+                                      const Executor &executor) {
   size_t n_all = areas.size();
-  MatrixXd mean = MatrixXd::Zero(n_all, 3);
-  for (const auto &t : mesh.triangles()) {
-    auto addComponent = [&](size_t i1, size_t i2, size_t i3) {
-      const Vector3d &p1 = points.row(i1), &p2 = points.row(i2), &p3 = points.row(i3);
-      const Vector3d &n1 = normals.row(i1), &n2 = normals.row(i2), &n3 = normals.row(i3);
-      if (on_edge(i1)) {
-        if (on_edge(i2))
-          mean.row(i1) += (n1 * 2 + n2).normalized().cross(p2 - p1);
-        if (on_edge(i3))
-          mean.row(i1) += (n1 * 2 + n3).normalized().cross(p1 - p3);
-      }
-      mean.row(i1) += (n1 + n2 + n3).normalized().cross(p3 - p2);
-    };
-    addComponent(t[0], t[1], t[2]);
-    addComponent(t[1], t[2], t[0]);
-    addComponent(t[2], t[0], t[1]);
-  }
   DoubleVector result(n_all);
-  for (size_t i = 0; i < n_all; ++i)
-    result[i] = mean.row(i).norm() / (2 * areas[i]);
+  executor(n_all, [&](size_t begin, size_t end) {
+    for (size_t i1 = begin; i1 < end; ++i1) {
+      Vector3d mean = Vector3d::Zero();
+      for (auto [j, k] : incidence.corners[i1]) {
+        const auto &t = incidence.triangles[j];
+        size_t i2 = t[(k+1)%3], i3 = t[(k+2)%3];
+        const Vector3d &p1 = points.row(i1), &p2 = points.row(i2), &p3 = points.row(i3);
+        const Vector3d &n1 = normals.row(i1), &n2 = normals.row(i2), &n3 = normals.row(i3);
+        if (on_edge(i1)) {
+          if (on_edge(i2))
+            mean += (n1 * 2 + n2).normalized().cross(p2 - p1);
+          if (on_edge(i3))
+            mean += (n1 * 2 + n3).normalized().cross(p1 - p3);
+        }
+        mean += (n1 + n2 + n3).normalized().cross(p3 - p2);
+      }
+      result[i1] = mean.norm() / (2 * areas[i1]);
+    }
+  });
   return result;
 }
 
-static SparseMatrix<double> prepareSolver(const TriMesh &mesh, const PointVector &points,
-                                          const std::vector<size_t> &boundary, bool propagation) {
-  size_t n_all = points.size(), n_boundary = boundary.size();
-
+static SparseMatrix<double> prepareMatrix(const TriMesh &mesh, const Incidence &incidence,
+                                          const PointVector &points,
+                                          const std::vector<size_t> &boundary, bool propagation,
+                                          const Executor &executor) {
+  TRANSFINITE_TIMER("SurfaceBiharmonic::assemble");
   // Compute the required matrices
   SparseMatrix<double> Ls = laplaceMatrix(mesh, points);
-  auto areas = voronoiAreas(mesh, points);
+  auto areas = voronoiAreas(incidence, points, executor);
   Map<VectorXd> M(&areas[0], areas.size());
   DiagonalMatrix<double,Dynamic> M1 = M.asDiagonal().inverse();
   for (size_t b : boundary)
     M1.diagonal()(b) = 0;               // hack (private correspondence with T. Stanko)
   SparseMatrix<double> L = M1 * Ls;
 
-  // Set up the equations
-  SparseMatrix<double> A = propagation ? Ls * L : SparseMatrix<double>(L.transpose() * L);
-  A.conservativeResize(n_all + n_boundary, n_all + n_boundary);
-
-  // Add the lagrange multiplicator part
-  for (size_t j = 0; j < n_boundary; ++j) {
-    size_t i = boundary[j];
-    A.coeffRef(n_all + j, i) = 1;
-    A.coeffRef(i, n_all + j) = 1;
-  }
-
-  return A;
+  // Set up the equations (the boundary values are eliminated by the solver)
+  return propagation ? Ls * L : SparseMatrix<double>(L.transpose() * L);
 }
 
 [[maybe_unused]]
@@ -210,31 +275,30 @@ static Point2DVector projectToLSQPlane(const PointVector &pv) {
   return result;
 }
 
-[[maybe_unused]]
 auto
 SurfaceBiharmonic::generateDomainOld(size_t resolution) const {
   TriMesh mesh = domain_->meshTopology(resolution);
   Point2DVector uvs = domain_->parameters(resolution);
-  auto on_edge = [=](size_t i) { return domain_->onEdge(resolution, i); };
-  auto vertex_boundary = [=](size_t i) {
-    auto bc = dynamic_cast<ParameterizationBarycentric*>(param_.get())->barycentric(uvs[i]);
-    auto j = std::distance(bc.begin(), std::max_element(bc.begin(), bc.end()));
-    if (bc[next(j)] > bc[prev(j)])
-      j = next(j);
-    return std::make_pair(j, bc[j]);
+  auto boundary = domain_->meshBoundary(resolution); // kept by the functions
+  auto on_edge = [boundary](size_t i) { return (bool)boundary->on_edge[i]; };
+  auto vertex_boundary = [boundary](size_t i) {
+    auto it = std::lower_bound(boundary->vertices.begin(), boundary->vertices.end(), i,
+                               [](const Domain::BoundaryVertex &bv, size_t i) {
+                                 return bv.index < i;
+                               });
+    return std::make_pair(it->side, it->s);
   };
   return std::make_tuple(mesh, uvs, on_edge, vertex_boundary);
 }
 
-[[maybe_unused]]
-auto
-SurfaceBiharmonic::generateDomain(size_t resolution) const {
+Point2DVector
+SurfaceBiharmonic::boundarySamples(size_t resolution, double &max_area) const {
 #ifdef HAVE_LIBTRIANGLE
   PointVector points3d;
   double length = 0;
   for (size_t i = 0; i < domain_->size(); ++i) {
     auto curve = ribbons_[i]->curve();
-    length += curve->arcLength(curve->basis().low(), curve->basis().high());
+    length += curveMetrics(curve)->length; // the curves are normalized by setupLoop()
     for (size_t j = 0; j < resolution; ++j) {
       double u = (double)j / resolution;
       points3d.push_back(curve->eval(u));
@@ -242,9 +306,19 @@ SurfaceBiharmonic::generateDomain(size_t resolution) const {
   }
   length /= resolution * domain_->size();
 
-  auto projected = projectToLSQPlane(points3d);
-  double max_area = (length * length * std::sqrt(3.0)) / 4;
+  max_area = (length * length * std::sqrt(3.0)) / 4;
+  return projectToLSQPlane(points3d);
+#else  // !HAVE_LIBTRIANGLE
+  max_area = 0;
+  return domain_->vertices();
+#endif // HAVE_LIBTRIANGLE
+}
 
+[[maybe_unused]]
+auto
+SurfaceBiharmonic::generateDomain(size_t resolution, const Point2DVector &projected,
+                                  double max_area) const {
+#ifdef HAVE_LIBTRIANGLE
   // Input points
   size_t n = projected.size();
   DoubleVector points; points.reserve(2 * n);
@@ -310,78 +384,196 @@ SurfaceBiharmonic::generateDomain(size_t resolution) const {
 
 TriMesh
 SurfaceBiharmonic::eval(size_t resolution) const {
-  auto [mesh, uvs, on_edge, vertex_boundary] = generateDomain(resolution);
-  PointVector uvs3d;
-  std::transform(uvs.begin(), uvs.end(), std::back_inserter(uvs3d),
-                 [](const Point2D &p) { return Point3D(p[0], p[1], 0); });
-
-  size_t n_all = uvs.size();
-  PointVector points(n_all);
-  VectorVector normals(n_all);
-
-  // Set up boundary index map
-  std::vector<size_t> boundary;
-  for (size_t i = 0; i < n_all; ++i)
-    if (on_edge(i))
-      boundary.push_back(i);
-  size_t n_boundary = boundary.size();
+  // Multigrid needs the nested uniform meshes
+  return solve(resolution, use_multigrid_);
+}
 
-  // Fill the boundary points & normals
-  for (auto i : boundary) {
-    auto [j, u] = vertex_boundary(i);
-    points[i] = ribbons_[j]->curve()->eval(u);
-    normals[i] = ribbons_[j]->normal(u);
-  }
+FloatMesh
+SurfaceBiharmonic::evalFloat(size_t resolution) const {
+  return FloatMesh(eval(resolution));
+}
 
-  // Compute the system
-  auto A = prepareSolver(mesh, uvs3d, boundary, true);
-  SparseLU<SparseMatrix<double>> solver(A);
+// On the uniform mesh, as the points should correspond to Domain::parameters(resolution)
+void
+SurfaceBiharmonic::evalPoints(size_t resolution, const PointStore &store) const {
+  TriMesh mesh = solve(resolution, true);
+  store(0, mesh.points().size(), mesh.points().data());
+}
 
-  // Propagate the boundary points
-  MatrixXd b = MatrixXd::Zero(n_all + n_boundary, 3);
-  for (size_t j = 0; j < n_boundary; ++j)
-    b.row(n_all + j) = Map<const Vector3d>(points[boundary[j]].data());
-  MatrixXd Vstar = solver.solve(b);
+static bool
+samePoints(const Point2DVector &a, const Point2DVector &b) {
+  return a.size() == b.size() &&
+    std::equal(a.begin(), a.end(), b.begin(),
+               [](const Point2D &p, const Point2D &q) { return p[0] == q[0] && p[1] == q[1]; });
+}
 
-  // Propagate the normal vectors
-  b = MatrixXd::Zero(n_all + n_boundary, 3);
-  for (size_t j = 0; j < n_boundary; ++j)
-    b.row(n_all + j) = Map<const Vector3d>(normals[boundary[j]].data());
-  MatrixXd Nstar = solver.solve(b);
-  for (size_t i = 0; i < n_all; ++i)
-    Nstar.row(i) = Nstar.row(i).normalized();
+TriMesh
+SurfaceBiharmonic::solve(size_t resolution, bool uniform) const {
+  std::shared_ptr<const SolutionCache::Mesh> cmesh;
+  std::shared_ptr<const SolutionCache::Propagated> propagated;
+  SolutionCache::Solutions previous;
+  {
+    std::lock_guard<std::mutex> lock(solutions_->mutex);
+    const auto &entry = solutions_->entries[{resolution, uniform}];
+    cmesh = entry.mesh;
+    propagated = entry.propagated;
+    previous = entry.solutions;
+  }
 
-  // Recompute the matrices with the propagated surface
-  for (size_t i = 0; i < n_all; ++i)
-    points[i] = { Vstar(i, 0), Vstar(i, 1), Vstar(i, 2) };
-  auto A2 = prepareSolver(mesh, points, boundary, false);
-  SparseLU<SparseMatrix<double>> solver2(A2);
+  // The domain mesh is rebuilt only when its input or the solver type has changed
+  // (in interactive mode, only when the number of sides or the solver type has)
+  double max_area = 0;
+  Point2DVector key = uniform ? domain_->vertices() : boundarySamples(resolution, max_area);
+  bool multigrid = use_multigrid_ && uniform;
+  if (!cmesh || cmesh->key.size() != key.size() || cmesh->multigrid != multigrid ||
+      (!interactive_ && (!samePoints(cmesh->key, key) || cmesh->max_area != max_area))) {
+    auto m = std::make_shared<SolutionCache::Mesh>();
+    m->key = key;
+    m->max_area = max_area;
+    m->multigrid = multigrid;
+    Point2DVector uvs;
+    if (uniform)
+      std::tie(m->mesh, uvs, m->on_edge, m->vertex_boundary) = generateDomainOld(resolution);
+    else
+      std::tie(m->mesh, uvs, m->on_edge, m->vertex_boundary) =
+        generateDomain(resolution, key, max_area);
+    std::transform(uvs.begin(), uvs.end(), std::back_inserter(m->uvs3d),
+                   [](const Point2D &p) { return Point3D(p[0], p[1], 0); });
+
+    m->incidence = incidence(m->mesh, uvs.size());
+
+    // Set up boundary index map
+    for (size_t i = 0; i < uvs.size(); ++i)
+      if (m->on_edge(i))
+        m->boundary.push_back(i);
+
+    // Without prolongations, the multigrid solver factorizes the system
+    if (multigrid)
+      m->prolongations = MultigridSolver::prolongations(*domain_, resolution);
+
+    // Compute the system
+    m->propagation = std::make_unique<MultigridSolver>(prepareMatrix(m->mesh, m->incidence,
+                                                                     m->uvs3d, m->boundary,
+                                                                     true, executor_),
+                                                       m->boundary, m->prolongations);
+    cmesh = m;
+    propagated.reset();
+  }
+  const TriMesh &mesh = cmesh->mesh;
+  const auto &boundary = cmesh->boundary;
+  size_t n_all = cmesh->uvs3d.size(), n_boundary = boundary.size();
 
-  // Also recompute L & areas (TODO: redundant)
-  SparseMatrix<double> Ls = laplaceMatrix(mesh, points);
-  auto areas = voronoiAreas(mesh, points);
-  Map<VectorXd> M(&areas[0], areas.size());
-  SparseMatrix<double> L = M.asDiagonal().inverse() * Ls;
+  // Fill the boundary points & normals
+  MatrixXd b(n_boundary, 3), bn(n_boundary, 3);
+  for (size_t j = 0; j < n_boundary; ++j) {
+    auto [side, u] = cmesh->vertex_boundary(boundary[j]);
+    b.row(j) = Map<const Vector3d>(ribbons_[side]->curve()->eval(u).data());
+    bn.row(j) = Map<const Vector3d>(ribbons_[side]->normal(u).data());
+  }
+  SolutionCache::Solutions current = previous;
+
+  // Propagate the boundary points and normals (in one solve), and recompute the matrices
+  // with the propagated surface, unless only the normals have changed
+  MatrixXd Nstar;
+  std::shared_ptr<SolutionCache::Propagated> p;
+  std::future<void> system;
+  if (!propagated || propagated->boundary_points != b) {
+    std::shared_ptr<const MultigridSolver> last;
+    if (interactive_ && propagated)
+      last = propagated->system;
+    p = std::make_shared<SolutionCache::Propagated>();
+    p->boundary_points = b;
+    MatrixXd values(n_boundary, 6), guess;
+    values << b, bn;
+    if (previous.points.size() && previous.normals.size()) {
+      guess.resize(n_all, 6);
+      guess << previous.points, previous.normals;
+    }
+    MatrixXd VN = cmesh->propagation->solve(MatrixXd(), values, guess);
+    p->Vstar = VN.leftCols<3>();
+    Nstar = VN.rightCols<3>();
+    current.points = p->Vstar;
+
+    auto points = std::make_shared<PointVector>(n_all);
+    for (size_t i = 0; i < n_all; ++i)
+      (*points)[i] = { p->Vstar(i, 0), p->Vstar(i, 1), p->Vstar(i, 2) };
+
+    // The final system is assembled and factorized (unless previewed with the last solver)
+    // while the curvatures are computed
+    system = std::async(std::launch::async, [&, points, last]() {
+      auto A = prepareMatrix(mesh, cmesh->incidence, *points, boundary, false, executor_);
+      if (last) {
+        p->system = last;
+        p->preview = true;
+        p->A = A;                       // converted once, not in each preview solve
+      } else
+        p->system = std::make_shared<MultigridSolver>(A, boundary, cmesh->prolongations);
+    });
+
+    // Also recompute L & areas (TODO: redundant)
+    SparseMatrix<double> Ls = laplaceMatrix(mesh, *points);
+    p->areas = voronoiAreas(cmesh->incidence, *points, executor_);
+    Map<VectorXd> M(&p->areas[0], p->areas.size());
+    p->L = M.asDiagonal().inverse() * Ls;
+    propagated = p;
+  } else
+    Nstar = cmesh->propagation->solve(MatrixXd(), bn, previous.normals);
+  const MatrixXd &Vstar = propagated->Vstar;
+  current.normals = Nstar;
+  executor_(n_all, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      Nstar.row(i) = Nstar.row(i).normalized();
+  });
 
   // Compute mean curvature
-  auto mean = computeCurvatures(mesh, areas, on_edge, Vstar, Nstar);
+  auto mean = computeCurvatures(cmesh->incidence, propagated->areas, cmesh->on_edge,
+                                Vstar, Nstar, executor_);
   MatrixXd H(n_all, 3);
   for (size_t i = 0; i < n_all; ++i)
     H.row(i) = - Nstar.row(i) * mean[i];
-  MatrixXd LH = L * H;
-
-  // Compute the final surface
-  b = MatrixXd::Zero(n_all + n_boundary, 3);
-  b.block(0, 0, n_all, 3) = LH;
+  MatrixXd LH = propagated->L * H;
+
+  // Compute the final surface (factorizing a previewed system after the interactive mode)
+  if (p)
+    system.get();
+  else if (propagated->preview && !interactive_) {
+    auto exact = std::make_shared<SolutionCache::Propagated>(*propagated);
+    exact->system = std::make_shared<MultigridSolver>(exact->A, boundary, cmesh->prolongations);
+    exact->preview = false;
+    exact->A = SparseMatrix<double, RowMajor>();
+    propagated = exact;
+  }
   for (size_t j = 0; j < n_boundary; ++j)
-    b.row(n_all + j) = Vstar.row(boundary[j]);
-  MatrixXd x = solver2.solve(b);
+    b.row(j) = Vstar.row(boundary[j]);
+  MatrixXd x = propagated->preview
+    ? propagated->system->solve(propagated->A, LH, b, previous.surface, preview_iterations_)
+    : propagated->system->solve(LH, b, previous.surface);
+  current.surface = x;
+
+  {
+    size_t limit = domain_->parameterCacheLimit();
+    std::lock_guard<std::mutex> lock(solutions_->mutex);
+    auto &entries = solutions_->entries;
+    auto &entry = entries[{resolution, uniform}];
+    entry.mesh = cmesh;
+    entry.propagated = propagated;
+    if (use_multigrid_ || interactive_)
+      entry.solutions = current;
+    entry.last_use = ++solutions_->clock;
+    while (limit > 0 && entries.size() > limit)
+      entries.erase(std::min_element(entries.begin(), entries.end(),
+                                     [](const auto &a, const auto &b) {
+                                       return a.second.last_use < b.second.last_use;
+                                     }));
+  }
 
+  PointVector points(n_all);
   for (size_t i = 0; i < n_all; ++i)
     points[i] = { x(i, 0), x(i, 1), x(i, 2) };
 
-  mesh.setPoints(points);
-  return mesh;
+  TriMesh result = mesh;
+  result.setPoints(points);
+  return result;
 }
 
 std::shared_ptr<Ribbon>
@@ -10,13 +10,43 @@ public:
   SurfaceBiharmonic(const SurfaceBiharmonic &) = default;
   virtual ~SurfaceBiharmonic();
   SurfaceBiharmonic &operator=(const SurfaceBiharmonic &) = default;
+  virtual std::shared_ptr<Surface> clone() const override;
+  virtual void update(size_t i) override;
+  virtual void update() override;
+  using Surface::eval;
+  // Interpolates a mesh of the evaluation resolution, computed at the first call after an update
   virtual Point3D eval(const Point2D &uv) const override;
   virtual TriMesh eval(size_t resolution) const override;
+  // The same mesh as eval(resolution); the buffer outputs of eval and the streamed mesh
+  // use the uniform mesh (the same without libtriangle)
+  virtual FloatMesh evalFloat(size_t resolution) const override;
+  // Solve by multigrid on the uniform domain mesh, instead of factorizing the systems
+  // (see MultigridSolver)
+  void useMultigrid(bool use);
+  // For dragging curves or normal fences: the domain meshes (with the factorized propagation
+  // systems) are kept, and the final systems are solved by at most `iterations` conjugate gradient
+  // steps, preconditioned by the last exact solver and started from the last solution;
+  // turning it off makes the next evaluation exact again
+  void setInteractive(bool interactive, size_t iterations = 4);
+  void setEvaluationResolution(size_t resolution);
 
 protected:
   auto generateDomainOld(size_t resolution) const;
-  auto generateDomain(size_t resolution) const;
+  // Boundary points to be triangulated, projected onto their least squares plane,
+  // with the maximal triangle area (without libtriangle, the domain vertices)
+  Point2DVector boundarySamples(size_t resolution, double &max_area) const;
+  auto generateDomain(size_t resolution, const Point2DVector &projected, double max_area) const;
+  TriMesh solve(size_t resolution, bool uniform) const;
+  virtual void evalPoints(size_t resolution, const PointStore &store) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+  virtual void detach() override;
+
+private:
+  struct SolutionCache;
+  std::shared_ptr<SolutionCache> solutions_; // shared by copies
+  bool use_multigrid_, interactive_;
+  size_t preview_iterations_;
+  size_t eval_resolution_;
 };
 
 } // namespace Transfinite
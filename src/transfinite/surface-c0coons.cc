@@ -13,14 +13,19 @@ SurfaceC0Coons::SurfaceC0Coons() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
 }
 
 SurfaceC0Coons::~SurfaceC0Coons() {
 }
 
+std::shared_ptr<Surface>
+SurfaceC0Coons::clone() const {
+  return std::make_shared<SurfaceC0Coons>(*this);
+}
+
 Point3D
-SurfaceC0Coons::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
+SurfaceC0Coons::evalMapped(const Point2D &, const Point2DVector &sds) const {
   Point3D p(0,0,0);
   for (size_t i = 0; i < n_; ++i)
     p += ribbons_[i]->eval(sds[i]) * (1 - sds[i][1]) / 2;
@@ -10,10 +10,11 @@ public:
   SurfaceC0Coons(const SurfaceC0Coons &) = default;
   virtual ~SurfaceC0Coons();
   SurfaceC0Coons &operator=(const SurfaceC0Coons &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
 };
 
@@ -14,19 +14,39 @@ SurfaceCompositeRibbon::SurfaceCompositeRibbon() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
+  blend_type_ = BlendType::CORNER;
 }
 
 SurfaceCompositeRibbon::~SurfaceCompositeRibbon() {
 }
 
+std::shared_ptr<Surface>
+SurfaceCompositeRibbon::clone() const {
+  return std::make_shared<SurfaceCompositeRibbon>(*this);
+}
+
 Point3D
-SurfaceCompositeRibbon::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendCorner(sds);
+SurfaceCompositeRibbon::evalBlended(const Point2D &, const Point2DVector &sds,
+                                    const double *blends) const {
   Point3D p(0,0,0);
-  for (size_t i = 0; i < n_; ++i)
-    p += compositeRibbon(i, sds[i]) * (blends[i] + blends[prev(i)]);
-  return p * 0.5;
+  double skipped = 0;
+  for (size_t i = 0; i < n_; ++i) {
+    double blend = (blends[i] + blends[prev(i)]) * 0.5;
+    if (negligibleBlend(blend))
+      skipped += blend;
+    else
+      p += compositeRibbon(i, sds[i]) * blend;
+  }
+  return p + corner_centroid_ * skipped;
+}
+
+uint64_t
+SurfaceCompositeRibbon::blendSides(size_t i) const {
+  uint64_t result = 0;
+  for (size_t j : { prev(i), i, next(i), next(i, 2) })
+    result |= uint64_t(1) << j;
+  return result;
 }
 
 std::shared_ptr<Ribbon>
@@ -37,7 +57,7 @@ SurfaceCompositeRibbon::newRibbon() const {
 Point3D
 SurfaceCompositeRibbon::compositeRibbon(size_t i, const Point2D &sd) const {
   double s = sd[0], d = sd[1], s1 = 1.0 - s, d1 = 1.0 - d;
-  double Hs = hermite(0, s), Hd = hermite(0, d), Hs1 = 1.0 - Hs;
+  double Hs = hermite<0>(s), Hd = hermite<0>(d), Hs1 = 1.0 - Hs;
   return sideInterpolant(i, s, d) * Hd
     + sideInterpolant(prev(i), d1, s) * Hs
     + sideInterpolant(next(i), d, s1) * Hs1
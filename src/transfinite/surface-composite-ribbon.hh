@@ -10,10 +10,14 @@ public:
   SurfaceCompositeRibbon(const SurfaceCompositeRibbon &) = default;
   virtual ~SurfaceCompositeRibbon();
   SurfaceCompositeRibbon &operator=(const SurfaceCompositeRibbon &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
 
 protected:
+  virtual Point3D evalBlended(const Point2D &uv, const Point2DVector &sds,
+                              const double *blends) const override;
+  // Composite ribbons i and i+1, using sides i-1 .. i+2
+  virtual uint64_t blendSides(size_t i) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
   Point3D compositeRibbon(size_t i, const Point2D &sd) const;
 };
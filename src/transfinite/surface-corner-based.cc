@@ -13,18 +13,42 @@ SurfaceCornerBased::SurfaceCornerBased() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
+  blend_type_ = BlendType::CORNER;
+  fast_kind_ = SurfaceKind::CORNER_BASED;
+  mapped_derivatives_ = true;
 }
 
 SurfaceCornerBased::~SurfaceCornerBased() {
 }
 
+std::shared_ptr<Surface>
+SurfaceCornerBased::clone() const {
+  return std::make_shared<SurfaceCornerBased>(*this);
+}
+
 Point3D
-SurfaceCornerBased::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendCorner(sds);
+SurfaceCornerBased::evalBlended(const Point2D &, const Point2DVector &sds,
+                                const double *blends) const {
   Point3D p(0,0,0);
+  double skipped = 0;
+  for (size_t i = 0; i < n_; ++i)
+    if (negligibleBlend(blends[i]))
+      skipped += blends[i];
+    else
+      p += cornerInterpolant(i, sds) * blends[i];
+  return p + corner_centroid_ * skipped;
+}
+
+Surface::Derivatives
+SurfaceCornerBased::evalMappedDerivatives(const Point2D &, const Point2DVector &sds,
+                                          const Vector2DVector &ds, const Vector2DVector &dd) const {
+  thread_local DoubleVector blends;
+  thread_local Vector2DVector dblends;
+  blendCorner(sds, ds, dd, blends, dblends);
+  Derivatives p = { Point3D(0,0,0), Vector3D(0,0,0), Vector3D(0,0,0) };
   for (size_t i = 0; i < n_; ++i)
-    p += cornerInterpolant(i, sds) * blends[i];
+    addBlended(p, cornerInterpolant(i, sds, ds, dd), blends[i], dblends[i]);
   return p;
 }
 
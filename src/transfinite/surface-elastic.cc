@@ -18,16 +18,21 @@ SurfaceElastic::SurfaceElastic() : domain_tolerance(1.0e-5) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
 }
 
 SurfaceElastic::~SurfaceElastic() {
 }
 
+std::shared_ptr<Surface>
+SurfaceElastic::clone() const {
+  return std::make_shared<SurfaceElastic>(*this);
+}
+
 Point3D
-SurfaceElastic::eval(const Point2D &uv) const {
+SurfaceElastic::evalMapped(const Point2D &uv, const Point2DVector &sds) const {
   double u = uv[0], v = uv[1];
-  auto sds = param_->mapToRibbons(uv);
-  auto dpoly = domain()->vertices();
+  const auto &dpoly = domain_->vertices();
 
   Matrix3d A = Matrix3d::Zero(), b = Matrix3d::Zero();
 
@@ -36,29 +41,55 @@ SurfaceElastic::eval(const Point2D &uv) const {
     auto boundary_point = affineCombine(dpoly[prev(i)], s, dpoly[i]);
     auto ui = boundary_point[0], vi = boundary_point[1];
     auto di = (uv - boundary_point).norm();
-    auto Pi = ribbons_[i]->eval({ s, 0 });
+    // Sampled ribbons (see setRibbonSampling) give the point and the cross-derivative by interpolation
+    Point3D Pi;
+    Vector3D cross;
+    if (ribbons_[i]->sampling() > 0) {
+      Pi = ribbons_[i]->eval(Point2D(s, 0.0));
+      cross = ribbons_[i]->eval(Point2D(s, 1.0)) - Pi;
+    } else {
+      auto frame = ribbons_[i]->frame(s);
+      Pi = frame.point;
+      cross = frame.cross;
+    }
     if (di < domain_tolerance)
       return Pi;
-    auto Ti = ribbons_[i]->crossDerivative(s) * di;
+    auto Ti = cross * di;
 
-    double denom = std::pow(di, -3);
+    double denom = 1.0 / (di * di * di);
+    double du = u - ui, dv = v - vi;
     A(0, 0) += 2 * denom;
-    A(0, 1) += (u - ui) * denom;
-    A(0, 2) += (v - vi) * denom;
-    A(1, 0) += 3 * (u - ui) * denom;
-    A(1, 1) += 2 * std::pow(u - ui, 2) * denom;
-    A(1, 2) += 2 * (u - ui) * (v - vi) * denom;
-    A(2, 0) += 3 * (v - vi) * denom;
-    A(2, 1) += 2 * (u - ui) * (v - vi) * denom;
-    A(2, 2) += 2 * std::pow(v - vi, 2) * denom;
+    A(0, 1) += du * denom;
+    A(0, 2) += dv * denom;
+    A(1, 0) += 3 * du * denom;
+    A(1, 1) += 2 * du * du * denom;
+    A(1, 2) += 2 * du * dv * denom;
+    A(2, 0) += 3 * dv * denom;
+    A(2, 1) += 2 * du * dv * denom;
+    A(2, 2) += 2 * dv * dv * denom;
 
     for (size_t k = 0; k < 3; ++k) {
       b(0, k) += (2 * Pi[k] + Ti[k]) * denom;
-      b(1, k) += (3 * (u - ui) * Pi[k] + (u - ui) * Ti[k]) * denom;
-      b(2, k) += (3 * (v - vi) * Pi[k] + (v - vi) * Ti[k]) * denom;
+      b(1, k) += (3 * du * Pi[k] + du * Ti[k]) * denom;
+      b(2, k) += (3 * dv * Pi[k] + dv * Ti[k]) * denom;
     }
   }
 
+  // Only the first row of the solution is needed, i.e., the first row of the inverse,
+  // given by the cofactors of the first column (Cramer's rule);
+  // nearly singular systems are left to the QR decomposition
+  double c0 = A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1);
+  double c1 = A(0, 2) * A(2, 1) - A(0, 1) * A(2, 2);
+  double c2 = A(0, 1) * A(1, 2) - A(0, 2) * A(1, 1);
+  double det = A(0, 0) * c0 + A(1, 0) * c1 + A(2, 0) * c2;
+  double scale = A.cwiseAbs().maxCoeff();
+  if (std::abs(det) > 1.0e-12 * scale * scale * scale) {
+    Point3D p;
+    for (size_t k = 0; k < 3; ++k)
+      p[k] = (c0 * b(0, k) + c1 * b(1, k) + c2 * b(2, k)) / det;
+    return p;
+  }
+
   Matrix3d x = A.colPivHouseholderQr().solve(b);
   Point3D p(x(0,0), x(0,1), x(0,2));
   // Vector3D j1(-x(1,0), -x(1,1), -x(1,2)), j2(-x(2,0), -x(2,1), -x(2,2));
@@ -10,10 +10,11 @@ public:
   SurfaceElastic(const SurfaceElastic &) = default;
   virtual ~SurfaceElastic();
   SurfaceElastic &operator=(const SurfaceElastic &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
 
 private:
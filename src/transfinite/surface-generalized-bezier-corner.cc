@@ -16,46 +16,66 @@ SurfaceGeneralizedBezierCorner::SurfaceGeneralizedBezierCorner() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_derivatives_ = false;  // evalMapped() is overridden without a derivative version
 }
 
 SurfaceGeneralizedBezierCorner::~SurfaceGeneralizedBezierCorner() {
 }
 
+std::shared_ptr<Surface>
+SurfaceGeneralizedBezierCorner::clone() const {
+  return std::make_shared<SurfaceGeneralizedBezierCorner>(*this);
+}
+
 void
 SurfaceGeneralizedBezierCorner::initNetwork(size_t n, size_t degree) {
   assert(degree % 2 == 1 && "This representation works only for odd degrees");
   SurfaceGeneralizedBezier::initNetwork(n, degree);
 }
 
-Point3D
-SurfaceGeneralizedBezierCorner::eval(const Point2D &uv) const {
-  Point3D surface_point(0,0,0);
-  Point2DVector sds = param_->mapToRibbons(uv);
+// Calls add(control point, index, blend) as in mappedBlends()
+template<typename F>
+void
+SurfaceGeneralizedBezierCorner::cornerBlends(const Point2DVector &sds, F add) const {
   double weight_sum = 0.0;
+  thread_local DoubleVector bl_di, bl_di1;
+  bl_di.resize(degree_ + 1); bl_di1.resize(degree_ + 1);
   for (size_t i = 0; i < n_; ++i) {
     const double &di   = sds[i][1];
     const double &di1  = sds[next(i)][1];
-    DoubleVector bl_di, bl_di1;
-    bernstein(degree_, di, bl_di);
-    bernstein(degree_, di1, bl_di1);
+    bernstein(degree_, di, bl_di.data());
+    bernstein(degree_, di1, bl_di1.data());
     for (size_t j = 0; j < layers_; ++j) {
       for (size_t k = 0; k < layers_; ++k) {
         double blend = bl_di1[j] * bl_di[k];
-        surface_point += nets_[i][degree_-j][k] * blend;
+        if (blend != 0.0)
+          add(nets_[i][degree_-j][k], (i * (degree_ + 1) + degree_ - j) * layers_ + k, blend);
         weight_sum += blend;
       }
     }
   }
-  surface_point += central_cp_ * (1.0 - weight_sum);
+  add(central_cp_, n_ * (degree_ + 1) * layers_, 1.0 - weight_sum);
+}
+
+Point3D
+SurfaceGeneralizedBezierCorner::evalMapped(const Point2D &, const Point2DVector &sds) const {
+  Point3D surface_point(0,0,0);
+  cornerBlends(sds, [&](const Point3D &cp, size_t, double blend) { surface_point += cp * blend; });
   return surface_point;
 }
 
+void
+SurfaceGeneralizedBezierCorner::planBlends(const Point2DVector &sds, const BlendAdder &add,
+                                           double *) const {
+  cornerBlends(sds, [&](const Point3D &, size_t index, double blend) { add(index, blend); });
+}
+
 double
 SurfaceGeneralizedBezierCorner::cornerWeight(size_t i, size_t j, size_t k, const Point2D &uv) const
 {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  const double &di   = sds[i][1];
-  const double &di1  = sds[next(i)][1];
+  auto sds = param_->mapToRibbons(uv);
+  const double &di   = (*sds)[i][1];
+  const double &di1  = (*sds)[next(i)][1];
   DoubleVector bl_di, bl_di1;
   bernstein(degree_, di, bl_di);
   bernstein(degree_, di1, bl_di1);
@@ -9,15 +9,20 @@ public:
   SurfaceGeneralizedBezierCorner();
   SurfaceGeneralizedBezierCorner(const SurfaceGeneralizedBezierCorner &) = default;
   virtual ~SurfaceGeneralizedBezierCorner();
+  virtual std::shared_ptr<Surface> clone() const override;
   virtual void initNetwork(size_t n, size_t degree) override;
-  virtual Point3D eval(const Point2D &uv) const override;
   using Surface::eval;
   virtual double weight(size_t i, size_t j, size_t k, const Point2D &uv) const override;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
+  virtual void planBlends(const Point2DVector &sds, const BlendAdder &add,
+                          double *side_blends) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
 
 private:
+  template<typename F>
+  void cornerBlends(const Point2DVector &sds, F add) const;
   double cornerWeight(size_t i, size_t j, size_t k, const Point2D &uv) const;
 };
 
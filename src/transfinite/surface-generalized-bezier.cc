@@ -1,11 +1,18 @@
 //#define USE_CONSTRAINED_BARYCENTRIC
 
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+
 #include "domain-regular.hh"
 #ifdef USE_CONSTRAINED_BARYCENTRIC
 # include "parameterization-constrained-barycentric.hh"
 #else
 # include "parameterization-barycentric.hh"
 #endif
+#include "profiler.hh"
 #include "ribbon-dummy.hh"
 #include "surface-generalized-bezier.hh"
 #include "utilities.hh"
@@ -20,15 +27,68 @@ using ParamType = ParameterizationBarycentric;
 #endif
 using RibbonType = RibbonDummy;
 
-SurfaceGeneralizedBezier::SurfaceGeneralizedBezier() : squared_weights_(false) {
+struct SurfaceGeneralizedBezier::TessellationPlan : BlendMatrix {
+  std::shared_ptr<const ParameterTable> table; // that it was computed from
+  size_t degree;
+  bool squared_weights;
+  DoubleVector side_blends;                    // n for each point, with side terms
+};
+
+struct SurfaceGeneralizedBezier::PlanCache {
+  struct SideTerms {
+    std::shared_ptr<const TessellationPlan> plan;
+    std::shared_ptr<const PointVector> points;
+  };
+  std::map<size_t, std::shared_ptr<const TessellationPlan>> plans;
+  std::map<size_t, SideTerms> side_terms;      // cleared in each update, as they use the ribbons
+  std::mutex mutex;
+};
+
+SurfaceGeneralizedBezier::SurfaceGeneralizedBezier()
+  : squared_weights_(false), planned_eval_(true), side_terms_(false),
+    plans_(std::make_shared<PlanCache>()) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
+  mapped_derivatives_ = true;
 }
 
 SurfaceGeneralizedBezier::~SurfaceGeneralizedBezier() {
 }
 
+std::shared_ptr<Surface>
+SurfaceGeneralizedBezier::clone() const {
+  return std::make_shared<SurfaceGeneralizedBezier>(*this);
+}
+
+// The snapshot gets a copy of the cache, as the two would replace each other's entries
+void
+SurfaceGeneralizedBezier::detach() {
+  Surface::detach();
+  auto plans = std::make_shared<PlanCache>();
+  {
+    std::lock_guard<std::mutex> lock(plans_->mutex);
+    plans->plans = plans_->plans;
+    plans->side_terms = plans_->side_terms;
+  }
+  plans_ = plans;
+}
+
+void
+SurfaceGeneralizedBezier::update(size_t i) {
+  Surface::update(i);
+  std::lock_guard<std::mutex> lock(plans_->mutex);
+  plans_->side_terms.clear();
+}
+
+void
+SurfaceGeneralizedBezier::update() {
+  Surface::update();
+  std::lock_guard<std::mutex> lock(plans_->mutex);
+  plans_->side_terms.clear();
+}
+
 /*
   This is a trivial implementation of the surface evaluator.
   It is much slower than the one given below,
@@ -53,10 +113,11 @@ SurfaceGeneralizedBezier::eval(const Point2D &uv) const {
 }
 */
 
-Point3D
-SurfaceGeneralizedBezier::eval(const Point2D &uv) const {
-  Point3D surface_point(0,0,0);
-  Point2DVector sds = param_->mapToRibbons(uv);
+template<typename F>
+void
+SurfaceGeneralizedBezier::mappedBlends(const Point2DVector &sds, F add) const {
+  thread_local DoubleVector bl_s, bl_d;
+  bl_s.resize(degree_ + 1); bl_d.resize(degree_ + 1);
   double weight_sum = 0.0;
   for (size_t i = 0; i < n_; ++i) {
     const double &si   = sds[i][0];
@@ -65,9 +126,10 @@ SurfaceGeneralizedBezier::eval(const Point2D &uv) const {
     const double &di1  = sds[next(i)][1];
     if (di + di1 < epsilon || di_1 + di < epsilon) {
       if (di + di1 < epsilon)
-        return nets_[i][degree_][0];
+        add(nets_[i][degree_][0], (i * (degree_ + 1) + degree_) * layers_, 1.0);
       else
-        return nets_[i][0][0];
+        add(nets_[i][0][0], i * (degree_ + 1) * layers_, 1.0);
+      return;
     }
     double alpha, beta;
     if (squared_weights_) {
@@ -78,9 +140,8 @@ SurfaceGeneralizedBezier::eval(const Point2D &uv) const {
       alpha = di_1 / (di_1 + di);
       beta  = di1  / (di1  + di);
     }
-    DoubleVector bl_s, bl_d;
-    bernstein(degree_, si, bl_s);
-    bernstein(degree_, di, bl_d);
+    bernstein(degree_, si, bl_s.data());
+    bernstein(degree_, di, bl_d.data());
     for (size_t k = 0; k < layers_; ++k) {
       for (size_t j = 0; j <= degree_; ++j) {
         double blend = bl_s[j] * bl_d[k];
@@ -96,17 +157,261 @@ SurfaceGeneralizedBezier::eval(const Point2D &uv) const {
         } else if (j == k || j == degree_ - k)
           blend *= 0.5;
         else if (j < k || j > degree_ - k)
-          blend = 0.0;
+          continue;
 #endif
-        surface_point += nets_[i][j][k] * blend;
+        if (blend != 0.0)
+          add(nets_[i][j][k], (i * (degree_ + 1) + j) * layers_ + k, blend);
         weight_sum += blend;
       }
     }
   }
-  surface_point += central_cp_ * (1.0 - weight_sum);
+  add(central_cp_, n_ * (degree_ + 1) * layers_, 1.0 - weight_sum);
+}
+
+void
+SurfaceGeneralizedBezier::planBlends(const Point2DVector &sds, const BlendAdder &add,
+                                     double *) const {
+  mappedBlends(sds, [&](const Point3D &, size_t index, double blend) { add(index, blend); });
+}
+
+Point3D
+SurfaceGeneralizedBezier::evalMapped(const Point2D &, const Point2DVector &sds) const {
+  Point3D surface_point(0,0,0);
+  mappedBlends(sds, [&](const Point3D &cp, size_t, double blend) { surface_point += cp * blend; });
   return surface_point;
 }
 
+TriMesh
+SurfaceGeneralizedBezier::eval(size_t resolution) const {
+  if (!use_tables_ || !planned_eval_)
+    return Surface::eval(resolution);
+
+  TriMesh mesh = domain_->meshTopology(resolution);
+  PointVector points(mesh.points().size());
+  evalPoints(resolution, [&](size_t first, size_t size, const Point3D *block) {
+    std::copy_n(block, size, &points[first]);
+  });
+  mesh.setPoints(points);
+  return mesh;
+}
+
+void
+SurfaceGeneralizedBezier::evalPoints(size_t resolution, const PointStore &store) const {
+  if (!use_tables_ || !planned_eval_) {
+    Surface::evalPoints(resolution, store);
+    return;
+  }
+
+  TRANSFINITE_TIMER("SurfaceGeneralizedBezier::evalPoints");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  auto plan = tessellationPlan(resolution);
+  TRANSFINITE_COUNT("evaluated points", plan->offsets.size() - 1);
+  std::shared_ptr<const PointVector> side_terms;
+  if (side_terms_)
+    side_terms = sideTerms(resolution, plan);
+  PointVector cps = controlPoints();
+  executor_(plan->offsets.size() - 1, [&](size_t begin, size_t end) {
+    PointVector points(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      Point3D p(0, 0, 0);
+      for (size_t j = plan->offsets[i]; j < plan->offsets[i+1]; ++j)
+        p += cps[plan->indices[j]] * plan->blends[j];
+      if (side_terms)
+        p += (*side_terms)[i];
+      points[i-begin] = p;
+    }
+    store(begin, points.size(), points.data());
+  });
+}
+
+InfluenceMap
+SurfaceGeneralizedBezier::influences(size_t resolution, double threshold) const {
+  if (!planned_eval_)
+    throw std::runtime_error("influence images need evaluation by the blends of planBlends()");
+  auto plan = tessellationPlan(resolution);
+  size_t size = plan->offsets.size() - 1;
+  std::vector<std::vector<std::pair<size_t, double>>> rows(size);
+  for (size_t i = 0; i < size; ++i)
+    for (size_t j = plan->offsets[i]; j < plan->offsets[i+1]; ++j)
+      rows[i].emplace_back(plan->indices[j], plan->blends[j]);
+  return InfluenceMap(eval(resolution), n_ * (degree_ + 1) * layers_ + 1, rows, threshold);
+}
+
+std::vector<size_t>
+SurfaceGeneralizedBezier::controlPointIndices(size_t i, size_t j, size_t k) const {
+  auto index = [&](size_t i, size_t j, size_t k) { return (i * (degree_ + 1) + j) * layers_ + k; };
+  std::vector<size_t> result = { index(i, j, k) };
+  if (j < layers_)
+    result.push_back(index(prev(i), degree_ - k, j));
+  else if (degree_ - j < layers_)
+    result.push_back(index(next(i), k, degree_ - j));
+  return result;
+}
+
+PointVector
+SurfaceGeneralizedBezier::controlPoints() const {
+  PointVector cps;
+  cps.reserve(n_ * (degree_ + 1) * layers_ + 1);
+  for (const auto &net : nets_)
+    for (const auto &column : net)
+      cps.insert(cps.end(), column.begin(), column.end());
+  cps.push_back(central_cp_);
+  return cps;
+}
+
+std::shared_ptr<const SurfaceGeneralizedBezier::BlendMatrix>
+SurfaceGeneralizedBezier::blendMatrix(size_t resolution) const {
+  if (!planned_eval_ || side_terms_)
+    throw std::runtime_error("blend matrices need evaluation by the blends of control points");
+  return tessellationPlan(resolution);
+}
+
+// Recomputed when the parameter table is replaced (after a domain change), or the weights change
+std::shared_ptr<const SurfaceGeneralizedBezier::TessellationPlan>
+SurfaceGeneralizedBezier::tessellationPlan(size_t resolution) const {
+  auto table = param_->parameterTable(resolution, executor_);
+  {
+    std::lock_guard<std::mutex> lock(plans_->mutex);
+    const auto &plan = plans_->plans[resolution];
+    if (plan && plan->table == table && plan->degree == degree_ &&
+        plan->squared_weights == squared_weights_)
+      return plan;
+  }
+
+  size_t size = table->sds.size() / n_;
+  std::vector<std::vector<std::pair<uint32_t, double>>> rows(size);
+  auto plan = std::make_shared<TessellationPlan>();
+  if (side_terms_)
+    plan->side_blends.assign(size * n_, 0.0);
+  executor_(size, [&](size_t begin, size_t end) {
+    Point2DVector sds(n_);
+    for (size_t i = begin; i < end; ++i) {
+      std::copy_n(table->row(i), n_, sds.begin());
+      planBlends(sds, [&](size_t index, double blend) { rows[i].emplace_back(index, blend); },
+                 side_terms_ ? &plan->side_blends[i * n_] : nullptr);
+    }
+  });
+
+  plan->table = table;
+  plan->degree = degree_;
+  plan->squared_weights = squared_weights_;
+  plan->offsets.reserve(size + 1);
+  plan->offsets.push_back(0);
+  for (const auto &row : rows) {
+    for (const auto &[index, blend] : row) {
+      plan->indices.push_back(index);
+      plan->blends.push_back(blend);
+    }
+    plan->offsets.push_back(plan->indices.size());
+  }
+
+  std::lock_guard<std::mutex> lock(plans_->mutex);
+  plans_->plans[resolution] = plan;
+  return plan;
+}
+
+// Concurrent first calls may compute these more than once, but with the same result
+std::shared_ptr<const PointVector>
+SurfaceGeneralizedBezier::sideTerms(size_t resolution,
+                                    const std::shared_ptr<const TessellationPlan> &plan) const {
+  {
+    std::lock_guard<std::mutex> lock(plans_->mutex);
+    auto it = plans_->side_terms.find(resolution);
+    if (it != plans_->side_terms.end() && it->second.plan == plan)
+      return it->second.points;
+  }
+
+  TRANSFINITE_TIMER("SurfaceGeneralizedBezier::sideTerms");
+  size_t size = plan->offsets.size() - 1;
+  auto points = std::make_shared<PointVector>(size);
+  executor_(size, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const Point2D *sds = plan->table->row(i);
+      const double *blends = &plan->side_blends[i * n_];
+      Point3D p(0, 0, 0);
+      for (size_t j = 0; j < n_; ++j)
+        if (blends[j] != 0.0)
+          p += sideInterpolant(j, sds[j][0], sds[j][1]) * blends[j];
+      (*points)[i] = p;
+    }
+  });
+
+  std::lock_guard<std::mutex> lock(plans_->mutex);
+  plans_->side_terms[resolution] = { plan, points };
+  return points;
+}
+
+Surface::Derivatives
+SurfaceGeneralizedBezier::evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                                const Vector2DVector &ds,
+                                                const Vector2DVector &dd) const {
+  Derivatives result = { Point3D(0,0,0), Vector3D(0,0,0), Vector3D(0,0,0) };
+  double weight_sum = 0.0;
+  Vector2D dweight_sum(0, 0);
+  for (size_t i = 0; i < n_; ++i) {
+    size_t im = prev(i), ip = next(i);
+    const double &si   = sds[i][0];
+    const double &di_1 = sds[im][1];
+    const double &di   = sds[i][1];
+    const double &di1  = sds[ip][1];
+    if (di + di1 < epsilon || di_1 + di < epsilon)
+      return evalDerivativesNumerically(uv); // the rational weights are singular at the corners
+    double alpha, beta;
+    Vector2D dalpha, dbeta;
+    if (squared_weights_) {
+      double di_1_sq = di_1 * di_1, di_sq = di * di, di1_sq = di1 * di1;
+      alpha = di_1_sq / (di_1_sq + di_sq);
+      beta  = di1_sq  / (di1_sq  + di_sq);
+      dalpha = (dd[im] * di - dd[i] * di_1) * (2.0 * di_1 * di / std::pow(di_1_sq + di_sq, 2));
+      dbeta  = (dd[ip] * di - dd[i] * di1)  * (2.0 * di1 * di  / std::pow(di1_sq  + di_sq, 2));
+    } else {
+      alpha = di_1 / (di_1 + di);
+      beta  = di1  / (di1  + di);
+      dalpha = (dd[im] * di - dd[i] * di_1) / std::pow(di_1 + di, 2);
+      dbeta  = (dd[ip] * di - dd[i] * di1)  / std::pow(di1  + di, 2);
+    }
+    thread_local DoubleVector bl_s, bl_d, dbl_s, dbl_d;
+    bernstein(degree_, si, bl_s, dbl_s);
+    bernstein(degree_, di, bl_d, dbl_d);
+    for (size_t k = 0; k < layers_; ++k) {
+      for (size_t j = 0; j <= degree_; ++j) {
+        double blend = bl_s[j] * bl_d[k];
+        Vector2D dblend = ds[i] * (dbl_s[j] * bl_d[k]) + dd[i] * (bl_s[j] * dbl_d[k]);
+#ifdef USE_CONSTRAINED_BARYCENTRIC
+        if (j * 2 != degree_) {
+          blend *= 0.5;
+          dblend = dblend * 0.5;
+        }
+#else
+        if (k < 2 && (j < 2 || j > degree_ - 2)) {
+          if (j < 2) {
+            dblend = dblend * alpha + dalpha * blend;
+            blend *= alpha;
+          } else {
+            dblend = dblend * beta + dbeta * blend;
+            blend *= beta;
+          }
+        } else if (j == k || j == degree_ - k) {
+          blend *= 0.5;
+          dblend = dblend * 0.5;
+        } else if (j < k || j > degree_ - k)
+          continue;
+#endif
+        const Point3D &cp = nets_[i][j][k];
+        result.point += cp * blend;
+        result.du += cp * dblend[0];
+        result.dv += cp * dblend[1];
+        weight_sum += blend;
+        dweight_sum += dblend;
+      }
+    }
+  }
+  result.point += central_cp_ * (1.0 - weight_sum);
+  result.du -= central_cp_ * dweight_sum[0];
+  result.dv -= central_cp_ * dweight_sum[1];
+  return result;
+}
+
 size_t
 SurfaceGeneralizedBezier::degree() const {
   return degree_;
@@ -136,6 +441,83 @@ SurfaceGeneralizedBezier::initNetwork(size_t n, size_t degree) {
     }
     nets_.push_back(cn);
   }
+
+  // Serial indices
+  size_t cp = n_ * (1 + degree_ / 2) * layers_ + 1;
+  serial_cps_.clear(); serial_cps_.reserve(cp - 1);
+  serial_indices_.assign(n_ * (degree_ + 1) * (degree_ + 1), 0);
+  auto setSerial = [&](size_t i, size_t j, size_t k, size_t c) {
+    size_t &index = serial_indices_[(i * (degree_ + 1) + j) * (degree_ + 1) + k];
+    if (index == 0)
+      index = c;
+  };
+  for (size_t c = 1, side = 0, col = 0, row = 0; c < cp; ++c, ++col) {
+    if (col >= degree_ - row) {
+      if (++side >= n_) {
+        side = 0;
+        ++row;
+      }
+      col = row;
+    }
+    serial_cps_.push_back({ side, col, row });
+    setSerial(side, col, row, c);
+    setSerial(prev(side), degree_ - row, col, c);
+    setSerial(next(side), row, degree_ - col, c);
+  }
+}
+
+size_t
+SurfaceGeneralizedBezier::serialCount() const {
+  return serial_cps_.size() + 1;
+}
+
+size_t
+SurfaceGeneralizedBezier::serialIndex(size_t i, size_t j, size_t k) const {
+  if (i >= n_ || j > degree_ || k > degree_)
+    return 0;
+  return serial_indices_[(i * (degree_ + 1) + j) * (degree_ + 1) + k];
+}
+
+const std::array<size_t, 3> &
+SurfaceGeneralizedBezier::serialControlPoint(size_t c) const {
+  return serial_cps_[c - 1];
+}
+
+// One mapping per parameter, instead of one for every weight() call;
+// subclasses with their own weights use those
+void
+SurfaceGeneralizedBezier::serialWeights(const Point2DVector &uvs,
+                                        const std::function<void(size_t, const DoubleVector &)> &f) const {
+  size_t cp = serialCount();
+  std::vector<size_t> serial(n_ * (degree_ + 1) * layers_ + 1, 0); // by mappedBlends index
+  for (size_t i = 0; i < n_; ++i)
+    for (size_t j = 0; j <= degree_; ++j)
+      for (size_t k = 0; k < layers_; ++k)
+        serial[(i * (degree_ + 1) + j) * layers_ + k] = serialIndex(i, j, k);
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    DoubleVector weights;
+    for (size_t s = begin; s < end; ++s) {
+      weights.assign(cp, 0.0);
+      if (planned_eval_ && !side_terms_) {
+        Point2DVector sds = *param_->mapToRibbons(uvs[s]);
+        planBlends(sds, [&](size_t index, double blend) { weights[serial[index]] += blend; },
+                   nullptr);
+      } else {
+        double weight_sum = 0.0;
+        for (size_t c = 1; c < cp; ++c) {
+          auto [i, j, k] = serial_cps_[c - 1];
+          weights[c] = weight(i, j, k, uvs[s]);
+          if (j < layers_)
+            weights[c] += weight(prev(i), degree_ - k, j, uvs[s]);
+          if (j > degree_ - layers_)
+            weights[c] += weight(next(i), k, degree_ - j, uvs[s]);
+          weight_sum += weights[c];
+        }
+        weights[0] = 1.0 - weight_sum;
+      }
+      f(s, weights);
+    }
+  });
 }
 
 void
@@ -154,8 +536,7 @@ SurfaceGeneralizedBezier::setupLoop() {
 
   Surface::setupLoop();
 
-  if (domain_->update())
-    param_->update();
+  updateDomain();
 }
 
 void
@@ -201,8 +582,21 @@ SurfaceGeneralizedBezier::weight(size_t i, size_t j, size_t k, const Point2D &uv
     return 0.0;
 
   // Otherwise we need the local parameters
-  Point2DVector sds = param_->mapToRibbons(uv);
-  const double &si   = sds[i][0];
+  return mappedWeight(i, j, k, *param_->mapToRibbons(uv));
+}
+
+double
+SurfaceGeneralizedBezier::mappedWeight(size_t i, size_t j, size_t k,
+                                       const Point2DVector &sds) const {
+  return mappedWeight(i, j, k, sds, nullptr, nullptr);
+}
+
+double
+SurfaceGeneralizedBezier::mappedWeight(size_t i, size_t j, size_t k, const Point2DVector &sds,
+                                       const double *bl_s, const double *bl_d) const {
+  if (k >= 2 && (j < k || j > degree_ - k))
+    return 0.0;
+
   const double &di_1 = sds[prev(i)][1];
   const double &di   = sds[i][1];
   const double &di1  = sds[next(i)][1];
@@ -215,7 +609,15 @@ SurfaceGeneralizedBezier::weight(size_t i, size_t j, size_t k, const Point2D &uv
     return j == 0 && k == 0 ? 0.5 : 0.0;
 
   // Basic blend is computed by Bernstein functions
-  double blend = bernstein(j, degree_, si) * bernstein(k, degree_, di);
+  if (!bl_s) {
+    thread_local DoubleVector s_values, d_values;
+    s_values.resize(degree_ + 1); d_values.resize(degree_ + 1);
+    bernstein(degree_, sds[i][0], s_values.data());
+    bernstein(degree_, sds[i][1], d_values.data());
+    bl_s = s_values.data();
+    bl_d = d_values.data();
+  }
+  double blend = bl_s[j] * bl_d[k];
 
   // At the 2x2 corners use rational weights
   if (k < 2 && (j < 2 || j > degree_ - 2)) {
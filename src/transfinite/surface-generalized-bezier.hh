@@ -1,5 +1,6 @@
 #pragma once
 
+#include "influence.hh"
 #include "surface.hh"
 
 namespace Transfinite {
@@ -10,29 +11,99 @@ public:
   SurfaceGeneralizedBezier(const SurfaceGeneralizedBezier &) = default;
   virtual ~SurfaceGeneralizedBezier();
   SurfaceGeneralizedBezier &operator=(const SurfaceGeneralizedBezier &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
   size_t degree() const;
   size_t layers() const;
   virtual void initNetwork(size_t n, size_t degree);
   virtual void setupLoop() override;
+  virtual void update(size_t i) override;
+  virtual void update() override;
   void useSquaredRationalWeights(bool use);
   Point3D centralControlPoint() const;
   void setCentralControlPoint(const Point3D &p);
   Point3D controlPoint(size_t i, size_t j, size_t k) const;
   void setControlPoint(size_t i, size_t j, size_t k, const Point3D &p);
   void setIndividualControlPoint(size_t i, size_t j, size_t k, const Point3D &p);
+  // Serial numbering of the control points, as used in files and fitting:
+  // 0 is the central control point, followed by rows k = 0 .. layers - 1, each going around the sides
+  // with j = k .. degree - k - 1; aliases of the same control point have the same index,
+  // and (i, j, k) outside the network also gives 0
+  size_t serialCount() const;
+  size_t serialIndex(size_t i, size_t j, size_t k) const;
+  const std::array<size_t, 3> &serialControlPoint(size_t c) const; // (i, j, k) of c > 0
+  // Calls f(index, weights) for each of the parameters, in parallel, where weights[c] is
+  // the total weight of the control point with serial index c (as in eval, with 1 - the rest at 0)
+  void serialWeights(const Point2DVector &uvs,
+                     const std::function<void(size_t, const DoubleVector &)> &f) const;
   virtual double weight(size_t i, size_t j, size_t k, const Point2D &uv) const;
+  // Uses a tessellation plan (see below) when parameter tables are used, and planned_eval_ is set
+  virtual TriMesh eval(size_t resolution) const override;
+  // Influence images of the control points (indexed as in mappedBlends) on the uniform mesh;
+  // setControlPoint(i, j, k) moves all control points of controlPointIndices(i, j, k)
+  InfluenceMap influences(size_t resolution, double threshold = 0.0) const;
+  std::vector<size_t> controlPointIndices(size_t i, size_t j, size_t k) const;
+  // All control points, indexed as in mappedBlends
+  PointVector controlPoints() const;
+  // The blends of controlPoints() at the points of the uniform mesh, in compressed rows:
+  // point i is the sum of controlPoints()[indices[j]] * blends[j] for j in [offsets[i], offsets[i+1]);
+  // this is the tessellation plan (see below), so control point changes need no recomputation.
+  // Not available for subclasses with side terms (see side_terms_).
+  struct BlendMatrix {
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> indices;
+    DoubleVector blends;
+  };
+  std::shared_ptr<const BlendMatrix> blendMatrix(size_t resolution) const;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
+  virtual Derivatives evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                            const Vector2DVector &ds,
+                                            const Vector2DVector &dd) const override;
+  virtual void evalPoints(size_t resolution, const PointStore &store) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+  virtual void detach() override;
+  double mappedWeight(size_t i, size_t j, size_t k, const Point2DVector &sds) const;
+  // The same, given the Bernstein polynomials bl_s and bl_d of degree_ at sds[i]
+  // (when null, they are only computed for weights that are not decided by the checks)
+  double mappedWeight(size_t i, size_t j, size_t k, const Point2DVector &sds,
+                      const double *bl_s, const double *bl_d) const;
+  // Calls add(control point, index, blend) for the control points with nonzero blends,
+  // in the order of summation; the index of nets_[i][j][k] is (i * (degree_ + 1) + j) * layers_ + k,
+  // and the central control point comes last
+  template<typename F>
+  void mappedBlends(const Point2DVector &sds, F add) const;
+  // The blends of the tessellation plan: calls add(index, blend) as mappedBlends() does;
+  // subclasses with other blends override this (and keep planned_eval_). With side_terms_,
+  // the blends of the side interpolants (see sideInterpolant) are written to side_blends.
+  using BlendAdder = std::function<void(size_t index, double blend)>;
+  virtual void planBlends(const Point2DVector &sds, const BlendAdder &add,
+                          double *side_blends) const;
 
   using ControlNet = std::vector<PointVector>;
 
   size_t degree_, layers_;
   Point3D central_cp_;
   std::vector<ControlNet> nets_;
+  std::vector<size_t> serial_indices_;                // by (i * (degree_ + 1) + j) * (degree_ + 1) + k
+  std::vector<std::array<size_t, 3>> serial_cps_;     // starting with index 1
   bool squared_weights_;
+  bool planned_eval_; // evalMapped() is given by planBlends(); subclasses not overriding that clear this
+  bool side_terms_;   // evalMapped() also blends the side interpolants (see planBlends)
+
+private:
+  // For each point of a uniform mesh, the blends of the control points by index (see planBlends),
+  // in compressed rows; they depend only on the ribbon parameters (i.e., the domain),
+  // so moving control points needs only a sparse matrix-vector product
+  struct TessellationPlan;
+  struct PlanCache;
+  std::shared_ptr<const TessellationPlan> tessellationPlan(size_t resolution) const;
+  // The blended side interpolants of each point of a plan, cached until the next update
+  std::shared_ptr<const PointVector> sideTerms(size_t resolution,
+                                               const std::shared_ptr<const TessellationPlan> &plan) const;
+
+  std::shared_ptr<PlanCache> plans_; // shared by copies
 };
 
 } // namespace Transfinite
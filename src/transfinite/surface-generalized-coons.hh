@@ -10,10 +10,15 @@ public:
   SurfaceGeneralizedCoons(const SurfaceGeneralizedCoons &) = default;
   virtual ~SurfaceGeneralizedCoons();
   SurfaceGeneralizedCoons &operator=(const SurfaceGeneralizedCoons &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
 
 protected:
+  virtual Point3D evalBlended(const Point2D &uv, const Point2DVector &sds,
+                              const double *blends) const override;
+  virtual Derivatives evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                            const Vector2DVector &ds,
+                                            const Vector2DVector &dd) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
 };
 
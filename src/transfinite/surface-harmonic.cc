@@ -1,9 +1,15 @@
-#include <exception>
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 #include <Eigen/Sparse>
 
+#include "constrained-solver.hh"
 #include "domain-regular.hh"
+#include "locator.hh"
+#include "multigrid-solver.hh"
 #include "parameterization-barycentric.hh"
+#include "profiler.hh"
 #include "ribbon-dummy.hh"
 #include "surface-harmonic.hh"
 #include "utilities.hh"
@@ -16,64 +22,120 @@ using DomainType = DomainRegular;
 using ParamType = ParameterizationBarycentric;
 using RibbonType = RibbonDummy;
 
-SurfaceHarmonic::SurfaceHarmonic() {
+// The factorized system depends only on the domain and the resolution, so it is kept
+// for later evaluations, which then only need to sample the curves and back-substitute.
+// In multigrid mode the last solution is also kept, as the initial guess of the next one.
+struct SurfaceHarmonic::SolverCache {
+  struct Solver {
+    Solver(const Point2DVector &vertices, const SparseMatrix<double> &A,
+           const std::vector<size_t> &boundary)
+      : vertices(vertices), system(std::make_unique<ConstrainedSolver>(A, boundary)) {
+    }
+    Solver(const Point2DVector &vertices, const SparseMatrix<double> &A,
+           const std::vector<size_t> &boundary, const std::vector<SparseMatrix<double>> &P)
+      : vertices(vertices), multigrid(std::make_unique<MultigridSolver>(A, boundary, P)) {
+    }
+    Point2DVector vertices; // of the domain it was computed for
+    std::unique_ptr<ConstrainedSolver> system;
+    std::unique_ptr<MultigridSolver> multigrid;
+  };
+  std::map<size_t, std::shared_ptr<const Solver>> solvers;
+  std::map<size_t, MatrixXd> solutions;
+  std::shared_ptr<const MeshInterpolant> interpolant; // for eval(uv), until the next update
+  std::mutex mutex;
+};
+
+SurfaceHarmonic::SurfaceHarmonic()
+  : solvers_(std::make_shared<SolverCache>()), use_multigrid_(false), eval_resolution_(64) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  pointwise_mesh_ = false;
 }
 
 SurfaceHarmonic::~SurfaceHarmonic() {
 }
 
-Point3D
-SurfaceHarmonic::eval(const Point2D &uv) const {
-  throw std::runtime_error("single-point evaluation is not supported for harmonic surfaces");
+std::shared_ptr<Surface>
+SurfaceHarmonic::clone() const {
+  return std::make_shared<SurfaceHarmonic>(*this);
 }
 
-static Point3D
-from2D(const Point2D &p) {
-  return { p[0], p[1], 0 };
+// The snapshot gets a copy of the cache, as the two would replace each other's entries
+void
+SurfaceHarmonic::detach() {
+  Surface::detach();
+  auto solvers = std::make_shared<SolverCache>();
+  {
+    std::lock_guard<std::mutex> lock(solvers_->mutex);
+    solvers->solvers = solvers_->solvers;
+    solvers->solutions = solvers_->solutions;
+    solvers->interpolant = solvers_->interpolant;
+  }
+  solvers_ = solvers;
 }
 
-// Based on a program by Marton Vaitkus
-TriMesh
-SurfaceHarmonic::eval(size_t resolution) const {
-  TriMesh mesh = domain_->meshTopology(resolution);
-  Point2DVector uvs = domain_->parameters(resolution);
-  size_t n_all = uvs.size(), n_boundary = 0;
-  PointVector points; points.resize(n_all);
+void
+SurfaceHarmonic::update(size_t i) {
+  Surface::update(i);
+  std::lock_guard<std::mutex> lock(solvers_->mutex);
+  solvers_->interpolant.reset();
+}
 
-  // Set up valences
-  std::vector<size_t> valences(n_all, 0);
-  for (const auto &t : mesh.triangles())
-    for (auto i : t)
-      valences[i]++;
+void
+SurfaceHarmonic::update() {
+  Surface::update();
+  std::lock_guard<std::mutex> lock(solvers_->mutex);
+  solvers_->interpolant.reset();
+}
 
-  // Fill the boundary points
-  for (size_t i = 0; i < n_all; ++i)
-    if (domain_->onEdge(resolution, i)) {
-      auto bc = dynamic_cast<ParameterizationBarycentric*>(param_.get())->barycentric(uvs[i]);
-      auto j = std::distance(bc.begin(), std::max_element(bc.begin(), bc.end()));
-      if (bc[next(j)] > bc[prev(j)])
-        j = next(j);
-      points[i] = ribbons_[j]->curve()->eval(bc[j]);
-      ++n_boundary;
-    }
+Point3D
+SurfaceHarmonic::eval(const Point2D &uv) const {
+  std::shared_ptr<const MeshInterpolant> interpolant;
+  {
+    std::lock_guard<std::mutex> lock(solvers_->mutex);
+    interpolant = solvers_->interpolant;
+  }
+  if (!interpolant) {
+    // Concurrent first calls may compute it more than once, but with the same result
+    interpolant = std::make_shared<MeshInterpolant>(domain_->locator(eval_resolution_),
+                                                    eval(eval_resolution_).points());
+    std::lock_guard<std::mutex> lock(solvers_->mutex);
+    solvers_->interpolant = interpolant;
+  }
+  return interpolant->eval(uv);
+}
 
-  // Set up the equations
-  SparseMatrix<double> A(n_all + n_boundary, n_all + n_boundary);
-  MatrixXd b = MatrixXd::Zero(n_all + n_boundary, 3);
+// The solution is needed as a whole
+void
+SurfaceHarmonic::evalPoints(size_t resolution, const PointStore &store) const {
+  TriMesh mesh = eval(resolution);
+  store(0, mesh.points().size(), mesh.points().data());
+}
 
-  // - Sparse matrix handling
-  VectorXd nnz(n_all + n_boundary);
-  for (size_t i = 0; i < n_all; ++i)
-    nnz(i) = valences[i] + 2;
-  for (size_t i = 0; i < n_boundary; ++i)
-    nnz(n_all + i) = 1;
-  A.makeCompressed();
-  A.reserve(nnz);
+void
+SurfaceHarmonic::useMultigrid(bool use) {
+  use_multigrid_ = use;
+}
+
+void
+SurfaceHarmonic::setEvaluationResolution(size_t resolution) {
+  eval_resolution_ = resolution;
+  std::lock_guard<std::mutex> lock(solvers_->mutex);
+  solvers_->interpolant.reset();
+}
+
+static Point3D
+from2D(const Point2D &p) {
+  return { p[0], p[1], 0 };
+}
 
-  // - Laplacian coeficients
+// The cotangent Laplacian (duplicates are summed by setFromTriplets)
+static SparseMatrix<double>
+laplaceMatrix(const TriMesh &mesh, const Point2DVector &uvs) {
+  TRANSFINITE_TIMER("SurfaceHarmonic::assemble");
+  std::vector<Triplet<double>> triplets;
+  triplets.reserve(mesh.triangles().size() * 9);
   for (const auto &t : mesh.triangles()) {
     auto p1 = from2D(uvs[t[0]]), p2 = from2D(uvs[t[1]]), p3 = from2D(uvs[t[2]]);
     double Ai = ((p2 - p1) ^ (p3 - p1)).norm();
@@ -81,33 +143,77 @@ SurfaceHarmonic::eval(size_t resolution) const {
     double v2_cot = 0.5 * ((p1 - p2) * (p3 - p2)) / Ai;
     double v3_cot = 0.5 * ((p2 - p3) * (p1 - p3)) / Ai;
 
-    A.coeffRef(t[0], t[0]) += v3_cot + v2_cot;
-    A.coeffRef(t[0], t[1]) += -v3_cot;
-    A.coeffRef(t[0], t[2]) += -v2_cot;
+    triplets.emplace_back(t[0], t[0], v3_cot + v2_cot);
+    triplets.emplace_back(t[0], t[1], -v3_cot);
+    triplets.emplace_back(t[0], t[2], -v2_cot);
 
-    A.coeffRef(t[1], t[0]) += -v3_cot;
-    A.coeffRef(t[1], t[1]) += v3_cot + v1_cot;
-    A.coeffRef(t[1], t[2]) += -v1_cot;
+    triplets.emplace_back(t[1], t[0], -v3_cot);
+    triplets.emplace_back(t[1], t[1], v3_cot + v1_cot);
+    triplets.emplace_back(t[1], t[2], -v1_cot);
 
-    A.coeffRef(t[2], t[0]) += -v2_cot;
-    A.coeffRef(t[2], t[1]) += -v1_cot;
-    A.coeffRef(t[2], t[2]) += v2_cot + v1_cot;
+    triplets.emplace_back(t[2], t[0], -v2_cot);
+    triplets.emplace_back(t[2], t[1], -v1_cot);
+    triplets.emplace_back(t[2], t[2], v2_cot + v1_cot);
   }
+  SparseMatrix<double> A(uvs.size(), uvs.size());
+  A.setFromTriplets(triplets.begin(), triplets.end());
+  return A;
+}
 
-  // - Constraints
-  for (size_t i = 0, j = 0; i < n_all; ++i)
-    if (domain_->onEdge(resolution, i)) {
-      A.coeffRef(n_all + j, i) = 1;
-      A.coeffRef(i, n_all + j) = 1;
-      b.block<1,3>(n_all + j, 0) = Map<const Vector3d>(points[i].data());
-      ++j;
+// Based on a program by Marton Vaitkus
+TriMesh
+SurfaceHarmonic::eval(size_t resolution) const {
+  TriMesh mesh = domain_->meshTopology(resolution);
+  auto mesh_boundary = domain_->meshBoundary(resolution);
+  const auto &boundary = mesh_boundary->vertices;
+  size_t n_all = mesh.points().size(), n_boundary = boundary.size();
+
+  std::shared_ptr<const SolverCache::Solver> solver;
+  {
+    std::lock_guard<std::mutex> lock(solvers_->mutex);
+    auto &cached = solvers_->solvers[resolution];
+    const Point2DVector &vertices = domain_->vertices();
+    if (!cached || cached->vertices.size() != vertices.size() ||
+        !std::equal(vertices.begin(), vertices.end(), cached->vertices.begin(),
+                    [](const Point2D &p, const Point2D &q) { return p[0] == q[0] && p[1] == q[1]; }) ||
+        (bool)cached->multigrid != use_multigrid_) {
+      // Set up the equations: the cotangent Laplacian, with the boundary values eliminated
+      SparseMatrix<double> A = laplaceMatrix(mesh, *domain_->sharedParameters(resolution));
+      std::vector<size_t> indices;
+      for (const auto &bv : boundary)
+        indices.push_back(bv.index);
+      if (use_multigrid_)
+        cached = std::make_shared<SolverCache::Solver>(vertices, A, indices,
+                                                       MultigridSolver::prolongations(*domain_,
+                                                                                      resolution));
+      else
+        cached = std::make_shared<SolverCache::Solver>(vertices, A, indices);
     }
+    solver = cached;
+  }
+
+  // Fill the boundary points
+  MatrixXd b(n_boundary, 3);
+  for (size_t j = 0; j < n_boundary; ++j) {
+    Point3D p = ribbons_[boundary[j].side]->curve()->eval(boundary[j].s);
+    b.row(j) = Map<const Vector3d>(p.data());
+  }
 
   // Solve the system
-  SparseLU<SparseMatrix<double>> solver;
-  solver.compute(A);
-  MatrixXd x = solver.solve(b);
+  MatrixXd x;
+  if (solver->multigrid) {
+    MatrixXd guess;
+    {
+      std::lock_guard<std::mutex> lock(solvers_->mutex);
+      guess = solvers_->solutions[resolution];
+    }
+    x = solver->multigrid->solve(MatrixXd(), b, guess);
+    std::lock_guard<std::mutex> lock(solvers_->mutex);
+    solvers_->solutions[resolution] = x;
+  } else
+    x = solver->system->solve(MatrixXd(), b);
 
+  PointVector points(n_all);
   for (size_t i = 0; i < n_all; ++i)
     points[i] = { x(i, 0), x(i, 1), x(i, 2) };
 
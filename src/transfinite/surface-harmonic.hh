@@ -10,11 +10,27 @@ public:
   SurfaceHarmonic(const SurfaceHarmonic &) = default;
   virtual ~SurfaceHarmonic();
   SurfaceHarmonic &operator=(const SurfaceHarmonic &) = default;
+  virtual std::shared_ptr<Surface> clone() const override;
+  virtual void update(size_t i) override;
+  virtual void update() override;
+  using Surface::eval;
+  // Interpolates a mesh of the evaluation resolution, computed at the first call after an update
   virtual Point3D eval(const Point2D &uv) const override;
   virtual TriMesh eval(size_t resolution) const override;
+  // Solve by multigrid instead of factorizing the system (see MultigridSolver)
+  void useMultigrid(bool use);
+  void setEvaluationResolution(size_t resolution);
 
 protected:
+  virtual void evalPoints(size_t resolution, const PointStore &store) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+  virtual void detach() override;
+
+private:
+  struct SolverCache;
+  std::shared_ptr<SolverCache> solvers_; // shared by copies
+  bool use_multigrid_;
+  size_t eval_resolution_;
 };
 
 } // namespace Transfinite
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "domain-regular.hh"
 #include "parameterization-barycentric.hh"
 #include "ribbon-compatible-with-handler.hh"
@@ -15,29 +17,51 @@ SurfaceHybrid::SurfaceHybrid() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_derivatives_ = false;  // evalMapped() is overridden without a derivative version
+  side_terms_ = true;
 }
 
 SurfaceHybrid::~SurfaceHybrid() {
 }
 
-Point3D
-SurfaceHybrid::eval(const Point2D &uv) const {
-  Point3D surface_point(0,0,0);
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends(n_, 0.0);
+std::shared_ptr<Surface>
+SurfaceHybrid::clone() const {
+  return std::make_shared<SurfaceHybrid>(*this);
+}
+
+// Calls add(control point, index, blend) as in mappedBlends()
+template<typename F>
+void
+SurfaceHybrid::hybridBlends(const Point2DVector &sds, F add, double *side_blends) const {
+  thread_local DoubleVector bl_s, bl_d;
+  bl_s.resize(degree_ + 1); bl_d.resize(degree_ + 1);
+  std::fill_n(side_blends, n_, 0.0);
 
   double weight_sum = 0.0;
-  for (size_t i = 0; i < n_; ++i)
+  for (size_t i = 0; i < n_; ++i) {
+    bernstein(degree_, sds[i][0], bl_s.data());
+    bernstein(degree_, sds[i][1], bl_d.data());
     for (size_t k = 0; k < layers_; ++k)
       for (size_t j = 0; j <= degree_; ++j) {
-        double blend = weight(i, j, k, uv);
-        if (k >= 2)
-          surface_point += nets_[i][j][k] * blend;
-        else
-          blends[i] += blend;
+        double blend = mappedWeight(i, j, k, sds, bl_s.data(), bl_d.data());
+        if (k >= 2) {
+          if (blend != 0.0)
+            add(nets_[i][j][k], (i * (degree_ + 1) + j) * layers_ + k, blend);
+        } else
+          side_blends[i] += blend;
         weight_sum += blend;
       }
-  surface_point += central_cp_ * (1.0 - weight_sum);
+  }
+  add(central_cp_, n_ * (degree_ + 1) * layers_, 1.0 - weight_sum);
+}
+
+Point3D
+SurfaceHybrid::evalMapped(const Point2D &, const Point2DVector &sds) const {
+  Point3D surface_point(0,0,0);
+  thread_local DoubleVector blends;
+  blends.resize(n_);
+  hybridBlends(sds, [&](const Point3D &cp, size_t, double blend) { surface_point += cp * blend; },
+               blends.data());
 
   for (size_t i = 0; i < n_; ++i)
     surface_point += sideInterpolant(i, sds[i][0], sds[i][1]) * blends[i];
@@ -45,6 +69,13 @@ SurfaceHybrid::eval(const Point2D &uv) const {
   return surface_point;
 }
 
+void
+SurfaceHybrid::planBlends(const Point2DVector &sds, const BlendAdder &add,
+                          double *side_blends) const {
+  hybridBlends(sds, [&](const Point3D &, size_t index, double blend) { add(index, blend); },
+               side_blends);
+}
+
 std::shared_ptr<Ribbon>
 SurfaceHybrid::newRibbon() const {
   return std::make_shared<RibbonType>();
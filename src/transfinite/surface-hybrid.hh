@@ -10,11 +10,20 @@ public:
   SurfaceHybrid(const SurfaceHybrid &) = default;
   virtual ~SurfaceHybrid();
   SurfaceHybrid &operator=(const SurfaceHybrid &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
+  // The inner control points (k >= 2) and the central one, with the blends of the outer two
+  // layers of each side given to its side interpolant
+  virtual void planBlends(const Point2DVector &sds, const BlendAdder &add,
+                          double *side_blends) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+
+private:
+  template<typename F>
+  void hybridBlends(const Point2DVector &sds, F add, double *side_blends) const;
 };
 
 } // namespace Transfinite
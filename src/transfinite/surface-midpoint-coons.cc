@@ -20,17 +20,52 @@ SurfaceMidpointCoons::SurfaceMidpointCoons() {
 SurfaceMidpointCoons::~SurfaceMidpointCoons() {
 }
 
+std::shared_ptr<Surface>
+SurfaceMidpointCoons::clone() const {
+  return std::make_shared<SurfaceMidpointCoons>(*this);
+}
+
 Point3D
-SurfaceMidpointCoons::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendCornerDeficient(sds);
+SurfaceMidpointCoons::evalBlended(const Point2D &, const Point2DVector &sds,
+                                  const double *blends) const {
   Point3D p(0,0,0);
+  double skipped = 0;
   for (size_t i = 0; i < n_; ++i) {
     double s = sds[i][0], d = sds[i][1], s1 = sds[next(i)][0];
-    p += sideInterpolant(i, s, d) * (blends[i] + blends[prev(i)]);
-    p -= cornerCorrection(i, 1.0 - s, s1) * blends[i];
+    double side_blend = blends[i] + blends[prev(i)];
+    if (negligibleBlend(side_blend))
+      skipped += side_blend;
+    else
+      p += sideInterpolant(i, s, d) * side_blend;
+    if (negligibleBlend(blends[i]))
+      skipped -= blends[i];
+    else
+      p -= cornerCorrection(i, 1.0 - s, s1) * blends[i];
+  }
+  p += corner_centroid_ * skipped;
+  p += central_cp_ * (1.0 - std::accumulate(blends, blends + n_, 0.0));
+  return p;
+}
+
+Surface::Derivatives
+SurfaceMidpointCoons::evalMappedDerivatives(const Point2D &, const Point2DVector &sds,
+                                            const Vector2DVector &ds, const Vector2DVector &dd) const {
+  thread_local DoubleVector blends;
+  thread_local Vector2DVector dblends;
+  blendCornerDeficient(sds, ds, dd, blends, dblends);
+  Derivatives p = { Point3D(0,0,0), Vector3D(0,0,0), Vector3D(0,0,0) };
+  Vector2D dsum(0, 0);
+  for (size_t i = 0; i < n_; ++i) {
+    size_t ip = next(i), im = prev(i);
+    double s = sds[i][0], d = sds[i][1], s1 = sds[ip][0];
+    addBlended(p, sideInterpolant(i, s, d, ds[i], dd[i]),
+               blends[i] + blends[im], dblends[i] + dblends[im]);
+    addBlended(p, cornerCorrection(i, 1.0 - s, s1, ds[i] * -1.0, ds[ip]),
+               -blends[i], dblends[i] * -1.0);
+    dsum += dblends[i];
   }
-  p += central_cp_ * (1.0 - std::accumulate(blends.begin(), blends.end(), 0.0));
+  Derivatives central = { central_cp_, Vector3D(0,0,0), Vector3D(0,0,0) };
+  addBlended(p, central, 1.0 - std::accumulate(blends.begin(), blends.end(), 0.0), dsum * -1.0);
   return p;
 }
 
@@ -10,8 +10,15 @@ public:
   SurfaceMidpointCoons(const SurfaceMidpointCoons &) = default;
   virtual ~SurfaceMidpointCoons();
   SurfaceMidpointCoons &operator=(const SurfaceMidpointCoons &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
+
+protected:
+  virtual Point3D evalBlended(const Point2D &uv, const Point2DVector &sds,
+                              const double *blends) const override;
+  virtual Derivatives evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                            const Vector2DVector &ds,
+                                            const Vector2DVector &dd) const override;
 };
 
 } // namespace Transfinite
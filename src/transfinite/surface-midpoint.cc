@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 
 #include "domain-regular.hh"
@@ -16,11 +17,19 @@ SurfaceMidpoint::SurfaceMidpoint() : midpoint_set_(false) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
+  blend_type_ = BlendType::CORNER_DEFICIENT;
+  mapped_derivatives_ = true;
 }
 
 SurfaceMidpoint::~SurfaceMidpoint() {
 }
 
+std::shared_ptr<Surface>
+SurfaceMidpoint::clone() const {
+  return std::make_shared<SurfaceMidpoint>(*this);
+}
+
 void
 SurfaceMidpoint::update(size_t i) {
   Surface::update(i);
@@ -34,13 +43,34 @@ SurfaceMidpoint::update() {
 }
 
 Point3D
-SurfaceMidpoint::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendCornerDeficient(sds);
+SurfaceMidpoint::evalBlended(const Point2D &, const Point2DVector &sds,
+                             const double *blends) const {
   Point3D p(0,0,0);
+  double skipped = 0;
   for (size_t i = 0; i < n_; ++i)
-    p += cornerInterpolant(i, sds) * blends[i];
-  p += central_cp_ * (1.0 - std::accumulate(blends.begin(), blends.end(), 0.0));
+    if (negligibleBlend(blends[i]))
+      skipped += blends[i];
+    else
+      p += cornerInterpolant(i, sds) * blends[i];
+  p += corner_centroid_ * skipped;
+  p += central_cp_ * (1.0 - std::accumulate(blends, blends + n_, 0.0));
+  return p;
+}
+
+Surface::Derivatives
+SurfaceMidpoint::evalMappedDerivatives(const Point2D &, const Point2DVector &sds,
+                                       const Vector2DVector &ds, const Vector2DVector &dd) const {
+  thread_local DoubleVector blends;
+  thread_local Vector2DVector dblends;
+  blendCornerDeficient(sds, ds, dd, blends, dblends);
+  Derivatives p = { Point3D(0,0,0), Vector3D(0,0,0), Vector3D(0,0,0) };
+  Vector2D dsum(0, 0);
+  for (size_t i = 0; i < n_; ++i) {
+    addBlended(p, cornerInterpolant(i, sds, ds, dd), blends[i], dblends[i]);
+    dsum += dblends[i];
+  }
+  Derivatives central = { central_cp_, Vector3D(0,0,0), Vector3D(0,0,0) };
+  addBlended(p, central, 1.0 - std::accumulate(blends.begin(), blends.end(), 0.0), dsum * -1.0);
   return p;
 }
 
@@ -57,13 +87,41 @@ SurfaceMidpoint::unsetMidpoint() {
   updateCentralControlPoint();
 }
 
+uint64_t
+SurfaceMidpoint::deficiencySides() const {
+  return ~uint64_t(0);
+}
+
 double
 SurfaceMidpoint::deficiency(const Point2D &p) const {
-  DoubleVector blends = blendCornerDeficient(param_->mapToRibbons(p));
+  DoubleVector blends;
+  blendCornerDeficient(*param_->mapToRibbons(p), blends);
   double blf_sum = std::accumulate(blends.begin(), blends.end(), 0.0);
   return 1.0 - blf_sum;
 }
 
+// Moving the midpoint by d moves the central control point by d / deficiency(center)
+// (see updateCentralControlPoint), so a vertex moves by d * deficiency(uv) / deficiency(center)
+InfluenceMap
+SurfaceMidpoint::influences(size_t resolution, double threshold) const {
+  double def = deficiency(domain_->center());
+  if (std::abs(def) < epsilon)
+    def = 1.0;
+  auto table = param_->parameterTable(resolution, executor_);
+  size_t size = table->sds.size() / n_;
+  std::vector<std::vector<std::pair<size_t, double>>> rows(size);
+  executor_(size, [&](size_t begin, size_t end) {
+    Point2DVector sds(n_);
+    DoubleVector blends;
+    for (size_t v = begin; v < end; ++v) {
+      std::copy_n(table->row(v), n_, sds.begin());
+      blendCornerDeficient(sds, blends);
+      rows[v].emplace_back(0, (1.0 - std::accumulate(blends.begin(), blends.end(), 0.0)) / def);
+    }
+  });
+  return InfluenceMap(eval(resolution), 1, rows, threshold);
+}
+
 std::shared_ptr<Ribbon>
 SurfaceMidpoint::newRibbon() const {
   return std::make_shared<RibbonType>();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "influence.hh"
 #include "surface.hh"
 
 namespace Transfinite {
@@ -10,14 +11,24 @@ public:
   SurfaceMidpoint(const SurfaceMidpoint &) = default;
   virtual ~SurfaceMidpoint();
   SurfaceMidpoint &operator=(const SurfaceMidpoint &) = default;
+  virtual std::shared_ptr<Surface> clone() const override;
   virtual void update(size_t i) override;
   virtual void update() override;
-  virtual Point3D eval(const Point2D &uv) const override;
   using Surface::eval;
   void setMidpoint(const Point3D &p);
   void unsetMidpoint();
+  // Influence image of the midpoint (as a single control point) on the uniform mesh,
+  // valid while the midpoint is set
+  InfluenceMap influences(size_t resolution, double threshold = 0.0) const;
 
 protected:
+  virtual Point3D evalBlended(const Point2D &uv, const Point2DVector &sds,
+                              const double *blends) const override;
+  virtual Derivatives evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                            const Vector2DVector &ds,
+                                            const Vector2DVector &dd) const override;
+  // The central control point depends on all sides
+  virtual uint64_t deficiencySides() const override;
   virtual double deficiency(const Point2D &p) const;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
 
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+
 #include "domain-angular.hh"
 #include "parameterization-parallel.hh"
 #include "parameterization-perp-polar.hh"
+#include "profiler.hh"
 #include "ribbon-nsided.hh"
 #include "surface-nsided.hh"
 
@@ -8,36 +13,120 @@ namespace Transfinite {
 
 using DomainType = DomainAngular;
 using ParamType = ParameterizationPerpPolar;
+using BlendParamType = ParameterizationParallel;
 using RibbonType = RibbonNSided;
 
-SurfaceNSided::SurfaceNSided() {
+struct SurfaceNSided::DualTable {
+  Point2DVector sds;
+};
+
+struct SurfaceNSided::TableCache {
+  std::map<size_t, std::shared_ptr<const DualTable>> tables;
+  std::mutex mutex;
+};
+
+SurfaceNSided::SurfaceNSided() : tables_(std::make_shared<TableCache>()) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
-  blend_param_ = std::make_shared<ParameterizationParallel>();
+  blend_param_ = std::make_shared<BlendParamType>();
   blend_param_->setDomain(domain_);
 }
 
 SurfaceNSided::~SurfaceNSided() {
 }
 
+std::shared_ptr<Surface>
+SurfaceNSided::clone() const {
+  return std::make_shared<SurfaceNSided>(*this);
+}
+
+void
+SurfaceNSided::detach() {
+  Surface::detach();
+  blend_param_ = blend_param_->clone();
+  blend_param_->setDomain(domain_);
+}
+
+void
+SurfaceNSided::shareDomain(const Surface &other) {
+  Surface::shareDomain(other);
+  blend_param_->setDomain(domain_);
+}
+
 void
 SurfaceNSided::update(size_t i) {
   Surface::update(i);
   blend_param_->update();
+  tables_ = std::make_shared<TableCache>();
 }
 
 void
 SurfaceNSided::update() {
   Surface::update();
   blend_param_->update();
+  tables_ = std::make_shared<TableCache>();
 }
 
 Point3D
 SurfaceNSided::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  Point2DVector blend_sds = blend_param_->mapToRibbons(uv);
-  DoubleVector blends = blendSideSingular(blend_sds);
+  thread_local Point2DVector sds;
+  sds.resize(2 * n_);
+  mapToRibbons(uv, sds.data());
+  return evalDual(sds.data());
+}
+
+TriMesh
+SurfaceNSided::eval(size_t resolution) const {
+  if (!use_tables_)
+    return Surface::eval(resolution);
+
+  TriMesh mesh = domain_->meshTopology(resolution);
+  PointVector points(mesh.points().size());
+  evalPoints(resolution, [&](size_t first, size_t size, const Point3D *block) {
+    std::copy_n(block, size, &points[first]);
+  });
+  mesh.setPoints(points);
+  return mesh;
+}
+
+void
+SurfaceNSided::evalPoints(size_t resolution, const PointStore &store) const {
+  if (!use_tables_) {
+    Surface::evalPoints(resolution, store);
+    return;
+  }
+
+  TRANSFINITE_TIMER("SurfaceNSided::evalPoints");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  auto table = dualTable(resolution);
+  TRANSFINITE_COUNT("evaluated points", table->sds.size() / (2 * n_));
+  executor_(table->sds.size() / (2 * n_), [&](size_t begin, size_t end) {
+    PointVector points(end - begin);
+    for (size_t i = begin; i < end; ++i)
+      points[i-begin] = evalDual(&table->sds[i * 2 * n_]);
+    store(begin, points.size(), points.data());
+  });
+}
+
+void
+SurfaceNSided::mapToRibbons(const Point2D &uv, Point2D *sds) const {
+  const auto &param = static_cast<const ParamType &>(*param_);
+  const auto &blend_param = static_cast<const BlendParamType &>(*blend_param_);
+  const Point2DVector &vertices = domain_->vertices();
+  for (size_t i = 0; i < n_; ++i) {
+    Point2D p = domain_->toLocal(i, uv - vertices[prev(i)]);
+    sds[i] = param.mapLocal(i, uv, p);
+    sds[n_+i] = blend_param.mapLocal(i, p);
+  }
+}
+
+Point3D
+SurfaceNSided::evalDual(const Point2D *sds) const {
+  thread_local Point2DVector blend_sds;
+  thread_local DoubleVector blends;
+  blend_sds.assign(sds + n_, sds + 2 * n_);
+  blendSideSingular(blend_sds, blends);
   Point3D p(0,0,0);
   return ribbons_[3]->eval(sds[3]);
   for (size_t i = 0; i < n_; ++i)
@@ -45,6 +134,29 @@ SurfaceNSided::eval(const Point2D &uv) const {
   return p;
 }
 
+std::shared_ptr<const SurfaceNSided::DualTable>
+SurfaceNSided::dualTable(size_t resolution) const {
+  {
+    std::lock_guard<std::mutex> lock(tables_->mutex);
+    const auto &table = tables_->tables[resolution];
+    if (table)
+      return table;
+  }
+
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  auto table = std::make_shared<DualTable>();
+  table->sds.resize(uvs.size() * 2 * n_);
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      mapToRibbons(uvs[i], &table->sds[i * 2 * n_]);
+  });
+
+  std::lock_guard<std::mutex> lock(tables_->mutex);
+  tables_->tables[resolution] = table;
+  return table;
+}
+
 std::shared_ptr<Ribbon>
 SurfaceNSided::newRibbon() const {
   return std::make_shared<RibbonType>();
@@ -10,15 +10,34 @@ public:
   SurfaceNSided(const SurfaceNSided &) = default;
   virtual ~SurfaceNSided();
   SurfaceNSided &operator=(const SurfaceNSided &) = default;
+  virtual std::shared_ptr<Surface> clone() const override;
   virtual void update(size_t i) override;
   virtual void update() override;
+  virtual void shareDomain(const Surface &other) override;
   virtual Point3D eval(const Point2D &uv) const override;
+  // Uses a table of both parameterizations (see below) when parameter tables are used
+  virtual TriMesh eval(size_t resolution) const override;
   using Surface::eval;
 
 protected:
+  virtual void evalPoints(size_t resolution, const PointStore &store) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+  virtual void detach() override;
 
   std::shared_ptr<Parameterization> blend_param_;
+
+private:
+  // Both parameterizations of all sides in one pass over the domain edges,
+  // sharing the local coordinates of uv: sds[i] for param_ and sds[n_ + i] for blend_param_
+  void mapToRibbons(const Point2D &uv, Point2D *sds) const;
+  Point3D evalDual(const Point2D *sds) const;
+
+  // Rows of 2 * n_ parameters at the points of Domain::parameters(resolution)
+  struct DualTable;
+  struct TableCache;
+  std::shared_ptr<const DualTable> dualTable(size_t resolution) const;
+
+  std::shared_ptr<TableCache> tables_; // replaced at update()
 };
 
 } // namespace Transfinite
@@ -1,7 +1,10 @@
+#include <algorithm>
+
 #include "Eigen/LU"
 
 #include "domain-angular.hh"
 #include "parameterization-polar.hh"
+#include "profiler.hh"
 #include "ribbon-compatible-with-handler.hh"
 #include "surface-polar.hh"
 #include "utilities.hh"
@@ -12,29 +15,171 @@ using DomainType = DomainAngular;
 using ParamType = ParameterizationPolar;
 using RibbonType = RibbonCompatibleWithHandler;
 
-SurfacePolar::SurfacePolar(size_t max_degree) : max_degree_(max_degree) {
+SurfacePolar::SurfacePolar(size_t max_degree)
+  : max_degree_(max_degree), max_samples_(1024), tolerance_(0), table_error_(0) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
 }
 
 SurfacePolar::~SurfacePolar() {
 }
 
+std::shared_ptr<Surface>
+SurfacePolar::clone() const {
+  return std::make_shared<SurfacePolar>(*this);
+}
+
+void
+SurfacePolar::update(size_t i) {
+  Surface::update(i);
+  updateTables();
+}
+
+void
+SurfacePolar::update() {
+  Surface::update();
+  updateTables();
+}
+
+void
+SurfacePolar::setRibbonTolerance(double tolerance, size_t max_samples) {
+  tolerance_ = tolerance;
+  max_samples_ = std::max<size_t>(max_samples, 2);
+}
+
+double
+SurfacePolar::ribbonTableError() const {
+  return tables_ ? table_error_ : 0.0;
+}
+
 Point3D
-SurfacePolar::eval(const Point2D &uv) const {
-  Point2DVector pds = param_->mapToRibbons(uv);
+SurfacePolar::evalMapped(const Point2D &, const Point2DVector &pds) const {
   Point3D p(0,0,0);
   double d2sum = 0.0;
   // return polarRibbon(0, pds[0]); // test
+  auto tables = tables_.get();
   for (size_t i = 0; i < n_; ++i) {
     double d2 = std::pow(pds[i][1], 2);
-    p += polarRibbon(i, pds[i]) * d2;
+    p += (tables ? tableRibbon((*tables)[i], pds[i]) : polarRibbon(i, pds[i])) * d2;
     d2sum += d2;
   }
   return p / d2sum;
 }
 
+void
+SurfacePolar::updateTables() {
+  tables_.reset();
+  table_error_ = 0;
+  if (tolerance_ <= 0)
+    return;
+  TRANSFINITE_TIMER("SurfacePolar::updateTables");
+  auto tables = std::make_shared<std::vector<RibbonTables>>(n_);
+  for (size_t i = 0; i < n_; ++i) {
+    DoubleVector breaks = { 0.0, 1.0 };
+    for (size_t j = next(i, 2); j != prev(i); j = next(j)) {
+      double psi = param_->mapToRibbon(i, domain_->vertices()[j])[0];
+      if (psi > epsilon && psi < 1 - epsilon)
+        breaks.push_back(psi);
+    }
+    std::sort(breaks.begin(), breaks.end());
+    for (size_t k = 1; k < breaks.size(); ++k) {
+      RibbonTable table;
+      table.begin = breaks[k-1];
+      table.end = breaks[k];
+      table_error_ = std::max(table_error_, buildTable(i, table));
+      (*tables)[i].push_back(std::move(table));
+    }
+  }
+  tables_ = tables;
+}
+
+// Starts with a few samples, and doubles them while the midpoints (the new samples of the next
+// level) are not interpolated well enough. The samples at the breaks are moved slightly inside,
+// to get the limits from this side.
+double
+SurfacePolar::buildTable(size_t i, RibbonTable &table) const {
+  const double inside = 1.0e-9;
+  size_t m = max_degree_ + 1;
+  double begin = table.begin > 0 ? table.begin + inside : 0;
+  double end = table.end < 1 ? table.end - inside : 1;
+  auto sample = [&](double x) { return polarCurve(i, begin + (end - begin) * x); };
+  size_t initial = std::min<size_t>(8, max_samples_);
+  std::vector<PointVector> curves(initial + 1);
+  executor_(initial + 1, [&](size_t first, size_t last) {
+    for (size_t j = first; j < last; ++j)
+      curves[j] = sample((double)j / initial);
+  });
+  while (true) {
+    size_t samples = curves.size() - 1;
+    table.samples = samples;
+    table.cpts.resize((samples + 3) * m);
+    for (size_t j = 0; j <= samples; ++j)
+      std::copy(curves[j].begin(), curves[j].end(), table.cpts.begin() + (j + 1) * m);
+    for (size_t k = 0; k < m; ++k) {
+      size_t last = (samples + 1) * m + k;
+      table.cpts[k] = table.cpts[m + k] * 2 - table.cpts[2 * m + k];
+      table.cpts[last + m] = table.cpts[last] * 2 - table.cpts[last - m];
+    }
+
+    std::vector<PointVector> midpoints(samples);
+    executor_(samples, [&](size_t first, size_t last) {
+      for (size_t j = first; j < last; ++j)
+        midpoints[j] = sample((j + 0.5) / samples);
+    });
+    double error = 0;
+    PointVector interpolated(m);
+    for (size_t j = 0; j < samples; ++j) {
+      double psi = begin + (end - begin) * (j + 0.5) / samples;
+      tableCurve(table, psi, interpolated.data());
+      for (size_t k = 0; k < m; ++k)
+        error = std::max(error, (interpolated[k] - midpoints[j][k]).norm());
+    }
+    if (error <= tolerance_ || 2 * samples > max_samples_)
+      return error;
+
+    std::vector<PointVector> refined;
+    for (size_t j = 0; j < samples; ++j) {
+      refined.push_back(std::move(curves[j]));
+      refined.push_back(std::move(midpoints[j]));
+    }
+    refined.push_back(std::move(curves.back()));
+    curves = std::move(refined);
+  }
+}
+
+// Catmull-Rom interpolation of the rows around psi
+void
+SurfacePolar::tableCurve(const RibbonTable &table, double psi, Point3D *cpts) const {
+  size_t m = max_degree_ + 1;
+  double x = inrange(0, (psi - table.begin) / (table.end - table.begin), 1) * table.samples;
+  size_t j = std::min((size_t)x, table.samples - 1);
+  double t = x - j, t2 = t * t, t3 = t2 * t;
+  double w[4] = { (-t3 + 2 * t2 - t) / 2, (3 * t3 - 5 * t2 + 2) / 2,
+                  (-3 * t3 + 4 * t2 + t) / 2, (t3 - t2) / 2 };
+  const Point3D *rows = &table.cpts[j * m];
+  for (size_t k = 0; k < m; ++k)
+    cpts[k] = rows[k] * w[0] + rows[m + k] * w[1] + rows[2 * m + k] * w[2] + rows[3 * m + k] * w[3];
+}
+
+Point3D
+SurfacePolar::tableRibbon(const RibbonTables &tables, const Point2D &pd) const {
+  thread_local PointVector cpts;
+  thread_local DoubleVector coeff;
+  cpts.resize(max_degree_ + 1);
+  coeff.resize(max_degree_ + 1);
+  size_t k = 0;
+  while (k + 1 < tables.size() && pd[0] >= tables[k].end)
+    ++k;
+  tableCurve(tables[k], pd[0], cpts.data());
+  bernstein(max_degree_, 1 - inrange(0, pd[1], 1), coeff.data());
+  Point3D p(0, 0, 0);
+  for (size_t k = 0; k <= max_degree_; ++k)
+    p += cpts[k] * coeff[k];
+  return p;
+}
+
 std::shared_ptr<Ribbon>
 SurfacePolar::newRibbon() const {
   return std::make_shared<RibbonType>();
@@ -62,9 +207,13 @@ namespace {
 }
 
 Point3D SurfacePolar::polarRibbon(size_t i, const Point2D &pd) const {
+  double d = inrange(0, pd[1], 1); // avoid -epsilon and 1+epsilon
+  return BSCurve(polarCurve(i, pd[0])).eval(1 - d);
+}
+
+PointVector
+SurfacePolar::polarCurve(size_t i, double psi) const {
   // C0 Bezier displacement version
-  double psi = pd[0], d = pd[1];
-  d = inrange(0, d, 1);         // avoid -epsilon and 1+epsilon
   size_t i1 = next(i);
 
   // 1. Linear base interpolant
@@ -82,7 +231,14 @@ Point3D SurfacePolar::polarRibbon(size_t i, const Point2D &pd) const {
   Vector3D N = D1 ^ D2, D1p = N ^ D1;
   double angle = psi * acos(inrange(-1, D1 * D2, 1));
   Vector3D D = D1 * cos(angle) + D1p * sin(angle);
-  Point2D p = domain_->vertices()[i], q = param_->inverse(i, Point2D(psi, 0));
+  // All inverses are on the same sweepline: (psi, 0), then (psi, 1 - j / degree) for each degree
+  DoubleVector ds = { 0.0 };
+  for (size_t degree = 2; degree <= max_degree_; ++degree)
+    for (size_t j = 1; j < degree; ++j)
+      ds.push_back(1.0 - (double)j / degree);
+  auto inverses = static_cast<const ParamType *>(param_.get())->inverse(i, psi, ds);
+  auto inverse = inverses.begin();
+  Point2D p = domain_->vertices()[i], q = *inverse++;
   double l = (q - p).norm();
   double L = l * ((1 - psi) * L1 / l1 + psi * L2 / l2);
   Point3D Q = P + D * L;
@@ -98,7 +254,7 @@ Point3D SurfacePolar::polarRibbon(size_t i, const Point2D &pd) const {
     for (size_t j = 1; j < degree; ++j) {
       double u = (double)j / degree;
       uniform.push_back(u);
-      Point2D qu = param_->inverse(i, Point2D(psi, 1 - u));
+      Point2D qu = *inverse++;
       positions.push_back((qu - p).norm() / l);
       samples_left.push_back(ribbons_[i]->curve()->eval(1 - u));
       Vector3D dleft = samples_left.back() - BSCurve(left).eval(u);
@@ -112,7 +268,7 @@ Point3D SurfacePolar::polarRibbon(size_t i, const Point2D &pd) const {
     bezierRefit(curve, positions, samples);
   }
 
-  return BSCurve(curve).eval(1 - d);
+  return curve;
 }
 
 // Point3D SurfacePolar::polarRibbon(size_t i, const Point2D &pd) const {
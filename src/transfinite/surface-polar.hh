@@ -10,15 +10,49 @@ public:
   SurfacePolar(const SurfacePolar &) = default;
   virtual ~SurfacePolar();
   SurfacePolar &operator=(const SurfacePolar &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
+  virtual void update(size_t i) override;
+  virtual void update() override;
   using Surface::eval;
+  // With a positive tolerance, each update samples the polar ribbons of every side at uniform
+  // angles, as the control points of their radial Bezier curves, doubling the samples (up to
+  // max_samples) until the cubic interpolation of the control points is within the tolerance
+  // at the midpoints of the intervals; the ribbons are then evaluated from these tables,
+  // without inverting the parameterization. As the curve points are convex combinations of
+  // the control points, this also bounds the error of the ribbons at the checked angles.
+  // 0 (the default) evaluates the ribbons exactly.
+  void setRibbonTolerance(double tolerance, size_t max_samples = 1024);
+  // The largest deviation found at the midpoints when the tables were built (0 without them)
+  double ribbonTableError() const;
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
   Point3D polarRibbon(size_t i, const Point2D &pd) const;
 
 private:
-  size_t max_degree_;
+  // Control points of the radial curves of a side at uniform angles in [begin, end], in rows of
+  // max_degree_ + 1, with a linearly extrapolated row before the first and after the last.
+  // The ribbons jump where the sweepline passes a domain vertex, so the tables of a side
+  // are split there.
+  struct RibbonTable {
+    double begin, end;
+    size_t samples;
+    PointVector cpts;
+  };
+  using RibbonTables = std::vector<RibbonTable>;
+
+  // Control points of the radial curve of polarRibbon(i, (psi, d)), from d = 1 to d = 0
+  PointVector polarCurve(size_t i, double psi) const;
+  // Returns the largest deviation at the midpoints
+  double buildTable(size_t i, RibbonTable &table) const;
+  void tableCurve(const RibbonTable &table, double psi, Point3D *cpts) const;
+  Point3D tableRibbon(const RibbonTables &tables, const Point2D &pd) const;
+  void updateTables();
+
+  size_t max_degree_, max_samples_;
+  double tolerance_, table_error_;
+  std::shared_ptr<const std::vector<RibbonTables>> tables_; // of each side, replaced in updates
 };
 
 } // namespace Transfinite
@@ -13,18 +13,42 @@ SurfaceSideBased::SurfaceSideBased() {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
+  blend_type_ = BlendType::SIDE_SINGULAR;
+  fast_kind_ = SurfaceKind::SIDE_BASED;
+  mapped_derivatives_ = true;
 }
 
 SurfaceSideBased::~SurfaceSideBased() {
 }
 
+std::shared_ptr<Surface>
+SurfaceSideBased::clone() const {
+  return std::make_shared<SurfaceSideBased>(*this);
+}
+
 Point3D
-SurfaceSideBased::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendSideSingular(sds);
+SurfaceSideBased::evalBlended(const Point2D &, const Point2DVector &sds,
+                              const double *blends) const {
   Point3D p(0,0,0);
+  double skipped = 0;
+  for (size_t i = 0; i < n_; ++i)
+    if (negligibleBlend(blends[i]))
+      skipped += blends[i];
+    else
+      p += sideInterpolant(i, sds[i][0], sds[i][1]) * blends[i];
+  return p + corner_centroid_ * skipped;
+}
+
+Surface::Derivatives
+SurfaceSideBased::evalMappedDerivatives(const Point2D &, const Point2DVector &sds,
+                                        const Vector2DVector &ds, const Vector2DVector &dd) const {
+  thread_local DoubleVector blends;
+  thread_local Vector2DVector dblends;
+  blendSideSingular(sds, ds, dd, blends, dblends);
+  Derivatives p = { Point3D(0,0,0), Vector3D(0,0,0), Vector3D(0,0,0) };
   for (size_t i = 0; i < n_; ++i)
-    p += sideInterpolant(i, sds[i][0], sds[i][1]) * blends[i];
+    addBlended(p, sideInterpolant(i, sds[i][0], sds[i][1], ds[i], dd[i]), blends[i], dblends[i]);
   return p;
 }
 
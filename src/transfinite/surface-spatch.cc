@@ -21,6 +21,11 @@ SurfaceSPatch::SurfaceSPatch() {
 SurfaceSPatch::~SurfaceSPatch() {
 }
 
+std::shared_ptr<Surface>
+SurfaceSPatch::clone() const {
+  return std::make_shared<SurfaceSPatch>(*this);
+}
+
 static size_t multinomial(const SurfaceSPatch::Index &index) {
   auto fact = [](size_t n) { return (size_t)std::lround(std::tgamma(n + 1)); };
   size_t numerator = 0, denominator = 1;
@@ -31,28 +36,68 @@ static size_t multinomial(const SurfaceSPatch::Index &index) {
   return fact(numerator) / denominator;
 }
 
-static double multiBernstein(const SurfaceSPatch::Index &index, const DoubleVector &bc) {
-  double result = multinomial(index);
-  for (size_t i = 0; i < index.size(); ++i)
-    result *= std::pow(bc[i], index[i]);
-  return result;
+void
+SurfaceSPatch::blends(const Point2D &uv, DoubleVector &result) const {
+  blends(dynamic_cast<const ParameterizationBarycentric *>(param_.get())->barycentric(uv).data(),
+         result);
+}
+
+void
+SurfaceSPatch::blends(const double *bc, DoubleVector &result) const {
+  thread_local DoubleVector powers;
+  powers.resize(n_ * (depth_ + 1));
+  for (size_t i = 0; i < n_; ++i) {
+    double *pi = &powers[i * (depth_ + 1)];
+    pi[0] = 1.0;
+    for (size_t k = 1; k <= depth_; ++k)
+      pi[k] = pi[k-1] * bc[i];
+  }
+  size_t size = points_.size();
+  result.resize(size);
+  for (size_t j = 0; j < size; ++j) {
+    const size_t *exponents = &exponents_[j * n_];
+    double blend = multinomials_[j];
+    for (size_t i = 0; i < n_; ++i)
+      blend *= powers[i * (depth_ + 1) + exponents[i]];
+    result[j] = blend;
+  }
 }
 
 Point3D
-SurfaceSPatch::eval(const Point2D &uv) const {
-  DoubleVector bc =
-    dynamic_cast<const ParameterizationBarycentric *>(param_.get())->barycentric(uv);
+SurfaceSPatch::combine(const DoubleVector &bl) const {
   Point3D p(0,0,0);
-  for (const auto &cp : net_)
-    p += cp.second * multiBernstein(cp.first, bc);
+  for (size_t j = 0; j < points_.size(); ++j)
+    p += points_[j] * bl[j];
   return p;
 }
 
+Point3D
+SurfaceSPatch::eval(const Point2D &uv) const {
+  thread_local DoubleVector bl;
+  blends(uv, bl);
+  return combine(bl);
+}
+
+void
+SurfaceSPatch::evalBlock(const Point2D *uvs, size_t size, Point3D *points) const {
+  thread_local DoubleVector bc, bl;
+  bc.resize(size * n_);
+  dynamic_cast<const ParameterizationBarycentric *>(param_.get())->barycentric(uvs, size,
+                                                                               bc.data());
+  for (size_t i = 0; i < size; ++i) {
+    blends(&bc[i * n_], bl);
+    points[i] = combine(bl);
+  }
+}
+
 void
 SurfaceSPatch::initNetwork(size_t n, size_t d) {
   n_ = n;
   depth_ = d;
   net_.clear();
+  points_.clear();
+  exponents_.clear();
+  multinomials_.clear();
 }
 
 void
@@ -63,32 +108,75 @@ SurfaceSPatch::setupLoop() {
     PointVector pv;
     Index index(n_, 0);
     index[i] = depth_;
+    auto point = [&]() {
+      if (!net_.count(index))
+        setControlPoint(index, Point3D(0, 0, 0));
+      return controlPoint(index);
+    };
     for (size_t j = 0; j < depth_; ++j) {
-      pv.push_back(net_[index]);
+      pv.push_back(point());
       --index[i];
       ++index[ip];
     }
-    pv.push_back(net_[index]);
+    pv.push_back(point());
     curves.push_back(std::make_shared<BSCurve>(pv));
   }
   setCurves(curves);
 
   Surface::setupLoop();
 
-  if (domain_->update())
-    param_->update();
+  updateDomain();
 }
 
 void
 SurfaceSPatch::setControlPoint(const Index &i, const Point3D &p) {
-  net_[i] = p;
+  auto it = net_.find(i);
+  if (it != net_.end()) {
+    points_[it->second] = p;
+    return;
+  }
+  net_[i] = points_.size();
+  points_.push_back(p);
+  exponents_.insert(exponents_.end(), i.begin(), i.end());
+  multinomials_.push_back(multinomial(i));
 }
 
 Point3D
 SurfaceSPatch::controlPoint(const Index &i) const {
+  return points_[net_.at(i)];
+}
+
+InfluenceMap
+SurfaceSPatch::influences(size_t resolution, double threshold) const {
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  std::vector<std::vector<std::pair<size_t, double>>> rows(uvs.size());
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    DoubleVector bl;
+    for (size_t v = begin; v < end; ++v) {
+      blends(uvs[v], bl);
+      // Only the kept blends, as in the rows of a tessellation plan
+      for (size_t i = 0; i < bl.size(); ++i)
+        if (std::abs(bl[i]) >= threshold && bl[i] != 0.0)
+          rows[v].emplace_back(i, bl[i]);
+    }
+  });
+  return InfluenceMap(eval(resolution), points_.size(), rows, threshold);
+}
+
+size_t
+SurfaceSPatch::controlPointIndex(const Index &i) const {
   return net_.at(i);
 }
 
+std::vector<SurfaceSPatch::Index>
+SurfaceSPatch::controlPointIndices() const {
+  std::vector<Index> result(net_.size());
+  for (const auto &[index, position] : net_)
+    result[position] = index;
+  return result;
+}
+
 std::shared_ptr<Ribbon>
 SurfaceSPatch::newRibbon() const {
   return std::make_shared<RibbonType>();
@@ -2,6 +2,7 @@
 
 #include <map>
 
+#include "influence.hh"
 #include "surface.hh"
 
 namespace Transfinite {
@@ -13,19 +14,36 @@ public:
   SurfaceSPatch(const SurfaceSPatch &) = default;
   virtual ~SurfaceSPatch();
   SurfaceSPatch &operator=(const SurfaceSPatch &) = default;
+  virtual std::shared_ptr<Surface> clone() const override;
   virtual Point3D eval(const Point2D &uv) const override;
   using Surface::eval;
   void initNetwork(size_t n, size_t d);
   virtual void setupLoop() override;
   void setControlPoint(const Index &i, const Point3D &p);
   Point3D controlPoint(const Index &i) const;
+  // Influence images of the control points on the uniform mesh, in the order of controlPointIndex
+  InfluenceMap influences(size_t resolution, double threshold = 0.0) const;
+  // Position of the control point in the order of insertion
+  size_t controlPointIndex(const Index &i) const;
+  // Indices of all control points, in the order of insertion
+  std::vector<Index> controlPointIndices() const;
 
 protected:
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
+  // Computes the barycentric coordinates of the whole block at once, without caching
+  virtual void evalBlock(const Point2D *uvs, size_t size, Point3D *points) const override;
 
 private:
+  // Bernstein polynomials of all control points, by powers of the barycentric coordinates
+  void blends(const Point2D &uv, DoubleVector &result) const;
+  void blends(const double *bc, DoubleVector &result) const;
+  Point3D combine(const DoubleVector &bl) const;
+
   size_t depth_;
-  std::map<Index, Point3D> net_;
+  std::map<Index, size_t> net_;   // positions in the flat arrays below
+  PointVector points_;
+  std::vector<size_t> exponents_; // n_ for each control point
+  DoubleVector multinomials_;
 };
 
 } // namespace Transfinite
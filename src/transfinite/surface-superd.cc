@@ -18,11 +18,17 @@ SurfaceSuperD::SurfaceSuperD() : fullness_(0.5) {
   domain_ = std::make_shared<DomainType>();
   param_ = std::make_shared<ParamType>();
   param_->setDomain(domain_);
+  mapped_eval_ = true;
 }
 
 SurfaceSuperD::~SurfaceSuperD() {
 }
 
+std::shared_ptr<Surface>
+SurfaceSuperD::clone() const {
+  return std::make_shared<SurfaceSuperD>(*this);
+}
+
 SurfaceSuperD::QuarticCurve
 SurfaceSuperD::generateQuartic(const Point3D &a, const Point3D &b, const Point3D &c) const {
   double x1 = (2.0/5.0 * fullness_ + 3.0/5.0) * fullness_;
@@ -97,28 +103,88 @@ SurfaceSuperD::generateRibbon(size_t i) const {
   return result;
 }
 
-static
-Point3D bezierEvaluate(const SurfaceSuperD::QuarticSurface &s, double u, double v) {
-  DoubleVector coeff_u, coeff_v;
-  bernstein(4, u, coeff_u);
-  bernstein(4, v, coeff_v);
-  Point3D result(0, 0, 0);
-  for (size_t i = 0; i <= 4; ++i)
-    for (size_t j = 0; j <= 4; ++j)
-      result += s[i][j] * coeff_u[i] * coeff_v[j];
-  return result;
+static inline void
+quarticBernstein(double t, double *b) {
+  double s = 1.0 - t, s2 = s * s, t2 = t * t;
+  b[0] = s2 * s2;
+  b[1] = 4.0 * s2 * s * t;
+  b[2] = 6.0 * s2 * t2;
+  b[3] = 4.0 * s * t2 * t;
+  b[4] = t2 * t2;
+}
+
+// Tensor product evaluation of a quartic ribbon in the layout of coefficients_
+static inline Point3D
+bezierEvaluate(const double *c, double u, double v) {
+  double bu[5], bv[5], b[25];
+  quarticBernstein(u, bu);
+  quarticBernstein(v, bv);
+  for (size_t i = 0; i < 5; ++i)
+    for (size_t j = 0; j < 5; ++j)
+      b[i*5+j] = bu[i] * bv[j];
+  double x = 0, y = 0, z = 0;
+  for (size_t k = 0; k < 25; ++k) {
+    x += c[k] * b[k];
+    y += c[25+k] * b[k];
+    z += c[50+k] * b[k];
+  }
+  return Point3D(x, y, z);
 }
 
 Point3D
-SurfaceSuperD::eval(const Point2D &uv) const {
-  Point2DVector sds = param_->mapToRibbons(uv);
-  DoubleVector blends = blendSideSingular(sds);
+SurfaceSuperD::evalMapped(const Point2D &uv, const Point2DVector &sds) const {
+  return evalMapped(uv, sds, coefficients_.data());
+}
+
+Point3D
+SurfaceSuperD::evalMapped(const Point2D &, const Point2DVector &sds,
+                          const double *coefficients) const {
+  thread_local DoubleVector blends;
+  blendSideSingular(sds, blends);
   Point3D p(0,0,0);
   for (size_t i = 0; i < n_; ++i)
-    p += bezierEvaluate(quartic_ribbons_[i], sds[i][0], sds[i][1]) * blends[i];
+    p += bezierEvaluate(&coefficients[i*75], sds[i][0], sds[i][1]) * blends[i];
   return p;
 }
 
+std::vector<TriMesh>
+SurfaceSuperD::eval(const std::vector<SurfaceSuperD> &surfaces, size_t resolution,
+                    const Executor &executor) {
+  std::vector<std::shared_ptr<const ParameterTable>> tables;
+  std::vector<std::shared_ptr<const Point2DVector>> uvs;
+  std::vector<size_t> offsets = { 0 }, starts;
+  DoubleVector coefficients;
+  for (const auto &s : surfaces) {
+    tables.push_back(s.param_->parameterTable(resolution, executor));
+    uvs.push_back(s.domain_->sharedParameters(resolution));
+    offsets.push_back(offsets.back() + uvs.back()->size());
+    starts.push_back(coefficients.size());
+    coefficients.insert(coefficients.end(), s.coefficients_.begin(), s.coefficients_.end());
+  }
+
+  PointVector points(offsets.back());
+  executor(points.size(), [&](size_t begin, size_t end) {
+    size_t k = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+    Point2DVector sds;
+    for (size_t i = begin; i < end; ++i) {
+      while (i >= offsets[k+1])
+        ++k;
+      const auto &s = surfaces[k];
+      sds.resize(s.n_);
+      size_t j = i - offsets[k];
+      std::copy_n(tables[k]->row(j), s.n_, sds.begin());
+      points[i] = s.evalMapped((*uvs[k])[j], sds, &coefficients[starts[k]]);
+    }
+  });
+
+  std::vector<TriMesh> result;
+  for (size_t k = 0; k < surfaces.size(); ++k) {
+    result.push_back(surfaces[k].domain_->meshTopology(resolution));
+    result.back().setPoints(PointVector(points.begin() + offsets[k], points.begin() + offsets[k+1]));
+  }
+  return result;
+}
+
 void
 SurfaceSuperD::initNetwork(size_t n) {
   n_ = n;
@@ -139,15 +205,19 @@ SurfaceSuperD::setupLoop() {
 
   Surface::setupLoop();
 
-  if (domain_->update())
-    param_->update();
+  updateDomain();
 }
 
 void
 SurfaceSuperD::updateRibbons() {
-  quartic_ribbons_.clear();
-  for (size_t i = 0; i < n_; ++i)
-    quartic_ribbons_.emplace_back(generateRibbon(i));
+  coefficients_.resize(n_ * 75);
+  for (size_t i = 0; i < n_; ++i) {
+    auto ribbon = generateRibbon(i);
+    for (size_t j = 0; j <= 4; ++j)
+      for (size_t k = 0; k <= 4; ++k)
+        for (size_t c = 0; c < 3; ++c)
+          coefficients_[i*75+c*25+j*5+k] = ribbon[j][k][c];
+  }
 }
 
 Point3D
@@ -190,6 +260,28 @@ SurfaceSuperD::setFullness(double f) {
   fullness_ = f;
 }
 
+// The surface is linear in the control points, so the weights of one of them are given by
+// the surface with all control points at the origin, except for that one at (1, 0, 0)
+InfluenceMap
+SurfaceSuperD::influences(size_t resolution, double threshold) const {
+  size_t size = 2 * n_ + 1;
+  SurfaceSuperD unit(*this);
+  std::vector<std::vector<std::pair<size_t, double>>> rows;
+  for (size_t i = 0; i < size; ++i) {
+    unit.cp_v_ = Point3D(0, 0, 0);
+    std::fill(unit.cp_f_.begin(), unit.cp_f_.end(), Point3D(0, 0, 0));
+    std::fill(unit.cp_e_.begin(), unit.cp_e_.end(), Point3D(0, 0, 0));
+    Point3D &cp = i == 0 ? unit.cp_v_ : (i <= n_ ? unit.cp_f_[i-1] : unit.cp_e_[i-n_-1]);
+    cp = Point3D(1, 0, 0);
+    unit.updateRibbons();
+    TriMesh mesh = unit.eval(resolution);
+    rows.resize(mesh.points().size());
+    for (size_t v = 0; v < rows.size(); ++v)
+      rows[v].emplace_back(i, mesh[v][0]);
+  }
+  return InfluenceMap(eval(resolution), size, rows, threshold);
+}
+
 std::shared_ptr<Ribbon>
 SurfaceSuperD::newRibbon() const {
   return std::make_shared<RibbonType>();
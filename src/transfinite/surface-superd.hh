@@ -1,5 +1,6 @@
 #pragma once
 
+#include "influence.hh"
 #include "surface.hh"
 
 namespace Transfinite {
@@ -12,7 +13,7 @@ public:
   SurfaceSuperD(const SurfaceSuperD &) = default;
   virtual ~SurfaceSuperD();
   SurfaceSuperD &operator=(const SurfaceSuperD &) = default;
-  virtual Point3D eval(const Point2D &uv) const override;
+  virtual std::shared_ptr<Surface> clone() const override;
   using Surface::eval;
   void initNetwork(size_t n);
   virtual void setupLoop() override;
@@ -25,8 +26,17 @@ public:
   void setEdgeControlPoint(size_t i, const Point3D &p);
   double fullness() const;
   void setFullness(double f);
+  // Influence images of the control points on the uniform mesh:
+  // the vertex control point first, then the face, and finally the edge control points
+  InfluenceMap influences(size_t resolution, double threshold = 0.0) const;
+  // Meshes of several patches (e.g. a model read by loadSuperDModel),
+  // evaluated in one pass, with the points of all patches distributed by the executor;
+  // the ribbon coefficients of all patches are gathered into one buffer for the pass
+  static std::vector<TriMesh> eval(const std::vector<SurfaceSuperD> &surfaces, size_t resolution,
+                                   const Executor &executor = threadExecutor());
 
 protected:
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const override;
   virtual std::shared_ptr<Ribbon> newRibbon() const override;
   // Functions generating the "real" ribbon:
   QuarticCurve generateQuartic(const Point3D &a, const Point3D &b, const Point3D &c) const;
@@ -36,10 +46,14 @@ protected:
   QuarticSurface generateRibbon(size_t i) const;
 
 private:
+  // evalMapped() with the ribbon coefficients in the layout of coefficients_
+  Point3D evalMapped(const Point2D &uv, const Point2DVector &sds,
+                     const double *coefficients) const;
+
   double fullness_;
   Point3D cp_v_;
   PointVector cp_f_, cp_e_;
-  std::vector<QuarticSurface> quartic_ribbons_;
+  DoubleVector coefficients_; // of the quartic ribbons: 25 x, 25 y and 25 z coordinates for each
 };
 
 } // namespace Transfinite
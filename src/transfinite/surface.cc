@@ -1,7 +1,24 @@
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
 
+#include "curve-metrics.hh"
 #include "domain.hh"
+#include "fast-evaluator.hh"
+#include "locator.hh"
+#include "mesh-sink.hh"
 #include "parameterization.hh"
+#include "profiler.hh"
+#include "ribbon-compatible-with-handler.hh"
 #include "ribbon.hh"
 #include "surface.hh"
 #include "utilities.hh"
@@ -11,8 +28,51 @@
 
 namespace Transfinite {
 
+// Number of points processed together by evalBlock()
+static const size_t block_size = 64;
+
+// Minimal number of points in a batch of eval(resolution, sink)
+static const size_t stream_batch_size = 1 << 16;
+
+FloatMesh::FloatMesh(const TriMesh &mesh) {
+  const PointVector &vertices = mesh.points();
+  if (vertices.size() > std::numeric_limits<uint32_t>::max())
+    throw std::length_error("too many vertices for 32-bit indices");
+  points.reserve(3 * vertices.size());
+  for (const auto &p : vertices)
+    for (size_t k = 0; k < 3; ++k)
+      points.push_back(static_cast<float>(p[k]));
+  triangles.reserve(3 * mesh.triangles().size());
+  for (const auto &t : mesh.triangles())
+    for (size_t i : t)
+      triangles.push_back(static_cast<uint32_t>(i));
+}
+
+// The hierarchy of the uniform mesh used by intersect(); `stale` when built before the last update
+struct Surface::PickingCache {
+  struct Entry {
+    size_t sides, resolution;
+    TriangleBVH bvh;
+    std::shared_ptr<const Point2DVector> uvs;
+  };
+  std::mutex mutex;
+  std::shared_ptr<const Entry> entry;
+  bool stale = false;
+};
+
+static uint64_t nextRevision() {
+  static std::atomic<uint64_t> next{1};
+  return next++;
+}
+
 Surface::Surface()
-  : n_(0), use_gamma_(true) {
+  : n_(0), mapped_eval_(false), mapped_derivatives_(false), use_tables_(true),
+    spatial_order_(false), pointwise_mesh_(true),
+    blend_type_(BlendType::NONE), fast_kind_(SurfaceKind::OTHER), blend_cutoff_(0.0),
+    corner_centroid_(0, 0, 0), executor_(threadExecutor()), use_gamma_(true), ribbon_samples_(0),
+    use_fast_eval_(true),
+    update_executor_(serialExecutor()), picking_(std::make_shared<PickingCache>()),
+    revision_(nextRevision()) {
 }
 
 Surface::~Surface() {
@@ -23,6 +83,64 @@ Surface::setGamma(bool use_gamma) {
   use_gamma_ = use_gamma;
 }
 
+void
+Surface::setExecutor(const Executor &executor) {
+  executor_ = executor;
+}
+
+void
+Surface::setUpdateExecutor(const Executor &executor) {
+  update_executor_ = executor;
+}
+
+void
+Surface::useParameterTables(bool use) {
+  use_tables_ = use;
+}
+
+void
+Surface::useSpatialOrder(bool use) {
+  spatial_order_ = use;
+}
+
+void
+Surface::setBlendCutoff(double cutoff) {
+  blend_cutoff_ = cutoff;
+}
+
+void
+Surface::setCacheLimits(size_t resolutions, size_t points) {
+  domain_->setParameterCacheLimit(resolutions);
+  param_->setCacheLimit(points);
+}
+
+void
+Surface::setParameterApproximation(size_t resolution) {
+  param_->setApproximation(resolution);
+}
+
+CacheStatistics
+Surface::domainCacheStatistics() const {
+  return domain_->parameterCacheStatistics();
+}
+
+CacheStatistics
+Surface::parameterizationCacheStatistics() const {
+  return param_->cacheStatistics();
+}
+
+// Ribbons are sampled in update(), and evaluated by interpolation
+// (see Ribbon::samplingError() for the resulting deviation)
+void
+Surface::setRibbonSampling(size_t samples) {
+  ribbon_samples_ = samples;
+}
+
+void
+Surface::useFastEvaluator(bool use) {
+  use_fast_eval_ = use;
+}
+
 void
 Surface::setCurve(size_t i, const std::shared_ptr<BSCurve> &curve) {
   if (n_ <= i) {
@@ -46,6 +164,29 @@ Surface::setCurves(const CurveVector &curves) {
   n_ = curves.size();
 }
 
+std::shared_ptr<const Surface>
+Surface::snapshot() const {
+  auto result = clone();
+  result->detach();
+  return result;
+}
+
+void
+Surface::detach() {
+  domain_ = domain_->clone();
+  param_ = param_->clone();
+  param_->setDomain(domain_);
+  for (auto &r : ribbons_)
+    r = r->snapshot();
+  CurveVector curves;
+  curves.reserve(n_);
+  for (size_t i = 0; i < n_; ++i) {
+    ribbons_[i]->relink(ribbons_[prev(i)], ribbons_[next(i)]);
+    curves.push_back(ribbons_[i]->curve());
+  }
+  domain_->setSides(curves);
+}
+
 void
 Surface::setupLoop() {
   // Tasks:
@@ -112,22 +253,37 @@ Surface::resetRibbon(size_t i) {
   ribbons_[i]->reset();
 }
 
+// Curve i has changed
 void
 Surface::update(size_t i) {
-  if (domain_->update())
-    param_->update();
-  ribbons_[i]->update();
-  updateCorner(prev(i));
-  updateCorner(i);
+  TRANSFINITE_TIMER("Surface::update");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  invalidatePicking();
+  revision_ = nextRevision();
+  updateDomain();
+  std::vector<bool> modified(n_, false);
+  modified[i] = true;
+  updateRibbons(modified);
 }
 
+// Only the ribbons affected by a change are updated
+// (and the parameterization only when the domain has changed)
 void
 Surface::update() {
-  if (domain_->update())
-    param_->update();
-  for (auto &r : ribbons_)
-    r->update();
-  updateCorners();
+  TRANSFINITE_TIMER("Surface::update");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  invalidatePicking();
+  revision_ = nextRevision();
+  updateDomain();
+  std::vector<bool> modified(n_);
+  for (size_t i = 0; i < n_; ++i)
+    modified[i] = ribbons_[i]->modified();
+  updateRibbons(modified);
+}
+
+uint64_t
+Surface::revision() const {
+  return revision_;
 }
 
 std::shared_ptr<const Domain>
@@ -145,17 +301,604 @@ Surface::ribbon(size_t i) const {
   return ribbons_[i];
 }
 
+Point3D
+Surface::eval(const Point2D &uv) const {
+  return evalMapped(uv, *param_->mapToRibbons(uv));
+}
+
+PointVector
+Surface::eval(const Point2DVector &uvs) const {
+  TRANSFINITE_TIMER("Surface::eval(uvs)");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  TRANSFINITE_COUNT("evaluated points", uvs.size());
+  auto order = spatialOrder(uvs);
+  if (order.empty())
+    return evalInOrder(uvs);
+  Point2DVector sorted(uvs.size());
+  for (size_t k = 0; k < uvs.size(); ++k)
+    sorted[k] = uvs[order[k]];
+  PointVector sorted_points = evalInOrder(sorted), points(uvs.size());
+  for (size_t k = 0; k < uvs.size(); ++k)
+    points[order[k]] = sorted_points[k];
+  return points;
+}
+
+void
+Surface::eval(const InputBuffer<double> &uvs, size_t size,
+              const OutputBuffer<double> &points) const {
+  TRANSFINITE_TIMER("Surface::eval(uvs)");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  TRANSFINITE_COUNT("evaluated points", size);
+  auto uv = [&](size_t i) {
+    const double *p = uvs.data + i * (uvs.stride ? uvs.stride : 2);
+    return Point2D(p[0], p[1]);
+  };
+  std::vector<size_t> order;
+  if (spatial_order_ && size > block_size) {
+    Point2DVector all(size);
+    for (size_t i = 0; i < size; ++i)
+      all[i] = uv(i);
+    order = spatialOrder(all);
+  }
+  executor_(size, [&](size_t begin, size_t end) {
+    Point2D block_uvs[block_size];
+    Point3D block[block_size];
+    for (size_t i = begin; i < end; i += block_size) {
+      size_t count = std::min(block_size, end - i);
+      for (size_t k = 0; k < count; ++k)
+        block_uvs[k] = uv(order.empty() ? i + k : order[i + k]);
+      evalBlock(block_uvs, count, block);
+      for (size_t k = 0; k < count; ++k) {
+        size_t j = order.empty() ? i + k : order[i + k];
+        double *p = points.data + j * (points.stride ? points.stride : 3);
+        for (size_t c = 0; c < 3; ++c)
+          p[c] = block[k][c];
+      }
+    }
+  });
+}
+
+PointVector
+Surface::evalInOrder(const Point2DVector &uvs) const {
+  PointVector points(uvs.size());
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i += block_size)
+      evalBlock(&uvs[i], std::min(block_size, end - i), &points[i]);
+  });
+  return points;
+}
+
+// Empty when the input order is kept (also for single blocks)
+std::vector<size_t>
+Surface::spatialOrder(const Point2DVector &uvs) const {
+  if (!spatial_order_ || uvs.size() <= block_size)
+    return {};
+  TRANSFINITE_TIMER("Surface::spatialOrder");
+  return mortonOrder(uvs);
+}
+
 TriMesh
 Surface::eval(size_t resolution) const {
   TriMesh mesh = domain_->meshTopology(resolution);
-  Point2DVector uvs = domain_->parameters(resolution);
-  PointVector points; points.reserve(uvs.size());
-  std::transform(uvs.begin(), uvs.end(), std::back_inserter(points),
-                 [this](const Point2D &uv) { return eval(uv); });
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  if (!mapped_eval_ || !use_tables_) {
+    mesh.setPoints(eval(uvs));
+    return mesh;
+  }
+
+  // The ribbon parameters are read by vertex index, bypassing the point cache
+  TRANSFINITE_TIMER("Surface::eval(resolution)");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  TRANSFINITE_COUNT("evaluated points", uvs.size());
+  auto table = param_->parameterTable(resolution, executor_);
+  PointVector points(uvs.size());
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i += block_size)
+      evalMappedBlock(&uvs[i], table->row(i), std::min(block_size, end - i), &points[i]);
+  });
   mesh.setPoints(points);
   return mesh;
 }
 
+PointVector
+Surface::eval(size_t resolution, const std::vector<size_t> &indices) const {
+  TRANSFINITE_TIMER("Surface::eval(indices)");
+  TRANSFINITE_COUNT("evaluated points", indices.size());
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  std::shared_ptr<const ParameterTable> table;
+  if (mapped_eval_ && use_tables_)
+    table = param_->parameterTable(resolution, executor_);
+  size_t n = domain_->size();
+  PointVector points(indices.size());
+  executor_(indices.size(), [&](size_t begin, size_t end) {
+    Point2D block_uvs[block_size];
+    Point2DVector block_sds(table ? block_size * n : 0);
+    for (size_t i = begin; i < end; i += block_size) {
+      size_t size = std::min(block_size, end - i);
+      for (size_t k = 0; k < size; ++k) {
+        block_uvs[k] = uvs[indices[i + k]];
+        if (table)
+          std::copy_n(table->row(indices[i + k]), n, &block_sds[k * n]);
+      }
+      if (table)
+        evalMappedBlock(block_uvs, block_sds.data(), size, &points[i]);
+      else
+        evalBlock(block_uvs, size, &points[i]);
+    }
+  });
+  return points;
+}
+
+void
+Surface::evalPoints(size_t resolution, const PointStore &store) const {
+  TRANSFINITE_TIMER("Surface::evalPoints");
+  TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  const Point2DVector &uvs = *shared_uvs;
+  TRANSFINITE_COUNT("evaluated points", uvs.size());
+  std::shared_ptr<const ParameterTable> table;
+  if (mapped_eval_ && use_tables_)
+    table = param_->parameterTable(resolution, executor_);
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    Point3D block[block_size];
+    for (size_t i = begin; i < end; i += block_size) {
+      size_t size = std::min(block_size, end - i);
+      if (table)
+        evalMappedBlock(&uvs[i], table->row(i), size, block);
+      else
+        evalBlock(&uvs[i], size, block);
+      store(i, size, block);
+    }
+  });
+}
+
+// Normals are computed as in eval(resolution, normals); when they are averaged,
+// the points are also kept in double precision
+template<typename T>
+void
+Surface::evalOutputs(size_t resolution, const OutputBuffer<T> &points,
+                     const OutputBuffer<T> &normals, const OutputBuffer<T> &uvs) const {
+  auto put = [](const OutputBuffer<T> &out, size_t dim, size_t i, const auto &v) {
+    T *p = out.data + i * (out.stride ? out.stride : dim);
+    for (size_t k = 0; k < dim; ++k)
+      p[k] = static_cast<T>(v[k]);
+  };
+  auto shared_params = domain_->sharedParameters(resolution);
+  const Point2DVector &params = *shared_params;
+  bool average = normals.data && !mapped_derivatives_;
+  PointVector positions(average ? params.size() : 0);
+  if (points.data || average)
+    evalPoints(resolution, [&](size_t first, size_t size, const Point3D *block) {
+      for (size_t i = 0; i < size; ++i) {
+        if (points.data)
+          put(points, 3, first + i, block[i]);
+        if (average)
+          positions[first + i] = block[i];
+      }
+    });
+
+  if (average) {
+    // Weighted by the triangle areas
+    VectorVector sums(params.size(), Vector3D(0, 0, 0));
+    auto shared_indices = domain_->meshIndices(resolution);
+    const auto &indices = *shared_indices;
+    for (size_t j = 0; j < indices.size(); j += 3) {
+      const uint32_t *t = &indices[j];
+      Vector3D normal = (positions[t[1]] - positions[t[0]]) ^ (positions[t[2]] - positions[t[0]]);
+      for (size_t k = 0; k < 3; ++k)
+        sums[t[k]] += normal;
+    }
+    for (size_t i = 0; i < params.size(); ++i)
+      put(normals, 3, i, sums[i].normalize());
+  } else if (normals.data)
+    executor_(params.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        auto d = evalDerivatives(params[i]);
+        put(normals, 3, i, (d.du ^ d.dv).normalize());
+      }
+    });
+
+  if (uvs.data)
+    for (size_t i = 0; i < params.size(); ++i)
+      put(uvs, 2, i, params[i]);
+}
+
+void
+Surface::eval(size_t resolution, const OutputBuffer<double> &points,
+              const OutputBuffer<double> &normals, const OutputBuffer<double> &uvs) const {
+  evalOutputs(resolution, points, normals, uvs);
+}
+
+void
+Surface::eval(size_t resolution, const OutputBuffer<float> &points,
+              const OutputBuffer<float> &normals, const OutputBuffer<float> &uvs) const {
+  evalOutputs(resolution, points, normals, uvs);
+}
+
+// A conversion helper: the points are evaluated in double precision, and rounded to float
+// as each block is stored
+FloatMesh
+Surface::evalFloat(size_t resolution) const {
+  FloatMesh mesh;
+  mesh.triangles = *domain_->meshIndices(resolution);
+  mesh.points.resize(3 * domain_->parameters(resolution).size());
+  eval(resolution, OutputBuffer<float>{ mesh.points.data(), 3 });
+  return mesh;
+}
+
+TriMesh
+Surface::eval(size_t resolution, VectorVector &normals) const {
+  if (!mapped_derivatives_) {
+    TriMesh mesh = eval(resolution);
+    const PointVector &points = mesh.points();
+    normals.assign(points.size(), Vector3D(0, 0, 0));
+    for (const auto &t : mesh.triangles()) {
+      // Weighted by the triangle areas
+      Vector3D normal = (points[t[1]] - points[t[0]]) ^ (points[t[2]] - points[t[0]]);
+      for (auto i : t)
+        normals[i] += normal;
+    }
+    for (auto &normal : normals)
+      normal.normalize();
+    return mesh;
+  }
+
+  TriMesh mesh = domain_->meshTopology(resolution);
+  auto shared_uvs = domain_->sharedParameters(resolution);
+  auto ders = evalDerivatives(*shared_uvs);
+  PointVector points(ders.size());
+  normals.resize(ders.size());
+  for (size_t i = 0; i < ders.size(); ++i) {
+    points[i] = ders[i].point;
+    normals[i] = (ders[i].du ^ ders[i].dv).normalize();
+  }
+  mesh.setPoints(points);
+  return mesh;
+}
+
+void
+Surface::eval(size_t resolution, MeshSink &sink, bool overlap) const {
+  struct Batch {
+    size_t first, oldest;
+    PointVector points;
+    std::vector<TriMesh::Triangle> triangles;
+  };
+
+  auto layers = domain_->meshLayers(resolution);
+  PointVector solved;
+  if (!pointwise_mesh_) {
+    solved.resize(layers.back());
+    evalPoints(resolution, [&](size_t first, size_t size, const Point3D *block) {
+      std::copy(block, block + size, solved.begin() + first);
+    });
+  }
+  size_t next_layer = 0;
+  // Whole layers, until at least stream_batch_size points; the triangles of layer l
+  // connect it to layer l - 1, so later triangles refer only to the last layer of the batch
+  auto compute = [&](Batch &batch) {
+    size_t first_layer = next_layer;
+    batch.first = layers[first_layer];
+    while (next_layer <= resolution && layers[next_layer] - batch.first < stream_batch_size)
+      ++next_layer;
+    batch.oldest = layers[next_layer - 1];
+    size_t size = layers[next_layer] - batch.first;
+    TRANSFINITE_TIMER("Surface::eval(sink)");
+    TRANSFINITE_ZONE_TEXT(Profiler::typeName(typeid(*this)));
+    TRANSFINITE_COUNT("evaluated points", size);
+    if (!pointwise_mesh_)
+      batch.points.assign(solved.begin() + batch.first, solved.begin() + batch.first + size);
+    else {
+      auto uvs = domain_->layerParameters(resolution, first_layer, next_layer);
+      batch.points.resize(size);
+      executor_(size, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i += block_size)
+          evalBlock(&uvs[i], std::min(block_size, end - i), &batch.points[i]);
+      });
+    }
+    batch.triangles.clear();
+    for (size_t l = std::max<size_t>(first_layer, 1); l < next_layer; ++l)
+      domain_->meshTriangles(resolution, l, batch.triangles);
+  };
+  auto send = [&](const Batch &batch) {
+    sink.addPoints(batch.first, batch.points);
+    sink.addTriangles(batch.triangles, batch.oldest);
+  };
+
+  sink.begin(layers.back(), domain_->meshTriangleCount(resolution));
+  if (!overlap) {
+    Batch batch;
+    while (next_layer <= resolution) {
+      compute(batch);
+      send(batch);
+    }
+    sink.end();
+    return;
+  }
+
+  // At most two batches are waiting for the writer thread
+  std::deque<Batch> queue;
+  bool finished = false;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::thread writer([&]() {
+    try {
+      while (true) {
+        Batch batch;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          changed.wait(lock, [&]() { return finished || !queue.empty(); });
+          if (queue.empty())
+            break;
+          batch = std::move(queue.front());
+          queue.pop_front();
+        }
+        changed.notify_all();
+        send(batch);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      error = std::current_exception();
+      queue.clear();
+    }
+    changed.notify_all();
+  });
+  try {
+    while (next_layer <= resolution) {
+      Batch batch;
+      compute(batch);
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return error || queue.size() < 2; });
+      if (error)
+        break;
+      queue.push_back(std::move(batch));
+      lock.unlock();
+      changed.notify_all();
+    }
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+    }
+    changed.notify_all();
+    writer.join();
+    throw;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  changed.notify_all();
+  writer.join();
+  if (error)
+    std::rethrow_exception(error);
+  sink.end();
+}
+
+Surface::Derivatives
+Surface::evalDerivatives(const Point2D &uv) const {
+  if (!mapped_derivatives_)
+    return evalDerivativesNumerically(uv);
+
+  thread_local Point2DVector sds;
+  thread_local Vector2DVector ds, dd;
+  sds.resize(n_); ds.resize(n_); dd.resize(n_);
+  param_->mapToRibbonsDerivatives(uv, sds.data(), ds.data(), dd.data());
+  return evalMappedDerivatives(uv, sds, ds, dd);
+}
+
+std::vector<Surface::Derivatives>
+Surface::evalDerivatives(const Point2DVector &uvs) const {
+  auto order = spatialOrder(uvs);
+  std::vector<Derivatives> result(uvs.size());
+  executor_(uvs.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      size_t i = order.empty() ? k : order[k];
+      result[i] = evalDerivatives(uvs[i]);
+    }
+  });
+  return result;
+}
+
+Point3D
+Surface::evalMapped(const Point2D &uv, const Point2DVector &sds) const {
+  if (blend_type_ == BlendType::NONE)
+    throw std::logic_error("evalMapped() is not implemented for this surface");
+  thread_local DoubleVector blends;
+  blends.resize(n_);
+  blendBlock(sds.data(), 1, blends.data());
+  return evalBlended(uv, sds, blends.data());
+}
+
+Point3D
+Surface::evalBlended(const Point2D &, const Point2DVector &, const double *) const {
+  throw std::logic_error("evalBlended() is not implemented for this surface");
+}
+
+uint64_t
+Surface::blendSides(size_t i) const {
+  if (blend_type_ == BlendType::SIDE_SINGULAR)
+    return uint64_t(1) << i;
+  return (uint64_t(1) << i) | (uint64_t(1) << next(i));
+}
+
+uint64_t
+Surface::deficiencySides() const {
+  return 0;
+}
+
+std::vector<uint64_t>
+Surface::sideInfluences(size_t resolution, double threshold) const {
+  auto table = param_->parameterTable(resolution, executor_);
+  size_t size = table->sds.size() / n_;
+  if (!mapped_eval_ || blend_type_ == BlendType::NONE || n_ > 64)
+    return std::vector<uint64_t>(size, ~uint64_t(0));
+
+  std::vector<uint64_t> masks(n_);
+  for (size_t i = 0; i < n_; ++i)
+    masks[i] = blendSides(i);
+  uint64_t deficiency = deficiencySides();
+  std::vector<uint64_t> result(size, 0);
+  executor_(size, [&](size_t begin, size_t end) {
+    thread_local DoubleVector blends;
+    blends.resize(block_size * n_);
+    for (size_t start = begin; start < end; start += block_size) {
+      size_t m = std::min(block_size, end - start);
+      blendBlock(table->row(start), m, blends.data());
+      for (size_t k = 0; k < m; ++k) {
+        const double *blf = &blends[k * n_];
+        uint64_t &mask = result[start + k];
+        double sum = 0.0;
+        for (size_t i = 0; i < n_; ++i) {
+          if (std::abs(blf[i]) > threshold)
+            mask |= masks[i];
+          sum += blf[i];
+        }
+        if (std::abs(1.0 - sum) > threshold)
+          mask |= deficiency;
+      }
+    }
+  });
+  return result;
+}
+
+// The central cross-derivative c = h * m * scale is moved by `scale` in each coordinate,
+// with the handler c / |c| and the multiplier |c| / scale
+Surface::RibbonJacobian
+Surface::ribbonJacobian(size_t resolution, size_t i) const {
+  RibbonJacobian result;
+  auto ribbon = std::dynamic_pointer_cast<const RibbonCompatibleWithHandler>(ribbons_.at(i));
+  if (!ribbon)
+    return result;
+  auto masks = sideInfluences(resolution, 0.0);
+  for (size_t k = 0; k < masks.size(); ++k)
+    if (i >= 64 || masks[k] & (uint64_t(1) << i))
+      result.vertices.push_back(k);
+  if (result.vertices.empty())
+    return result;
+
+  Vector3D central = ribbon->central(), direction = ribbon->direction();
+  double scale = ribbon->scale(), multiplier = ribbon->multiplier();
+  PointVector points = eval(resolution, result.vertices);
+  auto copy = clone();
+  copy->detach();
+  copy->param_->setParameterTable(resolution, param_->parameterTable(resolution, executor_));
+  std::array<VectorVector, 3> derivatives;
+  for (size_t k = 0; k < 3; ++k) {
+    Vector3D delta(0, 0, 0);
+    delta[k] = scale;
+    if ((central + delta).norm() < scale / 2)
+      delta[k] = -scale;
+    Vector3D moved = central + delta;
+    copy->setRibbonHandler(i, moved);
+    copy->setRibbonMultiplier(i, moved.norm() / scale);
+    copy->update(i);
+    PointVector moved_points = copy->eval(resolution, result.vertices);
+    for (size_t j = 0; j < points.size(); ++j)
+      derivatives[k].push_back((moved_points[j] - points[j]) / delta[k]);
+  }
+
+  // dc/dm = h * scale, dc/dh = m * scale * (I - h h^T) at |h| = 1
+  for (size_t j = 0; j < points.size(); ++j) {
+    Vector3D dm(0, 0, 0);
+    std::array<Vector3D, 3> dh;
+    for (size_t k = 0; k < 3; ++k) {
+      dm += derivatives[k][j] * direction[k] * scale;
+      dh[k] = Vector3D(0, 0, 0);
+      for (size_t l = 0; l < 3; ++l) {
+        double projection = (k == l ? 1.0 : 0.0) - direction[l] * direction[k];
+        dh[k] += derivatives[l][j] * (multiplier * scale * projection);
+      }
+    }
+    result.multiplier.push_back(dm);
+    result.handler.push_back(dh);
+    result.central.push_back({ derivatives[0][j], derivatives[1][j], derivatives[2][j] });
+  }
+  return result;
+}
+
+Surface::Derivatives
+Surface::evalMappedDerivatives(const Point2D &, const Point2DVector &,
+                               const Vector2DVector &, const Vector2DVector &) const {
+  throw std::logic_error("evalMappedDerivatives() is not implemented for this surface");
+}
+
+// Where a step leaves the domain, the difference is one-sided (of second order) from the inside;
+// where both steps along an axis leave it (at some corners), the partial derivatives are solved
+// from those in two directions at 30 degrees from the direction towards the center
+Surface::Derivatives
+Surface::evalDerivativesNumerically(const Point2D &uv) const {
+  static const double step = 1.0e-5;
+  Derivatives result;
+  result.point = eval(uv);
+  auto directional = [&](const Vector2D &d, Vector3D &der) {
+    bool forward = domain_->contains(uv + d * step);
+    bool backward = domain_->contains(uv - d * step);
+    if (forward && backward)
+      der = (eval(uv + d * step) - eval(uv - d * step)) / (2.0 * step);
+    else if (forward || backward) {
+      double h = forward ? step : -step;
+      der = ((eval(uv + d * h) - result.point) * 4 - (eval(uv + d * (2 * h)) - result.point))
+        / (2 * h);
+    } else
+      return false;
+    return true;
+  };
+  if (directional(Vector2D(1, 0), result.du) && directional(Vector2D(0, 1), result.dv))
+    return result;
+
+  Vector2D c = (domain_->center() - uv).normalize();
+  double cos30 = std::sqrt(3.0) / 2, sin30 = 0.5;
+  Vector2D d1(c[0] * cos30 - c[1] * sin30, c[0] * sin30 + c[1] * cos30);
+  Vector2D d2(c[0] * cos30 + c[1] * sin30, c[1] * cos30 - c[0] * sin30);
+  Vector3D der1(0, 0, 0), der2(0, 0, 0);
+  directional(d1, der1);
+  directional(d2, der2);
+  double det = d1[0] * d2[1] - d1[1] * d2[0];
+  result.du = (der1 * d2[1] - der2 * d1[1]) / det;
+  result.dv = (der2 * d1[0] - der1 * d2[0]) / det;
+  return result;
+}
+
+void
+Surface::evalBlock(const Point2D *uvs, size_t size, Point3D *points) const {
+  if (!mapped_eval_) {
+    for (size_t i = 0; i < size; ++i)
+      points[i] = eval(uvs[i]);
+    return;
+  }
+
+  thread_local Point2DVector block;
+  block.resize(size * n_);
+  param_->mapToRibbons(uvs, size, block.data());
+  evalMappedBlock(uvs, block.data(), size, points);
+}
+
+void
+Surface::evalMappedBlock(const Point2D *uvs, const Point2D *sds, size_t size,
+                         Point3D *points) const {
+  if (use_fast_eval_ && fast_eval_) {
+    fast_eval_->evalBlock(*this, sds, size, points);
+    return;
+  }
+  thread_local Point2DVector row;
+  thread_local DoubleVector blends;
+  row.resize(n_);
+  if (blend_type_ != BlendType::NONE) {
+    blends.resize(size * n_);
+    blendBlock(sds, size, blends.data());
+  }
+  for (size_t i = 0; i < size; ++i) {
+    std::copy_n(sds + i * n_, n_, row.begin());
+    if (blend_type_ != BlendType::NONE)
+      points[i] = evalBlended(uvs[i], row, &blends[i * n_]);
+    else
+      points[i] = evalMapped(uvs[i], row);
+  }
+}
+
 Point3D
 Surface::cornerCorrection(size_t i, double s1, double s2) const {
   // Assumes that both s1 and s2 are 0 at the corner,
@@ -189,9 +932,59 @@ Surface::cornerInterpolantD(size_t i, const Point2DVector &sds) const {
     - cornerCorrection(i, di1, di);
 }
 
-DoubleVector
-Surface::blendCorner(const Point2DVector &sds) const {
-  DoubleVector blf; blf.reserve(n_);
+Surface::Derivatives
+Surface::cornerCorrection(size_t i, double s1, double s2,
+                          const Vector2D &ds1, const Vector2D &ds2) const {
+  double g1 = gamma(s1), g2 = gamma(s2);
+  double t1 = inrange(0, g1, 1), t2 = inrange(0, g2, 1);
+  Vector2D dt1 = std::abs(t1 - g1) < epsilon ? ds1 * gammaDerivative(s1) : Vector2D(0, 0);
+  Vector2D dt2 = std::abs(t2 - g2) < epsilon ? ds2 * gammaDerivative(s2) : Vector2D(0, 0);
+  const CornerData &cd = corner_data_[i];
+  Vector3D twist = rationalTwist(t1, t2, cd.twist2, cd.twist1);
+
+  // Partial derivatives with respect to t1 and t2
+  Vector3D p1 = cd.tangent1 + twist * t2, p2 = cd.tangent2 + twist * t1;
+  if (std::abs(t1 + t2) >= epsilon) {
+    p1 += (cd.twist2 - twist) * (t1 * t2 / (t1 + t2));
+    p2 += (cd.twist1 - twist) * (t1 * t2 / (t1 + t2));
+  }
+
+  Derivatives result;
+  result.point = cornerCorrection(i, s1, s2);
+  result.du = p1 * dt1[0] + p2 * dt2[0];
+  result.dv = p1 * dt1[1] + p2 * dt2[1];
+  return result;
+}
+
+Surface::Derivatives
+Surface::sideInterpolant(size_t i, double si, double di,
+                         const Vector2D &dsi, const Vector2D &ddi) const {
+  double s = inrange(0, si, 1), d = gamma(di);
+  Vector2D ds = std::abs(s - si) < epsilon ? dsi : Vector2D(0, 0);
+  Vector2D dd = d > -epsilon ? ddi * gammaDerivative(di) : Vector2D(0, 0);
+  Vector3D ps, pd;
+  Derivatives result;
+  result.point = ribbons_[i]->evalDerivatives(Point2D(s, std::max(d, 0.0)), ps, pd);
+  result.du = ps * ds[0] + pd * dd[0];
+  result.dv = ps * ds[1] + pd * dd[1];
+  return result;
+}
+
+Surface::Derivatives
+Surface::cornerInterpolant(size_t i, const Point2DVector &sds,
+                           const Vector2DVector &ds, const Vector2DVector &) const {
+  size_t ip = next(i);
+  double si = sds[i][0], si1 = sds[ip][0];
+  Vector2D dsi = ds[i], dsi1 = ds[ip], dsi_neg = ds[i] * -1.0;
+  Derivatives a = sideInterpolant(i, si, si1, dsi, dsi1);
+  Derivatives b = sideInterpolant(ip, si1, 1.0 - si, dsi1, dsi_neg);
+  Derivatives c = cornerCorrection(i, 1.0 - si, si1, dsi_neg, dsi1);
+  return { a.point + b.point - c.point, a.du + b.du - c.du, a.dv + b.dv - c.dv };
+}
+
+void
+Surface::blendCorner(const Point2DVector &sds, DoubleVector &blf) const {
+  blf.clear(); blf.reserve(n_);
 
   size_t close_to_boundary = 0;
   for (const auto &sd : sds) {
@@ -222,13 +1015,11 @@ Surface::blendCorner(const Point2DVector &sds) const {
     std::transform(blf.begin(), blf.end(), blf.begin(),
                    [denominator](double x) { return x / denominator; });
   }
-
-  return blf;
 }
 
-DoubleVector
-Surface::blendSideSingular(const Point2DVector &sds) const {
-  DoubleVector blf; blf.reserve(n_);
+void
+Surface::blendSideSingular(const Point2DVector &sds, DoubleVector &blf) const {
+  blf.clear(); blf.reserve(n_);
 
   size_t close_to_boundary = 0;
   for (const auto &sd : sds) {
@@ -249,50 +1040,440 @@ Surface::blendSideSingular(const Point2DVector &sds) const {
     std::transform(blf.begin(), blf.end(), blf.begin(),
                    [denominator](double x) { return x / denominator; });
   }
-
-  return blf;
 }
 
-DoubleVector
-Surface::blendCornerDeficient(const Point2DVector &sds) const {
-  DoubleVector blf; blf.reserve(n_);
+void
+Surface::blendCornerDeficient(const Point2DVector &sds, DoubleVector &blf) const {
+  blf.clear(); blf.reserve(n_);
   for (size_t i = 0; i < n_; ++i) {
     size_t ip = next(i);
     if (sds[i][1] < epsilon && sds[ip][1] < epsilon) {
       blf.push_back(1.0);
       continue;
     }
-    blf.push_back((sds[ip][1] * hermite(0, 1.0 - sds[i][0]) * hermite(0, sds[i][1] ) +
-                   sds[i][1]  * hermite(0,    sds[ip][0]  ) * hermite(0, sds[ip][1])) /
+    blf.push_back((sds[ip][1] * hermite<0>(1.0 - sds[i][0]) * hermite<0>(sds[i][1] ) +
+                   sds[i][1]  * hermite<0>(   sds[ip][0]  ) * hermite<0>(sds[ip][1])) /
                   (sds[i][1] + sds[ip][1]));
   }
-  return blf;
+}
+
+namespace {
+
+  // The blend kernels below are instantiated for the common side counts, where the side loops
+  // and the neighbor indices are resolved at compile time; N = 0 stands for any n
+  template<typename F>
+  void withSides(size_t n, F f) {
+    switch (n) {
+    case 3: f(std::integral_constant<size_t, 3>()); break;
+    case 4: f(std::integral_constant<size_t, 4>()); break;
+    case 5: f(std::integral_constant<size_t, 5>()); break;
+    case 6: f(std::integral_constant<size_t, 6>()); break;
+    default: f(std::integral_constant<size_t, 0>());
+    }
+  }
+
+  // Gathers the k-th ribbon parameters of m points (rows of n) into arrays indexed
+  // by [side * block_size + point]
+  template<size_t N>
+  void gatherParameters(const Point2D *sds, size_t n_dynamic, size_t m, size_t k, double *result) {
+    const size_t n = N ? N : n_dynamic;
+    for (size_t i = 0; i < n; ++i)
+      for (size_t b = 0; b < m; ++b)
+        result[i * block_size + b] = sds[b * n + i][k];
+  }
+
+  // Reciprocal squares of the distances, 0 (instead of infinity) where these are below epsilon,
+  // also counting the small distances of each point
+  template<size_t N>
+  void inverseSquares(const double *d, size_t n_dynamic, size_t m, double *x, double *small) {
+    const size_t n = N ? N : n_dynamic;
+    std::fill_n(small, m, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+      const double *di = d + i * block_size;
+      double *xi = x + i * block_size;
+      for (size_t b = 0; b < m; ++b) {
+        bool on_boundary = di[b] < epsilon;
+        xi[b] = on_boundary ? 0.0 : 1.0 / (di[b] * di[b]);
+        small[b] += on_boundary ? 1.0 : 0.0;
+      }
+    }
+  }
+
+  template<size_t N>
+  void cornerBlends(const Point2D *sds, size_t n_dynamic, size_t size, double *blf) {
+    const size_t n = N ? N : n_dynamic;
+    thread_local DoubleVector d, x, small, sum;
+    d.resize(n * block_size); x.resize(n * block_size);
+    small.resize(block_size); sum.resize(block_size);
+    for (size_t start = 0; start < size; start += block_size) {
+      size_t m = std::min(block_size, size - start);
+      const Point2D *rows = sds + start * n;
+      double *result = blf + start * n;
+      gatherParameters<N>(rows, n, m, 1, d.data());
+      inverseSquares<N>(d.data(), n, m, x.data(), small.data());
+      std::fill_n(sum.begin(), m, 0.0);
+      for (size_t i = 0; i < n; ++i) {
+        const double *xi = &x[i * block_size], *xip = &x[(i + 1) % n * block_size];
+        for (size_t b = 0; b < m; ++b)
+          sum[b] += xi[b] * xip[b];
+      }
+      for (size_t i = 0; i < n; ++i) {
+        size_t ip = (i + 1) % n;
+        const double *di = &d[i * block_size], *dip = &d[ip * block_size];
+        const double *xi = &x[i * block_size], *xip = &x[ip * block_size];
+        const double *xim = &x[(i + n - 1) % n * block_size], *xipp = &x[(ip + 1) % n * block_size];
+        // With one small distance the blends at the two adjacent corners are the
+        // ratios of the other distances (cf. Surface::blendCorner(sds, blf))
+        for (size_t b = 0; b < m; ++b) {
+          bool si = di[b] < epsilon, sip = dip[b] < epsilon;
+          double one = si ? xip[b] / (xip[b] + xim[b]) : (sip ? xi[b] / (xi[b] + xipp[b]) : 0.0);
+          double many = si && sip ? 1.0 : 0.0;
+          double regular = xi[b] * xip[b] / sum[b];
+          result[b * n + i] = small[b] == 0.0 ? regular : (small[b] == 1.0 ? one : many);
+        }
+      }
+    }
+  }
+
+  template<size_t N>
+  void sideSingularBlends(const Point2D *sds, size_t n_dynamic, size_t size, double *blf) {
+    const size_t n = N ? N : n_dynamic;
+    thread_local DoubleVector d, x, small, sum;
+    d.resize(n * block_size); x.resize(n * block_size);
+    small.resize(block_size); sum.resize(block_size);
+    for (size_t start = 0; start < size; start += block_size) {
+      size_t m = std::min(block_size, size - start);
+      const Point2D *rows = sds + start * n;
+      double *result = blf + start * n;
+      gatherParameters<N>(rows, n, m, 1, d.data());
+      inverseSquares<N>(d.data(), n, m, x.data(), small.data());
+      std::fill_n(sum.begin(), m, 0.0);
+      for (size_t i = 0; i < n; ++i) {
+        const double *xi = &x[i * block_size];
+        for (size_t b = 0; b < m; ++b)
+          sum[b] += xi[b];
+      }
+      for (size_t i = 0; i < n; ++i) {
+        const double *di = &d[i * block_size], *xi = &x[i * block_size];
+        for (size_t b = 0; b < m; ++b) {
+          double singular = di[b] < epsilon ? 1.0 / small[b] : 0.0;
+          result[b * n + i] = small[b] > 0.0 ? singular : xi[b] / sum[b];
+        }
+      }
+    }
+  }
+
+  template<size_t N>
+  void cornerDeficientBlends(const Point2D *sds, size_t n_dynamic, size_t size, double *blf) {
+    const size_t n = N ? N : n_dynamic;
+    thread_local DoubleVector s, d;
+    s.resize(n * block_size); d.resize(n * block_size);
+    for (size_t start = 0; start < size; start += block_size) {
+      size_t m = std::min(block_size, size - start);
+      const Point2D *rows = sds + start * n;
+      double *result = blf + start * n;
+      gatherParameters<N>(rows, n, m, 0, s.data());
+      gatherParameters<N>(rows, n, m, 1, d.data());
+      for (size_t i = 0; i < n; ++i) {
+        size_t ip = (i + 1) % n;
+        const double *si = &s[i * block_size], *sip = &s[ip * block_size];
+        const double *di = &d[i * block_size], *dip = &d[ip * block_size];
+        for (size_t b = 0; b < m; ++b) {
+          double blend = (dip[b] * hermite<0>(1.0 - si[b]) * hermite<0>(di[b]) +
+                          di[b] * hermite<0>(sip[b]) * hermite<0>(dip[b])) / (di[b] + dip[b]);
+          result[b * n + i] = di[b] < epsilon && dip[b] < epsilon ? 1.0 : blend;
+        }
+      }
+    }
+  }
+
+}
+
+void
+Surface::blendBlock(const Point2D *sds, size_t size, double *blf) const {
+  switch (blend_type_) {
+  case BlendType::CORNER: blendCorner(sds, size, blf); break;
+  case BlendType::SIDE_SINGULAR: blendSideSingular(sds, size, blf); break;
+  case BlendType::CORNER_DEFICIENT: blendCornerDeficient(sds, size, blf); break;
+  default: ;
+  }
+}
+
+void
+Surface::blendCorner(const Point2D *sds, size_t size, double *blf) const {
+  withSides(n_, [&](auto sides) { cornerBlends<decltype(sides)::value>(sds, n_, size, blf); });
+}
+
+void
+Surface::blendSideSingular(const Point2D *sds, size_t size, double *blf) const {
+  withSides(n_, [&](auto sides) { sideSingularBlends<decltype(sides)::value>(sds, n_, size, blf); });
+}
+
+void
+Surface::blendCornerDeficient(const Point2D *sds, size_t size, double *blf) const {
+  withSides(n_, [&](auto sides) {
+    cornerDeficientBlends<decltype(sides)::value>(sds, n_, size, blf);
+  });
+}
+
+// At the points where the value version switches to a limit case, the derivatives
+// of the blends are taken as zero, except along a single boundary for blendCorner()
+void
+Surface::blendCorner(const Point2DVector &sds, const Vector2DVector &,
+                     const Vector2DVector &dd, DoubleVector &blf, Vector2DVector &dblf) const {
+  blendCorner(sds, blf);
+  dblf.assign(n_, Vector2D(0, 0));
+
+  size_t close_to_boundary = 0;
+  for (const auto &sd : sds) {
+    if (sd[1] < epsilon)
+      ++close_to_boundary;
+  }
+
+  // The gradient of d^-2 is -2 d^-3 grad(d)
+  auto inverseSquare = [&](size_t j, Vector2D &grad) {
+    double x = std::pow(sds[j][1], -2);
+    grad = dd[j] * (-2.0 * x / sds[j][1]);
+    return x;
+  };
+
+  if (close_to_boundary > 1)
+    return;
+  if (close_to_boundary == 1) {
+    for (size_t i = 0; i < n_; ++i) {
+      size_t ip = next(i), j, k;
+      if (sds[i][1] < epsilon) {
+        j = ip; k = prev(i);
+      } else if (sds[ip][1] < epsilon) {
+        j = i; k = next(ip);
+      } else
+        continue;
+      Vector2D dx, dy;
+      double x = inverseSquare(j, dx), y = inverseSquare(k, dy);
+      dblf[i] = (dx * y - dy * x) / ((x + y) * (x + y));
+    }
+    return;
+  }
+
+  Vector2D dsum(0, 0);
+  double sum = 0.0;
+  for (size_t i = 0; i < n_; ++i) {
+    // With w_i = (d_i d_i+1)^-2, grad(w_i) = -2 w_i (grad(d_i) / d_i + grad(d_i+1) / d_i+1)
+    size_t ip = next(i);
+    double w = std::pow(sds[i][1] * sds[ip][1], -2);
+    dblf[i] = (dd[i] / sds[i][1] + dd[ip] / sds[ip][1]) * (-2.0 * w);
+    dsum += dblf[i];
+    sum += w;
+  }
+  for (size_t i = 0; i < n_; ++i)
+    dblf[i] = (dblf[i] - dsum * blf[i]) / sum;
+}
+
+void
+Surface::blendSideSingular(const Point2DVector &sds, const Vector2DVector &,
+                           const Vector2DVector &dd, DoubleVector &blf,
+                           Vector2DVector &dblf) const {
+  blendSideSingular(sds, blf);
+  dblf.assign(n_, Vector2D(0, 0));
+  for (const auto &sd : sds)
+    if (sd[1] < epsilon)
+      return;
+
+  Vector2D dsum(0, 0);
+  double sum = 0.0;
+  for (size_t i = 0; i < n_; ++i) {
+    double w = std::pow(sds[i][1], -2);
+    dblf[i] = dd[i] * (-2.0 * w / sds[i][1]);
+    dsum += dblf[i];
+    sum += w;
+  }
+  for (size_t i = 0; i < n_; ++i)
+    dblf[i] = (dblf[i] - dsum * blf[i]) / sum;
+}
+
+void
+Surface::blendCornerDeficient(const Point2DVector &sds, const Vector2DVector &ds,
+                              const Vector2DVector &dd, DoubleVector &blf,
+                              Vector2DVector &dblf) const {
+  blendCornerDeficient(sds, blf);
+  dblf.assign(n_, Vector2D(0, 0));
+  for (size_t i = 0; i < n_; ++i) {
+    size_t ip = next(i);
+    double si = sds[i][0], di = sds[i][1], si1 = sds[ip][0], di1 = sds[ip][1];
+    if (di < epsilon && di1 < epsilon)
+      continue;
+    double a = hermite<0>(1.0 - si) * hermite<0>(di);
+    double b = hermite<0>(si1) * hermite<0>(di1);
+    Vector2D da = ds[i] * (-hermiteDerivative<0>(1.0 - si) * hermite<0>(di))
+      + dd[i] * (hermite<0>(1.0 - si) * hermiteDerivative<0>(di));
+    Vector2D db = ds[ip] * (hermiteDerivative<0>(si1) * hermite<0>(di1))
+      + dd[ip] * (hermite<0>(si1) * hermiteDerivative<0>(di1));
+    Vector2D dnumerator = dd[ip] * a + da * di1 + dd[i] * b + db * di;
+    dblf[i] = (dnumerator - (dd[i] + dd[ip]) * blf[i]) / (di + di1);
+  }
+}
+
+void
+Surface::addBlended(Derivatives &sum, const Derivatives &term,
+                    double blend, const Vector2D &dblend) {
+  sum.point += term.point * blend;
+  sum.du += term.du * blend + term.point * dblend[0];
+  sum.dv += term.dv * blend + term.point * dblend[1];
 }
 
 void
 Surface::updateCorner(size_t i) {
-  static const double step = 1.0e-4;
   size_t ip = next(i);
 
-  VectorVector der;
-  Vector3D d1, d2;
-  corner_data_[i].point = ribbons_[i]->curve()->eval(1.0, 1, der);
-  corner_data_[i].tangent1 = -der[1];
-  ribbons_[ip]->curve()->eval(0.0, 1, der);
-  corner_data_[i].tangent2 = der[1];
-  d1 = ribbons_[i]->crossDerivative(1.0);
-  d2 = ribbons_[i]->crossDerivative(1.0 - step);
-  corner_data_[i].twist1 = (d2 - d1) / step;
-  d1 = ribbons_[ip]->crossDerivative(0.0);
-  d2 = ribbons_[ip]->crossDerivative(step);
-  corner_data_[i].twist2 = (d2 - d1) / step;
+  auto metrics = curveMetrics(ribbons_[i]->curve());
+  corner_data_[i].point = metrics->end;
+  corner_data_[i].tangent1 = -metrics->end_tangent;
+  corner_data_[i].tangent2 = curveMetrics(ribbons_[ip]->curve())->start_tangent;
+  // The twists are taken in the direction of the tangents
+  corner_data_[i].twist1 = -ribbons_[i]->twist(1.0);
+  corner_data_[i].twist2 = ribbons_[ip]->twist(0.0);
+}
+
+// The old hierarchy is kept for refitting, but in a new cache, as copies may still use the old one
+void
+Surface::invalidatePicking() {
+  auto cache = std::make_shared<PickingCache>();
+  {
+    std::lock_guard<std::mutex> lock(picking_->mutex);
+    cache->entry = picking_->entry;
+  }
+  cache->stale = true;
+  picking_ = cache;
+}
+
+std::optional<Surface::RayHit>
+Surface::intersect(const Point3D &origin, const Vector3D &direction, size_t resolution) const {
+  std::shared_ptr<const PickingCache::Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(picking_->mutex);
+    auto &cached = picking_->entry;
+    bool same = cached && cached->sides == n_ && cached->resolution == resolution;
+    if (!same || picking_->stale) {
+      auto uvs = domain_->sharedParameters(resolution);
+      auto points = eval(*uvs);
+      std::shared_ptr<PickingCache::Entry> e;
+      if (same) {
+        TRANSFINITE_TIMER("Surface::intersect(refit)");
+        e = std::make_shared<PickingCache::Entry>(*cached);
+        e->bvh.refit(points);
+      } else {
+        TRANSFINITE_TIMER("Surface::intersect(build)");
+        TriMesh mesh = domain_->meshTopology(resolution);
+        mesh.setPoints(points);
+        e = std::make_shared<PickingCache::Entry>(PickingCache::Entry{ n_, resolution,
+                                                                       TriangleBVH(mesh), uvs });
+      }
+      e->uvs = uvs;
+      cached = e;
+      picking_->stale = false;
+    }
+    entry = cached;
+  }
+
+  TriMesh::Triangle triangle;
+  double t;
+  std::array<double, 3> bary;
+  if (!entry->bvh.intersect(origin, direction, triangle, t, bary))
+    return std::nullopt;
+  const Point2DVector &uvs = *entry->uvs;
+  Point2D uv(0, 0);
+  for (size_t k = 0; k < 3; ++k)
+    uv += uvs[triangle[k]] * bary[k];
+  RayHit hit = { uv, origin + direction * t, t };
+
+  // Solves S(uv) = origin + direction * t, by Cramer's rule for the 3x3 Jacobian [du dv -direction]
+  double residual = (eval(uv) - hit.point).norm();
+  if (residual == 0)
+    return hit;
+  for (size_t iteration = 0; iteration < 10; ++iteration) {
+    auto d = evalDerivatives(uv);
+    Vector3D f = origin + direction * t - d.point, c = -direction;
+    double det = d.du * (d.dv ^ c);
+    if (std::abs(det) < std::numeric_limits<double>::min())
+      break;
+    Vector2D duv((f * (d.dv ^ c)) / det, (d.du * (f ^ c)) / det);
+    uv += duv;
+    t += (d.du * (d.dv ^ f)) / det;
+    if (duv.norm() < epsilon * epsilon)
+      break;
+  }
+  Point3D point = eval(uv);
+  if (t >= 0 && (point - (origin + direction * t)).norm() < residual && domain_->contains(uv))
+    hit = { uv, point, t };
+  return hit;
+}
+
+void
+Surface::shareDomain(const Surface &other) {
+  if (other.n_ != n_ || typeid(*other.domain_) != typeid(*domain_))
+    throw std::invalid_argument("surfaces with different domains");
+  for (size_t i = 0; i < n_; ++i)
+    if (other.ribbons_[i]->curve() != ribbons_[i]->curve())
+      throw std::invalid_argument("surfaces with different curves");
+  domain_ = other.domain_;
+  if (param_->sameMapping(*other.param_))
+    param_ = other.param_;
+  else
+    param_->setDomain(domain_);
+}
+
+// Timed here, as the subclasses of Domain and Parameterization override update();
+// with a shared domain, another parameterization may have seen the change (see shareDomain)
+void
+Surface::updateDomain() {
+  {
+    TRANSFINITE_TIMER("Domain::update");
+    domain_->update();
+  }
+  if (param_->domainRevision() != domain_->revision()) {
+    TRANSFINITE_TIMER("Parameterization::update");
+    param_->update();
+  }
 }
 
+// A ribbon depends also on the curves of its neighbors, and a corner on its two ribbons;
+// ribbon updates only read the curves of the others, so they can run concurrently,
+// followed by the corner updates
 void
-Surface::updateCorners() {
+Surface::updateRibbons(const std::vector<bool> &modified) {
+  std::vector<bool> updated(n_, false);
+  std::vector<size_t> ribbons, corners;
+  for (size_t i = 0; i < n_; ++i) {
+    size_t range = std::min(ribbons_[i]->dependencyRange(), n_ / 2);
+    for (size_t j = 0; j <= range && !updated[i]; ++j)
+      updated[i] = modified[prev(i, j)] || modified[next(i, j)];
+    if (updated[i] || ribbons_[i]->sampling() != ribbon_samples_)
+      ribbons.push_back(i);
+  }
+  update_executor_(ribbons.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      size_t i = ribbons[k];
+      if (updated[i]) {
+        TRANSFINITE_TIMER("Ribbon::update");
+        ribbons_[i]->update();
+      }
+      ribbons_[i]->updateSampling(ribbon_samples_);
+    }
+  });
   corner_data_.resize(n_);
   for (size_t i = 0; i < n_; ++i)
-    updateCorner(i);
+    if (updated[i] || updated[next(i)])
+      corners.push_back(i);
+  update_executor_(corners.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k)
+      updateCorner(corners[k]);
+  });
+  corner_centroid_ = Point3D(0, 0, 0);
+  for (const auto &corner : corner_data_)
+    corner_centroid_ += corner.point;
+  if (n_ > 0)
+    corner_centroid_ /= n_;
+  fast_eval_ = makeFastEvaluator(*this);
 }
 
 double
@@ -302,6 +1483,13 @@ Surface::gamma(double d) const {
   return d;
 }
 
+double
+Surface::gammaDerivative(double d) const {
+  if (use_gamma_)
+    return 1.0 / std::pow(2.0 * d + 1.0, 2);
+  return 1.0;
+}
+
 Vector3D
 Surface::rationalTwist(double u, double v, const Vector3D &f, const Vector3D &g) {
   if (std::abs(u + v) < epsilon)
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "cache.hh"
+#include "executor.hh"
 #include "geometry.hh"
 
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <optional>
 
@@ -11,20 +16,119 @@ using namespace Geometry;
 
 using NormalFence = std::function<Vector3D(double)>;
   
+class BlockEvaluator;
 class Domain;
+class MeshSink;
 class Parameterization;
 class Ribbon;
 
+// Surfaces whose blended evaluation has a specialized version (see fast-evaluator.hh)
+enum class SurfaceKind { OTHER, SIDE_BASED, CORNER_BASED };
+template<size_t N, SurfaceKind K> class FastEvaluator;
+
+// Caller-provided memory, e.g. a mapped vertex buffer or a numpy array: the components of
+// element i start at data[i * stride] (the stride is in scalars, 0 meaning tightly packed)
+template<typename T>
+struct OutputBuffer {
+  T *data = nullptr;
+  size_t stride = 0;
+};
+
+// Caller-provided input, with the layout of OutputBuffer
+template<typename T>
+struct InputBuffer {
+  const T *data = nullptr;
+  size_t stride = 0;
+};
+
+// Mesh in single precision, as vertex and index buffers for GPU upload
+struct FloatMesh {
+  FloatMesh() = default;
+  explicit FloatMesh(const TriMesh &mesh);
+  std::vector<float> points;       // x, y and z of each vertex
+  std::vector<uint32_t> triangles; // vertex indices, three for each triangle
+};
+
+// Thread safety: after setup (setCurves, setupLoop, update etc.) is finished,
+// the const member functions, and in particular all evaluation functions,
+// can be called concurrently on the same surface.
+// Calls to non-const member functions must not overlap with any other call.
 class Surface {
 public:
+  // Point with its partial derivatives with respect to u and v
+  struct Derivatives {
+    Point3D point;
+    Vector3D du, dv;
+  };
+  // Intersection of a ray with the surface, at origin + direction * t
+  struct RayHit {
+    Point2D uv;
+    Point3D point;
+    double t;
+  };
+  // Derivatives of mesh vertices with respect to the settings of a ribbon (see ribbonJacobian)
+  struct RibbonJacobian {
+    std::vector<size_t> vertices;                 // those depending on the ribbon
+    VectorVector multiplier;                      // d vertex / d multiplier
+    std::vector<std::array<Vector3D, 3>> handler; // d vertex / d handler[k]
+    std::vector<std::array<Vector3D, 3>> central; // d vertex / d central cross-derivative[k]
+  };
+
   Surface();
+  // Copies share the domain, the parameterization and the ribbons (with their curves),
+  // so they can only be used while the original is unchanged; see snapshot()
   Surface(const Surface &) = default;
   virtual ~Surface();
   Surface &operator=(const Surface &) = default;
+  virtual std::shared_ptr<Surface> clone() const = 0;
+  // Evaluation-only copy of the surface as of the last update, which stays valid
+  // (and can be evaluated concurrently) while this one is edited and updated.
+  // Everything mutable is copied (curves, ribbons, domain, parameterization), but the caches
+  // computed so far, e.g. domain parameters, parameter tables and evaluation plans, are shared:
+  // these are never changed in place, only replaced by the next update of either surface.
+  // Like update(), this should not overlap with changes of the curves.
+  std::shared_ptr<const Surface> snapshot() const;
   void setGamma(bool use_gamma);
+  void setExecutor(const Executor &executor);
+  // Executor of the ribbon and corner updates in update() (serial by default);
+  // as there is only one task for each side, this should have a grain of 1
+  void setUpdateExecutor(const Executor &executor);
+  void useParameterTables(bool use);
+  // With this, eval(uvs) and evalDerivatives(uvs) evaluate the points in the order of mortonOrder
+  // (in chunks of the executor), so consecutive points are close in the domain and share the
+  // caches; the results are still in the order of uvs. Off by default.
+  void useSpatialOrder(bool use);
+  // Terms of the blended evaluation whose blend weights are at most `cutoff` in absolute value
+  // are not evaluated, but replaced by the centroid of the corners, with the same weight.
+  // The error is thus at most n * cutoff * the largest distance of a skipped interpolant from
+  // the centroid (about the size of the patch); derivatives are not affected.
+  // With 0 (the default) only zero weights are skipped, which is exact.
+  void setBlendCutoff(double cutoff);
+  // Limits the cached domain parameters (and the solutions of biharmonic surfaces) to
+  // `resolutions` resolutions (evicting the least recently used), and each point cache
+  // of the parameterization to about `points` entries; 0 means unlimited (the default)
+  void setCacheLimits(size_t resolutions, size_t points);
+  // Approximates the parameterization of single points (e.g. for eval(uv) in fitting, projection
+  // or picking) by interpolation in the domain mesh of the given resolution (0 turns this off);
+  // see Parameterization::setApproximation and approximationError
+  void setParameterApproximation(size_t resolution);
+  // Statistics of the parameter caches of the domain and of the parameterization
+  CacheStatistics domainCacheStatistics() const;
+  CacheStatistics parameterizationCacheStatistics() const;
+  void setRibbonSampling(size_t samples);
+  // With sampled ribbons, the block evaluation of 3- to 6-sided surfaces of a SurfaceKind
+  // uses a FastEvaluator built in update(), with the same results. On by default.
+  void useFastEvaluator(bool use);
   void setCurve(size_t i, const std::shared_ptr<BSCurve> &curve);
   void setCurves(const CurveVector &curves);
   virtual void setupLoop();
+  // Uses the domain of `other`, and also its parameterization if it has the same mapping
+  // (see Parameterization::sameMapping), so their parameters and tables are computed once;
+  // both should be set up on the same curve objects, with domains of the same type
+  // (throws std::invalid_argument otherwise). Either surface then updates the shared parts;
+  // as these are mutable, the sharing surfaces must not be updated concurrently,
+  // and a change of the curves should be followed by the update of all of them (see LoopContext).
+  virtual void shareDomain(const Surface &other);
   double ribbonMultiplier(size_t i) const;
   void setRibbonMultiplier(size_t i, double m);
   std::optional<Vector3D> ribbonHandler(size_t i) const;
@@ -33,21 +137,145 @@ public:
   void resetRibbon(size_t i);
   virtual void update(size_t i);
   virtual void update();
+  // Changed by each update; unique among all surfaces (but equal in copies), and never 0
+  uint64_t revision() const;
   std::shared_ptr<const Domain> domain() const;
   std::shared_ptr<const Parameterization> parameterization() const;
   std::shared_ptr<const Ribbon> ribbon(size_t i) const;
-  virtual Point3D eval(const Point2D &uv) const = 0;
+  virtual Point3D eval(const Point2D &uv) const;
+  PointVector eval(const Point2DVector &uvs) const;
+  // The same for `size` points read from `uvs` (u and v of each), written to `points`
+  // (x, y and z of each), so e.g. numpy arrays are evaluated in place
+  void eval(const InputBuffer<double> &uvs, size_t size, const OutputBuffer<double> &points) const;
   virtual TriMesh eval(size_t resolution) const;
+  // The points of eval(resolution) with the given vertex indices, read from the parameter table
+  // (without mapping the points again) when eval(resolution) uses one
+  PointVector eval(size_t resolution, const std::vector<size_t> &indices) const;
+  // Also computes unit vertex normals, in the same pass for surfaces with mapped_derivatives_,
+  // and by averaging the triangle normals otherwise
+  TriMesh eval(size_t resolution, VectorVector &normals) const;
+  // Writes the points of eval(resolution), and optionally the unit normals (as in
+  // eval(resolution, normals)) and the domain parameters, in the order of
+  // Domain::parameters(resolution), without building a mesh;
+  // the triangles are given by Domain::meshIndices(resolution)
+  void eval(size_t resolution, const OutputBuffer<double> &points,
+            const OutputBuffer<double> &normals = {},
+            const OutputBuffer<double> &uvs = {}) const;
+  void eval(size_t resolution, const OutputBuffer<float> &points,
+            const OutputBuffer<float> &normals = {}, const OutputBuffer<float> &uvs = {}) const;
+  // The mesh of eval(resolution) converted to single precision block by block, so no double
+  // precision mesh is built; this only converts the output, as the evaluation itself (and all
+  // setup) stays in double precision
+  virtual FloatMesh evalFloat(size_t resolution) const;
+  // Streams the mesh of eval(resolution) to the sink in batches of layers (see Domain::meshLayers),
+  // so memory use is bounded by the batch size, not by the resolution: also the domain parameters
+  // are computed for each batch (see Domain::layerParameters), and nothing is cached.
+  // The points are computed by evalBlock(), without parameter tables or evaluation plans;
+  // surfaces whose mesh is solved as a whole (harmonic and biharmonic) compute all points
+  // first by evalPoints(), so for them only the triangles are bounded.
+  // With `overlap`, the sink is called on a separate thread while the next batch is evaluated;
+  // exceptions thrown by the sink are propagated.
+  void eval(size_t resolution, MeshSink &sink, bool overlap = false) const;
+  // Analytic for surfaces setting mapped_derivatives_, approximated otherwise;
+  // on the boundary these are the limits from the inside of the domain
+  virtual Derivatives evalDerivatives(const Point2D &uv) const;
+  bool analyticDerivatives() const { return mapped_derivatives_; }
+  std::vector<Derivatives> evalDerivatives(const Point2DVector &uvs) const;
+  // The first intersection of the ray with the uniform mesh of the given resolution (evaluated
+  // pointwise), refined on the surface by Newton iterations (kept on the mesh when they leave
+  // the domain or do not converge). The mesh is indexed by a bounding volume hierarchy, cached
+  // until the next update; after an update of the same topology its boxes are only refitted
+  // to the new points. Can be called concurrently.
+  std::optional<RayHit> intersect(const Point3D &origin, const Vector3D &direction,
+                                  size_t resolution = 30) const;
+  // For each point of Domain::parameters(resolution), a mask of the sides (bit i for side i)
+  // whose ribbons and corners enter its value with a weight above the threshold (in absolute
+  // value), e.g. for re-evaluating only the points affected by update(i) (see
+  // IncrementalTessellator); all bits are set for surfaces without blended evaluation
+  // (see blend_type_), and for more than 64 sides
+  std::vector<uint64_t> sideInfluences(size_t resolution, double threshold) const;
+  // Derivatives of the vertices of eval(resolution) with respect to the multiplier and the
+  // (unit) handler of ribbon i, at their current values, for gradient-based optimization.
+  // The surfaces combine their ribbons linearly, and these settings enter the ribbons only by
+  // the central cross-derivative (see RibbonCompatibleWithHandler, the only ribbons using them),
+  // so its three partial derivatives are exact differences, evaluated on a detached copy
+  // at the vertices of sideInfluences(); the chain rule then gives all four parameters.
+  // Empty for other ribbons. For the control points of surfaces linear in them, the derivatives
+  // are the weights of their influences().
+  RibbonJacobian ribbonJacobian(size_t resolution, size_t i) const;
 
 protected:
+  // Blend functions computed before evalBlended() (see blend_type_)
+  enum class BlendType { NONE, CORNER, SIDE_SINGULAR, CORNER_DEFICIENT };
+
   virtual std::shared_ptr<Ribbon> newRibbon() const = 0;
+  // Replaces the mutable parts shared with the original in a fresh clone (see snapshot())
+  virtual void detach();
+  // Updates the domain, and the parameterization when the domain has changed since its last update
+  void updateDomain();
+  // Evaluation given sds = param_->mapToRibbons(uv); surfaces implementing this
+  // should set mapped_eval_, so that eval(resolution) can use parameter tables.
+  // By default this calls evalBlended() with the blends of blend_type_.
+  virtual Point3D evalMapped(const Point2D &uv, const Point2DVector &sds) const;
+  // Evaluation given also the blend functions; surfaces setting blend_type_ implement this
+  // instead of evalMapped(), and then the blends of whole blocks are computed at once
+  virtual Point3D evalBlended(const Point2D &uv, const Point2DVector &sds,
+                              const double *blends) const;
+  // Sides whose data are used by the terms of blend i in evalBlended() (see sideInfluences);
+  // by default those of corner i (sides i and i+1), or side i with BlendType::SIDE_SINGULAR
+  virtual uint64_t blendSides(size_t i) const;
+  // Sides used by the term of the deficiency 1 - sum(blends), if there is one
+  virtual uint64_t deficiencySides() const;
+  // Computes the points of eval(resolution) in the order of Domain::parameters(resolution),
+  // and passes them to store(first, size, points) in blocks, possibly concurrently;
+  // surfaces with their own eval(resolution) override this as well
+  using PointStore = std::function<void(size_t first, size_t size, const Point3D *points)>;
+  virtual void evalPoints(size_t resolution, const PointStore &store) const;
+  // Evaluates a block of points; by default surfaces with mapped evaluation map the whole
+  // block at once, bypassing the cache, and the others call eval(uv) for each point.
+  virtual void evalBlock(const Point2D *uvs, size_t size, Point3D *points) const;
+  // Derivatives given also the gradients of the ribbon parameters by (u, v),
+  // as computed by param_->mapToRibbonsDerivatives(); see also mapped_derivatives_
+  virtual Derivatives evalMappedDerivatives(const Point2D &uv, const Point2DVector &sds,
+                                            const Vector2DVector &ds,
+                                            const Vector2DVector &dd) const;
+  // Finite difference approximation of the derivatives: central differences,
+  // and one-sided ones from the inside where a step would leave the domain
+  Derivatives evalDerivativesNumerically(const Point2D &uv) const;
   Point3D cornerCorrection(size_t i, double s1, double s2) const;
   Point3D sideInterpolant(size_t i, double si, double di) const;
   Point3D cornerInterpolant(size_t i, const Point2DVector &sds) const;
   Point3D cornerInterpolantD(size_t i, const Point2DVector &sds) const;
-  DoubleVector blendCorner(const Point2DVector &sds) const;
-  DoubleVector blendSideSingular(const Point2DVector &sds) const;
-  DoubleVector blendCornerDeficient(const Point2DVector &sds) const;
+  // The blend functions overwrite `blf`, so (thread-local) scratch storage can be reused
+  void blendCorner(const Point2DVector &sds, DoubleVector &blf) const;
+  void blendSideSingular(const Point2DVector &sds, DoubleVector &blf) const;
+  void blendCornerDeficient(const Point2DVector &sds, DoubleVector &blf) const;
+  // Versions of the above for `size` points, with the parameters and the blends in rows of n_
+  // (as in ParameterTable); the inner loops run over the points of a block, x^-2 is computed
+  // as a reciprocal and the boundary cases are selected per point, so these vectorize
+  void blendCorner(const Point2D *sds, size_t size, double *blf) const;
+  void blendSideSingular(const Point2D *sds, size_t size, double *blf) const;
+  void blendCornerDeficient(const Point2D *sds, size_t size, double *blf) const;
+  // Versions of the above with derivatives, given the gradients of the parameters
+  Derivatives cornerCorrection(size_t i, double s1, double s2,
+                               const Vector2D &ds1, const Vector2D &ds2) const;
+  Derivatives sideInterpolant(size_t i, double si, double di,
+                              const Vector2D &dsi, const Vector2D &ddi) const;
+  Derivatives cornerInterpolant(size_t i, const Point2DVector &sds,
+                                const Vector2DVector &ds, const Vector2DVector &dd) const;
+  void blendCorner(const Point2DVector &sds, const Vector2DVector &ds, const Vector2DVector &dd,
+                   DoubleVector &blf, Vector2DVector &dblf) const;
+  void blendSideSingular(const Point2DVector &sds, const Vector2DVector &ds,
+                         const Vector2DVector &dd, DoubleVector &blf, Vector2DVector &dblf) const;
+  void blendCornerDeficient(const Point2DVector &sds, const Vector2DVector &ds,
+                            const Vector2DVector &dd, DoubleVector &blf,
+                            Vector2DVector &dblf) const;
+  // Whether a term of evalBlended() with this weight is replaced by corner_centroid_
+  // (see setBlendCutoff)
+  bool negligibleBlend(double blend) const { return std::abs(blend) <= blend_cutoff_; }
+  // Adds `term` multiplied by a blend function with gradient `dblend` to `sum`
+  static void addBlended(Derivatives &sum, const Derivatives &term,
+                         double blend, const Vector2D &dblend);
 
   size_t next(size_t i, size_t j = 1) const { return (i + j) % n_; }
   size_t prev(size_t i, size_t j = 1) const { return (i + n_ - j) % n_; }
@@ -56,20 +284,48 @@ protected:
   std::shared_ptr<Domain> domain_;
   std::shared_ptr<Parameterization> param_;
   std::vector<std::shared_ptr<Ribbon>> ribbons_;
+  bool mapped_eval_, mapped_derivatives_, use_tables_, spatial_order_;
+  bool pointwise_mesh_;                 // whether the mesh points are those of eval(uv)
+  BlendType blend_type_;
+  SurfaceKind fast_kind_;               // set by the surfaces whose evalBlended() it describes
+  double blend_cutoff_;
+  Point3D corner_centroid_;
+  Executor executor_;
 
 private:
+  template<size_t N, SurfaceKind K> friend class FastEvaluator;
+  friend std::shared_ptr<const BlockEvaluator> makeFastEvaluator(const Surface &surface);
+  struct PickingCache;
+
   struct CornerData {
     Point3D point;
     Vector3D tangent1, tangent2, twist1, twist2;
   };
 
+  template<typename T>
+  void evalOutputs(size_t resolution, const OutputBuffer<T> &points,
+                   const OutputBuffer<T> &normals, const OutputBuffer<T> &uvs) const;
+  // The points of eval(uvs) in the given order, and the permutation of spatial_order_
+  PointVector evalInOrder(const Point2DVector &uvs) const;
+  std::vector<size_t> spatialOrder(const Point2DVector &uvs) const;
+  // Evaluates `size` points, given their ribbon parameters in rows of n_
+  void evalMappedBlock(const Point2D *uvs, const Point2D *sds, size_t size, Point3D *points) const;
+  void blendBlock(const Point2D *sds, size_t size, double *blf) const;
+  void invalidatePicking();
   void updateCorner(size_t i);
-  void updateCorners();
+  void updateRibbons(const std::vector<bool> &modified);
   double gamma(double d) const;
+  double gammaDerivative(double d) const;
   static Vector3D rationalTwist(double u, double v, const Vector3D &f, const Vector3D &g);
 
   std::vector<CornerData> corner_data_;
   bool use_gamma_;
+  size_t ribbon_samples_;
+  bool use_fast_eval_;
+  std::shared_ptr<const BlockEvaluator> fast_eval_; // rebuilt in each update
+  Executor update_executor_;
+  std::shared_ptr<PickingCache> picking_; // replaced in each update, as copies share it
+  uint64_t revision_;
 };
 
 } // namespace Transfinite
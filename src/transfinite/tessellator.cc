@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "domain.hh"
+#include "ribbon-compatible-with-handler.hh"
+#include "ribbon.hh"
+#include "surface.hh"
+#include "tessellator.hh"
+
+namespace Transfinite {
+
+// Marks edges that were tested, but not split
+static const size_t none = std::numeric_limits<size_t>::max();
+
+Tessellator::Tessellator()
+  : resolution_(4), max_depth_(8), tolerance_(1.0e-3), max_angle_(M_PI) {
+}
+
+void
+Tessellator::setInitialResolution(size_t resolution) {
+  resolution_ = std::max<size_t>(resolution, 1);
+}
+
+void
+Tessellator::setChordTolerance(double tolerance) {
+  tolerance_ = tolerance;
+}
+
+void
+Tessellator::setMaxAngle(double angle) {
+  max_angle_ = angle;
+}
+
+void
+Tessellator::setMaxDepth(size_t depth) {
+  max_depth_ = depth;
+}
+
+TriMesh
+Tessellator::eval(const Surface &surface) const {
+  VectorVector normals;
+  return tessellate(surface, max_angle_ < M_PI, normals);
+}
+
+TriMesh
+Tessellator::eval(const Surface &surface, VectorVector &normals) const {
+  return tessellate(surface, true, normals);
+}
+
+TriMesh
+Tessellator::tessellate(const Surface &surface, bool with_normals, VectorVector &normals) const {
+  auto domain = surface.domain();
+  bool check_angles = max_angle_ < M_PI;
+  double min_cos = std::cos(max_angle_);
+
+  // Initial uniform mesh
+  auto shared_uvs = domain->sharedParameters(resolution_);
+  const Point2DVector &uvs = *shared_uvs;
+  auto boundary = domain->meshBoundary(resolution_);
+  const auto &on_edge = boundary->on_edge;
+  std::vector<Vertex> vertices(uvs.size());
+  for (size_t i = 0; i < uvs.size(); ++i) {
+    vertices[i].uv = uvs[i];
+    vertices[i].boundary = on_edge[i];
+  }
+  evalVertices(surface, with_normals, vertices);
+  TriMesh topology = domain->meshTopology(resolution_);
+  std::vector<Triangle> triangles(topology.triangles().begin(), topology.triangles().end());
+
+  // Each round tests the edges created by the previous one;
+  // triangles with no split edges are final, as the decisions do not change later
+  std::unordered_map<Edge, size_t, EdgeHash> splits;
+  std::vector<Triangle> final_triangles;
+  for (size_t depth = 0; depth < max_depth_ && !triangles.empty(); ++depth) {
+    std::vector<Edge> edges;
+    std::vector<Vertex> midpoints;
+    for (const auto &t : triangles)
+      for (size_t j = 0; j < 3; ++j) {
+        Edge e = std::minmax(t[j], t[(j+1)%3]);
+        if (!splits.emplace(e, none).second)
+          continue;
+        const Vertex &a = vertices[e.first], &b = vertices[e.second];
+        Vertex m;
+        m.uv = (a.uv + b.uv) / 2.0;
+        m.boundary = a.boundary && b.boundary && surface.domain()->onBoundary(m.uv);
+        edges.push_back(e);
+        midpoints.push_back(m);
+      }
+    evalVertices(surface, with_normals, midpoints);
+
+    bool changed = false;
+    for (size_t k = 0; k < edges.size(); ++k) {
+      const Vertex &a = vertices[edges[k].first], &b = vertices[edges[k].second];
+      const Vertex &m = midpoints[k];
+      bool split = (m.point - (a.point + b.point) / 2.0).norm() > tolerance_;
+      // Normals across patch boundaries may differ, so only the chord error is tested there
+      if (!split && check_angles && !m.boundary)
+        split = a.normal * b.normal < min_cos;
+      if (split) {
+        splits[edges[k]] = vertices.size();
+        vertices.push_back(m);
+        changed = true;
+      }
+    }
+    if (!changed)
+      break;
+
+    std::vector<Triangle> refined;
+    for (const auto &t : triangles) {
+      std::array<size_t, 3> mids;
+      for (size_t j = 0; j < 3; ++j)
+        mids[j] = splits[std::minmax(t[j], t[(j+1)%3])];
+      if (std::all_of(mids.begin(), mids.end(), [](size_t m) { return m == none; }))
+        final_triangles.push_back(t);
+      else
+        splitTriangle(t, mids, vertices, refined);
+    }
+    triangles.swap(refined);
+  }
+  final_triangles.insert(final_triangles.end(), triangles.begin(), triangles.end());
+
+  TriMesh mesh;
+  mesh.resizePoints(vertices.size());
+  normals.resize(with_normals ? vertices.size() : 0);
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    mesh[i] = vertices[i].point;
+    if (with_normals)
+      normals[i] = vertices[i].normal;
+  }
+  for (const auto &t : final_triangles)
+    mesh.addTriangle(t[0], t[1], t[2]);
+  return mesh;
+}
+
+void
+Tessellator::evalVertices(const Surface &surface, bool with_normals,
+                          std::vector<Vertex> &vertices) {
+  Point2DVector uvs;
+  uvs.reserve(vertices.size());
+  for (const auto &v : vertices)
+    uvs.push_back(v.uv);
+  if (with_normals) {
+    auto ders = surface.evalDerivatives(uvs);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      vertices[i].point = ders[i].point;
+      vertices[i].normal = (ders[i].du ^ ders[i].dv).normalize();
+    }
+  } else {
+    auto points = surface.eval(uvs);
+    for (size_t i = 0; i < vertices.size(); ++i)
+      vertices[i].point = points[i];
+  }
+}
+
+// Red-green refinement: a triangle with split edges is divided into 2, 3 or 4 by the midpoints of its split edges,
+// keeping the orientation; of the two possible diagonals, the shorter one is used
+void
+Tessellator::splitTriangle(const Triangle &t, const std::array<size_t, 3> &mids,
+                           const std::vector<Vertex> &vertices, std::vector<Triangle> &result) {
+  size_t count = std::count_if(mids.begin(), mids.end(), [](size_t m) { return m != none; });
+  if (count == 3) {
+    result.push_back({t[0], mids[0], mids[2]});
+    result.push_back({mids[0], t[1], mids[1]});
+    result.push_back({mids[2], mids[1], t[2]});
+    result.push_back({mids[0], mids[1], mids[2]});
+    return;
+  }
+
+  // Rotate such that edge (a, b) is split, and edge (c, a) is not
+  size_t r = 0;
+  while (mids[r] == none || mids[(r+2)%3] != none)
+    ++r;
+  size_t a = t[r], b = t[(r+1)%3], c = t[(r+2)%3], m0 = mids[r], m1 = mids[(r+1)%3];
+  if (count == 1) {
+    result.push_back({a, m0, c});
+    result.push_back({m0, b, c});
+    return;
+  }
+  result.push_back({m0, b, m1});
+  auto length = [&](size_t i, size_t j) { return (vertices[i].uv - vertices[j].uv).normSqr(); };
+  if (length(a, m1) < length(m0, c)) {
+    result.push_back({a, m0, m1});
+    result.push_back({a, m1, c});
+  } else {
+    result.push_back({a, m0, c});
+    result.push_back({m0, m1, c});
+  }
+}
+
+
+// Number of points evaluated between checks of the time budget
+static const size_t progressive_block_size = 1024;
+
+ProgressiveTessellator::ProgressiveTessellator(const std::shared_ptr<const Surface> &surface,
+                                               size_t resolution)
+  : surface_(surface), initial_resolution_(std::max<size_t>(resolution, 1)) {
+  reset();
+}
+
+void
+ProgressiveTessellator::reset() {
+  resolution_ = initial_resolution_;
+  mesh_ = surface_->eval(resolution_);
+  next_points_.clear();
+  next_indices_.clear();
+}
+
+size_t
+ProgressiveTessellator::resolution() const {
+  return resolution_;
+}
+
+const TriMesh &
+ProgressiveTessellator::mesh() const {
+  return mesh_;
+}
+
+bool
+ProgressiveTessellator::refine(std::chrono::steady_clock::duration budget) {
+  auto start = std::chrono::steady_clock::now();
+  if (next_points_.empty())
+    startLevel();
+
+  auto shared_uvs = surface_->domain()->sharedParameters(2 * resolution_);
+  const Point2DVector &uvs = *shared_uvs;
+  Point2DVector block;
+  do {
+    size_t end = std::min(next_evaluated_ + progressive_block_size, next_indices_.size());
+    block.clear();
+    for (size_t i = next_evaluated_; i < end; ++i)
+      block.push_back(uvs[next_indices_[i]]);
+    PointVector points = surface_->eval(block);
+    for (size_t i = next_evaluated_; i < end; ++i)
+      next_points_[next_indices_[i]] = points[i - next_evaluated_];
+    next_evaluated_ = end;
+  } while (next_evaluated_ < next_indices_.size() &&
+           std::chrono::steady_clock::now() - start < budget);
+  if (next_evaluated_ < next_indices_.size())
+    return false;
+
+  resolution_ *= 2;
+  mesh_ = surface_->domain()->meshTopology(resolution_);
+  mesh_.setPoints(next_points_);
+  next_points_.clear();
+  next_indices_.clear();
+  return true;
+}
+
+void
+ProgressiveTessellator::refine() {
+  refine(std::chrono::steady_clock::duration::max());
+}
+
+// Copies the known points into the next level, and collects the missing ones
+void
+ProgressiveTessellator::startLevel() {
+  auto domain = surface_->domain();
+  size_t size = domain->parameters(2 * resolution_).size();
+  std::vector<bool> known(size, false);
+  next_points_.resize(size);
+  auto nested = domain->nestedIndices(resolution_);
+  const PointVector &points = mesh_.points();
+  for (size_t i = 0; i < nested.size(); ++i) {
+    next_points_[nested[i]] = points[i];
+    known[nested[i]] = true;
+  }
+  for (size_t i = 0; i < size; ++i)
+    if (!known[i])
+      next_indices_.push_back(i);
+  next_evaluated_ = 0;
+}
+
+IncrementalTessellator::IncrementalTessellator(const std::shared_ptr<const Surface> &surface,
+                                               size_t resolution, double threshold)
+  : surface_(surface), resolution_(resolution), threshold_(threshold) {
+  reset();
+}
+
+void
+IncrementalTessellator::reset() {
+  mesh_ = surface_->eval(resolution_);
+  uvs_ = surface_->domain()->sharedParameters(resolution_);
+  influences_ = surface_->sideInfluences(resolution_, threshold_);
+  changed_.resize(uvs_->size());
+  std::iota(changed_.begin(), changed_.end(), 0);
+  ranges_ = { { 0, uvs_->size() } };
+}
+
+const TriMesh &
+IncrementalTessellator::mesh() const {
+  return mesh_;
+}
+
+// The mask of the ribbons updated with ribbon i is as in Surface::updateRibbons()
+const std::vector<IncrementalTessellator::Range> &
+IncrementalTessellator::update(size_t i) {
+  if (surface_->domain()->sharedParameters(resolution_) != uvs_) {
+    reset();
+    return ranges_;
+  }
+
+  size_t n = surface_->domain()->size();
+  uint64_t updated = ~uint64_t(0);
+  if (n <= 64) {
+    updated = 0;
+    for (size_t j = 0; j < n; ++j) {
+      size_t distance = std::min((i + n - j) % n, (j + n - i) % n);
+      if (distance <= std::min(surface_->ribbon(j)->dependencyRange(), n / 2))
+        updated |= uint64_t(1) << j;
+    }
+  }
+  changed_.clear();
+  for (size_t k = 0; k < influences_.size(); ++k)
+    if (influences_[k] & updated)
+      changed_.push_back(k);
+  evalChanged();
+
+  ranges_.clear();
+  for (size_t k : changed_)
+    if (!ranges_.empty() && ranges_.back().second == k)
+      ranges_.back().second++;
+    else
+      ranges_.emplace_back(k, k + 1);
+  return ranges_;
+}
+
+const std::vector<size_t> &
+IncrementalTessellator::changed() const {
+  return changed_;
+}
+
+void
+IncrementalTessellator::evalChanged() {
+  PointVector points = surface_->eval(resolution_, changed_);
+  for (size_t k = 0; k < changed_.size(); ++k)
+    mesh_[changed_[k]] = points[k];
+}
+
+RibbonEditTessellator::RibbonEditTessellator(const std::shared_ptr<const Surface> &surface,
+                                             size_t resolution)
+  : surface_(surface), resolution_(resolution) {
+  reset();
+}
+
+void
+RibbonEditTessellator::reset() {
+  mesh_ = surface_->eval(resolution_);
+  ribbons_.assign(surface_->domain()->size(), RibbonData());
+  for (size_t i = 0; i < ribbons_.size(); ++i)
+    if (auto ribbon =
+        std::dynamic_pointer_cast<const RibbonCompatibleWithHandler>(surface_->ribbon(i))) {
+      ribbons_[i].central = ribbon->central();
+      ribbons_[i].direction = ribbon->direction();
+      ribbons_[i].scale = ribbon->scale();
+    }
+}
+
+const TriMesh &
+RibbonEditTessellator::mesh() const {
+  return mesh_;
+}
+
+const std::vector<size_t> &
+RibbonEditTessellator::update(size_t i) {
+  static const std::vector<size_t> none;
+  auto ribbon = std::dynamic_pointer_cast<const RibbonCompatibleWithHandler>(surface_->ribbon(i));
+  if (!ribbon)
+    return none;
+  RibbonData &data = ribbons_[i];
+  if (!data.computed) {
+    auto jacobian = surface_->ribbonJacobian(resolution_, i);
+    data.vertices = jacobian.vertices;
+    data.derivatives = jacobian.central;
+    data.computed = true;
+  }
+
+  auto handler = ribbon->handler();
+  Vector3D direction = handler ? *handler : data.direction;
+  Vector3D central = direction * ribbon->multiplier() * data.scale;
+  Vector3D delta = central - data.central;
+  for (size_t j = 0; j < data.vertices.size(); ++j) {
+    const auto &d = data.derivatives[j];
+    mesh_[data.vertices[j]] += d[0] * delta[0] + d[1] * delta[1] + d[2] * delta[2];
+  }
+  data.central = central;
+  return data.vertices;
+}
+
+} // namespace Transfinite
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "geometry.hh"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <memory>
+
+namespace Transfinite {
+
+using namespace Geometry;
+
+class Surface;
+
+// Adaptive tessellation of a surface (evaluated through its own executor).
+// Starting from the uniform mesh of the given resolution, edges are bisected in the domain
+// while the surface at their midpoint deviates from the chord by more than the tolerance,
+// or the normals at their ends enclose a larger angle than allowed.
+// The decisions are made per edge, so the refined mesh has no T-junctions.
+// Boundary edges are tested only by the chord error, which depends on the boundary curve alone,
+// so adjacent patches with the same initial resolution are split identically along shared curves.
+class Tessellator {
+public:
+  Tessellator();
+  void setInitialResolution(size_t resolution);
+  void setChordTolerance(double tolerance);
+  void setMaxAngle(double angle); // in radians; the default (pi) disables the criterion
+  void setMaxDepth(size_t depth);
+  TriMesh eval(const Surface &surface) const;
+  TriMesh eval(const Surface &surface, VectorVector &normals) const;
+
+private:
+  struct Vertex {
+    Point2D uv;
+    Point3D point;
+    Vector3D normal;
+    bool boundary;
+  };
+  using Edge = std::pair<size_t, size_t>;
+  struct EdgeHash {
+    size_t operator()(const Edge &e) const {
+      return std::hash<size_t>()(e.first) ^ (std::hash<size_t>()(e.second) * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+  using Triangle = std::array<size_t, 3>;
+
+  TriMesh tessellate(const Surface &surface, bool with_normals, VectorVector &normals) const;
+  static void evalVertices(const Surface &surface, bool with_normals,
+                           std::vector<Vertex> &vertices);
+  static void splitTriangle(const Triangle &t, const std::array<size_t, 3> &mids,
+                            const std::vector<Vertex> &vertices, std::vector<Triangle> &result);
+
+  size_t resolution_, max_depth_;
+  double tolerance_, max_angle_;
+};
+
+// Progressive uniform tessellation, for showing a coarse mesh at once and refining it later.
+// Each level doubles the resolution, so it contains all points of the previous one
+// (see Domain::nestedIndices), and only the new points are evaluated.
+// The work on a level can be spread over several calls, each limited by a time budget.
+// After the surface has changed, reset() starts again from the initial resolution.
+class ProgressiveTessellator {
+public:
+  ProgressiveTessellator(const std::shared_ptr<const Surface> &surface, size_t resolution = 4);
+  void reset();
+  size_t resolution() const;
+  const TriMesh &mesh() const;
+  // Evaluates points of the next level for about `budget` (but at least one block);
+  // returns true when the level is complete, and mesh() has been replaced by it
+  bool refine(std::chrono::steady_clock::duration budget);
+  void refine();
+
+private:
+  void startLevel();
+
+  std::shared_ptr<const Surface> surface_;
+  size_t initial_resolution_, resolution_;
+  TriMesh mesh_;
+  PointVector next_points_;
+  std::vector<size_t> next_indices_; // points of the next level still to be evaluated
+  size_t next_evaluated_;
+};
+
+// Uniform tessellation kept up to date after edits of single sides (see Surface::update(i)).
+// The side influences of the vertices (see Surface::sideInfluences) are computed with the first
+// mesh, and after an update of side i only the vertices depending on the ribbons updated with it
+// are evaluated again. Vertices with smaller weights than the threshold keep their positions,
+// so they can be off by about the threshold times the change of the ribbons.
+// When the domain has changed, the whole mesh is evaluated again.
+class IncrementalTessellator {
+public:
+  using Range = std::pair<size_t, size_t>; // [first, last) of vertex indices
+
+  IncrementalTessellator(const std::shared_ptr<const Surface> &surface, size_t resolution,
+                         double threshold = 1.0e-8);
+  // Evaluates the whole mesh again (e.g. after changes of more than one side)
+  void reset();
+  const TriMesh &mesh() const;
+  // Should be called after surface->update(i); returns the changed vertices as increasing,
+  // maximal ranges of consecutive indices (e.g. for partial updates of a vertex buffer)
+  const std::vector<Range> &update(size_t i);
+  // The vertices evaluated again by the last update, in increasing order
+  const std::vector<size_t> &changed() const;
+
+private:
+  void evalChanged();
+
+  std::shared_ptr<const Surface> surface_;
+  size_t resolution_;
+  double threshold_;
+  TriMesh mesh_;
+  std::shared_ptr<const Point2DVector> uvs_; // to detect changes of the domain
+  std::vector<uint64_t> influences_;
+  std::vector<size_t> changed_;
+  std::vector<Range> ranges_;
+};
+
+// Uniform tessellation kept up to date while dragging the multiplier or the handler of a ribbon.
+// The patch is affine in the central cross-derivative of each ribbon (see
+// Surface::ribbonJacobian), so the derivatives of the vertices with respect to it are kept
+// (three vectors for each vertex depending on the ribbon), and an edit moves only those vertices,
+// by the derivatives times the change of the central cross-derivative; neither the surface
+// nor its curves and frames are evaluated. The derivatives of a ribbon are computed at its first
+// edit (by three evaluations of those vertices); the mesh is exact up to rounding as long as
+// only multipliers and handlers change, and after other changes (also resetRibbon) reset()
+// evaluates it again.
+class RibbonEditTessellator {
+public:
+  RibbonEditTessellator(const std::shared_ptr<const Surface> &surface, size_t resolution);
+  void reset();
+  const TriMesh &mesh() const;
+  // Should be called after surface->setRibbonMultiplier(i, ...) or setRibbonHandler(i, ...),
+  // before or after surface->update(i); returns the moved vertices, in increasing order
+  const std::vector<size_t> &update(size_t i);
+
+private:
+  struct RibbonData {
+    bool computed = false;
+    std::vector<size_t> vertices;
+    std::vector<std::array<Vector3D, 3>> derivatives;
+    Vector3D central, direction; // in the mesh, and the handler direction of its update
+    double scale;
+  };
+
+  std::shared_ptr<const Surface> surface_;
+  size_t resolution_;
+  TriMesh mesh_;
+  std::vector<RibbonData> ribbons_;
+};
+
+} // namespace Transfinite
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <numeric>
 
 #include "utilities.hh"
 
@@ -36,15 +39,27 @@ binomial(size_t n, size_t k) {
 double
 hermite(int i, double t) {
   switch(i) {
-  case 0: return std::pow(1 - t, 3) + 3.0 * std::pow(1 - t, 2) * t;
-  case 1: return std::pow(1 - t, 2) * t;
-  case 2: return (1 - t) * std::pow(t, 2);
-  case 3: return 3.0 * (1 - t) * std::pow(t, 2) + std::pow(t, 3);
+  case 0: return hermite<0>(t);
+  case 1: return hermite<1>(t);
+  case 2: return hermite<2>(t);
+  case 3: return hermite<3>(t);
   default: ;
   }
   return -1.0;                  // should not come here
 }
 
+double
+hermiteDerivative(int i, double t) {
+  switch(i) {
+  case 0: return hermiteDerivative<0>(t);
+  case 1: return hermiteDerivative<1>(t);
+  case 2: return hermiteDerivative<2>(t);
+  case 3: return hermiteDerivative<3>(t);
+  default: ;
+  }
+  return 0.0;                   // should not come here
+}
+
 void
 bernstein(size_t n, double u, DoubleVector &coeff) {
   coeff.clear(); coeff.reserve(n + 1);
@@ -61,6 +76,20 @@ bernstein(size_t n, double u, DoubleVector &coeff) {
   }
 }
 
+void
+bernstein(size_t n, double u, DoubleVector &coeff, DoubleVector &deriv) {
+  deriv.assign(n + 1, 0.0);
+  if (n > 0) {
+    // Computed from the polynomials of degree n - 1, left in `coeff` temporarily
+    bernstein(n - 1, u, coeff);
+    for (size_t j = 0; j < n; ++j) {
+      deriv[j] -= coeff[j] * n;
+      deriv[j+1] += coeff[j] * n;
+    }
+  }
+  bernstein(n, u, coeff);
+}
+
 double
 bernstein(size_t i, size_t n, double u) {
   DoubleVector tmp(n + 1, 0.0);
@@ -72,6 +101,41 @@ bernstein(size_t i, size_t n, double u) {
   return tmp[n];
 }
 
+namespace {
+
+  template<size_t N>
+  void storeBernstein(double u, double *coeff) {
+    auto values = bernstein<N>(u);
+    std::copy(values.begin(), values.end(), coeff);
+  }
+
+}
+
+void
+bernstein(size_t n, double u, double *coeff) {
+  switch (n) {
+  case 3: storeBernstein<3>(u, coeff); return;
+  case 4: storeBernstein<4>(u, coeff); return;
+  case 5: storeBernstein<5>(u, coeff); return;
+  case 6: storeBernstein<6>(u, coeff); return;
+  case 7: storeBernstein<7>(u, coeff); return;
+  case 8: storeBernstein<8>(u, coeff); return;
+  case 9: storeBernstein<9>(u, coeff); return;
+  default: ;
+  }
+  coeff[0] = 1.0;
+  const double u1 = 1.0 - u;
+  for (size_t j = 1; j <= n; ++j) {
+    double saved = 0.0;
+    for (size_t k = 0; k < j; ++k) {
+      double tmp = coeff[k];
+      coeff[k] = saved + tmp * u1;
+      saved = tmp * u;
+    }
+    coeff[j] = saved;
+  }
+}
+
 void
 bezierElevate(PointVector &cpts) {
   size_t n = cpts.size();
@@ -83,4 +147,122 @@ bezierElevate(PointVector &cpts) {
   cpts.push_back(tmp);
 }
 
+// The basis function derivatives are computed as in The NURBS Book, Algorithm A2.3
+Point3D
+evalCurve(const BSCurve &curve, double u, size_t nder, Vector3D *der) {
+  static const size_t max_degree = 15, max_nder = 3;
+  const auto &basis = curve.basis();
+  size_t p = basis.degree();
+  if (p > max_degree || nder > max_nder) {
+    thread_local VectorVector result;
+    curve.eval(u, nder, result);
+    std::copy_n(result.begin(), nder + 1, der);
+    return der[0];
+  }
+
+  // Span index as in BSBasis::findSpan
+  const DoubleVector &knots = basis.knots();
+  size_t n = knots.size() - p - 2, span;
+  if (u >= knots[n+1])
+    span = n;
+  else if (u <= knots[p])
+    span = p;
+  else
+    span = std::upper_bound(knots.begin() + p, knots.begin() + n + 1, u) - knots.begin() - 1;
+
+  double ndu[max_degree+1][max_degree+1], left[max_degree+1], right[max_degree+1];
+  ndu[0][0] = 1.0;
+  for (size_t j = 1; j <= p; ++j) {
+    left[j] = u - knots[span+1-j];
+    right[j] = knots[span+j] - u;
+    double saved = 0.0;
+    for (size_t r = 0; r < j; ++r) {
+      ndu[j][r] = right[r+1] + left[j-r];
+      double tmp = ndu[j][r] == 0 ? 0 : ndu[r][j-1] / ndu[j][r];
+      ndu[r][j] = saved + tmp * right[r+1];
+      saved = tmp * left[j-r];
+    }
+    ndu[j][j] = saved;
+  }
+
+  size_t nd = std::min(nder, p);
+  double ders[max_nder+1][max_degree+1], a[2][max_degree+1];
+  for (size_t j = 0; j <= p; ++j)
+    ders[0][j] = ndu[j][p];
+  for (size_t r = 0; r <= p; ++r) {
+    size_t s1 = 0, s2 = 1;
+    a[0][0] = 1.0;
+    for (size_t k = 1; k <= nd; ++k) {
+      double d = 0.0;
+      int rk = (int)r - (int)k, pk = (int)p - (int)k;
+      if (r >= k) {
+        a[s2][0] = ndu[pk+1][rk] == 0 ? 0 : a[s1][0] / ndu[pk+1][rk];
+        d = a[s2][0] * ndu[rk][pk];
+      }
+      size_t j1 = rk >= -1 ? 1 : -rk, j2 = (int)r - 1 <= pk ? k - 1 : p - r;
+      for (size_t j = j1; j <= j2; ++j) {
+        a[s2][j] = ndu[pk+1][rk+j] == 0 ? 0 : (a[s1][j] - a[s1][j-1]) / ndu[pk+1][rk+j];
+        d += a[s2][j] * ndu[rk+j][pk];
+      }
+      if ((int)r <= pk) {
+        a[s2][k] = ndu[pk+1][r] == 0 ? 0 : -a[s1][k-1] / ndu[pk+1][r];
+        d += a[s2][k] * ndu[r][pk];
+      }
+      ders[k][r] = d;
+      std::swap(s1, s2);
+    }
+  }
+
+  const PointVector &cp = curve.controlPoints();
+  double factor = 1.0;
+  for (size_t k = 0; k <= nder; ++k) {
+    der[k] = Vector3D(0, 0, 0);
+    if (k > nd)
+      continue;
+    for (size_t j = 0; j <= p; ++j)
+      der[k] += cp[span-p+j] * (ders[k][j] * factor);
+    factor *= p - k;
+  }
+  return der[0];
+}
+
+namespace {
+
+  // Spreads the lower 16 bits of x to the even bits
+  uint32_t spreadBits(uint32_t x) {
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+  }
+
+}
+
+std::vector<size_t>
+mortonOrder(const Point2DVector &points) {
+  std::vector<size_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (points.empty())
+    return order;
+  Point2D min = points[0], max = points[0];
+  for (const auto &p : points)
+    for (size_t k = 0; k < 2; ++k) {
+      min[k] = std::min(min[k], p[k]);
+      max[k] = std::max(max[k], p[k]);
+    }
+  double size = std::max(max[0] - min[0], max[1] - min[1]);
+  double scale = size > 0 ? 65535.0 / size : 0.0;
+  std::vector<uint32_t> codes(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    auto x = (uint32_t)((points[i][0] - min[0]) * scale);
+    auto y = (uint32_t)((points[i][1] - min[1]) * scale);
+    codes[i] = spreadBits(x) | (spreadBits(y) << 1);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t i, size_t j) { return codes[i] < codes[j]; });
+  return order;
+}
+
 } // namespace Transfinite
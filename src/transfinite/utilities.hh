@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <vector>
+
 #include "geometry.hh"
 
 namespace Transfinite {
@@ -14,9 +17,68 @@ double inrange(double min, double x, double max);
 size_t binomial(size_t n, size_t k);
 
 double hermite(int i, double t);
+double hermiteDerivative(int i, double t);
+
+// Compile-time versions of hermite(i, t) and hermiteDerivative(i, t)
+template<int I>
+constexpr double hermite(double t) {
+  static_assert(I >= 0 && I < 4, "cubic Hermite basis functions are indexed 0-3");
+  if constexpr (I == 0)
+    return (1 - t) * (1 - t) * (1 - t) + 3.0 * (1 - t) * (1 - t) * t;
+  else if constexpr (I == 1)
+    return (1 - t) * (1 - t) * t;
+  else if constexpr (I == 2)
+    return (1 - t) * t * t;
+  else
+    return 3.0 * (1 - t) * t * t + t * t * t;
+}
+
+template<int I>
+constexpr double hermiteDerivative(double t) {
+  static_assert(I >= 0 && I < 4, "cubic Hermite basis functions are indexed 0-3");
+  if constexpr (I == 0)
+    return -6.0 * (1 - t) * t;
+  else if constexpr (I == 1)
+    return (1 - t) * (1 - 3.0 * t);
+  else if constexpr (I == 2)
+    return t * (2 - 3.0 * t);
+  else
+    return 6.0 * (1 - t) * t;
+}
 
 void bernstein(size_t n, double u, DoubleVector &coeff);
+void bernstein(size_t n, double u, DoubleVector &coeff, DoubleVector &deriv);
 double bernstein(size_t i, size_t n, double u);
+// Stores the Bernstein polynomials of degree n at u in coeff[0..n] (without allocation);
+// uses the fixed-degree version below for degrees 3-9
+void bernstein(size_t n, double u, double *coeff);
+
+// Bernstein polynomials of degree N, computed as in bernstein(n, u, coeff)
+template<size_t N>
+constexpr std::array<double, N + 1> bernstein(double u) {
+  std::array<double, N + 1> coeff{};
+  coeff[0] = 1.0;
+  const double u1 = 1.0 - u;
+  for (size_t j = 1; j <= N; ++j) {
+    double saved = 0.0;
+    for (size_t k = 0; k < j; ++k) {
+      double tmp = coeff[k];
+      coeff[k] = saved + tmp * u1;
+      saved = tmp * u;
+    }
+    coeff[j] = saved;
+  }
+  return coeff;
+}
+
 void bezierElevate(PointVector &cpts);
 
+// The point and derivatives 1..nder (nder <= 3) of the curve at u, as curve.eval(u, nder, der),
+// stored in der[0..nder]; without heap allocation for degrees up to 15 (evaluated by libgeom above)
+Point3D evalCurve(const BSCurve &curve, double u, size_t nder, Vector3D *der);
+
+// Indices of the points in the order of a Z-order (Morton) curve over their bounding box,
+// quantized to a 2^16 x 2^16 grid (ties keep the input order)
+std::vector<size_t> mortonOrder(const Point2DVector &points);
+
 } // namespace Transfinite
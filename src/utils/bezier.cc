@@ -1,44 +1,41 @@
 #include "bezier.hh"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 
 #include "nelder-mead.hh"
 
 namespace Geometry {
 
-BCurve::BCurve() {
+BCurve::BCurve() : n_(0) {
 }
 
 BCurve::BCurve(const PointVector &cpts) : n_(cpts.size() - 1), cp_(cpts)
 {
+  updateDerivatives();
 }
 
 Point3D
 BCurve::eval(double u) const {
-  DoubleVector coeff; bernstein(n_, u, coeff);
-  Point3D p(0.0, 0.0, 0.0);
-  for(size_t k = 0; k <= n_; ++k)
-    p += cp_[k] * coeff[k];
-  return p;
+  return derivative(0, u);
 }
 
 Point3D
 BCurve::eval(double u, size_t nr_der, VectorVector &der) const {
-  size_t const du = std::min(nr_der, n_);
-  der.clear(); der.reserve(nr_der + 1);
-  std::vector<DoubleVector> coeff; bernsteinAll(n_, u, coeff);
-  std::vector<PointVector> dcp; derivativeControlPoints(du, dcp);
-  for(size_t k = 0; k <= du; ++k) {
-    der.push_back(Vector3D(0.0, 0.0, 0.0));
-    for(size_t j = 0; j <= n_ - k; ++j)
-      der[k] += dcp[k][j] * coeff[n_-k][j];
-  }
-  for(size_t k = n_ + 1; k <= nr_der; ++k)
-    der.push_back(Vector3D(0.0, 0.0, 0.0));
+  der.resize(nr_der + 1);
+  for (size_t k = 0; k <= nr_der; ++k)
+    der[k] = k <= n_ ? derivative(k, u) : Vector3D(0.0, 0.0, 0.0);
   return der[0];
 }
 
+void
+BCurve::eval(const DoubleVector &us, PointVector &points) const {
+  points.resize(us.size());
+  for (size_t i = 0; i < us.size(); ++i)
+    points[i] = derivative(0, us[i]);
+}
+
 const PointVector &
 BCurve::controlPoints() const {
   return cp_;
@@ -47,6 +44,7 @@ BCurve::controlPoints() const {
 void
 BCurve::reverse() {
   std::reverse(cp_.begin(), cp_.end());
+  updateDerivatives();
 }
 
 void
@@ -63,26 +61,86 @@ BCurve::arcLength(double from, double to) const {
                                  0.339981044, 0.652145155,
                                  0.861136312, 0.347854845};
 
+  if (n_ == 0)
+    return 0.0;
+
   double sum = 0.0;
   for (size_t i = 0; i < 8; i += 2) {
-    VectorVector der;
     double u = ((to - from) * gauss[i] + from + to) * 0.5;
-    eval(u, 1, der);
-    sum += der[1].norm() * gauss[i+1] * (to - from) * 0.5;
+    sum += derivative(1, u).norm() * gauss[i+1] * (to - from) * 0.5;
   }
 
   return sum;
 }
 
+namespace {
+
+  const double class_a_tolerance = 0.001;
+  const size_t class_a_max_degree = 50;
+  const double pi = 3.14159265358979323846; // M_PI is not standard (see domain.hh)
+
+  // Starting values of (phi, s) tried for each degree, beginning with the plain rotation
+  const std::vector<std::vector<double>> class_a_starts = {
+    { 0, 1 }, { pi / 2, 1 }, { -pi / 2, 1 }, { pi, 1 }
+  };
+
+}
+
 void
 BCurve::fitClassA(size_t degree,
                   const Point3D &pa, const Vector3D &va,
-                  const Point3D &pb, const Vector3D &vb) {
+                  const Point3D &pb, const Vector3D &vb,
+                  const Transfinite::Executor &executor) {
+  // Candidates are ordered by degree, then by starting value
+  std::vector<size_t> degrees = { degree };
+  while (degrees.back() < class_a_max_degree)
+    degrees.push_back(degrees.back() * 2);
+  size_t starts = class_a_starts.size(), size = degrees.size() * starts;
+
+  ClassAEnds ends = { pa, va, pb, vb };
+  std::vector<BCurve> candidates(size);
+  std::atomic<size_t> first_good(size);
+  executor(size, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      auto cancel = [&]() { return first_good.load() < c; };
+      if (cancel())
+        continue;
+      double err = candidates[c].fitClassACandidate(degrees[c / starts], class_a_starts[c % starts],
+                                                    ends, cancel);
+      if (err >= 0 && err <= class_a_tolerance) {
+        size_t current = first_good.load();
+        while (c < current && !first_good.compare_exchange_weak(current, c))
+          ;
+      }
+    }
+  });
+
+  // Without a good candidate, the first start of the highest degree is used
+  size_t best = first_good.load();
+  *this = std::move(candidates[best < size ? best : size - starts]);
+}
+
+std::vector<BCurve>
+BCurve::fitClassA(size_t degree, const std::vector<ClassAEnds> &ends,
+                  const Transfinite::Executor &executor) {
+  std::vector<BCurve> result(ends.size());
+  executor(ends.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      result[i].fitClassA(degree, ends[i].pa, ends[i].va, ends[i].pb, ends[i].vb);
+  });
+  return result;
+}
+
+double
+BCurve::fitClassACandidate(size_t degree, const std::vector<double> &start,
+                           const ClassAEnds &ends, const std::function<bool ()> &cancel) {
+  const Point3D &pa = ends.pa, &pb = ends.pb;
+
   // Initialize values
   n_ = degree;
   cp_.resize(degree + 1);
-  Vector3D v0 = va; v0.normalize();
-  Vector3D v1 = vb; v1.normalize();
+  Vector3D v0 = ends.va; v0.normalize();
+  Vector3D v1 = ends.vb; v1.normalize();
 
   // Generating control points
   auto generateClassA = [this] (const Point3D &p, const Vector3D &v, const Matrix3x3 &M) {
@@ -115,51 +173,18 @@ BCurve::fitClassA(size_t degree,
     setupMatrix(phi_s[0], phi_s[1], M);
     return std::abs(evalMatrix(M));
   };
-  std::vector<double> start = { 0, 1 };
-  NelderMead::optimize(targetFunction, start, 100, 1.0e-15, 1.0);
-  double err = targetFunction(start);        // update to the best value found so far
-  if (err > 0.001 && degree < 50) {
-    fitClassA(degree * 2, pa, va, pb, vb);
-    return;
-  }
+  std::vector<double> phi_s = start;
+  NelderMead::optimize(targetFunction, phi_s, 100, 1.0e-15, 1.0, cancel);
+  if (cancel())
+    return -1.0;
+  double err = targetFunction(phi_s);        // update to the best value found so far
 
   // Postprocessing
   v0 *= (pb - pa).norm() / (cp_[n_] - cp_[0]).norm();
   generateClassA(pa, v0, M);
   cp_[degree] = pb;
-}
-
-void
-BCurve::bernstein(size_t n, double u, DoubleVector &coeff) {
-  coeff.clear(); coeff.reserve(n + 1);
-  coeff.push_back(1.0);
-  double const u1 = 1.0 - u;
-  for(size_t j = 1; j <= n; ++j) {
-    double saved = 0.0;
-    for(size_t k = 0; k < j; ++k) {
-      double const tmp = coeff[k];
-      coeff[k] = saved + tmp * u1;
-      saved = tmp * u;
-    }
-    coeff.push_back(saved);
-  }
-}
-
-void
-BCurve::bernsteinAll(size_t n, double u, std::vector<DoubleVector> &coeff) {
-  coeff.clear(); coeff.resize(n + 1);
-  coeff[0].push_back(1.0);
-  double const u1 = 1.0 - u;
-  for(size_t j = 1; j <= n; ++j) {
-    coeff[j].reserve(j + 1);
-    double saved = 0.0;
-    for(size_t k = 0; k < j; ++k) {
-      double const tmp = coeff[j-1][k];
-      coeff[j].push_back(saved + tmp * u1);
-      saved = tmp * u;
-    }
-    coeff[j].push_back(saved);
-  }
+  updateDerivatives();
+  return err;
 }
 
 void
@@ -174,4 +199,21 @@ BCurve::derivativeControlPoints(size_t d, std::vector<PointVector> &dcp) const {
   }
 }
 
+void
+BCurve::updateDerivatives() {
+  derivativeControlPoints(n_, dcp_);
+}
+
+Vector3D
+BCurve::derivative(size_t k, double u) const {
+  thread_local PointVector tmp;
+  const PointVector &cp = dcp_[k];
+  tmp.assign(cp.begin(), cp.end());
+  const double u1 = 1.0 - u;
+  for (size_t m = tmp.size(); m > 1; --m)
+    for (size_t i = 0; i + 1 < m; ++i)
+      tmp[i] = tmp[i] * u1 + tmp[i+1] * u;
+  return tmp[0];
+}
+
 } // namespace Geometry
@@ -1,11 +1,23 @@
 #pragma once
 
+#include <functional>
+
 #include <geometry.hh>
 
+#include "executor.hh"
+
 namespace Geometry {
 
 class BCurve {
 public:
+  // End conditions of a class-A fit
+  struct ClassAEnds {
+    Point3D pa;
+    Vector3D va;
+    Point3D pb;
+    Vector3D vb;
+  };
+
   // Constructors
   BCurve();
   BCurve(const PointVector &cpts);
@@ -13,6 +25,8 @@ public:
   // Evaluation
   Point3D eval(double u) const;
   Point3D eval(double u, size_t nr_der, VectorVector &der) const;
+  // Evaluates all parameters, reusing the storage of `points`
+  void eval(const DoubleVector &us, PointVector &points) const;
 
   // Coordinates
   const PointVector &controlPoints() const;
@@ -22,18 +36,34 @@ public:
   void normalize();
 
   // Other
+  // Doubles the degree (up to 50) while the end direction has an error above 0.001,
+  // trying several starting values for each degree; the first good candidate in this order
+  // is taken, so the result does not depend on the executor, which runs the candidates
+  // (cancelling those after one that is already good), e.g. threadExecutor(0, 1)
   void fitClassA(size_t degree,
                  const Point3D &pa, const Vector3D &va,
-                 const Point3D &pb, const Vector3D &vb);
+                 const Point3D &pb, const Vector3D &vb,
+                 const Transfinite::Executor &executor = Transfinite::serialExecutor());
+  // Fits of all curves (e.g. of a loop), distributed by the executor
+  static std::vector<BCurve>
+  fitClassA(size_t degree, const std::vector<ClassAEnds> &ends,
+            const Transfinite::Executor &executor = Transfinite::threadExecutor(0, 1));
   double arcLength(double from, double to) const;
 
 private:
-  static void bernstein(size_t n, double u, DoubleVector &coeff);
-  static void bernsteinAll(size_t n, double u, std::vector<DoubleVector> &coeff);
   void derivativeControlPoints(size_t d, std::vector<PointVector> &dcp) const;
+  // One class-A candidate of a fixed degree from the given (phi, s) start; returns the error,
+  // or a negative value when cancelled
+  double fitClassACandidate(size_t degree, const std::vector<double> &start,
+                            const ClassAEnds &ends, const std::function<bool ()> &cancel);
+  // Recomputes dcp_, to be called whenever the control points change
+  void updateDerivatives();
+  // Evaluates the k-th derivative by the de Casteljau algorithm on dcp_[k]
+  Vector3D derivative(size_t k, double u) const;
 
   size_t n_;
   PointVector cp_;
+  std::vector<PointVector> dcp_; // control points of all derivatives, dcp_[0] = cp_
 };
 
 }
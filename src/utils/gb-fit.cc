@@ -1,10 +1,20 @@
+#include <algorithm>
+#include <mutex>
+
+#include "Eigen/Cholesky"
 #include "Eigen/LU"
+#include "Eigen/QR"
 #include "Eigen/SVD"
+#include "Eigen/Sparse"
 
 #include "domain.hh"
+#include "locator.hh"
 
 #include "gb-fit.hh"
 
+// Blends below this are left out of the sparse system
+static const double sparse_weight_threshold = 1.0e-12;
+
 SurfaceGeneralizedBezier elevateDegree(const SurfaceGeneralizedBezier &surf) {
   size_t n = surf.domain()->vertices().size();
   size_t d = surf.degree() + 1;
@@ -65,40 +75,99 @@ SurfaceGeneralizedBezier elevateDegree(const SurfaceGeneralizedBezier &surf) {
   return result;
 }
 
+// The parameter of p projected onto the plane of the triangle, interpolated from its vertices
+// (the first vertex index is `offset` in `params`); also gives the distance of the projection
+static Point2D
+triangleParameter(const PointVector &vertices, const Point2D *params, size_t offset,
+                  const TriMesh::Triangle &tri, const Point3D &p, double &distance) {
+  const Point3D &a = vertices[tri[0]], &b = vertices[tri[1]], &c = vertices[tri[2]];
+  Vector3D n = ((b - a) ^ (c - a)).normalize();
+  Point3D q = p + n * ((a - p) * n);
+  distance = (p - q).norm();
+  double x = ((b - q) ^ (c - q)).norm();
+  double y = ((a - q) ^ (c - q)).norm();
+  double z = ((a - q) ^ (b - q)).norm();
+  return (params[tri[0] - offset] * x + params[tri[1] - offset] * y +
+          params[tri[2] - offset] * z) / (x + y + z);
+}
+
 Point2DVector parameterizePoints(const Surface &surf, const PointVector &points) {
   size_t resolution = 15;
   TriMesh mesh = surf.eval(resolution);
   PointVector vertices = mesh.points();
   const Point2DVector &params = surf.domain()->parameters(resolution);
+  auto closest = TriangleBVH(mesh).closest(points);
   Point2DVector result; result.reserve(points.size());
-  for (const auto &p : points) {
-    TriMesh::Triangle tri = mesh.closestTriangle(p);
-    const Point3D &a = vertices[tri[0]], &b = vertices[tri[1]], &c = vertices[tri[2]];
-    Vector3D n = ((b - a) ^ (c - a)).normalize();
-    Point3D q = p + n * ((a - p) * n);
-    double x = ((b - q) ^ (c - q)).norm();
-    double y = ((a - q) ^ (c - q)).norm();
-    double z = ((a - q) ^ (b - q)).norm();
-    Point2D uv = (params[tri[0]] * x + params[tri[1]] * y + params[tri[2]] * z) / (x + y + z);
-    result.push_back(uv);
+  double distance;
+  for (size_t i = 0; i < points.size(); ++i)
+    result.push_back(triangleParameter(vertices, params.data(), 0, closest[i], points[i],
+                                       distance));
+  return result;
+}
+
+// Gauss-Newton steps towards the closest surface point of each sample, i.e., solving
+//   [Su.Su Su.Sv; Su.Sv Sv.Sv] [du dv]^T = -[Su.r Sv.r]^T, where r = S(u,v) - p;
+// steps leaving the domain are halved, and those not getting closer to the sample are rejected
+Point2DVector correctParameters(const Surface &surf, const PointVector &points,
+                                const Point2DVector &params, size_t iterations) {
+  const Point2DVector &vertices = surf.domain()->vertices();
+  auto inside = [&](const Point2D &uv) {
+    bool result = false;
+    for (size_t i = 0, j = vertices.size() - 1; i < vertices.size(); j = i++) {
+      const Point2D &a = vertices[i], &b = vertices[j];
+      if ((a[1] > uv[1]) != (b[1] > uv[1]) &&
+          uv[0] < (b[0] - a[0]) * (uv[1] - a[1]) / (b[1] - a[1]) + a[0])
+        result = !result;
+    }
+    return result;
+  };
+
+  Point2DVector result = params, next(params.size());
+  for (size_t iteration = 0; iteration < iterations; ++iteration) {
+    auto ders = surf.evalDerivatives(result);
+    for (size_t i = 0; i < result.size(); ++i) {
+      const auto &der = ders[i];
+      Vector3D r = der.point - points[i];
+      double a = der.du * der.du, b = der.du * der.dv, c = der.dv * der.dv;
+      double gu = der.du * r, gv = der.dv * r;
+      double det = a * c - b * b;
+      next[i] = result[i];
+      if (det <= epsilon * a * c)
+        continue;
+      Vector2D step((b * gv - c * gu) / det, (b * gu - a * gv) / det);
+      for (size_t k = 0; k < 10; ++k, step /= 2.0)
+        if (inside(result[i] + step)) {
+          next[i] = result[i] + step;
+          break;
+        }
+    }
+    PointVector moved = surf.eval(next);
+    for (size_t i = 0; i < result.size(); ++i)
+      if ((moved[i] - points[i]).normSqr() < (ders[i].point - points[i]).normSqr())
+        result[i] = next[i];
   }
   return result;
 }
 
-SurfaceGeneralizedBezier fitWithOriginal(const SurfaceGeneralizedBezier &original,
-                                         const PointVector &points,
-                                         const Point2DVector &params,
-                                         double smoothing, size_t fixed_rows) {
+namespace {
+
+// The least squares system of a fit in two blocks: the data terms (one row for each sample),
+// and the smoothing terms for unit smoothing (one row for each movable control point);
+// the columns are the movable control points (0 for the central one, then serial index - bcp),
+// and of triplets with the same position, the last one is valid
+struct FitSystem {
+  size_t bcp, mcp;
+  std::vector<Eigen::Triplet<double>> data, smoothing;
+  Eigen::MatrixXd data_rhs, smoothing_rhs;
+};
+
+}
+
+// Initialize patch with the fixed boundaries
+static SurfaceGeneralizedBezier
+fixedBoundaries(const SurfaceGeneralizedBezier &original) {
   size_t n = original.domain()->vertices().size();
   size_t d = original.degree();
-  size_t l = original.layers();
-  size_t cp = 1 + d / 2;
-  cp = n * cp * l + 1;                                // # of control points
-  size_t bcp = n * (d + 1 - fixed_rows) * fixed_rows; // # of boundary control points
-  size_t mcp = cp - bcp;                              // # of movable control points
-  size_t m = points.size();                           // # of samples
-
-  // Initialize patch with the fixed boundaries
   SurfaceGeneralizedBezier surf;
   surf.initNetwork(n, d);
   for (size_t i = 0; i < n; ++i)
@@ -106,108 +175,315 @@ SurfaceGeneralizedBezier fitWithOriginal(const SurfaceGeneralizedBezier &origina
       for (size_t k = 0; k < 2; ++k)
         surf.setControlPoint(i, j, k, original.controlPoint(i, j, k));
   surf.setupLoop();
+  return surf;
+}
 
-  Eigen::MatrixXd A(m + mcp, mcp);
-  Eigen::MatrixXd b(m + mcp, 3);
-  A.setZero();
-  b.setZero();
-
-  // Fill the matrices
-  for (size_t j = 0; j < m; ++j) {
-    double blend_sum = 0.0;
-    for (size_t i = 1, side = 0, col = 0, row = 0; i < cp; ++i, ++col) {
-      if (col >= d - row) {
-        if (++side >= n) {
-          side = 0;
-          ++row;
-        }
-        col = row;
-      }
-      double blend = surf.weight(side, col, row, params[j]);
-      if (col < l)
-        blend += surf.weight((side + n - 1) % n, d - row, col, params[j]);
-      if (col > d - l)
-        blend += surf.weight((side + 1) % n, row, d - col, params[j]);
-      if (i > bcp)
-        A(j, i - bcp) = blend;
-      else {
-        Point3D p = surf.controlPoint(side, col, row);
+// Data blends below the threshold are left out
+static FitSystem
+assembleFit(const SurfaceGeneralizedBezier &surf, const PointVector &points,
+            const Point2DVector &params, size_t fixed_rows, double threshold) {
+  size_t n = surf.domain()->vertices().size();
+  size_t d = surf.degree();
+  size_t l = surf.layers();
+  size_t cp = surf.serialCount();                     // # of control points
+  size_t bcp = n * (d + 1 - fixed_rows) * fixed_rows; // # of boundary control points
+  size_t mcp = cp - bcp;                              // # of movable control points
+  size_t m = points.size();                           // # of samples
+
+  FitSystem system;
+  system.bcp = bcp;
+  system.mcp = mcp;
+  system.data_rhs = Eigen::MatrixXd::Zero(m, 3);
+  system.smoothing_rhs = Eigen::MatrixXd::Zero(mcp, 3);
+  auto &b = system.data_rhs;
+
+  // Fill the matrices (the samples in parallel, with separate triplets for each)
+  PointVector fixed(bcp + 1);
+  for (size_t i = 1; i <= bcp; ++i) {
+    auto [side, col, row] = surf.serialControlPoint(i);
+    fixed[i] = surf.controlPoint(side, col, row);
+  }
+  std::vector<std::vector<Eigen::Triplet<double>>> sample_triplets(m);
+  surf.serialWeights(params, [&](size_t j, const DoubleVector &weights) {
+    for (size_t i = 0; i < cp; ++i) {
+      double blend = weights[i];
+      if (i > 0 && i <= bcp) {
+        const Point3D &p = fixed[i];
         b(j, 0) -= p[0] * blend; b(j, 1) -= p[1] * blend; b(j, 2) -= p[2] * blend;
-      }
-      blend_sum += blend;
+      } else if (blend != 0.0 && std::abs(blend) >= threshold)
+        sample_triplets[j].emplace_back(j, i == 0 ? 0 : i - bcp, blend);
     }
-    A(j, 0) = 1.0 - blend_sum;
     b(j, 0) += points[j][0]; b(j, 1) += points[j][1]; b(j, 2) += points[j][2];
-  }
+  });
+  for (const auto &ts : sample_triplets)
+    system.data.insert(system.data.end(), ts.begin(), ts.end());
+  sample_triplets.clear();
 
   // Smoothing terms
-  auto findControlPoint = [n,d,cp](size_t i, size_t j, size_t k) -> size_t {
-    for (size_t c = 1, side = 0, col = 0, row = 0; c < cp; ++c, ++col) {
-      if (col >= d - row) {
-        if (++side >= n) {
-          side = 0;
-          ++row;
-        }
-        col = row;
-      }
-      size_t side_m = (side + n - 1) % n, side_p = (side + 1) % n;
-      if ((i == side && j == col && k == row) ||
-          (i == side_m && j == d - row && k == col) ||
-          (i == side_p && j == row && k == d - col))
-        return c;
-    }
-    return 0;
-  };
-  auto setWeight = [&A,&b,n,d,l,bcp,surf,findControlPoint]
-    (size_t j, size_t side, size_t col, size_t row, double w) {
-    size_t i = findControlPoint(side, col, row);
+  auto &bs = system.smoothing_rhs;
+  auto setWeight = [&](size_t j, size_t side, size_t col, size_t row, double w) {
+    size_t i = surf.serialIndex(side, col, row);
     if (i > bcp)
-      A(j, i - bcp) = w;
+      system.smoothing.emplace_back(j, i - bcp, w);
     else if (i == 0)
-      A(j, 0) = w;
+      system.smoothing.emplace_back(j, 0, w);
     else {
       Point3D p = surf.controlPoint(side, col, row);
-      b(j, 0) -= p[0] * w; b(j, 1) -= p[1] * w; b(j, 2) -= p[2] * w;
+      bs(j, 0) -= p[0] * w; bs(j, 1) -= p[1] * w; bs(j, 2) -= p[2] * w;
     }
   };
   for (size_t j = 0; j < n; ++j)
-    setWeight(m, j, l, l - 1, -smoothing / n);
-  A(m, 0) = smoothing;
-  for (size_t i = bcp + 1, side = 0, col = fixed_rows, row = fixed_rows; i < cp; ++i, ++col) {
-    if (col >= d - row) {
-      if (++side >= n) {
-        side = 0;
-        ++row;
-      }
-      col = row;
-    }
-    size_t j = m + i - bcp;
-    setWeight(j, side, col - 1, row, -smoothing / 4.0);
-    setWeight(j, side, col + 1, row, -smoothing / 4.0);
-    setWeight(j, side, col, row - 1, -smoothing / 4.0);
-    setWeight(j, side, col, row + 1, -smoothing / 4.0);
-    A(j, i - bcp) = smoothing;
+    setWeight(0, j, l, l - 1, -1.0 / n);
+  system.smoothing.emplace_back(0, 0, 1.0);
+  for (size_t i = bcp + 1; i < cp; ++i) {
+    auto [side, col, row] = surf.serialControlPoint(i);
+    size_t j = i - bcp;
+    setWeight(j, side, col - 1, row, -1.0 / 4.0);
+    setWeight(j, side, col + 1, row, -1.0 / 4.0);
+    setWeight(j, side, col, row - 1, -1.0 / 4.0);
+    setWeight(j, side, col, row + 1, -1.0 / 4.0);
+    system.smoothing.emplace_back(j, i - bcp, 1.0);
   }
 
-  // LSQ Fit
-  Eigen::MatrixXd x = A.fullPivLu().solve(b);
-  if (!(A*x).isApprox(b)) {
-    Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
-    x = svd.solve(b);
-  }
+  return system;
+}
 
-  // Fill control points
+// Fill control points
+static void
+setMovableControlPoints(SurfaceGeneralizedBezier &surf, size_t bcp, const Eigen::MatrixXd &x) {
   surf.setCentralControlPoint(Point3D(x(0, 0), x(0, 1), x(0, 2)));
-  for (size_t i = bcp + 1, side = 0, col = fixed_rows, row = fixed_rows; i < cp; ++i, ++col) {
-    if (col >= d - row) {
-      if (++side >= n) {
-        side = 0;
-        ++row;
-      }
-      col = row;
-    }
+  for (size_t i = bcp + 1; i < surf.serialCount(); ++i) {
+    auto [side, col, row] = surf.serialControlPoint(i);
     surf.setControlPoint(side, col, row, Point3D(x(i - bcp, 0), x(i - bcp, 1), x(i - bcp, 2)));
   }
+}
 
+SurfaceGeneralizedBezier fitWithOriginal(const SurfaceGeneralizedBezier &original,
+                                         const PointVector &points,
+                                         const Point2DVector &params,
+                                         double smoothing, size_t fixed_rows, bool sparse) {
+  SurfaceGeneralizedBezier surf = fixedBoundaries(original);
+  FitSystem system = assembleFit(surf, points, params, fixed_rows,
+                                 sparse ? sparse_weight_threshold : 0.0);
+  size_t m = points.size(), mcp = system.mcp;
+
+  // The smoothing rows follow the data rows
+  auto &triplets = system.data;
+  for (const auto &t : system.smoothing)
+    triplets.emplace_back(m + t.row(), t.col(), t.value() * smoothing);
+  system.smoothing.clear();
+  Eigen::MatrixXd b(m + mcp, 3);
+  b << system.data_rhs, system.smoothing_rhs * smoothing;
+
+  // LSQ Fit
+  Eigen::MatrixXd x;
+  if (sparse) {
+    // Normal equations by Cholesky factorization, or sparse QR when they are not positive definite
+    Eigen::SparseMatrix<double> S(m + mcp, mcp);
+    S.setFromTriplets(triplets.begin(), triplets.end(), [](double, double w) { return w; });
+    triplets.clear();
+    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> llt(S.transpose() * S);
+    if (llt.info() == Eigen::Success)
+      x = llt.solve(S.transpose() * b);
+    if (llt.info() != Eigen::Success || !x.allFinite()) {
+      Eigen::SparseQR<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> qr(S);
+      x = qr.solve(b);
+    }
+  } else {
+    Eigen::MatrixXd A = Eigen::MatrixXd::Zero(m + mcp, mcp);
+    for (const auto &t : triplets)
+      A(t.row(), t.col()) = t.value();
+    triplets.clear();
+    x = A.fullPivLu().solve(b);
+    if (!(A*x).isApprox(b)) {
+      Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
+      x = svd.solve(b);
+    }
+  }
+
+  setMovableControlPoints(surf, system.bcp, x);
+  return surf;
+}
+
+FittingSession::FittingSession(const SurfaceGeneralizedBezier &original, const PointVector &points,
+                               size_t fixed_rows)
+  : FittingSession(original, points, parameterizePoints(original, points), fixed_rows) {
+}
+
+FittingSession::FittingSession(const SurfaceGeneralizedBezier &original, const PointVector &points,
+                               const Point2DVector &params, size_t fixed_rows)
+  : surf_(fixedBoundaries(original)), points_(points), params_(params), fixed_rows_(fixed_rows) {
+  assemble(true);
+}
+
+void
+FittingSession::assemble(bool with_smoothing) {
+  FitSystem system = assembleFit(surf_, points_, params_, fixed_rows_, sparse_weight_threshold);
+  bcp_ = system.bcp;
+  Eigen::SparseMatrix<double> D(points_.size(), system.mcp);
+  D.setFromTriplets(system.data.begin(), system.data.end(), [](double, double w) { return w; });
+  data_normal_ = D.transpose() * D;
+  data_rhs_ = D.transpose() * system.data_rhs;
+  if (with_smoothing) {
+    Eigen::SparseMatrix<double> S(system.mcp, system.mcp);
+    S.setFromTriplets(system.smoothing.begin(), system.smoothing.end(),
+                      [](double, double w) { return w; });
+    smoothing_normal_ = S.transpose() * S;
+    smoothing_rhs_ = S.transpose() * system.smoothing_rhs;
+  }
+}
+
+const Point2DVector &
+FittingSession::parameters() const {
+  return params_;
+}
+
+void
+FittingSession::correctParameters(const SurfaceGeneralizedBezier &surf, size_t iterations) {
+  params_ = ::correctParameters(surf, points_, params_, iterations);
+  assemble(false);
+}
+
+SurfaceGeneralizedBezier
+FittingSession::fitCorrected(double smoothing, size_t corrections, size_t iterations) {
+  SurfaceGeneralizedBezier surf = fit(smoothing);
+  for (size_t i = 0; i < corrections; ++i) {
+    correctParameters(surf, iterations);
+    surf = fit(smoothing);
+  }
   return surf;
 }
+
+// The normal equations of the combined system are
+//   (D^T D + s^2 S^T S) x = D^T b_D + s^2 S^T b_S,
+// solved by Cholesky factorization, or by complete orthogonal decomposition when that fails
+SurfaceGeneralizedBezier
+FittingSession::fit(double smoothing) const {
+  double s2 = smoothing * smoothing;
+  Eigen::MatrixXd N = data_normal_ + smoothing_normal_ * s2;
+  Eigen::MatrixXd r = data_rhs_ + smoothing_rhs_ * s2;
+  Eigen::MatrixXd x;
+  Eigen::LLT<Eigen::MatrixXd> llt(N);
+  if (llt.info() == Eigen::Success)
+    x = llt.solve(r);
+  if (llt.info() != Eigen::Success || !x.allFinite())
+    x = N.completeOrthogonalDecomposition().solve(r);
+
+  SurfaceGeneralizedBezier surf = surf_;
+  setMovableControlPoints(surf, bcp_, x);
+  return surf;
+}
+
+std::vector<SurfaceGeneralizedBezier>
+FittingSession::fit(const DoubleVector &smoothings, const Executor &executor) const {
+  std::vector<SurfaceGeneralizedBezier> result(smoothings.size());
+  executor(smoothings.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      result[i] = fit(smoothings[i]);
+  });
+  return result;
+}
+
+ModelFittingSession::ModelFittingSession(const std::vector<SurfaceGeneralizedBezier> &originals,
+                                         const PointVector &points, double max_distance,
+                                         size_t fixed_rows, size_t resolution,
+                                         const Executor &executor)
+  : originals_(originals), points_(originals.size()), sessions_(originals.size()) {
+  size_t np = originals_.size();
+  if (np == 0)
+    return;
+
+  // All patches in one mesh, the vertices of patch i starting at offsets[i]
+  std::vector<TriMesh> meshes(np);
+  executor(np, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      meshes[i] = originals_[i].eval(resolution);
+  });
+  std::vector<size_t> offsets;
+  PointVector vertices;
+  TriMesh mesh;
+  for (const auto &m : meshes) {
+    size_t offset = vertices.size();
+    offsets.push_back(offset);
+    vertices.insert(vertices.end(), m.points().begin(), m.points().end());
+    for (const auto &t : m.triangles())
+      mesh.addTriangle(t[0] + offset, t[1] + offset, t[2] + offset);
+  }
+  mesh.setPoints(vertices);
+  meshes.clear();
+
+  // Closest patches, in parallel (the BVH queries are distributed by their own grain)
+  auto closest = TriangleBVH(mesh).closest(points, threadExecutor());
+  std::vector<size_t> owner(points.size());
+  for (size_t j = 0; j < points.size(); ++j)
+    owner[j] = std::upper_bound(offsets.begin(), offsets.end(), closest[j][0]) -
+      offsets.begin() - 1;
+  for (size_t j = 0; j < points.size(); ++j)
+    points_[owner[j]].push_back(j);
+
+  executor(np, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const auto &params = originals_[i].domain()->parameters(resolution);
+      PointVector patch_points;
+      Point2DVector patch_params;
+      std::vector<size_t> kept;
+      double distance;
+      for (size_t j : points_[i]) {
+        Point2D uv = triangleParameter(vertices, params.data(), offsets[i], closest[j],
+                                       points[j], distance);
+        if (distance > max_distance)
+          continue;
+        kept.push_back(j);
+        patch_points.push_back(points[j]);
+        patch_params.push_back(uv);
+      }
+      points_[i] = kept;
+      if (!kept.empty())
+        sessions_[i] = std::make_unique<FittingSession>(originals_[i], patch_points,
+                                                        patch_params, fixed_rows);
+    }
+  });
+}
+
+size_t
+ModelFittingSession::size() const {
+  return originals_.size();
+}
+
+const std::vector<size_t> &
+ModelFittingSession::points(size_t patch) const {
+  return points_[patch];
+}
+
+template<typename F>
+std::vector<SurfaceGeneralizedBezier>
+ModelFittingSession::fitAll(const Callback &callback, const Executor &executor, F fit) {
+  std::vector<SurfaceGeneralizedBezier> result(originals_.size());
+  std::mutex mutex;
+  executor(originals_.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = sessions_[i] ? fit(*sessions_[i]) : originals_[i];
+      if (callback) {
+        std::lock_guard<std::mutex> lock(mutex);
+        callback(i, result[i]);
+      }
+    }
+  });
+  return result;
+}
+
+std::vector<SurfaceGeneralizedBezier>
+ModelFittingSession::fit(double smoothing, const Callback &callback,
+                         const Executor &executor) {
+  return fitAll(callback, executor, [&](FittingSession &session) {
+    return session.fit(smoothing);
+  });
+}
+
+std::vector<SurfaceGeneralizedBezier>
+ModelFittingSession::fitCorrected(double smoothing, size_t corrections, size_t iterations,
+                                  const Callback &callback, const Executor &executor) {
+  return fitAll(callback, executor, [&](FittingSession &session) {
+    return session.fitCorrected(smoothing, corrections, iterations);
+  });
+}
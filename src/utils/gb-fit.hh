@@ -1,12 +1,99 @@
 #pragma once
 
+#include <functional>
+#include <limits>
+#include <memory>
+
+#include "Eigen/Core"
+
 #include "surface-generalized-bezier.hh"
 
 using namespace Transfinite;
 
 SurfaceGeneralizedBezier elevateDegree(const SurfaceGeneralizedBezier &surf);
 Point2DVector parameterizePoints(const Surface &surf, const PointVector &points);
+// Improves the parameters of the points by closest-point iterations on the surface
+Point2DVector correctParameters(const Surface &surf, const PointVector &points,
+                                const Point2DVector &params, size_t iterations = 3);
+// Least squares fit of the inner control points, keeping the outer `fixed_rows` of the original.
+// By default the (thresholded) sparse system is solved via its normal equations;
+// the dense solver (LU, or SVD when that fails) may be preferable for small problems.
 SurfaceGeneralizedBezier fitWithOriginal(const SurfaceGeneralizedBezier &original,
                                          const PointVector &points,
                                          const Point2DVector &params,
-                                         double smoothing = 0, size_t fixed_rows = 2);
+                                         double smoothing = 0, size_t fixed_rows = 2,
+                                         bool sparse = true);
+
+// Fits of one patch to the same points with different smoothing values (cf. fitWithOriginal):
+// the parameterization and the normal matrices of the data and smoothing terms are computed once,
+// so each fit needs only the factorization of a (movable control points)^2 matrix
+class FittingSession {
+public:
+  // Parameterizes the points on the original patch
+  FittingSession(const SurfaceGeneralizedBezier &original, const PointVector &points,
+                 size_t fixed_rows = 2);
+  FittingSession(const SurfaceGeneralizedBezier &original, const PointVector &points,
+                 const Point2DVector &params, size_t fixed_rows = 2);
+  SurfaceGeneralizedBezier fit(double smoothing) const;
+  // Fits for all smoothing values, distributed by the executor
+  std::vector<SurfaceGeneralizedBezier> fit(const DoubleVector &smoothings,
+                                            const Executor &executor = threadExecutor()) const;
+  const Point2DVector &parameters() const;
+  // Corrects the parameters on the given patch (see correctParameters),
+  // reassembling only the data term
+  void correctParameters(const SurfaceGeneralizedBezier &surf, size_t iterations = 3);
+  // Alternates fits and parameter corrections on the fitted patch
+  SurfaceGeneralizedBezier fitCorrected(double smoothing, size_t corrections,
+                                        size_t iterations = 3);
+
+private:
+  void assemble(bool with_smoothing);
+
+  SurfaceGeneralizedBezier surf_; // with the fixed boundaries
+  PointVector points_;
+  Point2DVector params_;
+  size_t fixed_rows_, bcp_;
+  Eigen::MatrixXd data_normal_, smoothing_normal_, data_rhs_, smoothing_rhs_;
+};
+
+// Fits of all patches of a model to one scan. Each point is assigned to the patch closest to it,
+// found in a bounding volume hierarchy of the tessellations of all patches (points farther
+// than `max_distance` are left out), and parameterized by the closest triangle
+// (as by parameterizePoints). Each patch then has its own FittingSession keeping `fixed_rows`
+// of its boundary control points, so adjacent patches keep their common boundaries, and the
+// fits are independent: they run concurrently, and can be repeated with other settings.
+// The patches should be set up and updated; those without points are fitted as themselves.
+class ModelFittingSession {
+public:
+  // Receives each fitted patch when it is ready (the calls are serialized)
+  using Callback = std::function<void(size_t patch, const SurfaceGeneralizedBezier &surf)>;
+
+  // The points are partitioned and the sessions set up by the executor
+  ModelFittingSession(const std::vector<SurfaceGeneralizedBezier> &originals,
+                      const PointVector &points,
+                      double max_distance = std::numeric_limits<double>::infinity(),
+                      size_t fixed_rows = 2, size_t resolution = 15,
+                      const Executor &executor = threadExecutor(0, 1));
+  size_t size() const;
+  // Indices of the points of each patch
+  const std::vector<size_t> &points(size_t patch) const;
+  // Fits all patches, distributed by the executor (one patch per task); not const, as the fits
+  // use the sessions, which fitCorrected changes (so neither should run during another)
+  std::vector<SurfaceGeneralizedBezier> fit(double smoothing, const Callback &callback = {},
+                                            const Executor &executor = threadExecutor(0, 1));
+  // The same with FittingSession::fitCorrected, whose corrected parameters are kept
+  std::vector<SurfaceGeneralizedBezier> fitCorrected(double smoothing, size_t corrections,
+                                                     size_t iterations = 3,
+                                                     const Callback &callback = {},
+                                                     const Executor &executor =
+                                                       threadExecutor(0, 1));
+
+private:
+  template<typename F>
+  std::vector<SurfaceGeneralizedBezier> fitAll(const Callback &callback,
+                                               const Executor &executor, F fit);
+
+  std::vector<SurfaceGeneralizedBezier> originals_;
+  std::vector<std::vector<size_t>> points_;
+  std::vector<std::unique_ptr<FittingSession>> sessions_; // null for patches without points
+};
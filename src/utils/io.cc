@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -7,73 +11,287 @@
 #include "domain.hh"
 #include "utilities.hh"
 
-CurveVector readLOP(std::string filename) {
-  std::ifstream f(filename);
-  if (!f.is_open()) {
-    std::cerr << "Unable to open file: " << filename << std::endl;
-    return CurveVector();
+ParseError::ParseError(const std::string &filename, size_t line, const std::string &message)
+  : std::runtime_error(filename + (line > 0 ? ":" + std::to_string(line) : "") + ": " + message),
+    line_(line) {
+}
+
+size_t ParseError::line() const {
+  return line_;
+}
+
+namespace {
+
+  // Files are split into chunks of about this size for parsing
+  const size_t chunk_size = 1 << 20;
+
+  bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+
+  bool isNewline(char c) {
+    return c == '\n';
+  }
+
+  std::string readFile(const std::string &filename) {
+    std::ifstream f(filename, std::ios::binary);
+    if (!f.is_open())
+      throw ParseError(filename, 0, "unable to open file");
+    f.seekg(0, std::ios::end);
+    auto length = f.tellg();
+    if (length < 0)
+      throw ParseError(filename, 0, "unable to read file");
+    std::string buffer(static_cast<size_t>(length), '\0');
+    f.seekg(0, std::ios::beg);
+    f.read(&buffer[0], buffer.size());
+    if (!f)
+      throw ParseError(filename, 0, "unable to read file");
+    return buffer;
+  }
+
+  size_t lineOf(const std::string &buffer, size_t position) {
+    return 1 + std::count(buffer.begin(), buffer.begin() + position, '\n');
+  }
+
+  // Chunk boundaries are moved forward to a separator, so that no record is split
+  std::vector<size_t> chunkBounds(const std::string &buffer, bool (*separator)(char)) {
+    std::vector<size_t> bounds = { 0 };
+    while (bounds.back() < buffer.size()) {
+      size_t next = std::min(bounds.back() + chunk_size, buffer.size());
+      while (next < buffer.size() && !separator(buffer[next]))
+        ++next;
+      bounds.push_back(next);
+    }
+    return bounds;
+  }
+
+  // All numbers of a model file, read in order by the loaders
+  class NumberReader {
+  public:
+    NumberReader(const std::string &filename, const Executor &executor)
+      : filename_(filename), buffer_(readFile(filename)) {
+      auto bounds = chunkBounds(buffer_, isSpace);
+      std::vector<DoubleVector> chunks(bounds.size() - 1);
+      executor(chunks.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          parse(bounds[i], bounds[i+1], chunks[i]);
+      });
+      size_t size = 0;
+      for (const auto &chunk : chunks)
+        size += chunk.size();
+      values_.reserve(size);
+      for (const auto &chunk : chunks)
+        values_.insert(values_.end(), chunk.begin(), chunk.end());
+    }
+
+    double real() {
+      if (next_ >= values_.size())
+        error(buffer_.size(), "unexpected end of file");
+      return values_[next_++];
+    }
+
+    size_t index() {
+      double x = real();
+      if (x < 0 || x != std::floor(x) || x > 1e15)
+        fail("expected a non-negative integer");
+      return static_cast<size_t>(x);
+    }
+
+    Point3D point() {
+      double x = real(), y = real(), z = real();
+      return { x, y, z };
+    }
+
+    // Reports an error at the last number read
+    [[noreturn]] void fail(const std::string &message) const {
+      // Locate the number by scanning the file again
+      size_t count = 0, i = 0, position = 0;
+      while (i < buffer_.size()) {
+        while (i < buffer_.size() && isSpace(buffer_[i]))
+          ++i;
+        if (i == buffer_.size())
+          break;
+        position = i;
+        if (++count == next_)
+          break;
+        while (i < buffer_.size() && !isSpace(buffer_[i]))
+          ++i;
+      }
+      error(position, message);
+    }
+
+  private:
+    void parse(size_t begin, size_t end, DoubleVector &result) const {
+      const char *data = buffer_.data();
+      size_t i = begin;
+      while (true) {
+        while (i < end && isSpace(data[i]))
+          ++i;
+        if (i == end)
+          break;
+        size_t start = i;
+        while (i < end && !isSpace(data[i]))
+          ++i;
+        const char *first = data + start + (data[start] == '+' ? 1 : 0), *last = data + i;
+        double x;
+        auto [ptr, ec] = std::from_chars(first, last, x);
+        if (ec != std::errc() || ptr != last)
+          error(start, "invalid number '" + std::string(data + start, last) + "'");
+        result.push_back(x);
+      }
+    }
+
+    [[noreturn]] void error(size_t position, const std::string &message) const {
+      throw ParseError(filename_, lineOf(buffer_, position), message);
+    }
+
+    std::string filename_, buffer_;
+    DoubleVector values_;
+    size_t next_ = 0;
+  };
+
+  // The vertices and faces of a part of an OBJ file
+  struct ObjChunk {
+    PointVector points;
+    // Positive indices are stored 0-based, negative ones relative to the start of the chunk,
+    // to be resolved when the vertex counts of the preceding chunks are known
+    std::vector<std::array<long long, 3>> triangles;
+    std::vector<std::array<bool, 3>> relative;
+    std::vector<size_t> origins; // position of the face of each triangle
+    size_t error = std::string::npos; // position of the first malformed record
+    std::string message;
+  };
+
+  const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    return p;
+  }
+
+  // Reads `v` and `f` records of whole lines in [begin, end); polygons are triangulated as fans
+  void parseObjChunk(const char *data, size_t begin, size_t end, ObjChunk &chunk) {
+    const char *p = data + begin, *last = data + end;
+    std::vector<std::pair<long long, bool>> face;
+    while (p < last) {
+      const char *line = p, *eol = std::find(p, last, '\n');
+      p = eol + (eol < last ? 1 : 0);
+      const char *q = skipBlanks(line, eol);
+      if (q + 1 >= eol || (q[1] != ' ' && q[1] != '\t'))
+        continue;
+      auto fail = [&](const std::string &message) {
+        chunk.error = line - data;
+        chunk.message = message;
+      };
+      if (*q == 'v') {
+        Point3D v;
+        q += 2;
+        for (size_t i = 0; i < 3; ++i) {
+          q = skipBlanks(q, eol);
+          if (q < eol && *q == '+')
+            ++q;
+          auto [ptr, ec] = std::from_chars(q, eol, v[i]);
+          if (ec != std::errc()) {
+            fail("invalid vertex");
+            return;
+          }
+          q = ptr;
+        }
+        chunk.points.push_back(v);
+      } else if (*q == 'f') {
+        face.clear();
+        q = skipBlanks(q + 2, eol);
+        while (q < eol && !isSpace(*q)) {
+          long long index;
+          auto [ptr, ec] = std::from_chars(q, eol, index);
+          if (ec != std::errc() || index == 0) {
+            fail("invalid face");
+            return;
+          }
+          if (index > 0)
+            face.emplace_back(index - 1, false);
+          else
+            face.emplace_back(static_cast<long long>(chunk.points.size()) + index, true);
+          // Texture and normal indices are ignored
+          q = ptr;
+          while (q < eol && !isSpace(*q))
+            ++q;
+          q = skipBlanks(q, eol);
+        }
+        if (face.size() < 3) {
+          fail("a face needs at least 3 vertices");
+          return;
+        }
+        for (size_t i = 2; i < face.size(); ++i) {
+          chunk.triangles.push_back({ face[0].first, face[i-1].first, face[i].first });
+          chunk.relative.push_back({ face[0].second, face[i-1].second, face[i].second });
+          chunk.origins.push_back(line - data);
+        }
+      }
+    }
   }
 
-  size_t n, deg, nk, nc;
-  DoubleVector knots;
-  PointVector cpts;
+}
+
+CurveVector readLOP(std::string filename, const Executor &executor) {
+  NumberReader f(filename, executor);
   CurveVector result;
 
-  f >> n;
+  size_t n = f.index();
   result.reserve(n);
   for (size_t i = 0; i < n; ++i) {
-    f >> deg;
-    f >> nk;
-    knots.resize(nk);
+    size_t deg = f.index();
+    size_t nk = f.index();
+    DoubleVector knots(nk);
     for (size_t j = 0; j < nk; ++j)
-      f >> knots[j];
-    f >> nc;
-    cpts.resize(nc);
+      knots[j] = f.real();
+    size_t nc = f.index();
+    if (nk != nc + deg + 1)
+      f.fail("knot and control point counts do not match the degree");
+    PointVector cpts(nc);
     for (size_t j = 0; j < nc; ++j)
-      f >> cpts[j][0] >> cpts[j][1] >> cpts[j][2];
+      cpts[j] = f.point();
     result.push_back(std::make_shared<BSCurve>(deg, knots, cpts));
   }
 
   return result;
 }
 
-TriMesh readOBJ(const std::string &filename) {
-  TriMesh result;
-  std::ifstream f(filename);
-  if (!f.is_open()) {
-    std::cerr << "Unable to open file: " << filename << std::endl;
-    return result;
-  }
-  bool points_set = false;
-  std::string line;
-  std::istringstream ss;
-  Point3D p;
-  TriMesh::Triangle t;
+TriMesh readOBJ(const std::string &filename, const Executor &executor) {
+  std::string buffer = readFile(filename);
+  auto bounds = chunkBounds(buffer, isNewline);
+  std::vector<ObjChunk> chunks(bounds.size() - 1);
+  executor(chunks.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      parseObjChunk(buffer.data(), bounds[i], bounds[i+1], chunks[i]);
+  });
+  for (const auto &chunk : chunks)
+    if (chunk.error != std::string::npos)
+      throw ParseError(filename, lineOf(buffer, chunk.error), chunk.message);
+
+  // Stitch the chunks together
   PointVector pv;
-  while (!f.eof()) {
-    std::getline(f, line);
-    if (line.empty())
-      continue;
-    switch (line[0]) {
-    case 'v':
-      ss.str(line);
-      ss.seekg(2); // skip the first two characters
-      ss >> p[0] >> p[1] >> p[2];
-      pv.push_back(p);
-      break;
-    case 'f':
-      if (!points_set) {
-        result.setPoints(pv);
-        points_set = true;
+  size_t size = 0;
+  for (const auto &chunk : chunks)
+    size += chunk.points.size();
+  pv.reserve(size);
+  for (const auto &chunk : chunks)
+    pv.insert(pv.end(), chunk.points.begin(), chunk.points.end());
+  TriMesh result;
+  result.setPoints(pv);
+  long long offset = 0;
+  for (const auto &chunk : chunks) {
+    for (size_t i = 0; i < chunk.triangles.size(); ++i) {
+      std::array<size_t, 3> t;
+      for (size_t j = 0; j < 3; ++j) {
+        long long index = chunk.triangles[i][j] + (chunk.relative[i][j] ? offset : 0);
+        if (index < 0 || index >= static_cast<long long>(size))
+          throw ParseError(filename, lineOf(buffer, chunk.origins[i]),
+                           "face vertex index out of range");
+        t[j] = index;
       }
-      ss.str(line);
-      ss.seekg(2); // skip the first two characters
-      ss >> t[0] >> t[1] >> t[2];
-      result.addTriangle(t[0] - 1, t[1] - 1, t[2] - 1);
-      break;
-    default:
-      break;
+      result.addTriangle(t[0], t[1], t[2]);
     }
+    offset += chunk.points.size();
   }
   return result;
 }
@@ -97,36 +315,22 @@ void writePCP(const std::string &filename, const Point2DVector &uvs, const Point
 }
 
 void loadBezier(const std::string &filename, SurfaceGeneralizedBezier *surf) {
-  std::ifstream f(filename);
-  if (!f.is_open()) {
-    std::cerr << "Unable to open file: " << filename << std::endl;
-    return;
-  }
-
-  size_t n, d;
-  f >> n >> d;
-  size_t l = (d + 1) / 2;
-  size_t cp = 1 + d / 2;
-  cp = n * cp * l + 1;          // # of control points
+  NumberReader f(filename, serialExecutor());
 
+  size_t n = f.index();
+  if (n < 3)
+    f.fail("a patch needs at least 3 sides");
+  size_t d = f.index();
+  if (d < 1)
+    f.fail("the degree should be positive");
   surf->initNetwork(n, d);
+  size_t cp = surf->serialCount();
 
-  Point3D p;
-  f >> p[0] >> p[1] >> p[2];
-  surf->setCentralControlPoint(p);
-
-  for (size_t i = 1, side = 0, col = 0, row = 0; i < cp; ++i, ++col) {
-    if (col >= d - row) {
-      if (++side >= n) {
-        side = 0;
-        ++row;
-      }
-      col = row;
-    }
-    f >> p[0] >> p[1] >> p[2];
-    surf->setControlPoint(side, col, row, p);
+  surf->setCentralControlPoint(f.point());
+  for (size_t i = 1; i < cp; ++i) {
+    const auto &index = surf->serialControlPoint(i);
+    surf->setControlPoint(index[0], index[1], index[2], f.point());
   }
-  f.close();
 
   surf->setupLoop();
 }
@@ -141,65 +345,36 @@ void saveBezier(const SurfaceGeneralizedBezier &surf, const std::string &filenam
   size_t n = surf.domain()->vertices().size();
   size_t d = surf.degree();
   f << n << ' ' << d << std::endl;
-  size_t l = (d + 1) / 2;
-  size_t cp = 1 + d / 2;
-  cp = n * cp * l + 1;          // # of control points
+  size_t cp = surf.serialCount();
 
   Point3D p = surf.centralControlPoint();
   f << p[0] << ' ' << p[1] << ' ' << p[2] << std::endl;
 
-  for (size_t i = 1, side = 0, col = 0, row = 0; i < cp; ++i, ++col) {
-    if (col >= d - row) {
-      if (++side >= n) {
-        side = 0;
-        ++row;
-      }
-      col = row;
-    }
-    p = surf.controlPoint(side, col, row);
+  for (size_t i = 1; i < cp; ++i) {
+    const auto &index = surf.serialControlPoint(i);
+    p = surf.controlPoint(index[0], index[1], index[2]);
     f << p[0] << ' ' << p[1] << ' ' << p[2] << std::endl;
   }
   f.close();
 }
 
 void writeBezierControlPoints(const SurfaceGeneralizedBezier &surf, const std::string &filename) {
-  // Slow but simple implementation creating a nice mesh
   size_t n = surf.domain()->vertices().size();
   size_t d = surf.degree();
   size_t l = surf.layers();
-  size_t cp = 1 + d / 2;
-  cp = n * cp * l + 1;
-
-  auto findControlPoint = [n,d,cp](size_t i, size_t j, size_t k) -> size_t {
-    for (size_t c = 1, side = 0, col = 0, row = 0; c < cp; ++c, ++col) {
-      if (col >= d - row) {
-        if (++side >= n) {
-          side = 0;
-          ++row;
-        }
-        col = row;
-      }
-      size_t side_m = (side + n - 1) % n, side_p = (side + 1) % n;
-      if ((i == side && j == col && k == row) ||
-          (i == side_m && j == d - row && k == col) ||
-          (i == side_p && j == row && k == d - col))
-        return c + 1;
-    }
-    return 0;
+  size_t cp = surf.serialCount();
+
+  // OBJ indices start from 1
+  auto findControlPoint = [&surf](size_t i, size_t j, size_t k) -> size_t {
+    return surf.serialIndex(i, j, k) + 1;
   };
 
   std::ofstream f(filename);
   Point3D p = surf.centralControlPoint();
   f << "v " << p[0] << " " << p[1] << " " << p[2] << std::endl;
-  for (size_t i = 1, side = 0, col = 0, row = 0; i < cp; ++i, ++col) {
-    if (col >= d - row) {
-      if (++side >= n) {
-        side = 0;
-        ++row;
-      }
-      col = row;
-    }
-    p = surf.controlPoint(side, col, row);
+  for (size_t i = 1; i < cp; ++i) {
+    const auto &index = surf.serialControlPoint(i);
+    p = surf.controlPoint(index[0], index[1], index[2]);
     f << "v " << p[0] << " " << p[1] << " " << p[2] << std::endl;
   }
 
@@ -233,51 +408,46 @@ void writeBezierControlPoints(const SurfaceGeneralizedBezier &surf, const std::s
 }
 
 SurfaceSPatch loadSPatch(const std::string &filename) {
-  std::ifstream f(filename);
-  f.exceptions(std::ios::failbit | std::ios::badbit);
-  size_t n, d;
-  f >> n >> d;
+  NumberReader f(filename, serialExecutor());
+  size_t n = f.index();
+  if (n < 3)
+    f.fail("a patch needs at least 3 sides");
+  size_t d = f.index();
   size_t n_cp = binomial(n + d - 1, d);
   SurfaceSPatch surf;
   surf.initNetwork(n, d);
   SurfaceSPatch::Index index(n);
   for (size_t i = 0; i < n_cp; ++i) {
-    for (size_t j = 0; j < n; ++j)
-      f >> index[j];
-    Point3D p;
-    for (size_t j = 0; j < 3; ++j)
-      f >> p[j];
-    surf.setControlPoint(index, p);
+    size_t sum = 0;
+    for (size_t j = 0; j < n; ++j) {
+      index[j] = f.index();
+      sum += index[j];
+    }
+    if (sum != d)
+      f.fail("the control point index should sum to the degree");
+    surf.setControlPoint(index, f.point());
   }
   surf.setupLoop();
   return surf;
 }
 
-std::vector<SurfaceSuperD> loadSuperDModel(const std::string &filename) {
+std::vector<SurfaceSuperD> loadSuperDModel(const std::string &filename,
+                                           const Executor &executor) {
+  NumberReader f(filename, executor);
   std::vector<SurfaceSuperD> result;
-  std::ifstream f(filename);
-  if (!f.is_open()) {
-    std::cerr << "Unable to open file: " << filename << std::endl;
-    return {};
-  }
-  size_t patches;
-  f >> patches;
+  size_t patches = f.index();
+  result.reserve(patches);
   for (size_t i = 0; i < patches; ++i) {
     SurfaceSuperD surf;
-    size_t n;
-    f >> n;
+    size_t n = f.index();
+    if (n < 3)
+      f.fail("a patch needs at least 3 sides");
     surf.initNetwork(n);
-    double x, y, z;
-    for (size_t j = 0; j < n; ++j) {
-      f >> x >> y >> z;
-      surf.setFaceControlPoint(j, { x, y, z });
-    }
-    for (size_t j = 0; j < n; ++j) {
-      f >> x >> y >> z;
-      surf.setEdgeControlPoint(j, { x, y, z });
-    }
-    f >> x >> y >> z;
-    surf.setVertexControlPoint({ x, y, z });
+    for (size_t j = 0; j < n; ++j)
+      surf.setFaceControlPoint(j, f.point());
+    for (size_t j = 0; j < n; ++j)
+      surf.setEdgeControlPoint(j, f.point());
+    surf.setVertexControlPoint(f.point());
     surf.setupLoop();
     surf.updateRibbons();
     result.push_back(surf);
@@ -1,18 +1,34 @@
 #pragma once
 
+#include <stdexcept>
 #include <string>
 
+#include "executor.hh"
 #include "surface-generalized-bezier.hh"
 #include "surface-spatch.hh"
 #include "surface-superd.hh"
 
 using namespace Transfinite;
 
-CurveVector readLOP(std::string filename);
-TriMesh readOBJ(const std::string &filename);
+// Thrown by the model and mesh loaders when a file cannot be read (line 0) or is malformed
+class ParseError : public std::runtime_error {
+public:
+  ParseError(const std::string &filename, size_t line, const std::string &message);
+  size_t line() const;
+
+private:
+  size_t line_;
+};
+
+// The model files are read at once and their numbers are parsed (locale-independently)
+// in chunks distributed by the executor; only large files are split
+CurveVector readLOP(std::string filename, const Executor &executor = threadExecutor(0, 1));
+// Only vertices and faces are read; polygons are triangulated as fans
+TriMesh readOBJ(const std::string &filename, const Executor &executor = threadExecutor(0, 1));
 void writePCP(const std::string &filename, const Point2DVector &uvs, const PointVector &points);
 void loadBezier(const std::string &filename, SurfaceGeneralizedBezier *surf);
 void saveBezier(const SurfaceGeneralizedBezier &surf, const std::string &filename);
 void writeBezierControlPoints(const SurfaceGeneralizedBezier &surf, const std::string &filename);
 SurfaceSPatch loadSPatch(const std::string &filename);
-std::vector<SurfaceSuperD> loadSuperDModel(const std::string &filename);
+std::vector<SurfaceSuperD> loadSuperDModel(const std::string &filename,
+                                           const Executor &executor = threadExecutor(0, 1));
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "mesh-writer.hh"
+
+namespace {
+
+  bool littleEndian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const unsigned char *>(&probe) == 1;
+  }
+
+  template<typename T>
+  void putLE(std::string &out, T x) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &x, sizeof(T));
+    if (!littleEndian())
+      std::reverse(bytes, bytes + sizeof(T));
+    out.append(bytes, sizeof(T));
+  }
+
+  std::ofstream open(const std::string &filename) {
+    std::ofstream f(filename, std::ios::binary);
+    if (!f.is_open())
+      throw std::runtime_error("unable to open file: " + filename);
+    return f;
+  }
+
+  void check(const std::ostream &f, const std::string &filename) {
+    if (!f)
+      throw std::runtime_error("unable to write file: " + filename);
+  }
+
+}
+
+// OBJWriter
+
+OBJWriter::OBJWriter(const std::string &filename) : filename_(filename), f_(open(filename)) {
+}
+
+void
+OBJWriter::begin(size_t, size_t) {
+}
+
+void
+OBJWriter::addPoints(size_t, const PointVector &points) {
+  for (const auto &p : points)
+    f_ << "v " << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+  check(f_, filename_);
+}
+
+void
+OBJWriter::addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t) {
+  for (const auto &t : triangles)
+    f_ << "f " << t[0] + 1 << ' ' << t[1] + 1 << ' ' << t[2] + 1 << '\n';
+  check(f_, filename_);
+}
+
+void
+OBJWriter::end() {
+  f_.close();
+  check(f_, filename_);
+}
+
+// STLWriter
+
+STLWriter::STLWriter(const std::string &filename)
+  : filename_(filename), f_(open(filename)), first_(0) {
+}
+
+void
+STLWriter::begin(size_t, size_t triangles) {
+  std::string header(80, '\0');
+  header.replace(0, 11, "transfinite");
+  putLE(header, static_cast<uint32_t>(triangles));
+  f_.write(header.data(), header.size());
+  check(f_, filename_);
+}
+
+void
+STLWriter::addPoints(size_t, const PointVector &points) {
+  points_.insert(points_.end(), points.begin(), points.end());
+}
+
+void
+STLWriter::addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t oldest) {
+  std::string out;
+  out.reserve(triangles.size() * 50);
+  for (const auto &t : triangles) {
+    const Point3D &a = points_[t[0] - first_], &b = points_[t[1] - first_],
+      &c = points_[t[2] - first_];
+    Vector3D normal = ((b - a) ^ (c - a)).normalize();
+    for (const auto &p : { normal, a, b, c })
+      for (size_t i = 0; i < 3; ++i)
+        putLE(out, static_cast<float>(p[i]));
+    putLE(out, static_cast<uint16_t>(0));
+  }
+  f_.write(out.data(), out.size());
+  check(f_, filename_);
+  points_.erase(points_.begin(), points_.begin() + (oldest - first_));
+  first_ = oldest;
+}
+
+void
+STLWriter::end() {
+  f_.close();
+  check(f_, filename_);
+}
+
+// PLYWriter
+
+PLYWriter::PLYWriter(const std::string &filename)
+  : filename_(filename), f_(open(filename)), faces_(std::tmpfile()) {
+  if (!faces_)
+    throw std::runtime_error("unable to create a temporary file for " + filename);
+}
+
+PLYWriter::~PLYWriter() {
+  std::fclose(faces_);
+}
+
+void
+PLYWriter::begin(size_t points, size_t triangles) {
+  f_ << "ply\n"
+     << "format binary_little_endian 1.0\n"
+     << "element vertex " << points << '\n'
+     << "property double x\n"
+     << "property double y\n"
+     << "property double z\n"
+     << "element face " << triangles << '\n'
+     << "property list uchar uint vertex_indices\n"
+     << "end_header\n";
+  check(f_, filename_);
+}
+
+void
+PLYWriter::addPoints(size_t, const PointVector &points) {
+  std::string out;
+  out.reserve(points.size() * 24);
+  for (const auto &p : points)
+    for (size_t i = 0; i < 3; ++i)
+      putLE(out, p[i]);
+  f_.write(out.data(), out.size());
+  check(f_, filename_);
+}
+
+void
+PLYWriter::addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t) {
+  std::string out;
+  out.reserve(triangles.size() * 13);
+  for (const auto &t : triangles) {
+    putLE(out, static_cast<uint8_t>(3));
+    for (size_t i : t)
+      putLE(out, static_cast<uint32_t>(i));
+  }
+  if (std::fwrite(out.data(), 1, out.size(), faces_) != out.size())
+    throw std::runtime_error("unable to write the faces of " + filename_);
+}
+
+void
+PLYWriter::end() {
+  std::rewind(faces_);
+  char buffer[1 << 16];
+  size_t count;
+  while ((count = std::fread(buffer, 1, sizeof(buffer), faces_)) > 0)
+    f_.write(buffer, count);
+  f_.close();
+  check(f_, filename_);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "mesh-sink.hh"
+
+using namespace Transfinite;
+
+// Mesh file writers for Surface::eval(resolution, sink); all of them keep only
+// a bounded part of the mesh in memory. Errors throw std::runtime_error.
+
+// Same format as TriMesh::writeOBJ, with faces interleaved with the vertices
+class OBJWriter : public MeshSink {
+public:
+  explicit OBJWriter(const std::string &filename);
+  void begin(size_t points, size_t triangles) override;
+  void addPoints(size_t first, const PointVector &points) override;
+  void addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t oldest) override;
+  void end() override;
+
+private:
+  std::string filename_;
+  std::ofstream f_;
+};
+
+// Binary STL; the points of the last layers are retained until no triangle refers to them
+class STLWriter : public MeshSink {
+public:
+  explicit STLWriter(const std::string &filename);
+  void begin(size_t points, size_t triangles) override;
+  void addPoints(size_t first, const PointVector &points) override;
+  void addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t oldest) override;
+  void end() override;
+
+private:
+  std::string filename_;
+  std::ofstream f_;
+  size_t first_;        // index of points_[0]
+  PointVector points_;
+};
+
+// Binary (little endian) PLY with double coordinates; as the faces follow all vertices,
+// they are collected in a temporary file
+class PLYWriter : public MeshSink {
+public:
+  explicit PLYWriter(const std::string &filename);
+  ~PLYWriter();
+  void begin(size_t points, size_t triangles) override;
+  void addPoints(size_t first, const PointVector &points) override;
+  void addTriangles(const std::vector<TriMesh::Triangle> &triangles, size_t oldest) override;
+  void end() override;
+
+private:
+  std::string filename_;
+  std::ofstream f_;
+  std::FILE *faces_;
+};
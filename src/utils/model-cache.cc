@@ -0,0 +1,513 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "domain.hh"
+
+#include "io.hh"
+#include "model-cache.hh"
+
+namespace {
+
+  const char magic[8] = "TFCACHE";
+  const uint32_t version = 1;
+  const uint32_t byte_order = 0x01020304;
+
+  size_t padded(size_t size) {
+    return (size + 7) / 8 * 8;
+  }
+
+  template<typename T>
+  void append(std::string &buffer, const T *data, size_t count) {
+    const char *bytes = reinterpret_cast<const char *>(data);
+    buffer.append(bytes, bytes + count * sizeof(T));
+  }
+
+  // Sequential reader of the file contents, with bounds checking
+  class Cursor {
+  public:
+    Cursor(const std::string &filename, const char *data, size_t size)
+      : filename_(filename), data_(data), size_(size) { }
+    template<typename T>
+    void read(T *data, size_t count) {
+      std::memcpy(data, view<T>(count), count * sizeof(T));
+    }
+    // The next count elements in place (the arrays are at 8-byte aligned offsets)
+    template<typename T>
+    const T *view(size_t count) {
+      if (count > (size_ - position_) / sizeof(T))
+        throw ParseError(filename_, 0, "truncated model cache");
+      const T *result = reinterpret_cast<const T *>(data_ + position_);
+      position_ += count * sizeof(T);
+      return result;
+    }
+    template<typename T>
+    T read() {
+      T x;
+      read(&x, 1);
+      return x;
+    }
+    void skip(size_t size) {
+      if (size > size_ - position_)
+        throw ParseError(filename_, 0, "truncated model cache");
+      position_ += size;
+    }
+    bool done() const {
+      return position_ == size_;
+    }
+
+  private:
+    const std::string &filename_;
+    const char *data_;
+    size_t size_, position_ = 0;
+  };
+
+  // Sequential reader of an entry
+  class EntryReader {
+  public:
+    EntryReader(const uint64_t *ints, size_t int_count, const double *reals, size_t real_count)
+      : ints_(ints), reals_(reals), int_count_(int_count), real_count_(real_count) { }
+    size_t index() {
+      if (next_int_ >= int_count_)
+        throw std::runtime_error("corrupt model cache entry");
+      return ints_[next_int_++];
+    }
+    double real() {
+      if (next_real_ >= real_count_)
+        throw std::runtime_error("corrupt model cache entry");
+      return reals_[next_real_++];
+    }
+    Point3D point() {
+      double x = real(), y = real(), z = real();
+      return { x, y, z };
+    }
+
+  private:
+    const uint64_t *ints_;
+    const double *reals_;
+    size_t int_count_, real_count_, next_int_ = 0, next_real_ = 0;
+  };
+
+  void addPoint(DoubleVector &reals, const Point3D &p) {
+    reals.insert(reals.end(), { p[0], p[1], p[2] });
+  }
+
+}
+
+class ModelCache::Mapping {
+public:
+  explicit Mapping(const std::string &filename);
+  ~Mapping();
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  const char *data() const;
+  size_t size() const;
+
+private:
+#ifdef _WIN32
+  std::vector<uint64_t> buffer_; // 8-byte aligned, as a mapping
+#else
+  void *address_;
+#endif
+  size_t size_;
+};
+
+#ifdef _WIN32
+
+ModelCache::Mapping::Mapping(const std::string &filename) {
+  std::ifstream f(filename, std::ios::binary | std::ios::ate);
+  if (!f.is_open())
+    throw ParseError(filename, 0, "unable to open file");
+  size_ = static_cast<size_t>(f.tellg());
+  buffer_.resize(padded(size_) / 8);
+  f.seekg(0);
+  if (!f.read(reinterpret_cast<char *>(buffer_.data()), size_))
+    throw ParseError(filename, 0, "unable to read file");
+}
+
+ModelCache::Mapping::~Mapping() {
+}
+
+const char *
+ModelCache::Mapping::data() const {
+  return reinterpret_cast<const char *>(buffer_.data());
+}
+
+#else
+
+ModelCache::Mapping::Mapping(const std::string &filename) : address_(nullptr), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw ParseError(filename, 0, "unable to open file");
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    size_ = st.st_size;
+  if (size_ > 0)
+    address_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address_ == MAP_FAILED)
+    throw ParseError(filename, 0, "unable to map file");
+}
+
+ModelCache::Mapping::~Mapping() {
+  if (address_)
+    munmap(address_, size_);
+}
+
+const char *
+ModelCache::Mapping::data() const {
+  return static_cast<const char *>(address_);
+}
+
+#endif
+
+size_t
+ModelCache::Mapping::size() const {
+  return size_;
+}
+
+bool
+ModelCache::Entry::mapped() const {
+  return mapped_ints != nullptr;
+}
+
+const uint64_t *
+ModelCache::Entry::intData() const {
+  return mapped() ? mapped_ints : ints.data();
+}
+
+size_t
+ModelCache::Entry::intCount() const {
+  return mapped() ? mapped_int_count : ints.size();
+}
+
+const double *
+ModelCache::Entry::realData() const {
+  return mapped() ? mapped_reals : reals.data();
+}
+
+size_t
+ModelCache::Entry::realCount() const {
+  return mapped() ? mapped_real_count : reals.size();
+}
+
+ModelCache::ModelCache() {
+}
+
+// The entries are not copied, but keep the mapping alive
+ModelCache::ModelCache(const std::string &filename)
+  : file_(std::make_shared<Mapping>(filename)) {
+  Cursor c(filename, file_->data(), file_->size());
+  char file_magic[8];
+  c.read(file_magic, 8);
+  if (std::memcmp(file_magic, magic, 8) != 0)
+    throw ParseError(filename, 0, "not a model cache");
+  if (c.read<uint32_t>() != version)
+    throw ParseError(filename, 0, "unsupported model cache version");
+  if (c.read<uint32_t>() != byte_order)
+    throw ParseError(filename, 0, "model cache of a different byte order");
+  uint64_t count = c.read<uint64_t>();
+  for (uint64_t i = 0; i < count; ++i) {
+    auto type = c.read<uint32_t>();
+    auto name_length = c.read<uint32_t>();
+    Entry e;
+    e.type = static_cast<EntryType>(type);
+    e.source = c.read<uint64_t>();
+    auto ints = c.read<uint64_t>(), reals = c.read<uint64_t>();
+    std::string name(name_length, '\0');
+    c.read(&name[0], name_length);
+    c.skip(padded(name_length) - name_length);
+    e.mapped_ints = c.view<uint64_t>(ints);
+    e.mapped_int_count = ints;
+    e.mapped_reals = c.view<double>(reals);
+    e.mapped_real_count = reals;
+    entries_[name] = std::move(e);
+  }
+  if (!c.done())
+    throw ParseError(filename, 0, "trailing data in model cache");
+}
+
+void
+ModelCache::save(const std::string &filename) const {
+  std::string buffer;
+  append(buffer, magic, 8);
+  append(buffer, &version, 1);
+  append(buffer, &byte_order, 1);
+  uint64_t count = entries_.size();
+  append(buffer, &count, 1);
+  for (const auto &[name, e] : entries_) {
+    uint32_t header[] = { static_cast<uint32_t>(e.type), static_cast<uint32_t>(name.size()) };
+    uint64_t sizes[] = { e.source, e.intCount(), e.realCount() };
+    append(buffer, header, 2);
+    append(buffer, sizes, 3);
+    buffer.append(name);
+    buffer.append(padded(name.size()) - name.size(), '\0');
+    append(buffer, e.intData(), e.intCount());
+    append(buffer, e.realData(), e.realCount());
+  }
+
+  // Written next to the file and renamed, as the file may be mapped (e.g. by this cache)
+  std::string temporary = filename + ".tmp";
+  {
+    std::ofstream f(temporary, std::ios::binary);
+    if (!f.is_open() || !f.write(buffer.data(), buffer.size()))
+      throw std::runtime_error("unable to write file: " + filename);
+  }
+#ifdef _WIN32
+  std::remove(filename.c_str());
+#endif
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("unable to write file: " + filename);
+  }
+}
+
+uint64_t
+ModelCache::fingerprint(const std::string &filename) {
+  std::ifstream f(filename, std::ios::binary);
+  if (!f.is_open())
+    throw ParseError(filename, 0, "unable to open file");
+  uint64_t hash = 14695981039346656037ull;
+  char buffer[1 << 16];
+  while (f) {
+    f.read(buffer, sizeof(buffer));
+    for (std::streamsize i = 0, ie = f.gcount(); i < ie; ++i) {
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+bool
+ModelCache::contains(const std::string &name, uint64_t source) const {
+  auto it = entries_.find(name);
+  return it != entries_.end() && it->second.source == source;
+}
+
+void
+ModelCache::remove(const std::string &name) {
+  entries_.erase(name);
+}
+
+ModelCache::Entry &
+ModelCache::add(const std::string &name, EntryType type, uint64_t source) {
+  auto &e = entries_[name];
+  e = Entry();
+  e.type = type;
+  e.source = source;
+  return e;
+}
+
+const ModelCache::Entry &
+ModelCache::find(const std::string &name, EntryType type) const {
+  auto it = entries_.find(name);
+  if (it == entries_.end())
+    throw std::runtime_error("no model cache entry: " + name);
+  if (it->second.type != type)
+    throw std::runtime_error("model cache entry of a different type: " + name);
+  return it->second;
+}
+
+void
+ModelCache::store(const std::string &name, const CurveVector &curves, uint64_t source) {
+  auto &e = add(name, EntryType::CURVES, source);
+  e.ints.push_back(curves.size());
+  for (const auto &c : curves) {
+    const auto &knots = c->basis().knots();
+    const auto &cpts = c->controlPoints();
+    e.ints.insert(e.ints.end(), { c->degree(), knots.size(), cpts.size() });
+    e.reals.insert(e.reals.end(), knots.begin(), knots.end());
+    for (const auto &p : cpts)
+      addPoint(e.reals, p);
+  }
+}
+
+void
+ModelCache::store(const std::string &name, const SurfaceGeneralizedBezier &surf, uint64_t source) {
+  auto &e = add(name, EntryType::BEZIER, source);
+  e.ints.push_back(surf.domain()->vertices().size());
+  e.ints.push_back(surf.degree());
+  addPoint(e.reals, surf.centralControlPoint());
+  for (size_t i = 1, ie = surf.serialCount(); i < ie; ++i) {
+    const auto &index = surf.serialControlPoint(i);
+    addPoint(e.reals, surf.controlPoint(index[0], index[1], index[2]));
+  }
+}
+
+void
+ModelCache::store(const std::string &name, const SurfaceSPatch &surf, uint64_t source) {
+  auto &e = add(name, EntryType::SPATCH, source);
+  auto indices = surf.controlPointIndices();
+  size_t n = surf.domain()->vertices().size(), d = 0;
+  if (!indices.empty())
+    for (size_t k : indices.front())
+      d += k;
+  e.ints.insert(e.ints.end(), { n, d, indices.size() });
+  for (const auto &index : indices) {
+    e.ints.insert(e.ints.end(), index.begin(), index.end());
+    addPoint(e.reals, surf.controlPoint(index));
+  }
+}
+
+void
+ModelCache::store(const std::string &name, const std::vector<SurfaceSuperD> &surfaces,
+                  uint64_t source) {
+  auto &e = add(name, EntryType::SUPERD, source);
+  e.ints.push_back(surfaces.size());
+  for (const auto &surf : surfaces) {
+    size_t n = surf.domain()->vertices().size();
+    e.ints.push_back(n);
+    e.reals.push_back(surf.fullness());
+    for (size_t i = 0; i < n; ++i)
+      addPoint(e.reals, surf.faceControlPoint(i));
+    for (size_t i = 0; i < n; ++i)
+      addPoint(e.reals, surf.edgeControlPoint(i));
+    addPoint(e.reals, surf.vertexControlPoint());
+  }
+}
+
+void
+ModelCache::store(const std::string &name, const TriMesh &mesh, const VectorVector &normals,
+                  uint64_t source) {
+  const auto &points = mesh.points();
+  const auto &triangles = mesh.triangles();
+  if (!normals.empty() && normals.size() != points.size())
+    throw std::logic_error("there should be one normal for each point");
+  auto &e = add(name, EntryType::MESH, source);
+  e.ints.insert(e.ints.end(), { points.size(), triangles.size(), normals.empty() ? 0u : 1u });
+  e.ints.reserve(3 + triangles.size() * 3);
+  for (const auto &t : triangles)
+    e.ints.insert(e.ints.end(), t.begin(), t.end());
+  e.reals.reserve((points.size() + normals.size()) * 3);
+  for (const auto &p : points)
+    addPoint(e.reals, p);
+  for (const auto &v : normals)
+    addPoint(e.reals, v);
+}
+
+void
+ModelCache::store(const std::string &name, const Point2DVector &params, uint64_t source) {
+  auto &e = add(name, EntryType::PARAMETERS, source);
+  e.ints.push_back(params.size());
+  e.reals.reserve(params.size() * 2);
+  for (const auto &p : params)
+    e.reals.insert(e.reals.end(), { p[0], p[1] });
+}
+
+CurveVector
+ModelCache::curves(const std::string &name) const {
+  const auto &e = find(name, EntryType::CURVES);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  CurveVector result(r.index());
+  for (auto &c : result) {
+    size_t deg = r.index(), nk = r.index(), nc = r.index();
+    DoubleVector knots(nk);
+    for (auto &k : knots)
+      k = r.real();
+    PointVector cpts(nc);
+    for (auto &p : cpts)
+      p = r.point();
+    c = std::make_shared<BSCurve>(deg, knots, cpts);
+  }
+  return result;
+}
+
+void
+ModelCache::bezier(const std::string &name, SurfaceGeneralizedBezier *surf) const {
+  const auto &e = find(name, EntryType::BEZIER);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  size_t n = r.index(), d = r.index();
+  surf->initNetwork(n, d);
+  surf->setCentralControlPoint(r.point());
+  for (size_t i = 1, ie = surf->serialCount(); i < ie; ++i) {
+    const auto &index = surf->serialControlPoint(i);
+    surf->setControlPoint(index[0], index[1], index[2], r.point());
+  }
+  surf->setupLoop();
+}
+
+SurfaceSPatch
+ModelCache::spatch(const std::string &name) const {
+  const auto &e = find(name, EntryType::SPATCH);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  size_t n = r.index(), d = r.index(), count = r.index();
+  SurfaceSPatch surf;
+  surf.initNetwork(n, d);
+  SurfaceSPatch::Index index(n);
+  for (size_t i = 0; i < count; ++i) {
+    for (auto &k : index)
+      k = r.index();
+    surf.setControlPoint(index, r.point());
+  }
+  surf.setupLoop();
+  return surf;
+}
+
+std::vector<SurfaceSuperD>
+ModelCache::superD(const std::string &name) const {
+  const auto &e = find(name, EntryType::SUPERD);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  std::vector<SurfaceSuperD> result(r.index());
+  for (auto &surf : result) {
+    size_t n = r.index();
+    surf.initNetwork(n);
+    surf.setFullness(r.real());
+    for (size_t i = 0; i < n; ++i)
+      surf.setFaceControlPoint(i, r.point());
+    for (size_t i = 0; i < n; ++i)
+      surf.setEdgeControlPoint(i, r.point());
+    surf.setVertexControlPoint(r.point());
+    surf.setupLoop();
+    surf.updateRibbons();
+  }
+  return result;
+}
+
+TriMesh
+ModelCache::mesh(const std::string &name, VectorVector *normals) const {
+  const auto &e = find(name, EntryType::MESH);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  size_t np = r.index(), nt = r.index();
+  bool with_normals = r.index() != 0;
+  TriMesh result;
+  for (size_t i = 0; i < nt; ++i) {
+    size_t a = r.index(), b = r.index(), c = r.index();
+    if (a >= np || b >= np || c >= np)
+      throw std::runtime_error("corrupt model cache entry");
+    result.addTriangle(a, b, c);
+  }
+  PointVector points(np);
+  for (auto &p : points)
+    p = r.point();
+  result.setPoints(points);
+  if (normals) {
+    normals->clear();
+    if (with_normals) {
+      normals->resize(np);
+      for (auto &v : *normals)
+        v = r.point();
+    }
+  }
+  return result;
+}
+
+Point2DVector
+ModelCache::parameters(const std::string &name) const {
+  const auto &e = find(name, EntryType::PARAMETERS);
+  EntryReader r(e.intData(), e.intCount(), e.realData(), e.realCount());
+  Point2DVector result(r.index());
+  for (auto &p : result) {
+    double u = r.real(), v = r.real();
+    p = { u, v };
+  }
+  return result;
+}
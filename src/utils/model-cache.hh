@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "surface-generalized-bezier.hh"
+#include "surface-spatch.hh"
+#include "surface-superd.hh"
+
+using namespace Transfinite;
+
+// A versioned binary container of named entries: curve networks, control nets,
+// tessellated meshes and parameter tables.
+// Each entry is stored as two raw arrays (integers and doubles, in native byte order)
+// at 8-byte aligned offsets, so a whole cache is read without any parsing:
+// where mmap is available, the file is mapped and its entries are used in place.
+// Entries can be tagged with the fingerprint of their source, so that a batch job
+// only has to re-read and re-tessellate inputs that have changed.
+// Errors (missing entries, wrong entry types, corrupt files) throw std::runtime_error;
+// unreadable or incompatible files throw ParseError (see io.hh).
+class ModelCache {
+public:
+  ModelCache();
+  explicit ModelCache(const std::string &filename);
+  void save(const std::string &filename) const;
+
+  // FNV-1a hash of the file contents
+  static uint64_t fingerprint(const std::string &filename);
+  // True if there is an entry of this name, created from the given source
+  bool contains(const std::string &name, uint64_t source = 0) const;
+  void remove(const std::string &name);
+
+  void store(const std::string &name, const CurveVector &curves, uint64_t source = 0);
+  void store(const std::string &name, const SurfaceGeneralizedBezier &surf, uint64_t source = 0);
+  void store(const std::string &name, const SurfaceSPatch &surf, uint64_t source = 0);
+  void store(const std::string &name, const std::vector<SurfaceSuperD> &surfaces,
+             uint64_t source = 0);
+  // Normals are optional; when given, there should be one for each point
+  void store(const std::string &name, const TriMesh &mesh, const VectorVector &normals = {},
+             uint64_t source = 0);
+  // Parameter tables, e.g. the domain points of a mesh
+  void store(const std::string &name, const Point2DVector &params, uint64_t source = 0);
+
+  CurveVector curves(const std::string &name) const;
+  // As loadBezier, this also works for derived classes
+  void bezier(const std::string &name, SurfaceGeneralizedBezier *surf) const;
+  SurfaceSPatch spatch(const std::string &name) const;
+  std::vector<SurfaceSuperD> superD(const std::string &name) const;
+  TriMesh mesh(const std::string &name, VectorVector *normals = nullptr) const;
+  Point2DVector parameters(const std::string &name) const;
+
+private:
+  enum class EntryType : uint32_t { CURVES = 1, BEZIER, SPATCH, SUPERD, MESH, PARAMETERS };
+  // The contents of a cache file, mapped into memory (or read where mmap is not available)
+  class Mapping;
+  struct Entry {
+    EntryType type;
+    uint64_t source;
+    // Stored entries own their arrays; entries read from a file point into its mapping
+    std::vector<uint64_t> ints;
+    DoubleVector reals;
+    const uint64_t *mapped_ints = nullptr;
+    const double *mapped_reals = nullptr;
+    size_t mapped_int_count = 0, mapped_real_count = 0;
+
+    bool mapped() const;
+    const uint64_t *intData() const;
+    size_t intCount() const;
+    const double *realData() const;
+    size_t realCount() const;
+  };
+
+  Entry &add(const std::string &name, EntryType type, uint64_t source);
+  const Entry &find(const std::string &name, EntryType type) const;
+
+  std::shared_ptr<const Mapping> file_;
+  std::map<std::string, Entry> entries_;
+};
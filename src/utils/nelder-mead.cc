@@ -19,7 +19,7 @@ namespace NelderMead {
   }
 
   bool optimize(const Function &f, Point &x, size_t max_iteration, double tolerance,
-                double step_length) {
+                double step_length, const std::function<bool ()> &cancel) {
     // Create starting simplex
     size_t n = x.size();
     std::vector<Point> S(n + 1, x);
@@ -33,6 +33,8 @@ namespace NelderMead {
     std::transform(S.begin(), S.end(), std::back_inserter(y), f);
 
     for (size_t iter = 0; iter < max_iteration && Delta >= tolerance; ++iter) {
+      if (cancel && cancel())
+        return false;
       // Find the extreme values
       size_t low = 0, high = 0, second = 0;
       Point centroid(n, 0);     // of the face opposite the high point
@@ -8,7 +8,8 @@ namespace NelderMead {
   using Point = std::vector<double>;
   using Function = std::function<double (const Point &)>;
 
+  // Stops early (returning false) when `cancel` is given and returns true
   bool optimize(const Function &f, Point &x, size_t max_iteration, double tolerance,
-                double step_length);
+                double step_length, const std::function<bool ()> &cancel = {});
 
 }
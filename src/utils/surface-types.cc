@@ -0,0 +1,45 @@
+#include "surface-biharmonic.hh"
+#include "surface-c0coons.hh"
+#include "surface-composite-ribbon.hh"
+#include "surface-corner-based.hh"
+#include "surface-elastic.hh"
+#include "surface-generalized-bezier-corner.hh"
+#include "surface-generalized-coons.hh"
+#include "surface-harmonic.hh"
+#include "surface-hybrid.hh"
+#include "surface-midpoint-coons.hh"
+#include "surface-midpoint.hh"
+#include "surface-nsided.hh"
+#include "surface-polar.hh"
+#include "surface-side-based.hh"
+
+#include "surface-types.hh"
+
+const SurfaceTypes<SurfaceFactory> &
+curveSurfaces() {
+  static const SurfaceTypes<SurfaceFactory> types = {
+    { "SB", []() { return std::make_shared<SurfaceSideBased>(); } },
+    { "CB", []() { return std::make_shared<SurfaceCornerBased>(); } },
+    { "GC", []() { return std::make_shared<SurfaceGeneralizedCoons>(); } },
+    { "CR", []() { return std::make_shared<SurfaceCompositeRibbon>(); } },
+    { "MP", []() { return std::make_shared<SurfaceMidpoint>(); } },
+    { "MC", []() { return std::make_shared<SurfaceMidpointCoons>(); } },
+    { "C0Coons", []() { return std::make_shared<SurfaceC0Coons>(); } },
+    { "Elastic", []() { return std::make_shared<SurfaceElastic>(); } },
+    { "Polar", []() { return std::make_shared<SurfacePolar>(); } },
+    { "NSided", []() { return std::make_shared<SurfaceNSided>(); } },
+    { "Harmonic", []() { return std::make_shared<SurfaceHarmonic>(); } },
+    { "Biharmonic", []() { return std::make_shared<SurfaceBiharmonic>(); } }
+  };
+  return types;
+}
+
+const SurfaceTypes<BezierFactory> &
+bezierSurfaces() {
+  static const SurfaceTypes<BezierFactory> types = {
+    { "GB", []() { return std::make_shared<SurfaceGeneralizedBezier>(); } },
+    { "CornerGB", []() { return std::make_shared<SurfaceGeneralizedBezierCorner>(); } },
+    { "Hybrid", []() { return std::make_shared<SurfaceHybrid>(); } }
+  };
+  return types;
+}
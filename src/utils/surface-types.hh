@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "surface-generalized-bezier.hh"
+
+using namespace Transfinite;
+
+// The surface types of the tools (transfinite-bench, transfinite-batch and the Python module),
+// by the names used on their command lines and in their inputs
+using SurfaceFactory = std::function<std::shared_ptr<Surface>()>;
+using BezierFactory = std::function<std::shared_ptr<SurfaceGeneralizedBezier>()>;
+template<typename F>
+using SurfaceTypes = std::vector<std::pair<std::string, F>>;
+
+// Surfaces on curve loops (e.g. .lop files): SB, CB, GC, CR, MP, MC, C0Coons, Elastic, Polar,
+// NSided, Harmonic and Biharmonic
+const SurfaceTypes<SurfaceFactory> &curveSurfaces();
+// Surfaces of control nets (.gbp files): GB, CornerGB and Hybrid
+const SurfaceTypes<BezierFactory> &bezierSurfaces();